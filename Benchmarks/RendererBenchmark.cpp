@@ -0,0 +1,485 @@
+//
+//  Copyright (C) 2022 Arthur Benilov <arthur.benilov@gmail.com> and Timothy Schoen <timschoen123@gmail.com>
+//
+
+/*
+    Paints a set of widget scenes through each renderer and reports the time per frame:
+
+    - juce_software:    juce::LowLevelGraphicsSoftwareRenderer into a juce::Image
+    - juce_opengl:      JUCE's OpenGL graphics context
+    - nanovg_opengl:    NanoVGGraphicsContext on the OpenGL back-end
+    - nanovg_software:  NanoVGGraphicsContext on the tiled software back-end
+
+    cpu_ms is the process CPU time per frame (which includes driver and worker threads), wall_ms
+    the elapsed time including glFinish(). Draw calls and triangles are reported by nanovg only.
+
+    Runs without a GPU or a display under Mesa's llvmpipe:
+
+        xvfb-run -a env LIBGL_ALWAYS_SOFTWARE=1 GALLIUM_DRIVER=llvmpipe \
+            ./nanovg_renderer_bench --frames 100 --json results.json
+*/
+
+#include <JuceHeader.h>
+#include <ctime>
+#include "../Source/NanoVGGraphics.h"
+#include "../Source/NanoVGSoftwareRenderer.h"
+
+static constexpr int sceneWidth = 1280;
+static constexpr int sceneHeight = 800;
+
+static const char* const loremIpsum =
+    "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor incididunt ut labore et dolore "
+    "magna aliqua. Ut enim ad minim veniam, quis nostrud exercitation ullamco laboris nisi ut aliquip ex ea commodo "
+    "consequat. Duis aute irure dolor in reprehenderit in voluptate velit esse cillum dolore eu fugiat nulla pariatur.\n";
+
+/** Lays out the children of a component in a grid. */
+static void layoutGrid (juce::Component& parent, int columns, int rowHeight)
+{
+    const int cellWidth = parent.getWidth() / columns;
+
+    for (int i = 0; i < parent.getNumChildComponents(); ++i)
+        parent.getChildComponent (i)->setBounds (juce::Rectangle<int> ((i % columns) * cellWidth, (i / columns) * rowHeight,
+                                                                       cellWidth, rowHeight).reduced (6));
+}
+
+//==============================================================================
+struct SliderScene : public juce::Component
+{
+    SliderScene()
+    {
+        const juce::Slider::SliderStyle styles[] = { juce::Slider::LinearHorizontal,
+                                                     juce::Slider::LinearVertical,
+                                                     juce::Slider::RotaryHorizontalVerticalDrag };
+
+        for (int i = 0; i < 48; ++i)
+        {
+            auto* slider = sliders.add (new juce::Slider (styles[i % 3], juce::Slider::TextBoxBelow));
+            slider->setRange (0.0, 100.0, 0.1);
+            slider->setValue ((i * 37) % 100);
+            addAndMakeVisible (slider);
+        }
+    }
+
+    void resized() override { layoutGrid (*this, 8, getHeight() / 6); }
+
+    juce::OwnedArray<juce::Slider> sliders;
+};
+
+struct ButtonScene : public juce::Component
+{
+    ButtonScene()
+    {
+        for (int i = 0; i < 96; ++i)
+        {
+            auto* button = i % 3 == 2 ? buttons.add (new juce::ToggleButton ("Toggle " + juce::String (i)))
+                                      : buttons.add (new juce::TextButton ("Button " + juce::String (i)));
+            button->setToggleState (i % 5 == 0, juce::dontSendNotification);
+            addAndMakeVisible (button);
+        }
+    }
+
+    void resized() override { layoutGrid (*this, 8, getHeight() / 12); }
+
+    juce::OwnedArray<juce::Button> buttons;
+};
+
+struct TextEditorScene : public juce::Component
+{
+    TextEditorScene()
+    {
+        for (int i = 0; i < 12; ++i)
+        {
+            auto* editor = editors.add (new juce::TextEditor());
+            editor->setMultiLine (true);
+            editor->setText (juce::String::repeatedString (loremIpsum, 1 + i % 4));
+            addAndMakeVisible (editor);
+        }
+    }
+
+    void resized() override { layoutGrid (*this, 4, getHeight() / 3); }
+
+    juce::OwnedArray<juce::TextEditor> editors;
+};
+
+struct TableScene : public juce::Component,
+                    private juce::TableListBoxModel
+{
+    TableScene()
+    {
+        for (int column = 1; column <= 10; ++column)
+            table.getHeader().addColumn ("Column " + juce::String (column), column, 124);
+
+        table.setModel (this);
+        addAndMakeVisible (table);
+    }
+
+    void resized() override { table.setBounds (getLocalBounds()); }
+
+    int getNumRows() override { return 1000; }
+
+    void paintRowBackground (juce::Graphics& g, int row, int, int, bool selected) override
+    {
+        g.fillAll (selected ? juce::Colours::darkblue : (row % 2 ? juce::Colour (0xff263238) : juce::Colour (0xff2e3b42)));
+    }
+
+    void paintCell (juce::Graphics& g, int row, int column, int width, int height, bool) override
+    {
+        g.setColour (juce::Colours::white);
+        g.setFont (14.0f);
+        g.drawText ("Cell " + juce::String (row) + ":" + juce::String (column * 1237 % 10007),
+                    4, 0, width - 8, height, juce::Justification::centredLeft, true);
+    }
+
+    juce::TableListBox table;
+};
+
+/** Level meters, a spectrum and rotary arcs, all drawn as paths. */
+struct MeterScene : public juce::Component
+{
+    void paint (juce::Graphics& g) override
+    {
+        g.fillAll (juce::Colour (0xff1b1f23));
+
+        const juce::ColourGradient gradient (juce::Colours::green, 0.0f, (float) getHeight(),
+                                             juce::Colours::red, 0.0f, 0.0f, false);
+
+        for (int i = 0; i < 64; ++i)
+        {
+            const auto bar = juce::Rectangle<float> (10.0f + (float) i * 12.0f, 20.0f, 8.0f, 360.0f);
+            const float level = 0.5f + 0.5f * std::sin ((float) i * 0.37f);
+
+            g.setColour (juce::Colours::black);
+            g.fillRoundedRectangle (bar, 2.0f);
+            g.setGradientFill (gradient);
+            g.fillRoundedRectangle (bar.withTop (bar.getBottom() - bar.getHeight() * level), 2.0f);
+        }
+
+        juce::Path spectrum;
+        spectrum.startNewSubPath (0.0f, (float) getHeight());
+
+        for (int i = 0; i < 512; ++i)
+        {
+            const float x = (float) i * (float) getWidth() / 511.0f;
+            const float y = 600.0f - 150.0f * std::abs (std::sin ((float) i * 0.05f) * std::cos ((float) i * 0.011f));
+            spectrum.lineTo (x, y);
+        }
+
+        spectrum.lineTo ((float) getWidth(), (float) getHeight());
+        spectrum.closeSubPath();
+
+        g.setColour (juce::Colours::cyan.withAlpha (0.3f));
+        g.fillPath (spectrum);
+        g.setColour (juce::Colours::cyan);
+        g.strokePath (spectrum, juce::PathStrokeType (1.5f));
+
+        for (int i = 0; i < 16; ++i)
+        {
+            const float cx = 820.0f + (float) (i % 4) * 110.0f;
+            const float cy = 70.0f + (float) (i / 4) * 100.0f;
+
+            juce::Path arc;
+            arc.addCentredArc (cx, cy, 40.0f, 40.0f, 0.0f, -2.4f, -2.4f + 4.8f * (float) (i + 1) / 16.0f, true);
+
+            g.setColour (juce::Colours::orange);
+            g.strokePath (arc, juce::PathStrokeType (6.0f, juce::PathStrokeType::curved, juce::PathStrokeType::rounded));
+        }
+    }
+};
+
+//==============================================================================
+struct Renderer
+{
+    virtual ~Renderer() = default;
+
+    virtual juce::String getName() const = 0;
+
+    /** Paints one frame of the scene, and waits for it to be finished. */
+    virtual void renderFrame (juce::Component& scene) = 0;
+
+    /** Returns the draw calls and triangles of the last frame, or -1 if the renderer can't tell. */
+    virtual std::pair<int, int> getLastFrameCounts() { return { -1, -1 }; }
+};
+
+struct JuceSoftwareRenderer : public Renderer
+{
+    juce::String getName() const override { return "juce_software"; }
+
+    void renderFrame (juce::Component& scene) override
+    {
+        image.clear (image.getBounds());
+        juce::Graphics g (image);
+        scene.paintEntireComponent (g, true);
+    }
+
+    juce::Image image { juce::Image::ARGB, sceneWidth, sceneHeight, true, juce::SoftwareImageType() };
+};
+
+struct JuceOpenGLRenderer : public Renderer
+{
+    explicit JuceOpenGLRenderer (juce::OpenGLContext& c) : context (c) {}
+
+    juce::String getName() const override { return "juce_opengl"; }
+
+    void renderFrame (juce::Component& scene) override
+    {
+        juce::OpenGLHelpers::clear (juce::Colours::transparentBlack);
+
+        {
+            auto glContext = juce::createOpenGLGraphicsContext (context, sceneWidth, sceneHeight);
+            juce::Graphics g (*glContext);
+            scene.paintEntireComponent (g, true);
+        }
+
+        glFinish();
+    }
+
+    juce::OpenGLContext& context;
+};
+
+struct NanoVGOpenGLRenderer : public Renderer
+{
+    juce::String getName() const override { return "nanovg_opengl"; }
+
+    void renderFrame (juce::Component& scene) override
+    {
+        glViewport (0, 0, sceneWidth, sceneHeight);
+        glClearColor (0, 0, 0, 0);
+        glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+        nvgBeginFrame (graphicsContext.getContext(), sceneWidth, sceneHeight, 1.0f);
+
+        {
+            juce::Graphics g (graphicsContext);
+            scene.paintEntireComponent (g, true);
+        }
+
+        graphicsContext.flush();
+        nvgEndFrame (graphicsContext.getContext());
+        glFinish();
+    }
+
+    std::pair<int, int> getLastFrameCounts() override
+    {
+        return getCounts (graphicsContext.getContext());
+    }
+
+    /** The counters of a frame are published when the next one begins. */
+    static std::pair<int, int> getCounts (NVGcontext* nvg)
+    {
+        NVGframeStats stats;
+        nvgBeginFrame (nvg, sceneWidth, sceneHeight, 1.0f);
+        nvgCancelFrame (nvg);
+        nvgFrameStats (nvg, &stats);
+        return { stats.drawCalls, stats.fillTriangles + stats.strokeTriangles + stats.textTriangles };
+    }
+
+    NanoVGGraphicsContext graphicsContext { (void*) nullptr, sceneWidth, sceneHeight, 1.0f };
+};
+
+struct NanoVGSoftwareBackend : public Renderer
+{
+    juce::String getName() const override { return "nanovg_software"; }
+
+    void renderFrame (juce::Component& scene) override
+    {
+        renderer.renderComponent (scene, 1.0f);
+    }
+
+    std::pair<int, int> getLastFrameCounts() override
+    {
+        return NanoVGOpenGLRenderer::getCounts (renderer.getContext());
+    }
+
+    NanoVGSoftwareRenderer renderer;
+};
+
+//==============================================================================
+struct Result
+{
+    juce::String scene, renderer;
+    double cpuMs, wallMs;
+    int drawCalls, triangles;
+};
+
+/**
+    Runs every scene through every renderer on the OpenGL thread, then quits.
+*/
+class BenchmarkComponent : public juce::Component,
+                           private juce::OpenGLRenderer
+{
+public:
+    BenchmarkComponent (int framesToMeasure, juce::File jsonFile)
+        : numFrames (framesToMeasure), json (std::move (jsonFile))
+    {
+        scenes.add (new SliderScene());
+        scenes.add (new ButtonScene());
+        scenes.add (new TextEditorScene());
+        scenes.add (new TableScene());
+        scenes.add (new MeterScene());
+
+        for (auto* scene : scenes)
+            scene->setBounds (0, 0, sceneWidth, sceneHeight);
+
+        setSize (sceneWidth, sceneHeight);
+
+        openGLContext.setRenderer (this);
+        openGLContext.setComponentPaintingEnabled (false);
+        openGLContext.setContinuousRepainting (false);
+        openGLContext.attachTo (*this);
+    }
+
+    ~BenchmarkComponent() override
+    {
+        openGLContext.detach();
+    }
+
+private:
+    static const char* getSceneName (int index)
+    {
+        static const char* const names[] = { "sliders", "buttons", "text_editors", "table", "meters" };
+        return names[index];
+    }
+
+    void newOpenGLContextCreated() override {}
+
+    void openGLContextClosing() override
+    {
+        renderers.clear();
+    }
+
+    void renderOpenGL() override
+    {
+        if (finished.exchange (true))
+            return;
+
+        // The scenes are components, which are only safe to paint with the message thread locked.
+        const juce::MessageManagerLock mmLock;
+
+        renderers.push_back (std::make_unique<JuceSoftwareRenderer>());
+        renderers.push_back (std::make_unique<JuceOpenGLRenderer> (openGLContext));
+        renderers.push_back (std::make_unique<NanoVGOpenGLRenderer>());
+        renderers.push_back (std::make_unique<NanoVGSoftwareBackend>());
+
+        for (int i = 0; i < scenes.size(); ++i)
+            for (auto& renderer : renderers)
+                results.push_back (measure (*scenes[i], getSceneName (i), *renderer));
+
+        report();
+
+        juce::MessageManager::callAsync ([] { juce::JUCEApplication::quit(); });
+    }
+
+    Result measure (juce::Component& scene, const juce::String& sceneName, Renderer& renderer)
+    {
+        // Uploads images and fills glyph caches.
+        for (int i = 0; i < 5; ++i)
+            renderer.renderFrame (scene);
+
+        const auto cpuStart = std::clock();
+        const auto wallStart = juce::Time::getHighResolutionTicks();
+
+        for (int i = 0; i < numFrames; ++i)
+            renderer.renderFrame (scene);
+
+        const auto wallEnd = juce::Time::getHighResolutionTicks();
+        const auto cpuEnd = std::clock();
+
+        const auto counts = renderer.getLastFrameCounts();
+
+        return { sceneName,
+                 renderer.getName(),
+                 1000.0 * (double) (cpuEnd - cpuStart) / CLOCKS_PER_SEC / numFrames,
+                 1000.0 * juce::Time::highResolutionTicksToSeconds (wallEnd - wallStart) / numFrames,
+                 counts.first,
+                 counts.second };
+    }
+
+    void report()
+    {
+        std::cout << juce::String::formatted ("%-14s %-16s %10s %10s %10s %10s\n",
+                                              "scene", "renderer", "cpu ms", "wall ms", "draws", "triangles");
+
+        auto countToString = [] (int count) { return count < 0 ? juce::String ("-") : juce::String (count); };
+
+        juce::Array<juce::var> entries;
+
+        for (auto& r : results)
+        {
+            std::cout << juce::String::formatted ("%-14s %-16s %10.3f %10.3f %10s %10s\n",
+                                                  r.scene.toRawUTF8(), r.renderer.toRawUTF8(), r.cpuMs, r.wallMs,
+                                                  countToString (r.drawCalls).toRawUTF8(),
+                                                  countToString (r.triangles).toRawUTF8());
+
+            auto* entry = new juce::DynamicObject();
+            entry->setProperty ("scene", r.scene);
+            entry->setProperty ("renderer", r.renderer);
+            entry->setProperty ("cpu_ms", r.cpuMs);
+            entry->setProperty ("wall_ms", r.wallMs);
+            entry->setProperty ("draw_calls", r.drawCalls < 0 ? juce::var() : juce::var (r.drawCalls));
+            entry->setProperty ("triangles", r.triangles < 0 ? juce::var() : juce::var (r.triangles));
+            entries.add (juce::var (entry));
+        }
+
+        if (json != juce::File())
+        {
+            auto* root = new juce::DynamicObject();
+            root->setProperty ("gl_renderer", juce::String ((const char*) glGetString (GL_RENDERER)));
+            root->setProperty ("frames", numFrames);
+            root->setProperty ("results", entries);
+
+            if (! json.replaceWithText (juce::JSON::toString (juce::var (root))))
+                std::cerr << "Could not write " << json.getFullPathName() << std::endl;
+        }
+    }
+
+    juce::OpenGLContext openGLContext;
+    juce::OwnedArray<juce::Component> scenes;
+    std::vector<std::unique_ptr<Renderer>> renderers;
+    std::vector<Result> results;
+
+    const int numFrames;
+    const juce::File json;
+    std::atomic<bool> finished { false };
+
+    JUCE_DECLARE_NON_COPYABLE (BenchmarkComponent)
+};
+
+//==============================================================================
+class RendererBenchmarkApplication : public juce::JUCEApplication
+{
+public:
+    const juce::String getApplicationName() override       { return ProjectInfo::projectName; }
+    const juce::String getApplicationVersion() override    { return ProjectInfo::versionString; }
+    bool moreThanOneInstanceAllowed() override             { return true; }
+
+    void initialise (const juce::String& commandLine) override
+    {
+        const auto args = juce::StringArray::fromTokens (commandLine, true);
+
+        int frames = 50;
+        juce::File json;
+
+        for (int i = 0; i < args.size() - 1; ++i)
+        {
+            if (args[i] == "--frames")
+                frames = juce::jmax (1, args[i + 1].getIntValue());
+            else if (args[i] == "--json")
+                json = juce::File::getCurrentWorkingDirectory().getChildFile (args[i + 1].unquoted());
+        }
+
+        window = std::make_unique<juce::DocumentWindow> (getApplicationName(), juce::Colours::black, 0);
+        window->setUsingNativeTitleBar (true);
+        window->setContentOwned (new BenchmarkComponent (frames, json), true);
+        window->setVisible (true);
+    }
+
+    void shutdown() override
+    {
+        window = nullptr;
+    }
+
+private:
+    std::unique_ptr<juce::DocumentWindow> window;
+};
+
+START_JUCE_APPLICATION (RendererBenchmarkApplication)
@@ -0,0 +1,283 @@
+// Microbenchmarks of the nanovg front-end on the null back-end: shapes, strokes with every cap and
+// join, long polylines, cubic-heavy paths, text, and state nesting. Each workload draws a number of
+// ops per frame, and is timed over whole frames. Results are printed as JSON, e.g.
+//
+//   nanovg_bench [-filter name] [-time seconds] [-font file.ttf] [-threads n] > results.json
+//
+// With -threads, fills and strokes are tessellated on that many threads, see nvgTessellationThreads().
+// ns_per_op is the time per op, vertices_per_s counts the vertices handed to the back-end.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "nanovg.h"
+#include "nanovg_simd.h"
+#define NANOVG_NULL_IMPLEMENTATION
+#include "nanovg_null.h"
+
+#ifndef NANOVG_BENCH_FONT
+#define NANOVG_BENCH_FONT "Resources/Roboto-Regular.ttf"
+#endif
+
+#define WIDTH 1920
+#define HEIGHT 1080
+
+struct Bench {
+	const char* name;
+	void (*draw)(NVGcontext* vg, const struct Bench* bench);
+	int ops;		// Ops drawn per frame.
+	int param0;		// Workload specific, e.g. line cap or text length.
+	int param1;
+};
+typedef struct Bench Bench;
+
+static const char* lorem =
+	"Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor incididunt ut labore "
+	"et dolore magna aliqua. Ut enim ad minim veniam, quis nostrud exercitation ullamco laboris nisi ut "
+	"aliquip ex ea commodo consequat. Duis aute irure dolor in reprehenderit in voluptate velit esse cillum.";
+
+static double now(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Spreads ops over the frame so that shapes differ in position and size.
+static float posX(int i) { return (float)((i * 37) % (WIDTH - 100)); }
+static float posY(int i) { return (float)((i * 53) % (HEIGHT - 100)); }
+
+static void drawRects(NVGcontext* vg, const Bench* b)
+{
+	int i;
+	nvgFillColor(vg, nvgRGBA(200, 100, 50, 255));
+	for (i = 0; i < b->ops; i++) {
+		nvgBeginPath(vg);
+		nvgRect(vg, posX(i), posY(i), 20.0f + (float)(i % 60), 10.0f + (float)(i % 40));
+		nvgFill(vg);
+	}
+}
+
+static void drawRoundedRects(NVGcontext* vg, const Bench* b)
+{
+	int i;
+	nvgFillColor(vg, nvgRGBA(50, 100, 200, 255));
+	for (i = 0; i < b->ops; i++) {
+		nvgBeginPath(vg);
+		nvgRoundedRect(vg, posX(i), posY(i), 30.0f + (float)(i % 60), 20.0f + (float)(i % 40), 2.0f + (float)(i % 8));
+		nvgFill(vg);
+	}
+}
+
+static void drawCircles(NVGcontext* vg, const Bench* b)
+{
+	int i;
+	nvgFillColor(vg, nvgRGBA(50, 200, 100, 255));
+	for (i = 0; i < b->ops; i++) {
+		nvgBeginPath(vg);
+		nvgCircle(vg, posX(i) + 50.0f, posY(i) + 50.0f, 2.0f + (float)(i % 48));
+		nvgFill(vg);
+	}
+}
+
+// A stroked wave of param0 points per op.
+static void drawPolylines(NVGcontext* vg, const Bench* b)
+{
+	int i, j;
+	nvgStrokeColor(vg, nvgRGBA(255, 255, 255, 255));
+	nvgStrokeWidth(vg, 1.5f);
+	for (i = 0; i < b->ops; i++) {
+		float y = posY(i) + 50.0f;
+		nvgBeginPath(vg);
+		nvgMoveTo(vg, 0, y);
+		for (j = 1; j < b->param0; j++) {
+			float x = (float)j * (float)WIDTH / (float)b->param0;
+			nvgLineTo(vg, x, y + 40.0f * sinf((float)(j + i) * 0.05f));
+		}
+		nvgStroke(vg);
+	}
+}
+
+// A closed blob of param0 cubic segments per op.
+static void drawCubics(NVGcontext* vg, const Bench* b)
+{
+	int i, j, n = b->param0;
+	float da = 2.0f * NVG_PI / (float)n;
+	nvgFillColor(vg, nvgRGBA(180, 80, 200, 255));
+	for (i = 0; i < b->ops; i++) {
+		float cx = posX(i) + 50.0f, cy = posY(i) + 50.0f;
+		nvgBeginPath(vg);
+		nvgMoveTo(vg, cx + 40.0f, cy);
+		for (j = 1; j <= n; j++) {
+			float a0 = da * (float)(j - 1), a1 = da * (float)j;
+			float r = j % 2 ? 50.0f : 30.0f;
+			nvgBezierTo(vg, cx + 60.0f*cosf(a0 + da*0.3f), cy + 60.0f*sinf(a0 + da*0.3f),
+						cx + 20.0f*cosf(a1 - da*0.3f), cy + 20.0f*sinf(a1 - da*0.3f),
+						cx + r*cosf(a1), cy + r*sinf(a1));
+		}
+		nvgClosePath(vg);
+		nvgFill(vg);
+	}
+}
+
+// A zigzag of 16 points per op, stroked with line cap param0 and line join param1.
+static void drawStrokes(NVGcontext* vg, const Bench* b)
+{
+	int i, j;
+	nvgStrokeColor(vg, nvgRGBA(255, 200, 0, 255));
+	nvgStrokeWidth(vg, 6.0f);
+	nvgLineCap(vg, b->param0);
+	nvgLineJoin(vg, b->param1);
+	for (i = 0; i < b->ops; i++) {
+		float x = posX(i), y = posY(i);
+		nvgBeginPath(vg);
+		nvgMoveTo(vg, x, y);
+		for (j = 1; j < 16; j++)
+			nvgLineTo(vg, x + (float)j * 6.0f, y + (j % 2 ? 20.0f : 0.0f) + (float)(i % 7));
+		nvgStroke(vg);
+	}
+}
+
+// Strings of param0 characters at param1 pixels.
+static void drawText(NVGcontext* vg, const Bench* b)
+{
+	int i, len = (int)strlen(lorem);
+	nvgFontFace(vg, "sans");
+	nvgFontSize(vg, (float)b->param1);
+	nvgFillColor(vg, nvgRGBA(255, 255, 255, 255));
+	for (i = 0; i < b->ops; i++) {
+		const char* start = lorem + (i * 7) % (len - b->param0);
+		nvgText(vg, posX(i) * 0.5f, posY(i) + (float)b->param1, start, start + b->param0);
+	}
+}
+
+// Nests param0 levels of nvgSave() with state changes, then unwinds them; one op is a save/restore pair.
+static void drawSaveRestore(NVGcontext* vg, const Bench* b)
+{
+	int i, j;
+	for (i = 0; i < b->ops / b->param0; i++) {
+		for (j = 0; j < b->param0; j++) {
+			nvgSave(vg);
+			nvgTranslate(vg, 1.0f, 0.5f);
+			nvgFillColor(vg, nvgRGBA((unsigned char)j, 0, 0, 255));
+			nvgScissor(vg, (float)j, (float)j, 500.0f, 500.0f);
+		}
+		nvgBeginPath(vg);
+		nvgRect(vg, posX(i), posY(i), 10.0f, 10.0f);
+		nvgFill(vg);
+		for (j = 0; j < b->param0; j++)
+			nvgRestore(vg);
+	}
+}
+
+static const Bench benches[] = {
+	{ "rects", drawRects, 5000, 0, 0 },
+	{ "rounded_rects", drawRoundedRects, 5000, 0, 0 },
+	{ "circles", drawCircles, 5000, 0, 0 },
+	{ "polyline_1k", drawPolylines, 50, 1000, 0 },
+	{ "polyline_10k", drawPolylines, 5, 10000, 0 },
+	{ "cubics_64", drawCubics, 200, 64, 0 },
+	{ "stroke_butt_miter", drawStrokes, 2000, NVG_BUTT, NVG_MITER },
+	{ "stroke_butt_round", drawStrokes, 2000, NVG_BUTT, NVG_ROUND },
+	{ "stroke_butt_bevel", drawStrokes, 2000, NVG_BUTT, NVG_BEVEL },
+	{ "stroke_round_miter", drawStrokes, 2000, NVG_ROUND, NVG_MITER },
+	{ "stroke_round_round", drawStrokes, 2000, NVG_ROUND, NVG_ROUND },
+	{ "stroke_round_bevel", drawStrokes, 2000, NVG_ROUND, NVG_BEVEL },
+	{ "stroke_square_miter", drawStrokes, 2000, NVG_SQUARE, NVG_MITER },
+	{ "stroke_square_round", drawStrokes, 2000, NVG_SQUARE, NVG_ROUND },
+	{ "stroke_square_bevel", drawStrokes, 2000, NVG_SQUARE, NVG_BEVEL },
+	{ "text_8_12px", drawText, 2000, 8, 12 },
+	{ "text_8_32px", drawText, 2000, 8, 32 },
+	{ "text_64_12px", drawText, 500, 64, 12 },
+	{ "text_64_32px", drawText, 500, 64, 32 },
+	{ "text_256_12px", drawText, 100, 256, 12 },
+	{ "text_256_32px", drawText, 100, 256, 32 },
+	{ "save_restore_depth8", drawSaveRestore, 8000, 8, 0 },
+	{ "save_restore_depth31", drawSaveRestore, 7936, 31, 0 },
+};
+
+static void frame(NVGcontext* vg, const Bench* b)
+{
+	nvgBeginFrame(vg, WIDTH, HEIGHT, 1.0f);
+	b->draw(vg, b);
+	nvgEndFrame(vg);
+}
+
+static int usage(void)
+{
+	fprintf(stderr, "usage: nanovg_bench [-filter name] [-time seconds] [-font file.ttf] [-threads n]\n");
+	return 1;
+}
+
+int main(int argc, char** argv)
+{
+	const char* filter = NULL;
+	const char* fontFile = NANOVG_BENCH_FONT;
+	double minTime = 0.25;
+	NVGcontext* vg;
+	int i, first = 1, threads = 1;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-filter") == 0 && i+1 < argc)
+			filter = argv[++i];
+		else if (strcmp(argv[i], "-time") == 0 && i+1 < argc)
+			minTime = atof(argv[++i]);
+		else if (strcmp(argv[i], "-font") == 0 && i+1 < argc)
+			fontFile = argv[++i];
+		else if (strcmp(argv[i], "-threads") == 0 && i+1 < argc)
+			threads = atoi(argv[++i]);
+		else
+			return usage();
+	}
+
+	vg = nvgCreateNull(NVG_NULL_ANTIALIAS);
+	if (vg == NULL) return 1;
+	nvgTessellationThreads(vg, threads);
+	if (nvgCreateFont(vg, "sans", fontFile) == -1)
+		fprintf(stderr, "Could not load %s, text benchmarks are skipped.\n", fontFile);
+
+	printf("{\n");
+	printf("  \"kernels\": \"%s\",\n", nvgBestKernels()->name);
+	printf("  \"threads\": %d,\n", nvgGetTessellationThreads(vg));
+	printf("  \"width\": %d,\n  \"height\": %d,\n", WIDTH, HEIGHT);
+	printf("  \"results\": [");
+
+	for (i = 0; i < (int)(sizeof(benches) / sizeof(benches[0])); i++) {
+		const Bench* b = &benches[i];
+		const NVGnullStats* stats;
+		double t0, elapsed;
+		long long verts;
+		int frames = 0;
+
+		if (filter != NULL && strstr(b->name, filter) == NULL) continue;
+		if (b->draw == drawText && nvgFindFont(vg, "sans") == -1) continue;
+
+		// Warm up the glyph atlas and the frame buffers.
+		frame(vg, b);
+		frame(vg, b);
+
+		t0 = now();
+		do {
+			frame(vg, b);
+			frames++;
+			elapsed = now() - t0;
+		} while (elapsed < minTime);
+
+		stats = nvgNullFrameStats(vg);
+		verts = (long long)stats->fillVerts + stats->strokeVerts + stats->triangleVerts;
+
+		printf("%s\n    {\"name\": \"%s\", \"ops\": %d, \"frames\": %d, \"ns_per_op\": %.2f, "
+			   "\"vertices_per_frame\": %lld, \"vertices_per_s\": %.0f, \"draw_calls\": %d}",
+			   first ? "" : ",", b->name, b->ops, frames, elapsed * 1e9 / ((double)frames * b->ops),
+			   verts, (double)verts * frames / elapsed, stats->fills + stats->strokes + stats->triangles);
+		fflush(stdout);
+		first = 0;
+	}
+
+	printf("\n  ]\n}\n");
+
+	nvgDeleteNull(vg);
+	return 0;
+}
@@ -0,0 +1,258 @@
+// Throughput of the path expansion kernels in nanovg_simd.c, for every kernel set the CPU supports.
+// Runs segments, joins and fringe over a large synthetic polyline, and reports time per point and
+// speedup over the array-of-structs loops nanovg used before the kernels, and over the scalar kernels.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "nanovg_simd.h"
+
+#define NPOINTS (1 << 16)
+#define NRUNS 200
+
+struct Buffers {
+	float *x, *y, *dx, *dy, *len, *dmx, *dmy;
+	unsigned char* flags;
+	NVGvertex* verts;
+};
+typedef struct Buffers Buffers;
+
+// A point as nanovg stored them before the kernels, with the loops that expanded them below.
+struct AosPoint {
+	float x,y;
+	float dx, dy;
+	float len;
+	float dmx, dmy;
+	unsigned char flags;
+};
+typedef struct AosPoint AosPoint;
+
+static double now(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static float* allocFloats(int n)
+{
+	return (float*)calloc(n, sizeof(float));
+}
+
+static void initBuffers(Buffers* b)
+{
+	int i;
+	b->x = allocFloats(NPOINTS + 1);
+	b->y = allocFloats(NPOINTS + 1);
+	b->dx = allocFloats(NPOINTS + 1);
+	b->dy = allocFloats(NPOINTS + 1);
+	b->len = allocFloats(NPOINTS + 1);
+	b->dmx = allocFloats(NPOINTS);
+	b->dmy = allocFloats(NPOINTS);
+	b->flags = (unsigned char*)calloc(NPOINTS, 1);
+	b->verts = (NVGvertex*)calloc(NPOINTS * 2, sizeof(NVGvertex));
+
+	// A wobbly spiral, so that joins turn both ways and lengths vary.
+	for (i = 0; i <= NPOINTS; i++) {
+		float t = (float)i * 0.01f;
+		float r = 100.0f + 40.0f * sinf(t * 7.0f);
+		b->x[i] = 500.0f + r * cosf(t);
+		b->y[i] = 500.0f + r * sinf(t);
+	}
+}
+
+static AosPoint* allocAosPoints(const Buffers* b)
+{
+	AosPoint* pts = (AosPoint*)calloc(NPOINTS + 1, sizeof(AosPoint));
+	int i;
+	for (i = 0; i <= NPOINTS; i++) {
+		pts[i].x = b->x[i];
+		pts[i].y = b->y[i];
+	}
+	return pts;
+}
+
+static void aosSegments(AosPoint* pts, int n)
+{
+	AosPoint* p0 = &pts[0];
+	AosPoint* p1 = &pts[1];
+	int i;
+	for (i = 0; i < n; i++) {
+		float d;
+		p0->dx = p1->x - p0->x;
+		p0->dy = p1->y - p0->y;
+		d = sqrtf(p0->dx*p0->dx + p0->dy*p0->dy);
+		if (d > 1e-6f) {
+			float id = 1.0f / d;
+			p0->dx *= id;
+			p0->dy *= id;
+		}
+		p0->len = d;
+		p0 = p1++;
+	}
+}
+
+static void aosJoins(AosPoint* pts, int n, float iw, float miterLimit, int* nleft, int* nbevel)
+{
+	AosPoint* p0 = &pts[0];
+	AosPoint* p1 = &pts[1];
+	int i;
+	for (i = 0; i < n; i++) {
+		float dlx0, dly0, dlx1, dly1, dmr2, cross, limit, len;
+		dlx0 = p0->dy;
+		dly0 = -p0->dx;
+		dlx1 = p1->dy;
+		dly1 = -p1->dx;
+		p1->dmx = (dlx0 + dlx1) * 0.5f;
+		p1->dmy = (dly0 + dly1) * 0.5f;
+		dmr2 = p1->dmx*p1->dmx + p1->dmy*p1->dmy;
+		if (dmr2 > 0.000001f) {
+			float scale = 1.0f / dmr2;
+			if (scale > 600.0f)
+				scale = 600.0f;
+			p1->dmx *= scale;
+			p1->dmy *= scale;
+		}
+		p1->flags = (p1->flags & NVG_PT_CORNER) ? NVG_PT_CORNER : 0;
+		cross = p1->dx * p0->dy - p0->dx * p1->dy;
+		if (cross > 0.0f) {
+			(*nleft)++;
+			p1->flags |= NVG_PT_LEFT;
+		}
+		len = p0->len < p1->len ? p0->len : p1->len;
+		limit = 1.01f > len * iw ? 1.01f : len * iw;
+		if ((dmr2 * limit*limit) < 1.0f)
+			p1->flags |= NVG_PR_INNERBEVEL;
+		if (p1->flags & NVG_PT_CORNER) {
+			if ((dmr2 * miterLimit*miterLimit) < 1.0f)
+				p1->flags |= NVG_PT_BEVEL;
+		}
+		if ((p1->flags & (NVG_PT_BEVEL | NVG_PR_INNERBEVEL)) != 0)
+			(*nbevel)++;
+		p0 = p1++;
+	}
+}
+
+// Only the miter vertices, bevels are emitted by the same code with and without the kernels.
+static NVGvertex* aosFringe(const AosPoint* pts, int n, float lw, float rw, float lu, float ru, NVGvertex* dst)
+{
+	int i;
+	for (i = 0; i < n; i++) {
+		const AosPoint* p1 = &pts[i];
+		dst->x = p1->x + (p1->dmx * lw); dst->y = p1->y + (p1->dmy * lw); dst->u = lu; dst->v = 1; dst++;
+		dst->x = p1->x - (p1->dmx * rw); dst->y = p1->y - (p1->dmy * rw); dst->u = ru; dst->v = 1; dst++;
+	}
+	return dst;
+}
+
+static void freeBuffers(Buffers* b)
+{
+	free(b->x); free(b->y); free(b->dx); free(b->dy); free(b->len);
+	free(b->dmx); free(b->dmy); free(b->flags); free(b->verts);
+}
+
+// Fills ns with the time per point of segments, joins and fringe.
+static void run(const NVGkernels* k, Buffers* b, double* ns, float* checksum)
+{
+	double t0, t1, t2, t3;
+	int i, j, nleft = 0, nbevel = 0;
+	int n = NPOINTS;
+	float sum = 0;
+
+	t1 = t2 = t3 = 0;
+	for (i = 0; i < NRUNS; i++) {
+		t0 = now();
+		k->segments(b->x, b->y, b->x+1, b->y+1, b->dx, b->dy, b->len, n);
+		t1 += now() - t0;
+
+		t0 = now();
+		memset(b->flags, NVG_PT_CORNER, n);
+		k->joins(b->dx, b->dy, b->len, b->dx+1, b->dy+1, b->len+1, b->dmx, b->dmy, b->flags, n-1,
+				 0.5f, 10.0f, 0, &nleft, &nbevel);
+		t2 += now() - t0;
+
+		t0 = now();
+		k->fringe(b->x, b->y, b->dmx, b->dmy, n, 2.0f, 2.0f, 0.0f, 1.0f, b->verts);
+		t3 += now() - t0;
+	}
+
+	for (j = 0; j < n*2; j += 97)
+		sum += b->verts[j].x + b->verts[j].y;
+
+	ns[0] = t1 * 1e9 / ((double)NRUNS * n);
+	ns[1] = t2 * 1e9 / ((double)NRUNS * n);
+	ns[2] = t3 * 1e9 / ((double)NRUNS * n);
+	*checksum = sum;
+}
+
+// Same as run(), with the array-of-structs loops.
+static void runAos(AosPoint* pts, Buffers* b, double* ns, float* checksum)
+{
+	double t0, t1, t2, t3;
+	int i, j, nleft = 0, nbevel = 0;
+	int n = NPOINTS;
+	float sum = 0;
+
+	t1 = t2 = t3 = 0;
+	for (i = 0; i < NRUNS; i++) {
+		t0 = now();
+		aosSegments(pts, n);
+		t1 += now() - t0;
+
+		t0 = now();
+		for (j = 0; j < n; j++)
+			pts[j].flags = NVG_PT_CORNER;
+		aosJoins(pts, n-1, 0.5f, 10.0f, &nleft, &nbevel);
+		t2 += now() - t0;
+
+		t0 = now();
+		aosFringe(pts, n, 2.0f, 2.0f, 0.0f, 1.0f, b->verts);
+		t3 += now() - t0;
+	}
+
+	for (j = 0; j < n*2; j += 97)
+		sum += b->verts[j].x + b->verts[j].y;
+
+	ns[0] = t1 * 1e9 / ((double)NRUNS * n);
+	ns[1] = t2 * 1e9 / ((double)NRUNS * n);
+	ns[2] = t3 * 1e9 / ((double)NRUNS * n);
+	*checksum = sum;
+}
+
+int main(void)
+{
+	static const char* names[3] = { "segments", "joins", "fringe" };
+	Buffers b;
+	AosPoint* pts;
+	double aos[3], scalar[3] = { 0, 0, 0 };
+	float checksum;
+	int level, i;
+
+	initBuffers(&b);
+	pts = allocAosPoints(&b);
+	printf("%d points, %d runs, best kernels: %s\n\n", NPOINTS, NRUNS, nvgBestKernels()->name);
+	printf("%-8s %-10s %10s %10s %8s %9s\n", "kernels", "stage", "ns/point", "Mpoints/s", "vs aos", "vs scalar");
+
+	runAos(pts, &b, aos, &checksum);
+	for (i = 0; i < 3; i++)
+		printf("%-8s %-10s %10.3f %10.1f %7.2fx\n", "aos", names[i], aos[i], 1e3 / aos[i], 1.0);
+	printf("%-8s checksum %g\n\n", "aos", checksum);
+
+	for (level = NVG_SIMD_SCALAR; level <= NVG_SIMD_NEON; level++) {
+		const NVGkernels* k = nvgKernels(level);
+		double ns[3];
+		if (k == NULL) continue;
+		run(k, &b, ns, &checksum);
+		if (level == NVG_SIMD_SCALAR)
+			memcpy(scalar, ns, sizeof(scalar));
+		for (i = 0; i < 3; i++)
+			printf("%-8s %-10s %10.3f %10.1f %7.2fx %8.2fx\n", k->name, names[i], ns[i], 1e3 / ns[i], aos[i] / ns[i], scalar[i] / ns[i]);
+		printf("%-8s checksum %g\n\n", k->name, checksum);
+	}
+
+	free(pts);
+	freeBuffers(&b);
+	return 0;
+}
@@ -0,0 +1,161 @@
+// Replays a .nvgtrace file recorded with nvgTraceBegin(), and reports the time taken per frame.
+//
+//   nanovg_replay <file.nvgtrace> [-backend null|sw] [-repeat N] [-out last-frame.ppm]
+//
+// The null back-end measures the front-end alone (path flattening, tessellation, text layout), and
+// prints a checksum of the geometry of every frame, so that two builds can be compared. The sw
+// back-end rasterises the frames too, and can write the last one to an image.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "nanovg.h"
+#define NANOVG_NULL_IMPLEMENTATION
+#include "nanovg_null.h"
+#define NANOVG_SW_IMPLEMENTATION
+#include "nanovg_sw.h"
+
+struct FrameTimes {
+	double min, max, total;
+};
+typedef struct FrameTimes FrameTimes;
+
+static double now(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static int usage(void)
+{
+	fprintf(stderr, "usage: nanovg_replay <file.nvgtrace> [-backend null|sw] [-repeat N] [-out last-frame.ppm]\n");
+	return 1;
+}
+
+static int writePPM(const char* filename, const unsigned char* pixels, int w, int h)
+{
+	FILE* fp = fopen(filename, "wb");
+	int i;
+	if (fp == NULL) return 0;
+	fprintf(fp, "P6\n%d %d\n255\n", w, h);
+	for (i = 0; i < w*h; i++)
+		fwrite(&pixels[i*4], 1, 3, fp);
+	fclose(fp);
+	return 1;
+}
+
+int main(int argc, char** argv)
+{
+	const char* filename = NULL;
+	const char* backend = "null";
+	const char* out = NULL;
+	int repeat = 100;
+	NVGcontext* vg = NULL;
+	NVGreplay* replay = NULL;
+	FrameTimes* times = NULL;
+	unsigned char* pixels = NULL;
+	int i, j, nframes, pw = 0, ph = 0;
+	double total = 0;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-backend") == 0 && i+1 < argc)
+			backend = argv[++i];
+		else if (strcmp(argv[i], "-repeat") == 0 && i+1 < argc)
+			repeat = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-out") == 0 && i+1 < argc)
+			out = argv[++i];
+		else if (argv[i][0] != '-' && filename == NULL)
+			filename = argv[i];
+		else
+			return usage();
+	}
+	if (filename == NULL || repeat < 1) return usage();
+
+	if (strcmp(backend, "null") == 0)
+		vg = nvgCreateNull(NVG_NULL_ANTIALIAS | NVG_NULL_CHECKSUM);
+	else if (strcmp(backend, "sw") == 0)
+		vg = nvgCreateSW(NVG_SW_ANTIALIAS);
+	else
+		return usage();
+	if (vg == NULL) {
+		fprintf(stderr, "Could not create the %s back-end.\n", backend);
+		return 1;
+	}
+
+	replay = nvgReplayLoad(vg, filename);
+	if (replay == NULL) {
+		fprintf(stderr, "Could not load %s.\n", filename);
+		return 1;
+	}
+	nframes = nvgReplayFrameCount(replay);
+	if (nframes == 0) {
+		fprintf(stderr, "%s has no complete frames.\n", filename);
+		return 1;
+	}
+
+	// The software target must fit the largest frame.
+	if (strcmp(backend, "sw") == 0) {
+		for (i = 0; i < nframes; i++) {
+			float w, h, ratio;
+			nvgReplayFrameSize(replay, i, &w, &h, &ratio);
+			if ((int)(w*ratio + 0.5f) > pw) pw = (int)(w*ratio + 0.5f);
+			if ((int)(h*ratio + 0.5f) > ph) ph = (int)(h*ratio + 0.5f);
+		}
+		pixels = (unsigned char*)malloc((size_t)pw * ph * 4);
+		if (pixels == NULL) return 1;
+		nvgswSetTarget(vg, pixels, pw, ph, pw*4);
+	}
+
+	times = (FrameTimes*)calloc(nframes, sizeof(FrameTimes));
+	if (times == NULL) return 1;
+
+	// One pass to upload images and fill glyph atlases, which is not timed.
+	for (i = 0; i < nframes; i++)
+		nvgReplayFrame(replay, i);
+
+	for (j = 0; j < repeat; j++) {
+		for (i = 0; i < nframes; i++) {
+			double t;
+			if (pixels != NULL)
+				memset(pixels, 0, (size_t)pw * ph * 4);
+			t = now();
+			nvgReplayFrame(replay, i);
+			t = now() - t;
+			if (j == 0 || t < times[i].min) times[i].min = t;
+			if (j == 0 || t > times[i].max) times[i].max = t;
+			times[i].total += t;
+			total += t;
+		}
+	}
+
+	printf("%s: %d frames, %d repeats, %s back-end\n\n", filename, nframes, repeat, backend);
+	printf("%6s %10s %10s %10s", "frame", "min ms", "mean ms", "max ms");
+	if (pixels == NULL) printf(" %16s", "checksum");
+	printf("\n");
+	for (i = 0; i < nframes; i++) {
+		printf("%6d %10.3f %10.3f %10.3f", i, times[i].min*1e3, times[i].total*1e3/repeat, times[i].max*1e3);
+		if (pixels == NULL) {
+			// The checksum is of the last replay of the frame.
+			nvgReplayFrame(replay, i);
+			printf(" %016llx", (unsigned long long)nvgNullFrameStats(vg)->checksum);
+		}
+		printf("\n");
+	}
+	printf("\ntotal %.3f ms per pass, %.1f frames/s\n", total*1e3/repeat, (double)nframes*repeat/total);
+
+	if (out != NULL && pixels != NULL) {
+		if (!writePPM(out, pixels, pw, ph))
+			fprintf(stderr, "Could not write %s.\n", out);
+	}
+
+	nvgReplayDelete(replay);
+	if (pixels != NULL)
+		nvgDeleteSW(vg);
+	else
+		nvgDeleteNull(vg);
+	free(times);
+	free(pixels);
+	return 0;
+}
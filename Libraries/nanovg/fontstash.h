@@ -131,6 +131,18 @@ void fonsVertMetrics(FONScontext* s, float* ascender, float* descender, float* l
 int fonsTextIterInit(FONScontext* stash, FONStextIter* iter, float x, float y, const char* str, const char* end, int bitmapOption);
 int fonsTextIterNext(FONScontext* stash, FONStextIter* iter, struct FONSquad* quad);
 
+// Quad of a single codepoint with its origin at x,y, for text laid out elsewhere.
+// Kerning and horizontal alignment are not applied. Returns 0 if the glyph is not available.
+int fonsCodepointQuad(FONScontext* stash, unsigned int codepoint, float x, float y, int bitmapOption, struct FONSquad* quad);
+
+// Same as fonsCodepointQuad(), but for a glyph index of the current font, e.g. from a shaper.
+// Fallback fonts are not searched.
+int fonsGlyphQuad(FONScontext* stash, int glyphIndex, float x, float y, int bitmapOption, struct FONSquad* quad);
+
+// Glyph index of a codepoint in the current font, without searching fallback fonts.
+// Returns 0 if the font has no glyph for it and -1 if there is no current font.
+int fonsGlyphIndex(FONScontext* stash, unsigned int codepoint);
+
 // Pull texture changes
 const unsigned char* fonsGetTextureData(FONScontext* stash, int* width, int* height);
 int fonsValidateTexture(FONScontext* s, int* dirty);
@@ -1054,6 +1066,10 @@ static void fons__blur(FONScontext* stash, unsigned char* dst, int w, int h, int
 //	fons__blurcols(dst, w, h, dstStride, alpha);
 }
 
+// Glyphs requested by index are cached with their index and this bit as the codepoint,
+// which is beyond the Unicode range.
+#define FONS_GLYPH_INDEX 0x80000000u
+
 static FONSglyph* fons__getGlyph(FONScontext* stash, FONSfont* font, unsigned int codepoint,
 								 short isize, short iblur, int bitmapOption)
 {
@@ -1090,9 +1106,12 @@ static FONSglyph* fons__getGlyph(FONScontext* stash, FONSfont* font, unsigned in
 	}
 
 	// Create a new glyph or rasterize bitmap data for a cached glyph.
-	g = fons__tt_getGlyphIndex(&font->font, codepoint);
+	if (codepoint & FONS_GLYPH_INDEX)
+		g = (int)(codepoint & ~FONS_GLYPH_INDEX);
+	else
+		g = fons__tt_getGlyphIndex(&font->font, codepoint);
 	// Try to find the glyph in fallback fonts.
-	if (g == 0) {
+	if (g == 0 && !(codepoint & FONS_GLYPH_INDEX)) {
 		for (i = 0; i < font->nfallbacks; ++i) {
 			FONSfont* fallbackFont = stash->fonts[font->fallbacks[i]];
 			int fallbackIndex = fons__tt_getGlyphIndex(&fallbackFont->font, codepoint);
@@ -1438,6 +1457,52 @@ int fonsTextIterNext(FONScontext* stash, FONStextIter* iter, FONSquad* quad)
 	return 1;
 }
 
+static int fons__positionedQuad(FONScontext* stash, unsigned int codepoint, float x, float y, int bitmapOption, FONSquad* quad)
+{
+	FONSstate* state = fons__getState(stash);
+	FONSfont* font;
+	FONSglyph* glyph;
+	short isize;
+
+	if (state->font < 0 || state->font >= stash->nfonts) return 0;
+	font = stash->fonts[state->font];
+	if (font->data == NULL) return 0;
+
+	isize = (short)(state->size*10.0f);
+	glyph = fons__getGlyph(stash, font, codepoint, isize, (short)state->blur, bitmapOption);
+	if (glyph == NULL) return 0;
+
+	y += fons__getVertAlign(stash, font, state->align, isize);
+	// The scale is only used for kerning, which needs a previous glyph.
+	fons__getQuad(stash, font, -1, glyph, 0.0f, state->spacing, &x, &y, quad);
+
+	return 1;
+}
+
+int fonsCodepointQuad(FONScontext* stash, unsigned int codepoint, float x, float y, int bitmapOption, FONSquad* quad)
+{
+	if (codepoint & FONS_GLYPH_INDEX) return 0;
+	return fons__positionedQuad(stash, codepoint, x, y, bitmapOption, quad);
+}
+
+int fonsGlyphQuad(FONScontext* stash, int glyphIndex, float x, float y, int bitmapOption, FONSquad* quad)
+{
+	if (glyphIndex < 0) return 0;
+	return fons__positionedQuad(stash, (unsigned int)glyphIndex | FONS_GLYPH_INDEX, x, y, bitmapOption, quad);
+}
+
+int fonsGlyphIndex(FONScontext* stash, unsigned int codepoint)
+{
+	FONSstate* state = fons__getState(stash);
+	FONSfont* font;
+
+	if (state->font < 0 || state->font >= stash->nfonts) return -1;
+	font = stash->fonts[state->font];
+	if (font->data == NULL) return -1;
+
+	return fons__tt_getGlyphIndex(&font->font, (int)codepoint);
+}
+
 void fonsDrawDebug(FONScontext* stash, float x, float y)
 {
 	int i;
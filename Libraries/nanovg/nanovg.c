@@ -22,6 +22,9 @@
 #include <memory.h>
 
 #include "nanovg.h"
+#include "nanovg_simd.h"
+#include "nanovg_jobs.h"
+#include "nanovg_trace.h"
 #define FONTSTASH_IMPLEMENTATION
 #include "fontstash.h"
 #define STB_IMAGE_IMPLEMENTATION
@@ -40,30 +43,32 @@
 
 #define NVG_INIT_COMMANDS_SIZE 256
 #define NVG_INIT_POINTS_SIZE 128
+#define NVG_APPEND_CHUNK 64
 #define NVG_INIT_PATHS_SIZE 16
 #define NVG_INIT_VERTS_SIZE 256
+#define NVG_INIT_ARENA_SIZE (128*1024)
+#define NVG_ARENA_ALIGN 16
 #define NVG_MAX_STATES 32
+#define NVG_MAX_LAYERS 16
 
-#define NVG_KAPPA90 0.5522847493f	// Length proportional to radius of a cubic bezier handle for 90deg arcs.
+// Colour ramps of gradients with stops, one per row of the ramp atlas.
+#define NVG_RAMP_WIDTH 256
+#define NVG_RAMP_ROWS 64
+#define NVG_MAX_BEZIER_SEGMENTS 1024
 
-#define NVG_COUNTOF(arr) (sizeof(arr) / sizeof(0[arr]))
+#define NVG_RETAINED_BUCKETS 256
+#define NVG_RETAINED_BUDGET (4*1024*1024)
 
+#define NVG_TEXT_CACHE_BUCKETS 256
+#define NVG_TEXT_CACHE_BUDGET (1024*1024)
 
-enum NVGcommands {
-	NVG_MOVETO = 0,
-	NVG_LINETO = 1,
-	NVG_BEZIERTO = 2,
-	NVG_CLOSE = 3,
-	NVG_WINDING = 4,
-};
+// Deferred fills and strokes tessellated together at most, more are tessellated in another batch.
+#define NVG_MAX_DEFERRED 1024
+
+#define NVG_KAPPA90 0.5522847493f	// Length proportional to radius of a cubic bezier handle for 90deg arcs.
+
+#define NVG_COUNTOF(arr) (sizeof(arr) / sizeof(0[arr]))
 
-enum NVGpointFlags
-{
-	NVG_PT_CORNER = 0x01,
-	NVG_PT_LEFT = 0x02,
-	NVG_PT_BEVEL = 0x04,
-	NVG_PR_INNERBEVEL = 0x08,
-};
 
 struct NVGstate {
 	NVGcompositeOperationState compositeOperation;
@@ -86,6 +91,24 @@ struct NVGstate {
 };
 typedef struct NVGstate NVGstate;
 
+// Points are stored as a structure of arrays, so that segment directions, miters and plain fringe
+// vertices can be computed several points at a time by the kernels in nanovg_simd.c. All arrays
+// live in a single block starting at x.
+struct NVGpoints {
+	float* x;
+	float* y;
+	float* dx;
+	float* dy;
+	float* len;
+	float* dmx;
+	float* dmy;
+	unsigned char* flags;
+};
+typedef struct NVGpoints NVGpoints;
+
+#define NVG_POINT_BYTES (7*sizeof(float) + sizeof(unsigned char))
+
+// A single point gathered from NVGpoints, used by the join and cap builders.
 struct NVGpoint {
 	float x,y;
 	float dx, dy;
@@ -96,28 +119,197 @@ struct NVGpoint {
 typedef struct NVGpoint NVGpoint;
 
 struct NVGpathCache {
-	NVGpoint* points;
+	NVGpoints points;
 	int npoints;
 	int cpoints;
+	int gpoints;
 	NVGpath* paths;
 	int npaths;
 	int cpaths;
+	int gpaths;
 	NVGvertex* verts;
 	int nverts;
 	int cverts;
+	int gverts;
 	float bounds[4];
 };
 typedef struct NVGpathCache NVGpathCache;
 
+struct NVGarenaBlock {
+	struct NVGarenaBlock* next;
+};
+typedef struct NVGarenaBlock NVGarenaBlock;
+
+struct NVGarena {
+	NVGallocator allocator;
+	unsigned char* base;
+	int size;
+	int used;
+	int generation;			// Bumped on every rewind, buffers carved earlier are stale.
+	NVGarenaBlock* overflow;	// Heap blocks used once the arena ran out, freed on rewind.
+	int overflowBytes;
+	int allocations;
+	int bytes;
+	NVGframeStats last;
+};
+
+struct NVGretainedPath {
+	int first;
+	int count;
+	unsigned char closed;
+	int winding;
+	int convex;
+	int fillOffset;
+	int nfill;
+	int fringeOffset;
+	int nfringe;
+	int strokeOffset;
+	int nstroke;
+};
+typedef struct NVGretainedPath NVGretainedPath;
+
+struct NVGretained {
+	unsigned long long key;
+	float xform[6];			// Transform the geometry was built with, only the translation may differ on reuse.
+	float devicePxRatio;
+	float* commands;		// Commands the path was built from, compared on reuse, or NULL.
+	int ncommands;
+	NVGpoints points;
+	int npoints;
+	NVGretainedPath* paths;
+	int npaths;
+	float bounds[4];
+	// Fill geometry
+	int hasFill;
+	float fillFringe;
+	NVGvertex* fillVerts;
+	int nfillVerts;
+	// Stroke geometry
+	int hasStroke;
+	float strokeWidth;
+	float strokeFringe;
+	float miterLimit;
+	int lineCap;
+	int lineJoin;
+	NVGvertex* strokeVerts;
+	int nstrokeVerts;
+	int bytes;
+	struct NVGretained* next;
+	struct NVGretained* lruPrev;
+	struct NVGretained* lruNext;
+};
+typedef struct NVGretained NVGretained;
+
+struct NVGretainedCache {
+	NVGretained* buckets[NVG_RETAINED_BUCKETS];
+	NVGretained* lruHead;	// Most recently used.
+	NVGretained* lruTail;	// Least recently used.
+	NVGretained* current;	// Entry bound to the current path, or NULL.
+	unsigned long long pendingKey;
+	int pending;			// Set when the current path should be retained under pendingKey.
+	float* pendingCommands;	// Commands to retain with the current path.
+	int npendingCommands;
+	int cpendingCommands;
+	float origin[2];		// Translation of the current path in device space, retained geometry is moved to it.
+	int nentries;
+	int bytes;
+	int budget;
+	int hits;
+	int misses;
+};
+typedef struct NVGretainedCache NVGretainedCache;
+
+// Text style a run was shaped with, compared bytewise.
+struct NVGtextKey {
+	int fontId;
+	int align;
+	float size;			// Font size, letter spacing and blur in device pixels.
+	float spacing;
+	float blur;
+	float fracx, fracy;	// Sub-pixel position of the origin, glyph quads snap to pixels.
+	int length;
+};
+typedef struct NVGtextKey NVGtextKey;
+
+struct NVGtextRun {
+	unsigned long long hash;
+	NVGtextKey key;
+	char* string;
+	FONSquad* quads;		// Relative to the pixel of the origin, in device pixels.
+	int nquads;
+	float advance;
+	int bytes;
+	struct NVGtextRun* next;
+	struct NVGtextRun* lruPrev;
+	struct NVGtextRun* lruNext;
+};
+typedef struct NVGtextRun NVGtextRun;
+
+struct NVGtextCache {
+	NVGtextRun* buckets[NVG_TEXT_CACHE_BUCKETS];
+	NVGtextRun* lruHead;	// Most recently used.
+	NVGtextRun* lruTail;	// Least recently used.
+	int bytes;
+	int budget;
+};
+typedef struct NVGtextCache NVGtextCache;
+
+struct NVGramp {
+	unsigned long long hash;	// Hash of the stops.
+	unsigned int frame;			// Frame the ramp was last used in.
+	int used;
+};
+typedef struct NVGramp NVGramp;
+
+enum NVGdeferredType {
+	NVG_DEFERRED_FILL,
+	NVG_DEFERRED_STROKE,
+};
+
+// A fill or stroke recorded with tessellation threads, see nvgTessellationThreads().
+struct NVGdeferred {
+	int type;
+	NVGpaint paint;			// With the global alpha applied.
+	NVGcompositeOperationState compositeOperation;
+	NVGscissor scissor;
+	float fringe;			// Width of the anti-aliased fringe, 0 without.
+	float strokeWidth;
+	int lineCap;
+	int lineJoin;
+	float miterLimit;
+	int firstCommand;		// Path commands, in the deferred commands of the context.
+	int ncommands;
+	// Tessellated paths, in the buffers of the thread which tessellated them.
+	int worker;
+	int firstPath;
+	int npaths;
+	float bounds[4];
+};
+typedef struct NVGdeferred NVGdeferred;
+
+// A tessellated path. Its vertices are kept as offsets, the buffer they are in may still move
+// while the thread tessellates more paths.
+struct NVGtessPath {
+	NVGpath path;
+	int fillOffset;
+	int strokeOffset;
+};
+typedef struct NVGtessPath NVGtessPath;
+
 struct NVGcontext {
 	NVGparams params;
 	float* commands;
 	int ccommands;
 	int ncommands;
+	int gcommands;
 	float commandx, commandy;
 	NVGstate states[NVG_MAX_STATES];
 	int nstates;
 	NVGpathCache* cache;
+	NVGretainedCache* retained;
+	NVGtextCache* textCache;
+	NVGarena* arena;
+	const NVGkernels* kernels;
 	float tessTol;
 	float distTol;
 	float fringeWidth;
@@ -129,7 +321,47 @@ struct NVGcontext {
 	int fillTriCount;
 	int strokeTriCount;
 	int textTriCount;
+	int textCachedCount;
+	int textShapedCount;
+	unsigned int frameIndex;
+	NVGtrace* trace;
+	int traceMute;
+	int layers[NVG_MAX_LAYERS];	// Layers from renderBeginLayer(), or -1.
+	int nlayers;
+	int rampImage;
+	unsigned char* rampPixels;
+	NVGramp ramps[NVG_RAMP_ROWS];
+	// Tessellation threads, and the fills and strokes waiting for them.
+	NVGjobs* jobs;
+	struct NVGtessWorker** tessWorkers;
+	int ntessWorkers;
+	NVGdeferred* deferred;
+	int cdeferred;
+	int ndeferred;
+	int gdeferred;
+	float* deferredCommands;
+	int cdeferredCommands;
+	int ndeferredCommands;
+	int gdeferredCommands;
+	NVGpath* deferredPaths;		// Paths of a deferred fill or stroke handed to the back-end.
+	int cdeferredPaths;
+	int gdeferredPaths;
+};
+
+// Flattening and expansion work on a context, so each tessellation thread has one of its own with
+// only the fields they use: the path cache, an arena for it, the tolerances and the kernels. The
+// vertices of the paths it tessellates in a batch are put one after another in the path cache.
+struct NVGtessWorker {
+	NVGcontext ctx;
+	NVGtessPath* paths;
+	int cpaths;
+	int npaths;
+	int gpaths;
 };
+typedef struct NVGtessWorker NVGtessWorker;
+
+static void nvg__flushDeferred(NVGcontext* ctx);
+static void nvg__deleteTessWorkers(NVGcontext* ctx);
 
 static float nvg__sqrtf(float a) { return sqrtf(a); }
 static float nvg__modf(float a, float b) { return fmodf(a, b); }
@@ -164,37 +396,174 @@ static float nvg__normalize(float *x, float* y)
 static void nvg__deletePathCache(NVGpathCache* c)
 {
 	if (c == NULL) return;
-	if (c->points != NULL) free(c->points);
-	if (c->paths != NULL) free(c->paths);
-	if (c->verts != NULL) free(c->verts);
 	free(c);
 }
 
-static NVGpathCache* nvg__allocPathCache(void)
+static NVGpathCache* nvg__allocPathCache(const NVGmemoryParams* memory)
 {
 	NVGpathCache* c = (NVGpathCache*)malloc(sizeof(NVGpathCache));
-	if (c == NULL) goto error;
+	if (c == NULL) return NULL;
 	memset(c, 0, sizeof(NVGpathCache));
 
-	c->points = (NVGpoint*)malloc(sizeof(NVGpoint)*NVG_INIT_POINTS_SIZE);
-	if (!c->points) goto error;
-	c->npoints = 0;
-	c->cpoints = NVG_INIT_POINTS_SIZE;
+	// The buffers themselves are carved from the frame arena on first use.
+	c->cpoints = memory->points > 0 ? memory->points : NVG_INIT_POINTS_SIZE;
+	c->cpaths = memory->paths > 0 ? memory->paths : NVG_INIT_PATHS_SIZE;
+	c->cverts = memory->verts > 0 ? memory->verts : NVG_INIT_VERTS_SIZE;
 
-	c->paths = (NVGpath*)malloc(sizeof(NVGpath)*NVG_INIT_PATHS_SIZE);
-	if (!c->paths) goto error;
-	c->npaths = 0;
-	c->cpaths = NVG_INIT_PATHS_SIZE;
+	return c;
+}
 
-	c->verts = (NVGvertex*)malloc(sizeof(NVGvertex)*NVG_INIT_VERTS_SIZE);
-	if (!c->verts) goto error;
-	c->nverts = 0;
-	c->cverts = NVG_INIT_VERTS_SIZE;
+static int nvg__alignArena(int size)
+{
+	return (size + NVG_ARENA_ALIGN-1) & ~(NVG_ARENA_ALIGN-1);
+}
 
-	return c;
-error:
-	nvg__deletePathCache(c);
-	return NULL;
+static void* nvg__arenaDefaultAlloc(void* userPtr, int size)
+{
+	NVG_NOTUSED(userPtr);
+	return malloc(size);
+}
+
+static void nvg__arenaDefaultFree(void* userPtr, void* ptr)
+{
+	NVG_NOTUSED(userPtr);
+	free(ptr);
+}
+
+static void* nvg__arenaHeapAlloc(NVGarena* arena, int size)
+{
+	void* ptr = arena->allocator.alloc(arena->allocator.userPtr, size);
+	if (ptr == NULL) return NULL;
+	arena->allocations++;
+	arena->bytes += size;
+	return ptr;
+}
+
+static void nvg__deleteArena(NVGarena* arena)
+{
+	if (arena == NULL) return;
+	while (arena->overflow != NULL) {
+		NVGarenaBlock* next = arena->overflow->next;
+		arena->allocator.free(arena->allocator.userPtr, arena->overflow);
+		arena->overflow = next;
+	}
+	if (arena->base != NULL)
+		arena->allocator.free(arena->allocator.userPtr, arena->base);
+	free(arena);
+}
+
+static NVGarena* nvg__createArena(const NVGmemoryParams* memory)
+{
+	NVGarena* arena = (NVGarena*)malloc(sizeof(NVGarena));
+	if (arena == NULL) return NULL;
+	memset(arena, 0, sizeof(NVGarena));
+
+	arena->allocator = memory->allocator;
+	if (arena->allocator.alloc == NULL || arena->allocator.free == NULL) {
+		arena->allocator.alloc = nvg__arenaDefaultAlloc;
+		arena->allocator.free = nvg__arenaDefaultFree;
+	}
+
+	arena->size = nvg__alignArena(memory->arenaSize > 0 ? memory->arenaSize : NVG_INIT_ARENA_SIZE);
+	arena->base = (unsigned char*)nvg__arenaHeapAlloc(arena, arena->size);
+	if (arena->base == NULL) {
+		nvg__deleteArena(arena);
+		return NULL;
+	}
+	arena->generation = 1;
+
+	return arena;
+}
+
+// Rewinds the arena, invalidating everything carved from it since the last rewind.
+static void nvg__rewindArena(NVGarena* arena)
+{
+	int peak = arena->used + arena->overflowBytes;
+
+	arena->last.allocations = arena->allocations;
+	arena->last.bytes = arena->bytes;
+	arena->last.arenaSize = arena->size;
+	arena->last.arenaPeak = peak;
+	arena->allocations = 0;
+	arena->bytes = 0;
+
+	while (arena->overflow != NULL) {
+		NVGarenaBlock* next = arena->overflow->next;
+		arena->allocator.free(arena->allocator.userPtr, arena->overflow);
+		arena->overflow = next;
+	}
+	arena->overflowBytes = 0;
+
+	// Grow to the high-water mark so the next frame fits in one block.
+	if (peak > arena->size) {
+		int size = nvg__alignArena(peak);
+		unsigned char* base = (unsigned char*)nvg__arenaHeapAlloc(arena, size);
+		if (base != NULL) {
+			arena->allocator.free(arena->allocator.userPtr, arena->base);
+			arena->base = base;
+			arena->size = size;
+		}
+	}
+
+	arena->used = 0;
+	arena->generation++;
+}
+
+static void* nvg__arenaAlloc(NVGarena* arena, int size)
+{
+	NVGarenaBlock* block;
+
+	size = nvg__alignArena(size);
+	if (arena->used + size <= arena->size) {
+		void* ptr = arena->base + arena->used;
+		arena->used += size;
+		return ptr;
+	}
+
+	// Out of space, use the heap until the arena is resized on the next rewind.
+	block = (NVGarenaBlock*)nvg__arenaHeapAlloc(arena, NVG_ARENA_ALIGN + size);
+	if (block == NULL) return NULL;
+	block->next = arena->overflow;
+	arena->overflow = block;
+	arena->overflowBytes += size;
+
+	return (unsigned char*)block + NVG_ARENA_ALIGN;
+}
+
+void* nvgArenaReserve(NVGarena* arena, void* ptr, int* capacity, int* generation, int count, int keep, int elemSize)
+{
+	unsigned char* data;
+	int cap;
+
+	if (*generation != arena->generation) {
+		// The arena was rewound since this buffer was carved, start over at the previous capacity.
+		ptr = NULL;
+		keep = 0;
+		cap = nvg__maxi(count, *capacity);
+	} else if (count <= *capacity) {
+		return ptr;
+	} else {
+		int oldSize = nvg__alignArena(*capacity * elemSize);
+		cap = count + *capacity/2; // 1.5x Overallocate
+		// Grow in place if this is the most recent allocation.
+		if (ptr != NULL && (unsigned char*)ptr + oldSize == arena->base + arena->used) {
+			int extra = nvg__alignArena(cap * elemSize) - oldSize;
+			if (arena->used + extra <= arena->size) {
+				arena->used += extra;
+				*capacity = cap;
+				return ptr;
+			}
+		}
+	}
+
+	data = (unsigned char*)nvg__arenaAlloc(arena, cap * elemSize);
+	if (data == NULL) return NULL;
+	if (ptr != NULL && keep > 0)
+		memcpy(data, ptr, keep * elemSize);
+	*capacity = cap;
+	*generation = arena->generation;
+
+	return data;
 }
 
 static void nvg__setDevicePixelRatio(NVGcontext* ctx, float ratio)
@@ -283,6 +652,55 @@ static NVGstate* nvg__getState(NVGcontext* ctx)
 	return &ctx->states[ctx->nstates-1];
 }
 
+// Records a call while a trace is active. Calls made by other API functions are muted, so that
+// only the call the application made is recorded.
+#define NVG_TRACE(ctx, ...) do { if ((ctx)->trace != NULL && (ctx)->traceMute == 0) nvg__trace((ctx), __VA_ARGS__); } while (0)
+#define NVG_TRACE_MUTED(ctx, call) do { (ctx)->traceMute++; call; (ctx)->traceMute--; } while (0)
+
+static void nvg__trace(NVGcontext* ctx, int op, ...)
+{
+	va_list args;
+	int recording;
+	va_start(args, op);
+	recording = nvgTraceWriteV(ctx->trace, op, args);
+	va_end(args);
+	if (!recording)
+		nvgTraceEnd(ctx);
+}
+
+// Images created before the trace started are not in it, they are replaced on replay.
+static void nvg__traceImage(NVGcontext* ctx, int image)
+{
+	int w = 0, h = 0;
+	if (ctx->trace == NULL || image == 0 || nvgTraceHasImage(ctx->trace, image)) return;
+	ctx->params.renderGetTextureSize(ctx->params.userPtr, image, &w, &h);
+	nvgTraceAddImage(ctx->trace, image);
+	NVG_TRACE(ctx, NVG_TRACE_PLACEHOLDER_IMAGE, image, w, h);
+}
+
+static int nvg__fontFaceIndex(FONSfont* font)
+{
+#ifdef FONS_USE_FREETYPE
+	return (int)font->font.font->face_index;
+#else
+	int i, offset;
+	for (i = 0; (offset = stbtt_GetFontOffsetForIndex(font->data, i)) >= 0; i++) {
+		if (offset == font->font.font.fontstart)
+			return i;
+	}
+	return 0;
+#endif
+}
+
+static void nvg__traceFont(NVGcontext* ctx, int id)
+{
+	FONSfont* font;
+	if (ctx->trace == NULL || id < 0 || id >= ctx->fs->nfonts) return;
+	font = ctx->fs->fonts[id];
+	NVG_TRACE(ctx, NVG_TRACE_CREATE_FONT, id, font->name, (const char*)NULL, nvg__fontFaceIndex(font),
+			  (const void*)font->data, font->dataSize);
+}
+
 NVGcontext* nvgCreateInternal(NVGparams* params)
 {
 	FONSparams fontParams;
@@ -295,14 +713,28 @@ NVGcontext* nvgCreateInternal(NVGparams* params)
 	for (i = 0; i < NVG_MAX_FONTIMAGES; i++)
 		ctx->fontImages[i] = 0;
 
-	ctx->commands = (float*)malloc(sizeof(float)*NVG_INIT_COMMANDS_SIZE);
-	if (!ctx->commands) goto error;
+	ctx->arena = nvg__createArena(&params->memory);
+	if (ctx->arena == NULL) goto error;
+	ctx->params.frameArena = ctx->arena;
+
+	ctx->kernels = nvgBestKernels();
+
 	ctx->ncommands = 0;
-	ctx->ccommands = NVG_INIT_COMMANDS_SIZE;
+	ctx->ccommands = params->memory.commands > 0 ? params->memory.commands : NVG_INIT_COMMANDS_SIZE;
 
-	ctx->cache = nvg__allocPathCache();
+	ctx->cache = nvg__allocPathCache(&params->memory);
 	if (ctx->cache == NULL) goto error;
 
+	ctx->retained = (NVGretainedCache*)malloc(sizeof(NVGretainedCache));
+	if (ctx->retained == NULL) goto error;
+	memset(ctx->retained, 0, sizeof(NVGretainedCache));
+	ctx->retained->budget = NVG_RETAINED_BUDGET;
+
+	ctx->textCache = (NVGtextCache*)malloc(sizeof(NVGtextCache));
+	if (ctx->textCache == NULL) goto error;
+	memset(ctx->textCache, 0, sizeof(NVGtextCache));
+	ctx->textCache->budget = NVG_TEXT_CACHE_BUDGET;
+
 	nvgSave(ctx);
 	nvgReset(ctx);
 
@@ -344,8 +776,19 @@ void nvgDeleteInternal(NVGcontext* ctx)
 {
 	int i;
 	if (ctx == NULL) return;
-	if (ctx->commands != NULL) free(ctx->commands);
+	nvgTraceEnd(ctx);
+	ctx->ndeferred = 0;
+	nvg__deleteTessWorkers(ctx);
 	if (ctx->cache != NULL) nvg__deletePathCache(ctx->cache);
+	if (ctx->retained != NULL) {
+		nvgClearRetainedPaths(ctx);
+		free(ctx->retained->pendingCommands);
+		free(ctx->retained);
+	}
+	if (ctx->textCache != NULL) {
+		nvgClearTextCache(ctx);
+		free(ctx->textCache);
+	}
 
 	if (ctx->fs)
 		fonsDeleteInternal(ctx->fs);
@@ -357,9 +800,15 @@ void nvgDeleteInternal(NVGcontext* ctx)
 		}
 	}
 
+	if (ctx->rampImage != 0)
+		ctx->params.renderDeleteTexture(ctx->params.userPtr, ctx->rampImage);
+	free(ctx->rampPixels);
+
 	if (ctx->params.renderDelete != NULL)
 		ctx->params.renderDelete(ctx->params.userPtr);
 
+	nvg__deleteArena(ctx->arena);
+
 	free(ctx);
 }
 
@@ -369,9 +818,27 @@ void nvgBeginFrame(NVGcontext* ctx, float windowWidth, float windowHeight, float
 		ctx->drawCallCount, ctx->fillTriCount, ctx->strokeTriCount, ctx->textTriCount,
 		ctx->fillTriCount+ctx->strokeTriCount+ctx->textTriCount);*/
 
+	NVG_TRACE(ctx, NVG_TRACE_BEGIN_FRAME, windowWidth, windowHeight, devicePixelRatio);
+
+	// Anything still recorded from an unfinished frame lives in the arena and is dropped with it.
+	ctx->params.renderCancel(ctx->params.userPtr);
+	ctx->ncommands = 0;
+	ctx->ndeferred = 0;
+	ctx->ndeferredCommands = 0;
+	ctx->cache->npoints = 0;
+	ctx->cache->npaths = 0;
+	nvg__rewindArena(ctx->arena);
+	ctx->arena->last.drawCalls = ctx->drawCallCount;
+	ctx->arena->last.fillTriangles = ctx->fillTriCount;
+	ctx->arena->last.strokeTriangles = ctx->strokeTriCount;
+	ctx->arena->last.textTriangles = ctx->textTriCount;
+	ctx->arena->last.textRunsCached = ctx->textCachedCount;
+	ctx->arena->last.textRunsShaped = ctx->textShapedCount;
+
 	ctx->nstates = 0;
-	nvgSave(ctx);
-	nvgReset(ctx);
+	ctx->nlayers = 0;
+	NVG_TRACE_MUTED(ctx, nvgSave(ctx));
+	NVG_TRACE_MUTED(ctx, nvgReset(ctx));
 
 	nvg__setDevicePixelRatio(ctx, devicePixelRatio);
 
@@ -381,15 +848,66 @@ void nvgBeginFrame(NVGcontext* ctx, float windowWidth, float windowHeight, float
 	ctx->fillTriCount = 0;
 	ctx->strokeTriCount = 0;
 	ctx->textTriCount = 0;
+	ctx->textCachedCount = 0;
+	ctx->textShapedCount = 0;
+	ctx->frameIndex++;
+}
+
+void nvgFrameStats(NVGcontext* ctx, NVGframeStats* stats)
+{
+	if (stats == NULL) return;
+	*stats = ctx->arena->last;
+}
+
+unsigned int nvgFrameIndex(NVGcontext* ctx)
+{
+	return ctx->frameIndex;
+}
+
+int nvgTraceBegin(NVGcontext* ctx, const char* filename, int frames)
+{
+	int i, j;
+
+	nvgTraceEnd(ctx);
+	ctx->trace = nvgTraceOpen(filename, frames);
+	if (ctx->trace == NULL) return 0;
+
+	// Text can't be replayed without its fonts, so the existing ones go first.
+	for (i = 0; i < ctx->fs->nfonts; i++)
+		nvg__traceFont(ctx, i);
+	for (i = 0; i < ctx->fs->nfonts; i++) {
+		FONSfont* font = ctx->fs->fonts[i];
+		for (j = 0; j < font->nfallbacks; j++)
+			NVG_TRACE(ctx, NVG_TRACE_FALLBACK_FONT, i, font->fallbacks[j]);
+	}
+
+	return ctx->trace != NULL;
+}
+
+void nvgTraceEnd(NVGcontext* ctx)
+{
+	if (ctx->trace == NULL) return;
+	nvgTraceClose(ctx->trace);
+	ctx->trace = NULL;
+}
+
+int nvgTraceActive(NVGcontext* ctx)
+{
+	return ctx->trace != NULL;
 }
 
 void nvgCancelFrame(NVGcontext* ctx)
 {
+	NVG_TRACE(ctx, NVG_TRACE_CANCEL_FRAME);
+	ctx->ndeferred = 0;
+	ctx->ndeferredCommands = 0;
 	ctx->params.renderCancel(ctx->params.userPtr);
 }
 
 void nvgEndFrame(NVGcontext* ctx)
 {
+	NVG_TRACE(ctx, NVG_TRACE_END_FRAME);
+	nvg__flushDeferred(ctx);
 	ctx->params.renderFlush(ctx->params.userPtr);
 	if (ctx->fontImageIdx != 0) {
 		int fontImage = ctx->fontImages[ctx->fontImageIdx];
@@ -403,7 +921,7 @@ void nvgEndFrame(NVGcontext* ctx)
 				int nw, nh;
 				nvgImageSize(ctx, ctx->fontImages[i], &nw, &nh);
 				if (nw < iw || nh < ih)
-					nvgDeleteImage(ctx, ctx->fontImages[i]);
+					NVG_TRACE_MUTED(ctx, nvgDeleteImage(ctx, ctx->fontImages[i]));
 				else
 					ctx->fontImages[j++] = ctx->fontImages[i];
 			}
@@ -624,6 +1142,7 @@ static void nvg__setPaintColor(NVGpaint* p, NVGcolor color)
 // State handling
 void nvgSave(NVGcontext* ctx)
 {
+	NVG_TRACE(ctx, NVG_TRACE_SAVE);
 	if (ctx->nstates >= NVG_MAX_STATES)
 		return;
 	if (ctx->nstates > 0)
@@ -633,6 +1152,7 @@ void nvgSave(NVGcontext* ctx)
 
 void nvgRestore(NVGcontext* ctx)
 {
+	NVG_TRACE(ctx, NVG_TRACE_RESTORE);
 	if (ctx->nstates <= 1)
 		return;
 	ctx->nstates--;
@@ -641,6 +1161,7 @@ void nvgRestore(NVGcontext* ctx)
 void nvgReset(NVGcontext* ctx)
 {
 	NVGstate* state = nvg__getState(ctx);
+	NVG_TRACE(ctx, NVG_TRACE_RESET);
 	memset(state, 0, sizeof(*state));
 
 	nvg__setPaintColor(&state->fill, nvgRGBA(255,255,255,255));
@@ -656,6 +1177,7 @@ void nvgReset(NVGcontext* ctx)
 
 	state->scissor.extent[0] = -1.0f;
 	state->scissor.extent[1] = -1.0f;
+	state->scissor.clip = -1;
 
 	state->fontSize = 16.0f;
 	state->letterSpacing = 0.0f;
@@ -669,36 +1191,42 @@ void nvgReset(NVGcontext* ctx)
 void nvgShapeAntiAlias(NVGcontext* ctx, int enabled)
 {
 	NVGstate* state = nvg__getState(ctx);
+	NVG_TRACE(ctx, NVG_TRACE_SHAPE_ANTIALIAS, enabled);
 	state->shapeAntiAlias = enabled;
 }
 
 void nvgStrokeWidth(NVGcontext* ctx, float width)
 {
 	NVGstate* state = nvg__getState(ctx);
+	NVG_TRACE(ctx, NVG_TRACE_STROKE_WIDTH, width);
 	state->strokeWidth = width;
 }
 
 void nvgMiterLimit(NVGcontext* ctx, float limit)
 {
 	NVGstate* state = nvg__getState(ctx);
+	NVG_TRACE(ctx, NVG_TRACE_MITER_LIMIT, limit);
 	state->miterLimit = limit;
 }
 
 void nvgLineCap(NVGcontext* ctx, int cap)
 {
 	NVGstate* state = nvg__getState(ctx);
+	NVG_TRACE(ctx, NVG_TRACE_LINE_CAP, cap);
 	state->lineCap = cap;
 }
 
 void nvgLineJoin(NVGcontext* ctx, int join)
 {
 	NVGstate* state = nvg__getState(ctx);
+	NVG_TRACE(ctx, NVG_TRACE_LINE_JOIN, join);
 	state->lineJoin = join;
 }
 
 void nvgGlobalAlpha(NVGcontext* ctx, float alpha)
 {
 	NVGstate* state = nvg__getState(ctx);
+	NVG_TRACE(ctx, NVG_TRACE_GLOBAL_ALPHA, alpha);
 	state->alpha = alpha;
 }
 
@@ -706,12 +1234,14 @@ void nvgTransform(NVGcontext* ctx, float a, float b, float c, float d, float e,
 {
 	NVGstate* state = nvg__getState(ctx);
 	float t[6] = { a, b, c, d, e, f };
+	NVG_TRACE(ctx, NVG_TRACE_TRANSFORM, a, b, c, d, e, f);
 	nvgTransformPremultiply(state->xform, t);
 }
 
 void nvgResetTransform(NVGcontext* ctx)
 {
 	NVGstate* state = nvg__getState(ctx);
+	NVG_TRACE(ctx, NVG_TRACE_RESET_TRANSFORM);
 	nvgTransformIdentity(state->xform);
 }
 
@@ -719,6 +1249,7 @@ void nvgTranslate(NVGcontext* ctx, float x, float y)
 {
 	NVGstate* state = nvg__getState(ctx);
 	float t[6];
+	NVG_TRACE(ctx, NVG_TRACE_TRANSLATE, x, y);
 	nvgTransformTranslate(t, x,y);
 	nvgTransformPremultiply(state->xform, t);
 }
@@ -727,6 +1258,7 @@ void nvgRotate(NVGcontext* ctx, float angle)
 {
 	NVGstate* state = nvg__getState(ctx);
 	float t[6];
+	NVG_TRACE(ctx, NVG_TRACE_ROTATE, angle);
 	nvgTransformRotate(t, angle);
 	nvgTransformPremultiply(state->xform, t);
 }
@@ -735,6 +1267,7 @@ void nvgSkewX(NVGcontext* ctx, float angle)
 {
 	NVGstate* state = nvg__getState(ctx);
 	float t[6];
+	NVG_TRACE(ctx, NVG_TRACE_SKEW_X, angle);
 	nvgTransformSkewX(t, angle);
 	nvgTransformPremultiply(state->xform, t);
 }
@@ -743,6 +1276,7 @@ void nvgSkewY(NVGcontext* ctx, float angle)
 {
 	NVGstate* state = nvg__getState(ctx);
 	float t[6];
+	NVG_TRACE(ctx, NVG_TRACE_SKEW_Y, angle);
 	nvgTransformSkewY(t, angle);
 	nvgTransformPremultiply(state->xform, t);
 }
@@ -751,6 +1285,7 @@ void nvgScale(NVGcontext* ctx, float x, float y)
 {
 	NVGstate* state = nvg__getState(ctx);
 	float t[6];
+	NVG_TRACE(ctx, NVG_TRACE_SCALE, x, y);
 	nvgTransformScale(t, x,y);
 	nvgTransformPremultiply(state->xform, t);
 }
@@ -765,12 +1300,15 @@ void nvgCurrentTransform(NVGcontext* ctx, float* xform)
 void nvgStrokeColor(NVGcontext* ctx, NVGcolor color)
 {
 	NVGstate* state = nvg__getState(ctx);
+	NVG_TRACE(ctx, NVG_TRACE_STROKE_COLOR, &color);
 	nvg__setPaintColor(&state->stroke, color);
 }
 
 void nvgStrokePaint(NVGcontext* ctx, NVGpaint paint)
 {
 	NVGstate* state = nvg__getState(ctx);
+	nvg__traceImage(ctx, paint.image);
+	NVG_TRACE(ctx, NVG_TRACE_STROKE_PAINT, &paint);
 	state->stroke = paint;
 	nvgTransformMultiply(state->stroke.xform, state->xform);
 }
@@ -778,12 +1316,15 @@ void nvgStrokePaint(NVGcontext* ctx, NVGpaint paint)
 void nvgFillColor(NVGcontext* ctx, NVGcolor color)
 {
 	NVGstate* state = nvg__getState(ctx);
+	NVG_TRACE(ctx, NVG_TRACE_FILL_COLOR, &color);
 	nvg__setPaintColor(&state->fill, color);
 }
 
 void nvgFillPaint(NVGcontext* ctx, NVGpaint paint)
 {
 	NVGstate* state = nvg__getState(ctx);
+	nvg__traceImage(ctx, paint.image);
+	NVG_TRACE(ctx, NVG_TRACE_FILL_PAINT, &paint);
 	state->fill = paint;
 	nvgTransformMultiply(state->fill.xform, state->xform);
 }
@@ -817,18 +1358,68 @@ int nvgCreateImageMem(NVGcontext* ctx, int imageFlags, unsigned char* data, int
 	return image;
 }
 
+static int nvg__createImage(NVGcontext* ctx, int type, int w, int h, int imageFlags, const unsigned char* data)
+{
+	int image = ctx->params.renderCreateTexture(ctx->params.userPtr, type, w, h, imageFlags, data);
+	if (ctx->trace != NULL && image != 0) {
+		nvgTraceAddImage(ctx->trace, image);
+		NVG_TRACE(ctx, type == NVG_TEXTURE_BGRA ? NVG_TRACE_CREATE_IMAGE_BGRA : NVG_TRACE_CREATE_IMAGE,
+				  image, w, h, imageFlags, (const void*)data, w*h*4);
+	}
+	return image;
+}
+
 int nvgCreateImageRGBA(NVGcontext* ctx, int w, int h, int imageFlags, const unsigned char* data)
 {
-	return ctx->params.renderCreateTexture(ctx->params.userPtr, NVG_TEXTURE_RGBA, w, h, imageFlags, data);
+	return nvg__createImage(ctx, NVG_TEXTURE_RGBA, w, h, imageFlags, data);
+}
+
+int nvgCreateImageBGRA(NVGcontext* ctx, int w, int h, int imageFlags, const unsigned char* data)
+{
+	return nvg__createImage(ctx, NVG_TEXTURE_BGRA, w, h, imageFlags, data);
 }
 
 void nvgUpdateImage(NVGcontext* ctx, int image, const unsigned char* data)
 {
 	int w, h;
 	ctx->params.renderGetTextureSize(ctx->params.userPtr, image, &w, &h);
+	if (ctx->trace != NULL && nvgTraceHasImage(ctx->trace, image))
+		NVG_TRACE(ctx, NVG_TRACE_UPDATE_IMAGE, image, (const void*)data, w*h*4);
+	nvg__flushDeferred(ctx);
 	ctx->params.renderUpdateTexture(ctx->params.userPtr, image, 0,0, w,h, data);
 }
 
+// Records the pixels of the region only.
+static void nvg__traceImageRegion(NVGcontext* ctx, int image, int x, int y, int w, int h, int stride,
+								  const unsigned char* data)
+{
+	unsigned char* region = (unsigned char*)malloc((size_t)w*h*4);
+	int row;
+	if (region == NULL) return;
+	for (row = 0; row < h; row++)
+		memcpy(region + (size_t)row*w*4, data + ((size_t)(y+row)*stride + x)*4, (size_t)w*4);
+	NVG_TRACE(ctx, NVG_TRACE_UPDATE_IMAGE_REGION, image, x, y, w, h, (const void*)region, w*h*4);
+	free(region);
+}
+
+void nvgUpdateImageRegion(NVGcontext* ctx, int image, int x, int y, int w, int h, const unsigned char* data)
+{
+	int iw = 0, ih = 0;
+	ctx->params.renderGetTextureSize(ctx->params.userPtr, image, &iw, &ih);
+
+	// Clip the region to the image.
+	if (x < 0) { w += x; x = 0; }
+	if (y < 0) { h += y; y = 0; }
+	if (x + w > iw) w = iw - x;
+	if (y + h > ih) h = ih - y;
+	if (w <= 0 || h <= 0) return;
+
+	if (ctx->trace != NULL && nvgTraceHasImage(ctx->trace, image))
+		nvg__traceImageRegion(ctx, image, x, y, w, h, iw, data);
+	nvg__flushDeferred(ctx);
+	ctx->params.renderUpdateTexture(ctx->params.userPtr, image, x,y, w,h, data);
+}
+
 void nvgImageSize(NVGcontext* ctx, int image, int* w, int* h)
 {
 	ctx->params.renderGetTextureSize(ctx->params.userPtr, image, w, h);
@@ -836,6 +1427,11 @@ void nvgImageSize(NVGcontext* ctx, int image, int* w, int* h)
 
 void nvgDeleteImage(NVGcontext* ctx, int image)
 {
+	if (ctx->trace != NULL && ctx->traceMute == 0 && nvgTraceHasImage(ctx->trace, image)) {
+		nvgTraceRemoveImage(ctx->trace, image);
+		NVG_TRACE(ctx, NVG_TRACE_DELETE_IMAGE, image);
+	}
+	nvg__flushDeferred(ctx);
 	ctx->params.renderDeleteTexture(ctx->params.userPtr, image);
 }
 
@@ -905,6 +1501,109 @@ NVGpaint nvgRadialGradient(NVGcontext* ctx,
 	return p;
 }
 
+// Writes the colours of the stops into a row of the ramp atlas, interpolated with premultiplied alpha.
+static void nvg__fillRamp(unsigned char* dst, const float* offsets, const NVGcolor* colors, int nstops)
+{
+	int i, j = 0, k;
+	for (i = 0; i < NVG_RAMP_WIDTH; i++) {
+		float t = (i + 0.5f) / NVG_RAMP_WIDTH;
+		float o0, o1, u, c;
+		while (j < nstops - 2 && offsets[j+1] < t) j++;
+		o0 = offsets[j];
+		o1 = offsets[j+1];
+		if (o1 > o0)
+			u = nvg__clampf((t - o0) / (o1 - o0), 0.0f, 1.0f);
+		else
+			u = t < o0 ? 0.0f : 1.0f;
+		for (k = 0; k < 4; k++) {
+			float a0 = colors[j].a, a1 = colors[j+1].a;
+			c = k < 3 ? colors[j].rgba[k]*a0 + (colors[j+1].rgba[k]*a1 - colors[j].rgba[k]*a0) * u
+					  : a0 + (a1 - a0) * u;
+			dst[i*4+k] = (unsigned char)(nvg__clampf(c, 0.0f, 1.0f) * 255.0f + 0.5f);
+		}
+	}
+}
+
+// Makes a gradient paint sample the colours of the stops from the ramp atlas, adding their ramp if needed.
+static void nvg__gradientRamp(NVGcontext* ctx, NVGpaint* p, const float* offsets, const NVGcolor* colors, int nstops)
+{
+	unsigned long long hash = 14695981039346656037ULL;
+	const unsigned char* bytes;
+	NVGramp* ramp;
+	int i, row = -1, slot = -1;
+
+	if (!ctx->params.gradientRamps || nstops < 2) return;
+	// Two stops at the ends are a plain gradient.
+	if (nstops == 2 && offsets[0] <= 0.0f && offsets[1] >= 1.0f) return;
+
+	// FNV-1a of the stops.
+	bytes = (const unsigned char*)offsets;
+	for (i = 0; i < nstops * (int)sizeof(float); i++)
+		hash = (hash ^ bytes[i]) * 1099511628211ULL;
+	bytes = (const unsigned char*)colors;
+	for (i = 0; i < nstops * (int)sizeof(NVGcolor); i++)
+		hash = (hash ^ bytes[i]) * 1099511628211ULL;
+
+	for (i = 0; i < NVG_RAMP_ROWS; i++) {
+		ramp = &ctx->ramps[i];
+		if (ramp->used && ramp->hash == hash) {
+			row = i;
+			break;
+		}
+		// Ramps drawn in this frame are still to be read by the renderer.
+		if (ramp->used && ramp->frame == ctx->frameIndex) continue;
+		if (slot == -1 || (ctx->ramps[slot].used && (!ramp->used || ramp->frame < ctx->ramps[slot].frame)))
+			slot = i;
+	}
+
+	if (row == -1) {
+		if (slot == -1) return;
+		if (ctx->rampImage == 0) {
+			if (ctx->rampPixels == NULL) {
+				ctx->rampPixels = (unsigned char*)malloc(NVG_RAMP_WIDTH * NVG_RAMP_ROWS * 4);
+				if (ctx->rampPixels == NULL) return;
+				memset(ctx->rampPixels, 0, NVG_RAMP_WIDTH * NVG_RAMP_ROWS * 4);
+			}
+			ctx->rampImage = ctx->params.renderCreateTexture(ctx->params.userPtr, NVG_TEXTURE_RGBA, NVG_RAMP_WIDTH, NVG_RAMP_ROWS,
+															 NVG_IMAGE_PREMULTIPLIED, ctx->rampPixels);
+			if (ctx->rampImage == 0) return;
+		}
+		row = slot;
+		nvg__fillRamp(&ctx->rampPixels[row * NVG_RAMP_WIDTH * 4], offsets, colors, nstops);
+		nvg__flushDeferred(ctx);
+		ctx->params.renderUpdateTexture(ctx->params.userPtr, ctx->rampImage, 0, row, NVG_RAMP_WIDTH, 1, ctx->rampPixels);
+		ctx->ramps[row].hash = hash;
+		ctx->ramps[row].used = 1;
+	}
+	ctx->ramps[row].frame = ctx->frameIndex;
+
+	p->image = ctx->rampImage;
+	p->ramp = (row + 0.5f) / NVG_RAMP_ROWS;
+	p->innerColor = p->outerColor = nvgRGBAf(1.0f, 1.0f, 1.0f, 1.0f);
+
+	NVG_TRACE(ctx, NVG_TRACE_GRADIENT_RAMP, p->image, p->ramp, (const void*)colors, nstops * (int)sizeof(NVGcolor), offsets, nstops);
+}
+
+NVGpaint nvgLinearGradientStops(NVGcontext* ctx, float sx, float sy, float ex, float ey,
+								const float* offsets, const NVGcolor* colors, int nstops)
+{
+	NVGpaint p;
+	if (nstops < 1) return nvgLinearGradient(ctx, sx, sy, ex, ey, nvgRGBA(0,0,0,0), nvgRGBA(0,0,0,0));
+	p = nvgLinearGradient(ctx, sx, sy, ex, ey, colors[0], colors[nstops-1]);
+	nvg__gradientRamp(ctx, &p, offsets, colors, nstops);
+	return p;
+}
+
+NVGpaint nvgRadialGradientStops(NVGcontext* ctx, float cx, float cy, float inr, float outr,
+								const float* offsets, const NVGcolor* colors, int nstops)
+{
+	NVGpaint p;
+	if (nstops < 1) return nvgRadialGradient(ctx, cx, cy, inr, outr, nvgRGBA(0,0,0,0), nvgRGBA(0,0,0,0));
+	p = nvgRadialGradient(ctx, cx, cy, inr, outr, colors[0], colors[nstops-1]);
+	nvg__gradientRamp(ctx, &p, offsets, colors, nstops);
+	return p;
+}
+
 NVGpaint nvgBoxGradient(NVGcontext* ctx,
 							   float x, float y, float w, float h, float r, float f,
 							   NVGcolor icol, NVGcolor ocol)
@@ -957,6 +1656,7 @@ NVGpaint nvgImagePattern(NVGcontext* ctx,
 void nvgScissor(NVGcontext* ctx, float x, float y, float w, float h)
 {
 	NVGstate* state = nvg__getState(ctx);
+	NVG_TRACE(ctx, NVG_TRACE_SCISSOR, x, y, w, h);
 
 	w = nvg__maxf(0.0f, w);
 	h = nvg__maxf(0.0f, h);
@@ -991,9 +1691,11 @@ void nvgIntersectScissor(NVGcontext* ctx, float x, float y, float w, float h)
 	float rect[4];
 	float ex, ey, tex, tey;
 
+	NVG_TRACE(ctx, NVG_TRACE_INTERSECT_SCISSOR, x, y, w, h);
+
 	// If no previous scissor has been set, set the scissor as current scissor.
 	if (state->scissor.extent[0] < 0) {
-		nvgScissor(ctx, x, y, w, h);
+		NVG_TRACE_MUTED(ctx, nvgScissor(ctx, x, y, w, h));
 		return;
 	}
 
@@ -1010,7 +1712,7 @@ void nvgIntersectScissor(NVGcontext* ctx, float x, float y, float w, float h)
 	// Intersect rects.
 	nvg__isectRects(rect, pxform[4]-tex,pxform[5]-tey,tex*2,tey*2, x,y,w,h);
 
-	nvgScissor(ctx, rect[0], rect[1], rect[2], rect[3]);
+	NVG_TRACE_MUTED(ctx, nvgScissor(ctx, rect[0], rect[1], rect[2], rect[3]));
 }
 
 void nvgCurrentScissor(NVGcontext* ctx, float* x, float* y, float* w, float* h)
@@ -1043,6 +1745,7 @@ void nvgCurrentScissor(NVGcontext* ctx, float* x, float* y, float* w, float* h)
 void nvgResetScissor(NVGcontext* ctx)
 {
 	NVGstate* state = nvg__getState(ctx);
+	NVG_TRACE(ctx, NVG_TRACE_RESET_SCISSOR);
 	memset(state->scissor.xform, 0, sizeof(state->scissor.xform));
 	state->scissor.extent[0] = -1.0f;
 	state->scissor.extent[1] = -1.0f;
@@ -1052,6 +1755,7 @@ void nvgResetScissor(NVGcontext* ctx)
 void nvgGlobalCompositeOperation(NVGcontext* ctx, int op)
 {
 	NVGstate* state = nvg__getState(ctx);
+	NVG_TRACE(ctx, NVG_TRACE_COMPOSITE_OPERATION, op);
 	state->compositeOperation = nvg__compositeOperationState(op);
 }
 
@@ -1068,6 +1772,8 @@ void nvgGlobalCompositeBlendFuncSeparate(NVGcontext* ctx, int srcRGB, int dstRGB
 	op.srcAlpha = srcAlpha;
 	op.dstAlpha = dstAlpha;
 
+	NVG_TRACE(ctx, NVG_TRACE_COMPOSITE_BLEND, srcRGB, dstRGB, srcAlpha, dstAlpha);
+
 	NVGstate* state = nvg__getState(ctx);
 	state->compositeOperation = op;
 }
@@ -1099,16 +1805,12 @@ static float nvg__distPtSeg(float x, float y, float px, float py, float qx, floa
 static void nvg__appendCommands(NVGcontext* ctx, float* vals, int nvals)
 {
 	NVGstate* state = nvg__getState(ctx);
+	float* commands;
 	int i;
 
-	if (ctx->ncommands+nvals > ctx->ccommands) {
-		float* commands;
-		int ccommands = ctx->ncommands+nvals + ctx->ccommands/2;
-		commands = (float*)realloc(ctx->commands, sizeof(float)*ccommands);
-		if (commands == NULL) return;
-		ctx->commands = commands;
-		ctx->ccommands = ccommands;
-	}
+	commands = (float*)nvgArenaReserve(ctx->arena, ctx->commands, &ctx->ccommands, &ctx->gcommands, ctx->ncommands+nvals, ctx->ncommands, sizeof(float));
+	if (commands == NULL) return;
+	ctx->commands = commands;
 
 	if ((int)vals[0] != NVG_CLOSE && (int)vals[0] != NVG_WINDING) {
 		ctx->commandx = vals[nvals-2];
@@ -1150,13 +1852,99 @@ static void nvg__appendCommands(NVGcontext* ctx, float* vals, int nvals)
 	ctx->ncommands += nvals;
 }
 
-
 static void nvg__clearPathCache(NVGcontext* ctx)
 {
 	ctx->cache->npoints = 0;
 	ctx->cache->npaths = 0;
 }
 
+static void nvg__setPointArrays(NVGpoints* pts, unsigned char* block, int cap)
+{
+	float* f = (float*)block;
+	pts->x = f; f += cap;
+	pts->y = f; f += cap;
+	pts->dx = f; f += cap;
+	pts->dy = f; f += cap;
+	pts->len = f; f += cap;
+	pts->dmx = f; f += cap;
+	pts->dmy = f; f += cap;
+	pts->flags = (unsigned char*)f;
+}
+
+static int nvg__pointCapacity(int count)
+{
+	// Multiples of 8 keep every array 32 byte aligned.
+	return (nvg__maxi(count, 1) + 7) & ~7;
+}
+
+static void nvg__copyPoints(NVGpoints* dst, const NVGpoints* src, int n)
+{
+	memcpy(dst->x, src->x, sizeof(float)*n);
+	memcpy(dst->y, src->y, sizeof(float)*n);
+	memcpy(dst->dx, src->dx, sizeof(float)*n);
+	memcpy(dst->dy, src->dy, sizeof(float)*n);
+	memcpy(dst->len, src->len, sizeof(float)*n);
+	memcpy(dst->dmx, src->dmx, sizeof(float)*n);
+	memcpy(dst->dmy, src->dmy, sizeof(float)*n);
+	memcpy(dst->flags, src->flags, n);
+}
+
+static int nvg__reservePoints(NVGcontext* ctx, int count)
+{
+	NVGpathCache* cache = ctx->cache;
+	NVGpoints points;
+	unsigned char* block;
+	int cap, keep = cache->npoints;
+
+	if (cache->gpoints == ctx->arena->generation) {
+		if (count <= cache->cpoints) return 1;
+		cap = count + cache->cpoints/2; // 1.5x Overallocate
+	} else {
+		// The arena was rewound, start over at the previous capacity.
+		keep = 0;
+		cap = nvg__maxi(count, cache->cpoints);
+	}
+	cap = nvg__pointCapacity(cap);
+
+	block = (unsigned char*)nvg__arenaAlloc(ctx->arena, cap * (int)NVG_POINT_BYTES);
+	if (block == NULL) return 0;
+	nvg__setPointArrays(&points, block, cap);
+	if (keep > 0)
+		nvg__copyPoints(&points, &cache->points, keep);
+
+	cache->points = points;
+	cache->cpoints = cap;
+	cache->gpoints = ctx->arena->generation;
+	return 1;
+}
+
+// Points of a single path.
+static NVGpoints nvg__pathPoints(NVGpathCache* cache, const NVGpath* path)
+{
+	NVGpoints pts = cache->points;
+	pts.x += path->first;
+	pts.y += path->first;
+	pts.dx += path->first;
+	pts.dy += path->first;
+	pts.len += path->first;
+	pts.dmx += path->first;
+	pts.dmy += path->first;
+	pts.flags += path->first;
+	return pts;
+}
+
+static void nvg__getPoint(const NVGpoints* pts, int i, NVGpoint* pt)
+{
+	pt->x = pts->x[i];
+	pt->y = pts->y[i];
+	pt->dx = pts->dx[i];
+	pt->dy = pts->dy[i];
+	pt->len = pts->len[i];
+	pt->dmx = pts->dmx[i];
+	pt->dmy = pts->dmy[i];
+	pt->flags = pts->flags[i];
+}
+
 static NVGpath* nvg__lastPath(NVGcontext* ctx)
 {
 	if (ctx->cache->npaths > 0)
@@ -1167,14 +1955,11 @@ static NVGpath* nvg__lastPath(NVGcontext* ctx)
 static void nvg__addPath(NVGcontext* ctx)
 {
 	NVGpath* path;
-	if (ctx->cache->npaths+1 > ctx->cache->cpaths) {
-		NVGpath* paths;
-		int cpaths = ctx->cache->npaths+1 + ctx->cache->cpaths/2;
-		paths = (NVGpath*)realloc(ctx->cache->paths, sizeof(NVGpath)*cpaths);
-		if (paths == NULL) return;
-		ctx->cache->paths = paths;
-		ctx->cache->cpaths = cpaths;
-	}
+	NVGpath* paths = (NVGpath*)nvgArenaReserve(ctx->arena, ctx->cache->paths, &ctx->cache->cpaths, &ctx->cache->gpaths,
+											   ctx->cache->npaths+1, ctx->cache->npaths, sizeof(NVGpath));
+	if (paths == NULL) return;
+	ctx->cache->paths = paths;
+
 	path = &ctx->cache->paths[ctx->cache->npaths];
 	memset(path, 0, sizeof(*path));
 	path->first = ctx->cache->npoints;
@@ -1183,43 +1968,32 @@ static void nvg__addPath(NVGcontext* ctx)
 	ctx->cache->npaths++;
 }
 
-static NVGpoint* nvg__lastPoint(NVGcontext* ctx)
-{
-	if (ctx->cache->npoints > 0)
-		return &ctx->cache->points[ctx->cache->npoints-1];
-	return NULL;
-}
-
 static void nvg__addPoint(NVGcontext* ctx, float x, float y, int flags)
 {
+	NVGpathCache* cache = ctx->cache;
 	NVGpath* path = nvg__lastPath(ctx);
-	NVGpoint* pt;
+	int i;
 	if (path == NULL) return;
 
-	if (path->count > 0 && ctx->cache->npoints > 0) {
-		pt = nvg__lastPoint(ctx);
-		if (nvg__ptEquals(pt->x,pt->y, x,y, ctx->distTol)) {
-			pt->flags |= flags;
+	if (path->count > 0 && cache->npoints > 0) {
+		i = cache->npoints-1;
+		if (nvg__ptEquals(cache->points.x[i],cache->points.y[i], x,y, ctx->distTol)) {
+			cache->points.flags[i] |= flags;
 			return;
 		}
 	}
 
-	if (ctx->cache->npoints+1 > ctx->cache->cpoints) {
-		NVGpoint* points;
-		int cpoints = ctx->cache->npoints+1 + ctx->cache->cpoints/2;
-		points = (NVGpoint*)realloc(ctx->cache->points, sizeof(NVGpoint)*cpoints);
-		if (points == NULL) return;
-		ctx->cache->points = points;
-		ctx->cache->cpoints = cpoints;
-	}
+	if (nvg__reservePoints(ctx, cache->npoints+1) == 0) return;
 
-	pt = &ctx->cache->points[ctx->cache->npoints];
-	memset(pt, 0, sizeof(*pt));
-	pt->x = x;
-	pt->y = y;
-	pt->flags = (unsigned char)flags;
+	i = cache->npoints;
+	cache->points.x[i] = x;
+	cache->points.y[i] = y;
+	cache->points.dx[i] = cache->points.dy[i] = 0;
+	cache->points.len[i] = 0;
+	cache->points.dmx[i] = cache->points.dmy[i] = 0;
+	cache->points.flags[i] = (unsigned char)flags;
 
-	ctx->cache->npoints++;
+	cache->npoints++;
 	path->count++;
 }
 
@@ -1246,16 +2020,14 @@ static float nvg__getAverageScale(float *t)
 
 static NVGvertex* nvg__allocTempVerts(NVGcontext* ctx, int nverts)
 {
-	if (nverts > ctx->cache->cverts) {
-		NVGvertex* verts;
-		int cverts = (nverts + 0xff) & ~0xff; // Round up to prevent allocations when things change just slightly.
-		verts = (NVGvertex*)realloc(ctx->cache->verts, sizeof(NVGvertex)*cverts);
-		if (verts == NULL) return NULL;
-		ctx->cache->verts = verts;
-		ctx->cache->cverts = cverts;
-	}
-
-	return ctx->cache->verts;
+	NVGpathCache* cache = ctx->cache;
+	// Round up to prevent allocations when things change just slightly. The vertices before
+	// cache->nverts are kept, which only tessellation threads use.
+	NVGvertex* verts = (NVGvertex*)nvgArenaReserve(ctx->arena, cache->verts, &cache->cverts, &cache->gverts,
+												   (cache->nverts + nverts + 0xff) & ~0xff, cache->nverts, sizeof(NVGvertex));
+	if (verts == NULL) return NULL;
+	cache->verts = verts;
+	return &verts[cache->nverts];
 }
 
 static float nvg__triarea2(float ax, float ay, float bx, float by, float cx, float cy)
@@ -1267,27 +2039,24 @@ static float nvg__triarea2(float ax, float ay, float bx, float by, float cx, flo
 	return acx*aby - abx*acy;
 }
 
-static float nvg__polyArea(NVGpoint* pts, int npts)
+static float nvg__polyArea(const NVGpoints* pts, int npts)
 {
 	int i;
 	float area = 0;
-	for (i = 2; i < npts; i++) {
-		NVGpoint* a = &pts[0];
-		NVGpoint* b = &pts[i-1];
-		NVGpoint* c = &pts[i];
-		area += nvg__triarea2(a->x,a->y, b->x,b->y, c->x,c->y);
-	}
+	for (i = 2; i < npts; i++)
+		area += nvg__triarea2(pts->x[0],pts->y[0], pts->x[i-1],pts->y[i-1], pts->x[i],pts->y[i]);
 	return area * 0.5f;
 }
 
-static void nvg__polyReverse(NVGpoint* pts, int npts)
+static void nvg__polyReverse(NVGpoints* pts, int npts)
 {
-	NVGpoint tmp;
+	float tmp;
+	unsigned char flags;
 	int i = 0, j = npts-1;
 	while (i < j) {
-		tmp = pts[i];
-		pts[i] = pts[j];
-		pts[j] = tmp;
+		tmp = pts->x[i]; pts->x[i] = pts->x[j]; pts->x[j] = tmp;
+		tmp = pts->y[i]; pts->y[i] = pts->y[j]; pts->y[j] = tmp;
+		flags = pts->flags[i]; pts->flags[i] = pts->flags[j]; pts->flags[j] = flags;
 		i++;
 		j--;
 	}
@@ -1302,59 +2071,93 @@ static void nvg__vset(NVGvertex* vtx, float x, float y, float u, float v)
 	vtx->v = v;
 }
 
-static void nvg__tesselateBezier(NVGcontext* ctx,
-								 float x1, float y1, float x2, float y2,
-								 float x3, float y3, float x4, float y4,
-								 int level, int type)
+// Flattens a cubic bezier into line segments no further than tol away from the curve.
+// The segment count is derived up front from the control polygon (Wang's formula) and the points
+// are evaluated with forward differencing straight into the point cache. Points are in device
+// space at this stage, so a tolerance in pixels follows the current transform scale.
+static void nvg__flattenBezier(NVGcontext* ctx,
+							   float x1, float y1, float x2, float y2,
+							   float x3, float y3, float x4, float y4,
+							   float tol, int type)
 {
-	float x12,y12,x23,y23,x34,y34,x123,y123,x234,y234,x1234,y1234;
-	float dx,dy,d2,d3;
+	NVGpathCache* cache = ctx->cache;
+	NVGpath* path = nvg__lastPath(ctx);
+	NVGpoints* pts = &cache->points;
+	float ddx0, ddy0, ddx1, ddy1, dd, h, h2, h3;
+	float ax, ay, bx, by, cx, cy;
+	float fx, fy, dfx, dfy, ddfx, ddfy, dddfx, dddfy;
+	int i, n, last;
 
-	if (level > 10) return;
+	if (path == NULL) return;
 
-	x12 = (x1+x2)*0.5f;
-	y12 = (y1+y2)*0.5f;
-	x23 = (x2+x3)*0.5f;
-	y23 = (y2+y3)*0.5f;
-	x34 = (x3+x4)*0.5f;
-	y34 = (y3+y4)*0.5f;
-	x123 = (x12+x23)*0.5f;
-	y123 = (y12+y23)*0.5f;
+	// Wang's formula: n = sqrt(3/4 * max|P0 - 2P1 + P2|, |P1 - 2P2 + P3| / tol)
+	ddx0 = x1 - 2.0f*x2 + x3;
+	ddy0 = y1 - 2.0f*y2 + y3;
+	ddx1 = x2 - 2.0f*x3 + x4;
+	ddy1 = y2 - 2.0f*y3 + y4;
+	dd = nvg__maxf(ddx0*ddx0 + ddy0*ddy0, ddx1*ddx1 + ddy1*ddy1);
+	n = (int)ceilf(nvg__sqrtf(0.75f * nvg__sqrtf(dd) / tol));
+	n = nvg__clampi(n, 1, NVG_MAX_BEZIER_SEGMENTS);
+
+	if (nvg__reservePoints(ctx, cache->npoints + n) == 0) return;
+
+	// Polynomial coefficients, B(t) = a*t^3 + b*t^2 + c*t + P0
+	ax = -x1 + 3.0f*(x2 - x3) + x4;
+	ay = -y1 + 3.0f*(y2 - y3) + y4;
+	bx = 3.0f*(x1 - 2.0f*x2 + x3);
+	by = 3.0f*(y1 - 2.0f*y2 + y3);
+	cx = 3.0f*(x2 - x1);
+	cy = 3.0f*(y2 - y1);
+
+	h = 1.0f / (float)n;
+	h2 = h*h;
+	h3 = h2*h;
+	fx = x1;
+	fy = y1;
+	dfx = ax*h3 + bx*h2 + cx*h;
+	dfy = ay*h3 + by*h2 + cy*h;
+	ddfx = 6.0f*ax*h3 + 2.0f*bx*h2;
+	ddfy = 6.0f*ay*h3 + 2.0f*by*h2;
+	dddfx = 6.0f*ax*h3;
+	dddfy = 6.0f*ay*h3;
+
+	last = cache->npoints-1;
+	for (i = 1; i <= n; i++) {
+		int flags = 0;
+		if (i < n) {
+			fx += dfx; fy += dfy;
+			dfx += ddfx; dfy += ddfy;
+			ddfx += dddfx; ddfy += dddfy;
+		} else {
+			// Land exactly on the end point, forward differencing accumulates error.
+			fx = x4; fy = y4;
+			flags = type;
+		}
 
-	dx = x4 - x1;
-	dy = y4 - y1;
-	d2 = nvg__absf(((x2 - x4) * dy - (y2 - y4) * dx));
-	d3 = nvg__absf(((x3 - x4) * dy - (y3 - y4) * dx));
+		if (last >= 0 && path->count > 0 && nvg__ptEquals(pts->x[last],pts->y[last], fx,fy, ctx->distTol)) {
+			pts->flags[last] |= (unsigned char)flags;
+			continue;
+		}
 
-	if ((d2 + d3)*(d2 + d3) < ctx->tessTol * (dx*dx + dy*dy)) {
-		nvg__addPoint(ctx, x4, y4, type);
-		return;
+		last = cache->npoints++;
+		pts->x[last] = fx;
+		pts->y[last] = fy;
+		pts->dx[last] = pts->dy[last] = 0;
+		pts->len[last] = 0;
+		pts->dmx[last] = pts->dmy[last] = 0;
+		pts->flags[last] = (unsigned char)flags;
+		path->count++;
 	}
-
-/*	if (nvg__absf(x1+x3-x2-x2) + nvg__absf(y1+y3-y2-y2) + nvg__absf(x2+x4-x3-x3) + nvg__absf(y2+y4-y3-y3) < ctx->tessTol) {
-		nvg__addPoint(ctx, x4, y4, type);
-		return;
-	}*/
-
-	x234 = (x23+x34)*0.5f;
-	y234 = (y23+y34)*0.5f;
-	x1234 = (x123+x234)*0.5f;
-	y1234 = (y123+y234)*0.5f;
-
-	nvg__tesselateBezier(ctx, x1,y1, x12,y12, x123,y123, x1234,y1234, level+1, 0);
-	nvg__tesselateBezier(ctx, x1234,y1234, x234,y234, x34,y34, x4,y4, level+1, type);
 }
 
 static void nvg__flattenPaths(NVGcontext* ctx)
 {
 	NVGpathCache* cache = ctx->cache;
 //	NVGstate* state = nvg__getState(ctx);
-	NVGpoint* last;
-	NVGpoint* p0;
-	NVGpoint* p1;
-	NVGpoint* pts;
+	const NVGkernels* kernels = ctx->kernels;
+	NVGpoints pts;
 	NVGpath* path;
-	int i, j;
+	int i, j, n, last;
 	float* cp1;
 	float* cp2;
 	float* p;
@@ -1380,12 +2183,12 @@ static void nvg__flattenPaths(NVGcontext* ctx)
 			i += 3;
 			break;
 		case NVG_BEZIERTO:
-			last = nvg__lastPoint(ctx);
-			if (last != NULL) {
+			last = cache->npoints-1;
+			if (last >= 0) {
 				cp1 = &ctx->commands[i+1];
 				cp2 = &ctx->commands[i+3];
 				p = &ctx->commands[i+5];
-				nvg__tesselateBezier(ctx, last->x,last->y, cp1[0],cp1[1], cp2[0],cp2[1], p[0],p[1], 0, NVG_PT_CORNER);
+				nvg__flattenBezier(ctx, cache->points.x[last],cache->points.y[last], cp1[0],cp1[1], cp2[0],cp2[1], p[0],p[1], ctx->tessTol, NVG_PT_CORNER);
 			}
 			i += 7;
 			break;
@@ -1408,38 +2211,31 @@ static void nvg__flattenPaths(NVGcontext* ctx)
 	// Calculate the direction and length of line segments.
 	for (j = 0; j < cache->npaths; j++) {
 		path = &cache->paths[j];
-		pts = &cache->points[path->first];
+		pts = nvg__pathPoints(cache, path);
+		n = path->count;
+		if (n == 0) continue;
 
 		// If the first and last points are the same, remove the last, mark as closed path.
-		p0 = &pts[path->count-1];
-		p1 = &pts[0];
-		if (nvg__ptEquals(p0->x,p0->y, p1->x,p1->y, ctx->distTol)) {
+		if (nvg__ptEquals(pts.x[n-1],pts.y[n-1], pts.x[0],pts.y[0], ctx->distTol)) {
 			path->count--;
-			p0 = &pts[path->count-1];
 			path->closed = 1;
+			n = path->count;
 		}
 
 		// Enforce winding.
-		if (path->count > 2) {
-			area = nvg__polyArea(pts, path->count);
+		if (n > 2) {
+			area = nvg__polyArea(&pts, n);
 			if (path->winding == NVG_CCW && area < 0.0f)
-				nvg__polyReverse(pts, path->count);
+				nvg__polyReverse(&pts, n);
 			if (path->winding == NVG_CW && area > 0.0f)
-				nvg__polyReverse(pts, path->count);
+				nvg__polyReverse(&pts, n);
 		}
 
-		for(i = 0; i < path->count; i++) {
-			// Calculate segment direction and length
-			p0->dx = p1->x - p0->x;
-			p0->dy = p1->y - p0->y;
-			p0->len = nvg__normalize(&p0->dx, &p0->dy);
-			// Update bounds
-			cache->bounds[0] = nvg__minf(cache->bounds[0], p0->x);
-			cache->bounds[1] = nvg__minf(cache->bounds[1], p0->y);
-			cache->bounds[2] = nvg__maxf(cache->bounds[2], p0->x);
-			cache->bounds[3] = nvg__maxf(cache->bounds[3], p0->y);
-			// Advance
-			p0 = p1++;
+		if (n > 0) {
+			// Each point gets the segment to the next one, the last segment wraps around to the first point.
+			kernels->segments(pts.x, pts.y, pts.x+1, pts.y+1, pts.dx, pts.dy, pts.len, n-1);
+			kernels->segments(pts.x+n-1, pts.y+n-1, pts.x, pts.y, pts.dx+n-1, pts.dy+n-1, pts.len+n-1, 1);
+			kernels->bounds(pts.x, pts.y, n, cache->bounds);
 		}
 	}
 }
@@ -1677,7 +2473,9 @@ static NVGvertex* nvg__roundCapEnd(NVGvertex* dst, NVGpoint* p,
 static void nvg__calculateJoins(NVGcontext* ctx, float w, int lineJoin, float miterLimit)
 {
 	NVGpathCache* cache = ctx->cache;
-	int i, j;
+	const NVGkernels* kernels = ctx->kernels;
+	int bevelCorners = lineJoin == NVG_BEVEL || lineJoin == NVG_ROUND;
+	int i;
 	float iw = 0.0f;
 
 	if (w > 0.0f) iw = 1.0f / w;
@@ -1685,64 +2483,36 @@ static void nvg__calculateJoins(NVGcontext* ctx, float w, int lineJoin, float mi
 	// Calculate which joins needs extra vertices to append, and gather vertex count.
 	for (i = 0; i < cache->npaths; i++) {
 		NVGpath* path = &cache->paths[i];
-		NVGpoint* pts = &cache->points[path->first];
-		NVGpoint* p0 = &pts[path->count-1];
-		NVGpoint* p1 = &pts[0];
-		int nleft = 0;
-
-		path->nbevel = 0;
-
-		for (j = 0; j < path->count; j++) {
-			float dlx0, dly0, dlx1, dly1, dmr2, cross, limit;
-			dlx0 = p0->dy;
-			dly0 = -p0->dx;
-			dlx1 = p1->dy;
-			dly1 = -p1->dx;
-			// Calculate extrusions
-			p1->dmx = (dlx0 + dlx1) * 0.5f;
-			p1->dmy = (dly0 + dly1) * 0.5f;
-			dmr2 = p1->dmx*p1->dmx + p1->dmy*p1->dmy;
-			if (dmr2 > 0.000001f) {
-				float scale = 1.0f / dmr2;
-				if (scale > 600.0f) {
-					scale = 600.0f;
-				}
-				p1->dmx *= scale;
-				p1->dmy *= scale;
-			}
-
-			// Clear flags, but keep the corner.
-			p1->flags = (p1->flags & NVG_PT_CORNER) ? NVG_PT_CORNER : 0;
-
-			// Keep track of left turns.
-			cross = p1->dx * p0->dy - p0->dx * p1->dy;
-			if (cross > 0.0f) {
-				nleft++;
-				p1->flags |= NVG_PT_LEFT;
-			}
-
-			// Calculate if we should use bevel or miter for inner join.
-			limit = nvg__maxf(1.01f, nvg__minf(p0->len, p1->len) * iw);
-			if ((dmr2 * limit*limit) < 1.0f)
-				p1->flags |= NVG_PR_INNERBEVEL;
-
-			// Check to see if the corner needs to be beveled.
-			if (p1->flags & NVG_PT_CORNER) {
-				if ((dmr2 * miterLimit*miterLimit) < 1.0f || lineJoin == NVG_BEVEL || lineJoin == NVG_ROUND) {
-					p1->flags |= NVG_PT_BEVEL;
-				}
-			}
-
-			if ((p1->flags & (NVG_PT_BEVEL | NVG_PR_INNERBEVEL)) != 0)
-				path->nbevel++;
-
-			p0 = p1++;
+		NVGpoints pts = nvg__pathPoints(cache, path);
+		int n = path->count;
+		int nleft = 0, nbevel = 0;
+
+		if (n > 0) {
+			// The first point joins the closing segment, the rest join the segment before them.
+			kernels->joins(pts.dx+n-1, pts.dy+n-1, pts.len+n-1, pts.dx, pts.dy, pts.len,
+						   pts.dmx, pts.dmy, pts.flags, 1,
+						   iw, miterLimit, bevelCorners, &nleft, &nbevel);
+			kernels->joins(pts.dx, pts.dy, pts.len, pts.dx+1, pts.dy+1, pts.len+1,
+						   pts.dmx+1, pts.dmy+1, pts.flags+1, n-1,
+						   iw, miterLimit, bevelCorners, &nleft, &nbevel);
 		}
 
-		path->convex = (nleft == path->count) ? 1 : 0;
+		path->nbevel = nbevel;
+		path->convex = (nleft == n) ? 1 : 0;
 	}
 }
 
+// Emits the miter vertices of points s..e-1 up to the first one that needs a join, returns its index.
+static int nvg__miterRun(NVGcontext* ctx, const NVGpoints* pts, int s, int e,
+						 float lw, float rw, float lu, float ru, NVGvertex** dst)
+{
+	int j = s;
+	while (j < e && (pts->flags[j] & (NVG_PT_BEVEL | NVG_PR_INNERBEVEL)) == 0)
+		j++;
+	if (j > s)
+		*dst = ctx->kernels->fringe(pts->x+s, pts->y+s, pts->dmx+s, pts->dmy+s, j-s, lw, rw, lu, ru, *dst);
+	return j;
+}
 
 static int nvg__expandStroke(NVGcontext* ctx, float w, float fringe, int lineCap, int lineJoin, float miterLimit)
 {
@@ -1788,9 +2558,8 @@ static int nvg__expandStroke(NVGcontext* ctx, float w, float fringe, int lineCap
 
 	for (i = 0; i < cache->npaths; i++) {
 		NVGpath* path = &cache->paths[i];
-		NVGpoint* pts = &cache->points[path->first];
-		NVGpoint* p0;
-		NVGpoint* p1;
+		NVGpoints pts = nvg__pathPoints(cache, path);
+		NVGpoint p0, p1;
 		int s, e, loop;
 		float dx, dy;
 
@@ -1804,43 +2573,39 @@ static int nvg__expandStroke(NVGcontext* ctx, float w, float fringe, int lineCap
 
 		if (loop) {
 			// Looping
-			p0 = &pts[path->count-1];
-			p1 = &pts[0];
 			s = 0;
 			e = path->count;
 		} else {
 			// Add cap
-			p0 = &pts[0];
-			p1 = &pts[1];
 			s = 1;
 			e = path->count-1;
 		}
 
 		if (loop == 0) {
 			// Add cap
-			dx = p1->x - p0->x;
-			dy = p1->y - p0->y;
+			nvg__getPoint(&pts, 0, &p0);
+			nvg__getPoint(&pts, 1, &p1);
+			dx = p1.x - p0.x;
+			dy = p1.y - p0.y;
 			nvg__normalize(&dx, &dy);
 			if (lineCap == NVG_BUTT)
-				dst = nvg__buttCapStart(dst, p0, dx, dy, w, -aa*0.5f, aa, u0, u1);
+				dst = nvg__buttCapStart(dst, &p0, dx, dy, w, -aa*0.5f, aa, u0, u1);
 			else if (lineCap == NVG_BUTT || lineCap == NVG_SQUARE)
-				dst = nvg__buttCapStart(dst, p0, dx, dy, w, w-aa, aa, u0, u1);
+				dst = nvg__buttCapStart(dst, &p0, dx, dy, w, w-aa, aa, u0, u1);
 			else if (lineCap == NVG_ROUND)
-				dst = nvg__roundCapStart(dst, p0, dx, dy, w, ncap, aa, u0, u1);
+				dst = nvg__roundCapStart(dst, &p0, dx, dy, w, ncap, aa, u0, u1);
 		}
 
 		for (j = s; j < e; ++j) {
-			if ((p1->flags & (NVG_PT_BEVEL | NVG_PR_INNERBEVEL)) != 0) {
-				if (lineJoin == NVG_ROUND) {
-					dst = nvg__roundJoin(dst, p0, p1, w, w, u0, u1, ncap, aa);
-				} else {
-					dst = nvg__bevelJoin(dst, p0, p1, w, w, u0, u1, aa);
-				}
+			j = nvg__miterRun(ctx, &pts, j, e, w, w, u0, u1, &dst);
+			if (j == e) break;
+			nvg__getPoint(&pts, j > 0 ? j-1 : path->count-1, &p0);
+			nvg__getPoint(&pts, j, &p1);
+			if (lineJoin == NVG_ROUND) {
+				dst = nvg__roundJoin(dst, &p0, &p1, w, w, u0, u1, ncap, aa);
 			} else {
-				nvg__vset(dst, p1->x + (p1->dmx * w), p1->y + (p1->dmy * w), u0,1); dst++;
-				nvg__vset(dst, p1->x - (p1->dmx * w), p1->y - (p1->dmy * w), u1,1); dst++;
+				dst = nvg__bevelJoin(dst, &p0, &p1, w, w, u0, u1, aa);
 			}
-			p0 = p1++;
 		}
 
 		if (loop) {
@@ -1849,15 +2614,17 @@ static int nvg__expandStroke(NVGcontext* ctx, float w, float fringe, int lineCap
 			nvg__vset(dst, verts[1].x, verts[1].y, u1,1); dst++;
 		} else {
 			// Add cap
-			dx = p1->x - p0->x;
-			dy = p1->y - p0->y;
+			nvg__getPoint(&pts, e-1, &p0);
+			nvg__getPoint(&pts, e, &p1);
+			dx = p1.x - p0.x;
+			dy = p1.y - p0.y;
 			nvg__normalize(&dx, &dy);
 			if (lineCap == NVG_BUTT)
-				dst = nvg__buttCapEnd(dst, p1, dx, dy, w, -aa*0.5f, aa, u0, u1);
+				dst = nvg__buttCapEnd(dst, &p1, dx, dy, w, -aa*0.5f, aa, u0, u1);
 			else if (lineCap == NVG_BUTT || lineCap == NVG_SQUARE)
-				dst = nvg__buttCapEnd(dst, p1, dx, dy, w, w-aa, aa, u0, u1);
+				dst = nvg__buttCapEnd(dst, &p1, dx, dy, w, w-aa, aa, u0, u1);
 			else if (lineCap == NVG_ROUND)
-				dst = nvg__roundCapEnd(dst, p1, dx, dy, w, ncap, aa, u0, u1);
+				dst = nvg__roundCapEnd(dst, &p1, dx, dy, w, ncap, aa, u0, u1);
 		}
 
 		path->nstroke = (int)(dst - verts);
@@ -1895,9 +2662,9 @@ static int nvg__expandFill(NVGcontext* ctx, float w, int lineJoin, float miterLi
 
 	for (i = 0; i < cache->npaths; i++) {
 		NVGpath* path = &cache->paths[i];
-		NVGpoint* pts = &cache->points[path->first];
-		NVGpoint* p0;
-		NVGpoint* p1;
+		NVGpoints pts = nvg__pathPoints(cache, path);
+		NVGpoint p0, p1;
+		int n = path->count;
 		float rw, lw, woff;
 		float ru, lu;
 
@@ -1908,34 +2675,32 @@ static int nvg__expandFill(NVGcontext* ctx, float w, int lineJoin, float miterLi
 
 		if (fringe) {
 			// Looping
-			p0 = &pts[path->count-1];
-			p1 = &pts[0];
-			for (j = 0; j < path->count; ++j) {
-				if (p1->flags & NVG_PT_BEVEL) {
-					float dlx0 = p0->dy;
-					float dly0 = -p0->dx;
-					float dlx1 = p1->dy;
-					float dly1 = -p1->dx;
-					if (p1->flags & NVG_PT_LEFT) {
-						float lx = p1->x + p1->dmx * woff;
-						float ly = p1->y + p1->dmy * woff;
+			for (j = 0; j < n; ++j) {
+				if (pts.flags[j] & NVG_PT_BEVEL) {
+					int k = j > 0 ? j-1 : n-1;
+					float dlx0 = pts.dy[k];
+					float dly0 = -pts.dx[k];
+					float dlx1 = pts.dy[j];
+					float dly1 = -pts.dx[j];
+					if (pts.flags[j] & NVG_PT_LEFT) {
+						float lx = pts.x[j] + pts.dmx[j] * woff;
+						float ly = pts.y[j] + pts.dmy[j] * woff;
 						nvg__vset(dst, lx, ly, 0.5f,1); dst++;
 					} else {
-						float lx0 = p1->x + dlx0 * woff;
-						float ly0 = p1->y + dly0 * woff;
-						float lx1 = p1->x + dlx1 * woff;
-						float ly1 = p1->y + dly1 * woff;
+						float lx0 = pts.x[j] + dlx0 * woff;
+						float ly0 = pts.y[j] + dly0 * woff;
+						float lx1 = pts.x[j] + dlx1 * woff;
+						float ly1 = pts.y[j] + dly1 * woff;
 						nvg__vset(dst, lx0, ly0, 0.5f,1); dst++;
 						nvg__vset(dst, lx1, ly1, 0.5f,1); dst++;
 					}
 				} else {
-					nvg__vset(dst, p1->x + (p1->dmx * woff), p1->y + (p1->dmy * woff), 0.5f,1); dst++;
+					nvg__vset(dst, pts.x[j] + (pts.dmx[j] * woff), pts.y[j] + (pts.dmy[j] * woff), 0.5f,1); dst++;
 				}
-				p0 = p1++;
 			}
 		} else {
-			for (j = 0; j < path->count; ++j) {
-				nvg__vset(dst, pts[j].x, pts[j].y, 0.5f,1);
+			for (j = 0; j < n; ++j) {
+				nvg__vset(dst, pts.x[j], pts.y[j], 0.5f,1);
 				dst++;
 			}
 		}
@@ -1960,17 +2725,12 @@ static int nvg__expandFill(NVGcontext* ctx, float w, int lineJoin, float miterLi
 			}
 
 			// Looping
-			p0 = &pts[path->count-1];
-			p1 = &pts[0];
-
-			for (j = 0; j < path->count; ++j) {
-				if ((p1->flags & (NVG_PT_BEVEL | NVG_PR_INNERBEVEL)) != 0) {
-					dst = nvg__bevelJoin(dst, p0, p1, lw, rw, lu, ru, ctx->fringeWidth);
-				} else {
-					nvg__vset(dst, p1->x + (p1->dmx * lw), p1->y + (p1->dmy * lw), lu,1); dst++;
-					nvg__vset(dst, p1->x - (p1->dmx * rw), p1->y - (p1->dmy * rw), ru,1); dst++;
-				}
-				p0 = p1++;
+			for (j = 0; j < n; ++j) {
+				j = nvg__miterRun(ctx, &pts, j, n, lw, rw, lu, ru, &dst);
+				if (j == n) break;
+				nvg__getPoint(&pts, j > 0 ? j-1 : n-1, &p0);
+				nvg__getPoint(&pts, j, &p1);
+				dst = nvg__bevelJoin(dst, &p0, &p1, lw, rw, lu, ru, ctx->fringeWidth);
 			}
 
 			// Loop it
@@ -1988,29 +2748,342 @@ static int nvg__expandFill(NVGcontext* ctx, float w, int lineJoin, float miterLi
 	return 1;
 }
 
+static unsigned int nvg__retainedBucket(unsigned long long key)
+{
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	return (unsigned int)key & (NVG_RETAINED_BUCKETS-1);
+}
+
+static int nvg__retainedMatches(const NVGretained* e, unsigned long long key, const float* xform, float devicePxRatio)
+{
+	// Translation is applied as an offset, everything else must match.
+	return e->key == key &&
+		e->xform[0] == xform[0] && e->xform[1] == xform[1] &&
+		e->xform[2] == xform[2] && e->xform[3] == xform[3] &&
+		e->devicePxRatio == devicePxRatio;
+}
+
+static void nvg__unlinkRetained(NVGretainedCache* rc, NVGretained* e)
+{
+	// New entries are not linked yet, only the head and the tail have no neighbour on one side.
+	if (e->lruPrev != NULL) e->lruPrev->lruNext = e->lruNext;
+	else if (rc->lruHead == e) rc->lruHead = e->lruNext;
+	if (e->lruNext != NULL) e->lruNext->lruPrev = e->lruPrev;
+	else if (rc->lruTail == e) rc->lruTail = e->lruPrev;
+	e->lruPrev = e->lruNext = NULL;
+}
+
+static void nvg__touchRetained(NVGretainedCache* rc, NVGretained* e)
+{
+	nvg__unlinkRetained(rc, e);
+	e->lruNext = rc->lruHead;
+	if (rc->lruHead != NULL) rc->lruHead->lruPrev = e;
+	rc->lruHead = e;
+	if (rc->lruTail == NULL) rc->lruTail = e;
+}
+
+static void nvg__deleteRetained(NVGretainedCache* rc, NVGretained* e)
+{
+	NVGretained** link = &rc->buckets[nvg__retainedBucket(e->key)];
+	while (*link != NULL && *link != e)
+		link = &(*link)->next;
+	if (*link == e)
+		*link = e->next;
+	nvg__unlinkRetained(rc, e);
+	if (rc->current == e)
+		rc->current = NULL;
+	rc->bytes -= e->bytes;
+	rc->nentries--;
+	free(e->points.x);
+	free(e->paths);
+	free(e->commands);
+	free(e->fillVerts);
+	free(e->strokeVerts);
+	free(e);
+}
+
+static void nvg__trimRetained(NVGretainedCache* rc)
+{
+	NVGretained* e = rc->lruTail;
+	while (rc->bytes > rc->budget && e != NULL) {
+		NVGretained* prev = e->lruPrev;
+		// Keep the entry bound to the current path, it is still being filled in.
+		if (e != rc->current)
+			nvg__deleteRetained(rc, e);
+		e = prev;
+	}
+}
+
+// Copies retained geometry into the path cache, offset by the change in translation.
+static int nvg__loadRetained(NVGcontext* ctx, NVGretained* e)
+{
+	NVGpathCache* cache = ctx->cache;
+	float dx = ctx->retained->origin[0] - e->xform[4];
+	float dy = ctx->retained->origin[1] - e->xform[5];
+	NVGpath* paths;
+	int i;
+
+	cache->npoints = 0;
+	if (nvg__reservePoints(ctx, e->npoints) == 0) return 0;
+	paths = (NVGpath*)nvgArenaReserve(ctx->arena, cache->paths, &cache->cpaths, &cache->gpaths, e->npaths, 0, sizeof(NVGpath));
+	if (paths == NULL) return 0;
+	cache->paths = paths;
+
+	nvg__copyPoints(&cache->points, &e->points, e->npoints);
+	for (i = 0; i < e->npoints; i++) {
+		cache->points.x[i] += dx;
+		cache->points.y[i] += dy;
+	}
+	cache->npoints = e->npoints;
+
+	for (i = 0; i < e->npaths; i++) {
+		NVGpath* path = &cache->paths[i];
+		memset(path, 0, sizeof(*path));
+		path->first = e->paths[i].first;
+		path->count = e->paths[i].count;
+		path->closed = e->paths[i].closed;
+		path->winding = e->paths[i].winding;
+		path->convex = e->paths[i].convex;
+	}
+	cache->npaths = e->npaths;
+
+	cache->bounds[0] = e->bounds[0] + dx;
+	cache->bounds[1] = e->bounds[1] + dy;
+	cache->bounds[2] = e->bounds[2] + dx;
+	cache->bounds[3] = e->bounds[3] + dy;
+
+	return 1;
+}
+
+static NVGvertex* nvg__loadRetainedVerts(NVGcontext* ctx, const NVGretained* e, const NVGvertex* src, int nverts)
+{
+	float dx = ctx->retained->origin[0] - e->xform[4];
+	float dy = ctx->retained->origin[1] - e->xform[5];
+	NVGvertex* verts = nvg__allocTempVerts(ctx, nverts);
+	int i;
+
+	if (verts == NULL) return NULL;
+	for (i = 0; i < nverts; i++)
+		nvg__vset(&verts[i], src[i].x + dx, src[i].y + dy, src[i].u, src[i].v);
+	return verts;
+}
+
+static int nvg__storeRetainedVerts(NVGcontext* ctx, NVGretained* e, NVGvertex** dst, int* ndst, int nverts)
+{
+	const NVGvertex* src = ctx->cache->verts;
+	float dx = ctx->retained->origin[0] - e->xform[4];
+	float dy = ctx->retained->origin[1] - e->xform[5];
+	int i, delta;
+
+	if (nverts > *ndst || *dst == NULL) {
+		NVGvertex* verts = (NVGvertex*)realloc(*dst, sizeof(NVGvertex)*nvg__maxi(1, nverts));
+		if (verts == NULL) return 0;
+		*dst = verts;
+	}
+	for (i = 0; i < nverts; i++)
+		nvg__vset(&(*dst)[i], src[i].x - dx, src[i].y - dy, src[i].u, src[i].v);
+
+	delta = (int)sizeof(NVGvertex) * (nverts - *ndst);
+	e->bytes += delta;
+	ctx->retained->bytes += delta;
+	*ndst = nverts;
+	return 1;
+}
+
+// Returns the entry the current path should be retained in, creating it on a miss.
+static NVGretained* nvg__retainedEntry(NVGcontext* ctx)
+{
+	NVGretainedCache* rc = ctx->retained;
+	NVGpathCache* cache = ctx->cache;
+	NVGstate* state = nvg__getState(ctx);
+	NVGretained* e;
+	unsigned char* block;
+	unsigned int bucket;
+	int i, cap;
+
+	if (rc->current != NULL) return rc->current;
+	if (rc->pending == 0) return NULL;
+	rc->pending = 0;
+
+	e = (NVGretained*)malloc(sizeof(NVGretained));
+	if (e == NULL) return NULL;
+	memset(e, 0, sizeof(NVGretained));
+	cap = nvg__pointCapacity(cache->npoints);
+	block = (unsigned char*)malloc(cap * NVG_POINT_BYTES);
+	e->paths = (NVGretainedPath*)malloc(sizeof(NVGretainedPath)*nvg__maxi(1, cache->npaths));
+	if (rc->npendingCommands > 0)
+		e->commands = (float*)malloc(sizeof(float)*rc->npendingCommands);
+	if (block == NULL || e->paths == NULL || (rc->npendingCommands > 0 && e->commands == NULL)) {
+		free(block);
+		free(e->paths);
+		free(e->commands);
+		free(e);
+		return NULL;
+	}
+
+	e->key = rc->pendingKey;
+	memcpy(e->xform, state->xform, sizeof(float)*4);
+	e->xform[4] = rc->origin[0];
+	e->xform[5] = rc->origin[1];
+	e->devicePxRatio = ctx->devicePxRatio;
+	if (rc->npendingCommands > 0)
+		memcpy(e->commands, rc->pendingCommands, sizeof(float)*rc->npendingCommands);
+	e->ncommands = rc->npendingCommands;
+	nvg__setPointArrays(&e->points, block, cap);
+	nvg__copyPoints(&e->points, &cache->points, cache->npoints);
+	e->npoints = cache->npoints;
+	memset(e->paths, 0, sizeof(NVGretainedPath)*cache->npaths);
+	for (i = 0; i < cache->npaths; i++) {
+		e->paths[i].first = cache->paths[i].first;
+		e->paths[i].count = cache->paths[i].count;
+		e->paths[i].closed = cache->paths[i].closed;
+		e->paths[i].winding = cache->paths[i].winding;
+		e->paths[i].convex = cache->paths[i].convex;
+	}
+	e->npaths = cache->npaths;
+	memcpy(e->bounds, cache->bounds, sizeof(e->bounds));
+	e->bytes = (int)(sizeof(NVGretained) + NVG_POINT_BYTES*cap + sizeof(NVGretainedPath)*e->npaths + sizeof(float)*e->ncommands);
+
+	bucket = nvg__retainedBucket(e->key);
+	e->next = rc->buckets[bucket];
+	rc->buckets[bucket] = e;
+	nvg__touchRetained(rc, e);
+	rc->nentries++;
+	rc->bytes += e->bytes;
+	rc->current = e;
+
+	return e;
+}
+
+static int nvg__retainedFill(NVGcontext* ctx, float fringe)
+{
+	NVGretained* e = ctx->retained->current;
+	NVGvertex* verts;
+	int i;
+
+	if (e == NULL || e->hasFill == 0 || e->fillFringe != fringe)
+		return 0;
+
+	verts = nvg__loadRetainedVerts(ctx, e, e->fillVerts, e->nfillVerts);
+	if (verts == NULL) return 0;
+
+	for (i = 0; i < e->npaths; i++) {
+		NVGpath* path = &ctx->cache->paths[i];
+		const NVGretainedPath* rp = &e->paths[i];
+		path->fill = &verts[rp->fillOffset];
+		path->nfill = rp->nfill;
+		path->stroke = rp->nfringe > 0 ? &verts[rp->fringeOffset] : NULL;
+		path->nstroke = rp->nfringe;
+		path->convex = rp->convex;
+	}
+	return 1;
+}
+
+static void nvg__retainFill(NVGcontext* ctx, float fringe)
+{
+	NVGpathCache* cache = ctx->cache;
+	NVGretained* e = nvg__retainedEntry(ctx);
+	int i, nverts = 0;
+
+	if (e == NULL || e->npaths != cache->npaths) return;
+
+	for (i = 0; i < cache->npaths; i++) {
+		const NVGpath* path = &cache->paths[i];
+		NVGretainedPath* rp = &e->paths[i];
+		rp->fillOffset = path->fill != NULL ? (int)(path->fill - cache->verts) : 0;
+		rp->nfill = path->nfill;
+		rp->fringeOffset = path->stroke != NULL ? (int)(path->stroke - cache->verts) : 0;
+		rp->nfringe = path->nstroke;
+		rp->convex = path->convex;
+		nverts = nvg__maxi(nverts, rp->fillOffset + rp->nfill);
+		nverts = nvg__maxi(nverts, rp->fringeOffset + rp->nfringe);
+	}
+
+	e->hasFill = nvg__storeRetainedVerts(ctx, e, &e->fillVerts, &e->nfillVerts, nverts);
+	e->fillFringe = fringe;
+	nvg__trimRetained(ctx->retained);
+}
+
+static int nvg__retainedStroke(NVGcontext* ctx, float w, float fringe, int lineCap, int lineJoin, float miterLimit)
+{
+	NVGretained* e = ctx->retained->current;
+	NVGvertex* verts;
+	int i;
+
+	if (e == NULL || e->hasStroke == 0 || e->strokeWidth != w || e->strokeFringe != fringe ||
+		e->lineCap != lineCap || e->lineJoin != lineJoin || e->miterLimit != miterLimit)
+		return 0;
+
+	verts = nvg__loadRetainedVerts(ctx, e, e->strokeVerts, e->nstrokeVerts);
+	if (verts == NULL) return 0;
+
+	for (i = 0; i < e->npaths; i++) {
+		NVGpath* path = &ctx->cache->paths[i];
+		const NVGretainedPath* rp = &e->paths[i];
+		path->fill = NULL;
+		path->nfill = 0;
+		path->stroke = &verts[rp->strokeOffset];
+		path->nstroke = rp->nstroke;
+	}
+	return 1;
+}
+
+static void nvg__retainStroke(NVGcontext* ctx, float w, float fringe, int lineCap, int lineJoin, float miterLimit)
+{
+	NVGpathCache* cache = ctx->cache;
+	NVGretained* e = nvg__retainedEntry(ctx);
+	int i, nverts = 0;
+
+	if (e == NULL || e->npaths != cache->npaths) return;
+
+	for (i = 0; i < cache->npaths; i++) {
+		const NVGpath* path = &cache->paths[i];
+		NVGretainedPath* rp = &e->paths[i];
+		rp->strokeOffset = path->stroke != NULL ? (int)(path->stroke - cache->verts) : 0;
+		rp->nstroke = path->nstroke;
+		nverts = nvg__maxi(nverts, rp->strokeOffset + rp->nstroke);
+	}
+
+	e->hasStroke = nvg__storeRetainedVerts(ctx, e, &e->strokeVerts, &e->nstrokeVerts, nverts);
+	e->strokeWidth = w;
+	e->strokeFringe = fringe;
+	e->lineCap = lineCap;
+	e->lineJoin = lineJoin;
+	e->miterLimit = miterLimit;
+	nvg__trimRetained(ctx->retained);
+}
+
 
 // Draw
 void nvgBeginPath(NVGcontext* ctx)
 {
+	NVG_TRACE(ctx, NVG_TRACE_BEGIN_PATH);
 	ctx->ncommands = 0;
 	nvg__clearPathCache(ctx);
+	ctx->retained->current = NULL;
+	ctx->retained->pending = 0;
 }
 
 void nvgMoveTo(NVGcontext* ctx, float x, float y)
 {
 	float vals[] = { NVG_MOVETO, x, y };
+	NVG_TRACE(ctx, NVG_TRACE_MOVE_TO, x, y);
 	nvg__appendCommands(ctx, vals, NVG_COUNTOF(vals));
 }
 
 void nvgLineTo(NVGcontext* ctx, float x, float y)
 {
 	float vals[] = { NVG_LINETO, x, y };
+	NVG_TRACE(ctx, NVG_TRACE_LINE_TO, x, y);
 	nvg__appendCommands(ctx, vals, NVG_COUNTOF(vals));
 }
 
 void nvgBezierTo(NVGcontext* ctx, float c1x, float c1y, float c2x, float c2y, float x, float y)
 {
 	float vals[] = { NVG_BEZIERTO, c1x, c1y, c2x, c2y, x, y };
+	NVG_TRACE(ctx, NVG_TRACE_BEZIER_TO, c1x, c1y, c2x, c2y, x, y);
 	nvg__appendCommands(ctx, vals, NVG_COUNTOF(vals));
 }
 
@@ -2022,6 +3095,7 @@ void nvgQuadTo(NVGcontext* ctx, float cx, float cy, float x, float y)
 		x0 + 2.0f/3.0f*(cx - x0), y0 + 2.0f/3.0f*(cy - y0),
 		x + 2.0f/3.0f*(cx - x), y + 2.0f/3.0f*(cy - y),
 		x, y };
+	NVG_TRACE(ctx, NVG_TRACE_QUAD_TO, cx, cy, x, y);
 	nvg__appendCommands(ctx, vals, NVG_COUNTOF(vals));
 }
 
@@ -2032,6 +3106,8 @@ void nvgArcTo(NVGcontext* ctx, float x1, float y1, float x2, float y2, float rad
 	float dx0,dy0, dx1,dy1, a, d, cx,cy, a0,a1;
 	int dir;
 
+	NVG_TRACE(ctx, NVG_TRACE_ARC_TO, x1, y1, x2, y2, radius);
+
 	if (ctx->ncommands == 0) {
 		return;
 	}
@@ -2041,7 +3117,7 @@ void nvgArcTo(NVGcontext* ctx, float x1, float y1, float x2, float y2, float rad
 		nvg__ptEquals(x1,y1, x2,y2, ctx->distTol) ||
 		nvg__distPtSeg(x1,y1, x0,y0, x2,y2) < ctx->distTol*ctx->distTol ||
 		radius < ctx->distTol) {
-		nvgLineTo(ctx, x1,y1);
+		NVG_TRACE_MUTED(ctx, nvgLineTo(ctx, x1,y1));
 		return;
 	}
 
@@ -2058,7 +3134,7 @@ void nvgArcTo(NVGcontext* ctx, float x1, float y1, float x2, float y2, float rad
 //	printf("a=%f° d=%f\n", a/NVG_PI*180.0f, d);
 
 	if (d > 10000.0f) {
-		nvgLineTo(ctx, x1,y1);
+		NVG_TRACE_MUTED(ctx, nvgLineTo(ctx, x1,y1));
 		return;
 	}
 
@@ -2078,21 +3154,147 @@ void nvgArcTo(NVGcontext* ctx, float x1, float y1, float x2, float y2, float rad
 //		printf("CCW c=(%f, %f) a0=%f° a1=%f°\n", cx, cy, a0/NVG_PI*180.0f, a1/NVG_PI*180.0f);
 	}
 
-	nvgArc(ctx, cx, cy, radius, a0, a1, dir);
+	NVG_TRACE_MUTED(ctx, nvgArc(ctx, cx, cy, radius, a0, a1, dir));
 }
 
 void nvgClosePath(NVGcontext* ctx)
 {
 	float vals[] = { NVG_CLOSE };
+	NVG_TRACE(ctx, NVG_TRACE_CLOSE_PATH);
 	nvg__appendCommands(ctx, vals, NVG_COUNTOF(vals));
 }
 
 void nvgPathWinding(NVGcontext* ctx, int dir)
 {
 	float vals[] = { NVG_WINDING, (float)dir };
+	NVG_TRACE(ctx, NVG_TRACE_PATH_WINDING, dir);
 	nvg__appendCommands(ctx, vals, NVG_COUNTOF(vals));
 }
 
+static void nvg__placePoints(NVGcontext* ctx, float* pts, const int* slots, int npoints, const float* t)
+{
+	int i;
+	ctx->kernels->transform(pts, pts, npoints, t);
+	for (i = 0; i < npoints; i++) {
+		ctx->commands[slots[i]+0] = pts[i*2+0];
+		ctx->commands[slots[i]+1] = pts[i*2+1];
+	}
+}
+
+void nvgAppendPathCommands(NVGcontext* ctx, const float* cmds, int ncmds, const float* xform)
+{
+	NVGstate* state = nvg__getState(ctx);
+	float t[6], inv[6], sx, sy;
+	const float* last = NULL;
+	float pts[NVG_APPEND_CHUNK*2];
+	int slots[NVG_APPEND_CHUNK];
+	float* commands;
+	float* dst;
+	int i = 0, k, npoints = 0, nvals;
+
+	if (ncmds <= 0) return;
+	NVG_TRACE(ctx, NVG_TRACE_APPEND_PATH, cmds, ncmds, xform);
+
+	memcpy(t, state->xform, sizeof(float)*6);
+	if (xform != NULL) {
+		memcpy(t, xform, sizeof(float)*6);
+		nvgTransformMultiply(t, state->xform);
+	}
+
+	// Quads grow by two values when converted to cubics, so this covers the whole buffer.
+	nvals = ncmds + (ncmds/5)*2 + 2;
+	commands = (float*)nvgArenaReserve(ctx->arena, ctx->commands, &ctx->ccommands, &ctx->gcommands, ctx->ncommands + nvals, ctx->ncommands, sizeof(float));
+	if (commands == NULL) return;
+	ctx->commands = commands;
+
+	// Previous point in the space of the commands, needed to raise quads to cubics. Affine transforms
+	// keep the control points of the cubic, so it is raised before transforming it.
+	sx = ctx->commandx;
+	sy = ctx->commandy;
+	if (xform != NULL && nvgTransformInverse(inv, xform))
+		nvgTransformPoint(&sx, &sy, inv, ctx->commandx, ctx->commandy);
+
+	// Lay out the commands with the points packed on the side, and transform the points a chunk at
+	// a time while they are in the cache.
+	dst = &ctx->commands[ctx->ncommands];
+	while (i < ncmds) {
+		int cmd = (int)cmds[i];
+		int at = (int)(dst - ctx->commands) + 1;
+		if (npoints > NVG_APPEND_CHUNK-3) {
+			nvg__placePoints(ctx, pts, slots, npoints, t);
+			npoints = 0;
+		}
+		switch (cmd) {
+		case NVG_MOVETO:
+		case NVG_LINETO:
+			if (i+3 > ncmds) { i = ncmds; break; }
+			dst[0] = (float)cmd;
+			pts[npoints*2+0] = sx = cmds[i+1];
+			pts[npoints*2+1] = sy = cmds[i+2];
+			slots[npoints++] = at;
+			last = &cmds[i+1];
+			dst += 3;
+			i += 3;
+			break;
+		case NVG_BEZIERTO:
+			if (i+7 > ncmds) { i = ncmds; break; }
+			dst[0] = NVG_BEZIERTO;
+			for (k = 0; k < 6; k++)
+				pts[npoints*2+k] = cmds[i+1+k];
+			slots[npoints+0] = at;
+			slots[npoints+1] = at+2;
+			slots[npoints+2] = at+4;
+			npoints += 3;
+			sx = cmds[i+5]; sy = cmds[i+6];
+			last = &cmds[i+5];
+			dst += 7;
+			i += 7;
+			break;
+		case NVG_QUADTO:
+			if (i+5 > ncmds) { i = ncmds; break; }
+			dst[0] = NVG_BEZIERTO;
+			pts[npoints*2+0] = sx + 2.0f/3.0f*(cmds[i+1] - sx);
+			pts[npoints*2+1] = sy + 2.0f/3.0f*(cmds[i+2] - sy);
+			pts[npoints*2+2] = cmds[i+3] + 2.0f/3.0f*(cmds[i+1] - cmds[i+3]);
+			pts[npoints*2+3] = cmds[i+4] + 2.0f/3.0f*(cmds[i+2] - cmds[i+4]);
+			pts[npoints*2+4] = sx = cmds[i+3];
+			pts[npoints*2+5] = sy = cmds[i+4];
+			slots[npoints+0] = at;
+			slots[npoints+1] = at+2;
+			slots[npoints+2] = at+4;
+			npoints += 3;
+			last = &cmds[i+3];
+			dst += 7;
+			i += 5;
+			break;
+		case NVG_CLOSE:
+			*dst++ = NVG_CLOSE;
+			i++;
+			break;
+		case NVG_WINDING:
+			if (i+2 > ncmds) { i = ncmds; break; }
+			*dst++ = NVG_WINDING;
+			*dst++ = cmds[i+1];
+			i += 2;
+			break;
+		default:
+			i++;
+		}
+	}
+	ctx->ncommands = (int)(dst - ctx->commands);
+	nvg__placePoints(ctx, pts, slots, npoints, t);
+
+	// Keep the pen position in user space for subsequent nvgQuadTo()/nvgArcTo() calls.
+	if (last != NULL) {
+		if (xform != NULL)
+			nvgTransformPoint(&ctx->commandx, &ctx->commandy, xform, last[0], last[1]);
+		else {
+			ctx->commandx = last[0];
+			ctx->commandy = last[1];
+		}
+	}
+}
+
 void nvgArc(NVGcontext* ctx, float cx, float cy, float r, float a0, float a1, int dir)
 {
 	float a = 0, da = 0, hda = 0, kappa = 0;
@@ -2102,6 +3304,8 @@ void nvgArc(NVGcontext* ctx, float cx, float cy, float r, float a0, float a1, in
 	int i, ndivs, nvals;
 	int move = ctx->ncommands > 0 ? NVG_LINETO : NVG_MOVETO;
 
+	NVG_TRACE(ctx, NVG_TRACE_ARC, cx, cy, r, a0, a1, dir);
+
 	// Clamp angles
 	da = a1 - a0;
 	if (dir == NVG_CW) {
@@ -2167,6 +3371,7 @@ void nvgRect(NVGcontext* ctx, float x, float y, float w, float h)
 		NVG_LINETO, x+w,y,
 		NVG_CLOSE
 	};
+	NVG_TRACE(ctx, NVG_TRACE_RECT, x, y, w, h);
 	nvg__appendCommands(ctx, vals, NVG_COUNTOF(vals));
 }
 
@@ -2177,8 +3382,9 @@ void nvgRoundedRect(NVGcontext* ctx, float x, float y, float w, float h, float r
 
 void nvgRoundedRectVarying(NVGcontext* ctx, float x, float y, float w, float h, float radTopLeft, float radTopRight, float radBottomRight, float radBottomLeft)
 {
+	NVG_TRACE(ctx, NVG_TRACE_ROUNDED_RECT, x, y, w, h, radTopLeft, radTopRight, radBottomRight, radBottomLeft);
 	if(radTopLeft < 0.1f && radTopRight < 0.1f && radBottomRight < 0.1f && radBottomLeft < 0.1f) {
-		nvgRect(ctx, x, y, w, h);
+		NVG_TRACE_MUTED(ctx, nvgRect(ctx, x, y, w, h));
 		return;
 	} else {
 		float halfw = nvg__absf(w)*0.5f;
@@ -2213,6 +3419,7 @@ void nvgEllipse(NVGcontext* ctx, float cx, float cy, float rx, float ry)
 		NVG_BEZIERTO, cx-rx*NVG_KAPPA90, cy-ry, cx-rx, cy-ry*NVG_KAPPA90, cx-rx, cy,
 		NVG_CLOSE
 	};
+	NVG_TRACE(ctx, NVG_TRACE_ELLIPSE, cx, cy, rx, ry);
 	nvg__appendCommands(ctx, vals, NVG_COUNTOF(vals));
 }
 
@@ -2221,6 +3428,94 @@ void nvgCircle(NVGcontext* ctx, float cx, float cy, float r)
 	nvgEllipse(ctx, cx,cy, r,r);
 }
 
+int nvgBeginRetainedPath(NVGcontext* ctx, unsigned long long key)
+{
+	return nvgBeginRetainedPathCommands(ctx, key, NULL, 0, 0.0f, 0.0f);
+}
+
+int nvgBeginRetainedPathCommands(NVGcontext* ctx, unsigned long long key, const float* commands, int ncommands, float tx, float ty)
+{
+	NVGretainedCache* rc = ctx->retained;
+	NVGstate* state = nvg__getState(ctx);
+	NVGretained* e;
+
+	NVG_TRACE(ctx, NVG_TRACE_BEGIN_RETAINED_PATH, key);
+	NVG_TRACE_MUTED(ctx, nvgBeginPath(ctx));
+
+	// While recording, paths are always built so that the trace has their commands.
+	if (ctx->trace != NULL)
+		return 0;
+
+	nvgTransformPoint(&rc->origin[0], &rc->origin[1], state->xform, tx, ty);
+
+	for (e = rc->buckets[nvg__retainedBucket(key)]; e != NULL; e = e->next) {
+		if (nvg__retainedMatches(e, key, state->xform, ctx->devicePxRatio))
+			break;
+	}
+
+	// Another path with the same key, it is built again and retained in place of this one.
+	if (e != NULL && commands != NULL &&
+		(e->ncommands != ncommands || memcmp(e->commands, commands, sizeof(float)*ncommands) != 0)) {
+		nvg__deleteRetained(rc, e);
+		e = NULL;
+	}
+
+	if (e != NULL) {
+		if (nvg__loadRetained(ctx, e) == 0) {
+			nvg__clearPathCache(ctx);
+			return 0;
+		}
+		nvg__touchRetained(rc, e);
+		rc->current = e;
+		rc->hits++;
+		return 1;
+	}
+
+	rc->npendingCommands = 0;
+	if (commands != NULL && ncommands > 0) {
+		if (ncommands > rc->cpendingCommands) {
+			float* buf = (float*)realloc(rc->pendingCommands, sizeof(float)*ncommands);
+			if (buf == NULL) return 0;
+			rc->pendingCommands = buf;
+			rc->cpendingCommands = ncommands;
+		}
+		memcpy(rc->pendingCommands, commands, sizeof(float)*ncommands);
+		rc->npendingCommands = ncommands;
+	}
+
+	rc->pendingKey = key;
+	rc->pending = 1;
+	rc->misses++;
+	return 0;
+}
+
+void nvgRetainedPathBudget(NVGcontext* ctx, int bytes)
+{
+	NVG_TRACE(ctx, NVG_TRACE_RETAINED_BUDGET, bytes);
+	ctx->retained->budget = nvg__maxi(0, bytes);
+	nvg__trimRetained(ctx->retained);
+}
+
+void nvgRetainedPathStats(NVGcontext* ctx, NVGretainedStats* stats)
+{
+	NVGretainedCache* rc = ctx->retained;
+	if (stats == NULL) return;
+	stats->hits = rc->hits;
+	stats->misses = rc->misses;
+	stats->entries = rc->nentries;
+	stats->bytes = rc->bytes;
+	stats->budget = rc->budget;
+}
+
+void nvgClearRetainedPaths(NVGcontext* ctx)
+{
+	NVGretainedCache* rc = ctx->retained;
+	NVG_TRACE(ctx, NVG_TRACE_CLEAR_RETAINED);
+	while (rc->lruHead != NULL)
+		nvg__deleteRetained(rc, rc->lruHead);
+	rc->pending = 0;
+}
+
 void nvgDebugDumpPathCache(NVGcontext* ctx)
 {
 	const NVGpath* path;
@@ -2243,23 +3538,262 @@ void nvgDebugDumpPathCache(NVGcontext* ctx)
 	}
 }
 
+static NVGtessWorker* nvg__createTessWorker(NVGcontext* ctx)
+{
+	NVGtessWorker* w;
+	NVGmemoryParams memory = ctx->params.memory;
+
+	w = (NVGtessWorker*)malloc(sizeof(NVGtessWorker));
+	if (w == NULL) return NULL;
+	memset(w, 0, sizeof(NVGtessWorker));
+
+	// The allocator may not be thread safe.
+	memory.allocator.alloc = NULL;
+	memory.allocator.free = NULL;
+
+	w->ctx.cache = nvg__allocPathCache(&memory);
+	w->ctx.arena = nvg__createArena(&memory);
+	w->ctx.kernels = ctx->kernels;
+	if (w->ctx.cache == NULL || w->ctx.arena == NULL) {
+		nvg__deletePathCache(w->ctx.cache);
+		nvg__deleteArena(w->ctx.arena);
+		free(w);
+		return NULL;
+	}
+	return w;
+}
+
+static void nvg__deleteTessWorkers(NVGcontext* ctx)
+{
+	int i;
+	nvgDeleteJobs(ctx->jobs);
+	ctx->jobs = NULL;
+	for (i = 0; i < ctx->ntessWorkers; i++) {
+		NVGtessWorker* w = ctx->tessWorkers[i];
+		if (w == NULL) continue;
+		nvg__deletePathCache(w->ctx.cache);
+		nvg__deleteArena(w->ctx.arena);
+		free(w);
+	}
+	free(ctx->tessWorkers);
+	ctx->tessWorkers = NULL;
+	ctx->ntessWorkers = 0;
+}
+
+void nvgTessellationThreads(NVGcontext* ctx, int threads)
+{
+	int i, n;
+
+	nvg__flushDeferred(ctx);
+	nvg__deleteTessWorkers(ctx);
+	if (threads < 2) return;
+
+	ctx->jobs = nvgCreateJobs(threads);
+	if (ctx->jobs == NULL) return;
+
+	n = nvgJobThreads(ctx->jobs);
+	ctx->tessWorkers = (NVGtessWorker**)malloc(sizeof(NVGtessWorker*) * n);
+	if (ctx->tessWorkers == NULL) {
+		nvg__deleteTessWorkers(ctx);
+		return;
+	}
+	memset(ctx->tessWorkers, 0, sizeof(NVGtessWorker*) * n);
+	ctx->ntessWorkers = n;
+
+	for (i = 0; i < n; i++) {
+		ctx->tessWorkers[i] = nvg__createTessWorker(ctx);
+		if (ctx->tessWorkers[i] == NULL) {
+			nvg__deleteTessWorkers(ctx);
+			return;
+		}
+	}
+}
+
+int nvgGetTessellationThreads(NVGcontext* ctx)
+{
+	return nvgJobThreads(ctx->jobs);
+}
+
+// Records the current path to be tessellated on the tessellation threads, returns 0 if it should be drawn right away.
+static int nvg__deferPath(NVGcontext* ctx, int type, const NVGpaint* paint, float fringe, float strokeWidth)
+{
+	NVGstate* state = nvg__getState(ctx);
+	NVGdeferred* deferred;
+	float* commands;
+	NVGdeferred* job;
+
+	// A path which is already flattened, e.g. by a clip, or is retained, gains nothing from it.
+	if (ctx->jobs == NULL || ctx->cache->npaths > 0 || ctx->retained->current != NULL || ctx->retained->pending)
+		return 0;
+
+	if (ctx->ndeferred >= NVG_MAX_DEFERRED)
+		nvg__flushDeferred(ctx);
+
+	deferred = (NVGdeferred*)nvgArenaReserve(ctx->arena, ctx->deferred, &ctx->cdeferred, &ctx->gdeferred,
+											 ctx->ndeferred+1, ctx->ndeferred, sizeof(NVGdeferred));
+	if (deferred == NULL) return 0;
+	ctx->deferred = deferred;
+
+	commands = (float*)nvgArenaReserve(ctx->arena, ctx->deferredCommands, &ctx->cdeferredCommands, &ctx->gdeferredCommands,
+									   ctx->ndeferredCommands + ctx->ncommands, ctx->ndeferredCommands, sizeof(float));
+	if (commands == NULL) return 0;
+	ctx->deferredCommands = commands;
+
+	job = &ctx->deferred[ctx->ndeferred++];
+	job->type = type;
+	job->paint = *paint;
+	job->compositeOperation = state->compositeOperation;
+	job->scissor = state->scissor;
+	job->fringe = fringe;
+	job->strokeWidth = strokeWidth;
+	job->lineCap = state->lineCap;
+	job->lineJoin = state->lineJoin;
+	job->miterLimit = state->miterLimit;
+	job->firstCommand = ctx->ndeferredCommands;
+	job->ncommands = ctx->ncommands;
+	job->npaths = 0;
+
+	memcpy(&ctx->deferredCommands[ctx->ndeferredCommands], ctx->commands, sizeof(float) * ctx->ncommands);
+	ctx->ndeferredCommands += ctx->ncommands;
+
+	return 1;
+}
+
+// Flattens and expands a deferred path on a tessellation thread.
+static void nvg__tessellateDeferred(void* userPtr, int worker, int index)
+{
+	NVGcontext* ctx = (NVGcontext*)userPtr;
+	NVGtessWorker* w = ctx->tessWorkers[worker];
+	NVGcontext* wctx = &w->ctx;
+	NVGpathCache* cache = wctx->cache;
+	NVGdeferred* job = &ctx->deferred[index];
+	NVGtessPath* paths;
+	int i, ok, end;
+
+	wctx->commands = &ctx->deferredCommands[job->firstCommand];
+	wctx->ncommands = job->ncommands;
+	nvg__clearPathCache(wctx);
+
+	nvg__flattenPaths(wctx);
+	if (job->type == NVG_DEFERRED_FILL)
+		ok = nvg__expandFill(wctx, job->fringe, NVG_MITER, 2.4f);
+	else
+		ok = nvg__expandStroke(wctx, job->strokeWidth*0.5f, job->fringe, job->lineCap, job->lineJoin, job->miterLimit);
+
+	job->worker = worker;
+	job->firstPath = w->npaths;
+	job->npaths = 0;
+	memcpy(job->bounds, cache->bounds, sizeof(job->bounds));
+	if (!ok) return;
+
+	paths = (NVGtessPath*)nvgArenaReserve(wctx->arena, w->paths, &w->cpaths, &w->gpaths,
+										  w->npaths + cache->npaths, w->npaths, sizeof(NVGtessPath));
+	if (paths == NULL) return;
+	w->paths = paths;
+
+	// The vertices stay in the path cache, the next path goes after them.
+	end = cache->nverts;
+	for (i = 0; i < cache->npaths; i++) {
+		const NVGpath* path = &cache->paths[i];
+		NVGtessPath* dst = &w->paths[w->npaths++];
+		dst->path = *path;
+		dst->fillOffset = path->fill != NULL ? (int)(path->fill - cache->verts) : 0;
+		dst->strokeOffset = path->stroke != NULL ? (int)(path->stroke - cache->verts) : 0;
+		end = nvg__maxi(end, dst->fillOffset + path->nfill);
+		end = nvg__maxi(end, dst->strokeOffset + path->nstroke);
+	}
+	cache->nverts = end;
+	job->npaths = cache->npaths;
+}
+
+// Hands a tessellated path to the back-end.
+static void nvg__submitDeferred(NVGcontext* ctx, NVGdeferred* job)
+{
+	NVGtessWorker* w = ctx->tessWorkers[job->worker];
+	NVGvertex* verts = w->ctx.cache->verts;
+	NVGpath* paths;
+	int i;
+
+	paths = (NVGpath*)nvgArenaReserve(ctx->arena, ctx->deferredPaths, &ctx->cdeferredPaths, &ctx->gdeferredPaths,
+									  nvg__maxi(job->npaths, 1), 0, sizeof(NVGpath));
+	if (paths == NULL) return;
+	ctx->deferredPaths = paths;
+
+	for (i = 0; i < job->npaths; i++) {
+		const NVGtessPath* src = &w->paths[job->firstPath + i];
+		paths[i] = src->path;
+		paths[i].fill = &verts[src->fillOffset];
+		paths[i].stroke = &verts[src->strokeOffset];
+	}
+
+	if (job->type == NVG_DEFERRED_FILL) {
+		ctx->params.renderFill(ctx->params.userPtr, &job->paint, job->compositeOperation, &job->scissor, ctx->fringeWidth,
+							   job->bounds, paths, job->npaths);
+		for (i = 0; i < job->npaths; i++) {
+			ctx->fillTriCount += paths[i].nfill-2;
+			ctx->fillTriCount += paths[i].nstroke-2;
+			ctx->drawCallCount += 2;
+		}
+	} else {
+		ctx->params.renderStroke(ctx->params.userPtr, &job->paint, job->compositeOperation, &job->scissor, ctx->fringeWidth,
+								 job->strokeWidth, paths, job->npaths);
+		for (i = 0; i < job->npaths; i++) {
+			ctx->strokeTriCount += paths[i].nstroke-2;
+			ctx->drawCallCount++;
+		}
+	}
+}
+
+// Tessellates the deferred paths in parallel, and hands them to the back-end in the order they were drawn.
+// Called before anything else reaches the back-end.
+static void nvg__flushDeferred(NVGcontext* ctx)
+{
+	int i;
+
+	if (ctx->ndeferred == 0) return;
+
+	for (i = 0; i < ctx->ntessWorkers; i++) {
+		NVGtessWorker* w = ctx->tessWorkers[i];
+		nvg__rewindArena(w->ctx.arena);
+		w->ctx.cache->nverts = 0;
+		w->npaths = 0;
+		w->ctx.tessTol = ctx->tessTol;
+		w->ctx.distTol = ctx->distTol;
+		w->ctx.fringeWidth = ctx->fringeWidth;
+		w->ctx.devicePxRatio = ctx->devicePxRatio;
+	}
+
+	nvgRunJobs(ctx->jobs, nvg__tessellateDeferred, ctx, ctx->ndeferred);
+
+	for (i = 0; i < ctx->ndeferred; i++)
+		nvg__submitDeferred(ctx, &ctx->deferred[i]);
+
+	ctx->ndeferred = 0;
+	ctx->ndeferredCommands = 0;
+}
+
 void nvgFill(NVGcontext* ctx)
 {
 	NVGstate* state = nvg__getState(ctx);
 	const NVGpath* path;
 	NVGpaint fillPaint = state->fill;
+	float fringe = (ctx->params.edgeAntiAlias && state->shapeAntiAlias) ? ctx->fringeWidth : 0.0f;
 	int i;
 
-	nvg__flattenPaths(ctx);
-	if (ctx->params.edgeAntiAlias && state->shapeAntiAlias)
-		nvg__expandFill(ctx, ctx->fringeWidth, NVG_MITER, 2.4f);
-	else
-		nvg__expandFill(ctx, 0.0f, NVG_MITER, 2.4f);
+	NVG_TRACE(ctx, NVG_TRACE_FILL);
 
 	// Apply global alpha
 	fillPaint.innerColor.a *= state->alpha;
 	fillPaint.outerColor.a *= state->alpha;
 
+	if (nvg__deferPath(ctx, NVG_DEFERRED_FILL, &fillPaint, fringe, 0.0f))
+		return;
+	nvg__flushDeferred(ctx);
+
+	nvg__flattenPaths(ctx);
+	if (nvg__retainedFill(ctx, fringe) == 0 && nvg__expandFill(ctx, fringe, NVG_MITER, 2.4f))
+		nvg__retainFill(ctx, fringe);
+
 	ctx->params.renderFill(ctx->params.userPtr, &fillPaint, state->compositeOperation, &state->scissor, ctx->fringeWidth,
 						   ctx->cache->bounds, ctx->cache->paths, ctx->cache->npaths);
 
@@ -2272,6 +3806,343 @@ void nvgFill(NVGcontext* ctx)
 	}
 }
 
+// Appends an axis aligned rectangle and its fringe to a triangle strip, joined to the previous
+// rectangles by degenerate triangles. The corners go in the same order as in nvgRect(), so the
+// triangles face the same way as those of a convex fill. Writes at most 18 vertices.
+static NVGvertex* nvg__rectStrip(NVGvertex* dst, int first, float x0, float y0, float x1, float y1, float fringe)
+{
+	float w = fringe * 0.5f;
+	float ix0 = x0 + w, iy0 = y0 + w, ix1 = x1 - w, iy1 = y1 - w;
+	float ox0 = x0 - w, oy0 = y0 - w, ox1 = x1 + w, oy1 = y1 + w;
+
+	if (!first) {
+		*dst = dst[-1]; dst++;
+		nvg__vset(dst, ix0, iy0, 0.5f, 1); dst++;
+	}
+
+	if (fringe > 0.0f) {
+		// Fades from the inset corners to the outset ones, like the fringe of a convex fill.
+		nvg__vset(dst, ix0, iy0, 0.5f, 1); dst++;
+		nvg__vset(dst, ox0, oy0, 1, 1); dst++;
+		nvg__vset(dst, ix0, iy1, 0.5f, 1); dst++;
+		nvg__vset(dst, ox0, oy1, 1, 1); dst++;
+		nvg__vset(dst, ix1, iy1, 0.5f, 1); dst++;
+		nvg__vset(dst, ox1, oy1, 1, 1); dst++;
+		nvg__vset(dst, ix1, iy0, 0.5f, 1); dst++;
+		nvg__vset(dst, ox1, oy0, 1, 1); dst++;
+		nvg__vset(dst, ix0, iy0, 0.5f, 1); dst++;
+		nvg__vset(dst, ox0, oy0, 1, 1); dst++;
+		// Back to the inside, keeping an even vertex count so that the next triangles face the same way.
+		*dst = dst[-1]; dst++;
+		nvg__vset(dst, ix0, iy0, 0.5f, 1); dst++;
+	}
+
+	nvg__vset(dst, ix0, iy0, 0.5f, 1); dst++;
+	nvg__vset(dst, ix0, iy1, 0.5f, 1); dst++;
+	nvg__vset(dst, ix1, iy0, 0.5f, 1); dst++;
+	nvg__vset(dst, ix1, iy1, 0.5f, 1); dst++;
+
+	return dst;
+}
+
+void nvgFillRects(NVGcontext* ctx, const float* rects, int count)
+{
+	NVGstate* state = nvg__getState(ctx);
+	const float* t = state->xform;
+	NVGpaint fillPaint = state->fill;
+	float fringe = (ctx->params.edgeAntiAlias && state->shapeAntiAlias) ? ctx->fringeWidth : 0.0f;
+	float bounds[4] = { 1e6f, 1e6f, -1e6f, -1e6f };
+	NVGvertex* verts;
+	NVGvertex* dst;
+	NVGpath path;
+	int i;
+
+	NVG_TRACE(ctx, NVG_TRACE_FILL_RECTS, rects, count*4);
+
+	// The vertices are allocated where those of the current path are, so it is cleared as by nvgBeginPath().
+	ctx->ncommands = 0;
+	nvg__clearPathCache(ctx);
+	ctx->retained->current = NULL;
+	ctx->retained->pending = 0;
+
+	if (count <= 0) return;
+
+	if (!((t[1] == 0.0f && t[2] == 0.0f) || (t[0] == 0.0f && t[3] == 0.0f))) {
+		// Rotated or skewed rectangles are not axis aligned anymore.
+		for (i = 0; i < count; i++) {
+			const float* r = &rects[i*4];
+			NVG_TRACE_MUTED(ctx, { nvgBeginPath(ctx); nvgRect(ctx, r[0], r[1], r[2], r[3]); nvgFill(ctx); });
+		}
+		return;
+	}
+
+	nvg__flushDeferred(ctx);
+	verts = nvg__allocTempVerts(ctx, count * 18);
+	if (verts == NULL) return;
+
+	dst = verts;
+	for (i = 0; i < count; i++) {
+		const float* r = &rects[i*4];
+		float x0, y0, x1, y1, tmp;
+		nvgTransformPoint(&x0, &y0, t, r[0], r[1]);
+		nvgTransformPoint(&x1, &y1, t, r[0] + r[2], r[1] + r[3]);
+		if (x0 > x1) { tmp = x0; x0 = x1; x1 = tmp; }
+		if (y0 > y1) { tmp = y0; y0 = y1; y1 = tmp; }
+		if (x0 == x1 || y0 == y1) continue;
+		dst = nvg__rectStrip(dst, dst == verts, x0, y0, x1, y1, fringe);
+		bounds[0] = nvg__minf(bounds[0], x0 - fringe * 0.5f);
+		bounds[1] = nvg__minf(bounds[1], y0 - fringe * 0.5f);
+		bounds[2] = nvg__maxf(bounds[2], x1 + fringe * 0.5f);
+		bounds[3] = nvg__maxf(bounds[3], y1 + fringe * 0.5f);
+	}
+	if (dst == verts) return;
+
+	// A single convex path without a fan, its strip holds both the insides and the fringes.
+	memset(&path, 0, sizeof(path));
+	path.closed = 1;
+	path.stroke = verts;
+	path.nstroke = (int)(dst - verts);
+	path.winding = NVG_CCW;
+	path.convex = 1;
+
+	// Apply global alpha
+	fillPaint.innerColor.a *= state->alpha;
+	fillPaint.outerColor.a *= state->alpha;
+
+	ctx->params.renderFill(ctx->params.userPtr, &fillPaint, state->compositeOperation, &state->scissor, ctx->fringeWidth,
+						   bounds, &path, 1);
+
+	ctx->fillTriCount += path.nstroke-2;
+	ctx->drawCallCount++;
+}
+
+// Returns the bounds of the scissor, or 0 if there is none.
+static int nvg__scissorBounds(NVGstate* state, float* bounds)
+{
+	const float* t = state->scissor.xform;
+	float ex = state->scissor.extent[0], ey = state->scissor.extent[1];
+	float hw, hh;
+	if (ex < 0.0f || ey < 0.0f) return 0;
+	hw = ex*nvg__absf(t[0]) + ey*nvg__absf(t[2]);
+	hh = ex*nvg__absf(t[1]) + ey*nvg__absf(t[3]);
+	bounds[0] = t[4] - hw;
+	bounds[1] = t[5] - hh;
+	bounds[2] = t[4] + hw;
+	bounds[3] = t[5] + hh;
+	return 1;
+}
+
+// Sets the scissor to bounds, which are in the space of the vertices rather than of the current transform.
+static void nvg__setScissorBounds(NVGstate* state, const float* bounds)
+{
+	nvgTransformIdentity(state->scissor.xform);
+	state->scissor.xform[4] = (bounds[0] + bounds[2]) * 0.5f;
+	state->scissor.xform[5] = (bounds[1] + bounds[3]) * 0.5f;
+	state->scissor.extent[0] = nvg__maxf(0.0f, bounds[2] - bounds[0]) * 0.5f;
+	state->scissor.extent[1] = nvg__maxf(0.0f, bounds[3] - bounds[1]) * 0.5f;
+}
+
+// Narrows the scissor to bounds in the space of the vertices. The intersection is done in the space
+// of the scissor, so that unlike with nvgIntersectScissor() it never grows.
+static void nvg__intersectScissorBounds(NVGstate* state, const float* bounds)
+{
+	float inv[6], tr[6], x, y, b[4] = { 1e6f, 1e6f, -1e6f, -1e6f };
+	float ex = state->scissor.extent[0], ey = state->scissor.extent[1];
+	int i;
+
+	if (ex < 0.0f || ey < 0.0f) {
+		nvg__setScissorBounds(state, bounds);
+		return;
+	}
+	if (nvgTransformInverse(inv, state->scissor.xform) == 0) return;
+
+	for (i = 0; i < 4; i++) {
+		nvgTransformPoint(&x, &y, inv, bounds[(i & 1) ? 2 : 0], bounds[(i & 2) ? 3 : 1]);
+		b[0] = nvg__minf(b[0], x);
+		b[1] = nvg__minf(b[1], y);
+		b[2] = nvg__maxf(b[2], x);
+		b[3] = nvg__maxf(b[3], y);
+	}
+	b[0] = nvg__maxf(b[0], -ex);
+	b[1] = nvg__maxf(b[1], -ey);
+	b[2] = nvg__minf(b[2], ex);
+	b[3] = nvg__minf(b[3], ey);
+
+	nvgTransformTranslate(tr, (b[0] + b[2]) * 0.5f, (b[1] + b[3]) * 0.5f);
+	nvgTransformPremultiply(state->scissor.xform, tr);
+	state->scissor.extent[0] = nvg__maxf(0.0f, b[2] - b[0]) * 0.5f;
+	state->scissor.extent[1] = nvg__maxf(0.0f, b[3] - b[1]) * 0.5f;
+}
+
+// Returns 0 if the renderer could not add the clip.
+static int nvg__addClip(NVGcontext* ctx, int op, NVGpaint* paint, const float* bounds, const NVGpath* paths, int npaths)
+{
+	NVGstate* state = nvg__getState(ctx);
+	int clip;
+
+	if (ctx->params.renderClip == NULL) return 0;
+	nvg__flushDeferred(ctx);
+	clip = ctx->params.renderClip(ctx->params.userPtr, state->scissor.clip, op, paint, bounds, paths, npaths);
+	if (clip < 0) return 0;
+	state->scissor.clip = clip;
+	return 1;
+}
+
+// Sets the corners of a quad in the order of nvgRect(), transformed by t, and returns its bounds.
+static void nvg__clipQuad(NVGvertex* quad, NVGpath* path, float* bounds, const float* t, float x, float y, float w, float h)
+{
+	int i;
+	nvgTransformPoint(&quad[0].x, &quad[0].y, t, x, y);
+	nvgTransformPoint(&quad[1].x, &quad[1].y, t, x, y + h);
+	nvgTransformPoint(&quad[2].x, &quad[2].y, t, x + w, y + h);
+	nvgTransformPoint(&quad[3].x, &quad[3].y, t, x + w, y);
+
+	bounds[0] = bounds[1] = 1e6f;
+	bounds[2] = bounds[3] = -1e6f;
+	for (i = 0; i < 4; i++) {
+		quad[i].u = 0.5f;
+		quad[i].v = 1.0f;
+		bounds[0] = nvg__minf(bounds[0], quad[i].x);
+		bounds[1] = nvg__minf(bounds[1], quad[i].y);
+		bounds[2] = nvg__maxf(bounds[2], quad[i].x);
+		bounds[3] = nvg__maxf(bounds[3], quad[i].y);
+	}
+
+	memset(path, 0, sizeof(*path));
+	path->fill = quad;
+	path->nfill = 4;
+	path->closed = 1;
+	path->convex = 1;
+	path->winding = NVG_CCW;
+}
+
+static int nvg__isAxisAlignedQuad(const NVGvertex* v, int n)
+{
+	if (n != 4) return 0;
+	return (v[0].x == v[1].x && v[1].y == v[2].y && v[2].x == v[3].x && v[3].y == v[0].y) ||
+		   (v[0].y == v[1].y && v[1].x == v[2].x && v[2].y == v[3].y && v[3].x == v[0].x);
+}
+
+void nvgClipPath(NVGcontext* ctx)
+{
+	NVGpathCache* cache = ctx->cache;
+	float none[4] = { 0, 0, 0, 0 };
+
+	NVG_TRACE(ctx, NVG_TRACE_CLIP_PATH);
+
+	nvg__flattenPaths(ctx);
+	if (nvg__retainedFill(ctx, 0.0f) == 0 && nvg__expandFill(ctx, 0.0f, NVG_MITER, 2.4f) == 0)
+		return;
+
+	if (cache->npaths == 0) {
+		nvg__setScissorBounds(nvg__getState(ctx), none);
+		return;
+	}
+
+	nvg__intersectScissorBounds(nvg__getState(ctx), cache->bounds);
+
+	// Axis aligned rectangles need nothing but the scissor.
+	if (cache->npaths == 1 && nvg__isAxisAlignedQuad(cache->paths[0].fill, cache->paths[0].nfill))
+		return;
+
+	nvg__addClip(ctx, NVG_CLIP_INTERSECT, NULL, cache->bounds, cache->paths, cache->npaths);
+}
+
+int nvgExcludeClipRect(NVGcontext* ctx, float x, float y, float w, float h)
+{
+	NVGstate* state = nvg__getState(ctx);
+	const float* t = state->xform;
+	const float* st = state->scissor.xform;
+	NVGvertex quad[4];
+	NVGpath path;
+	float b[4], s[4];
+	int hasScissor;
+
+	NVG_TRACE(ctx, NVG_TRACE_EXCLUDE_CLIP_RECT, x, y, w, h);
+
+	if (w <= 0.0f || h <= 0.0f) return 1;
+
+	nvg__clipQuad(quad, &path, b, t, x, y, w, h);
+
+	hasScissor = nvg__scissorBounds(state, s);
+	if (hasScissor && (b[0] >= s[2] || b[2] <= s[0] || b[1] >= s[3] || b[3] <= s[1]))
+		return 1;
+
+	// When both are axis aligned and the rectangle covers one side of the scissor, the rest is a rectangle too.
+	if (hasScissor && t[1] == 0.0f && t[2] == 0.0f && st[1] == 0.0f && st[2] == 0.0f) {
+		int coversX = b[0] <= s[0] && b[2] >= s[2];
+		int coversY = b[1] <= s[1] && b[3] >= s[3];
+		int shrunk = 1;
+		if (coversY && b[0] <= s[0]) s[0] = b[2];
+		else if (coversY && b[2] >= s[2]) s[2] = b[0];
+		else if (coversX && b[1] <= s[1]) s[1] = b[3];
+		else if (coversX && b[3] >= s[3]) s[3] = b[1];
+		else shrunk = 0;
+		if (shrunk) {
+			nvg__setScissorBounds(state, s);
+			return 1;
+		}
+	}
+
+	return nvg__addClip(ctx, NVG_CLIP_EXCLUDE, NULL, b, &path, 1);
+}
+
+void nvgClipImageAlpha(NVGcontext* ctx, NVGpaint paint)
+{
+	NVGstate* state = nvg__getState(ctx);
+	NVGvertex quad[4];
+	NVGpath path;
+	float b[4];
+
+	NVG_TRACE(ctx, NVG_TRACE_CLIP_IMAGE_ALPHA, &paint);
+
+	nvgTransformMultiply(paint.xform, state->xform);
+	nvg__clipQuad(quad, &path, b, paint.xform, 0.0f, 0.0f, paint.extent[0], paint.extent[1]);
+
+	nvg__intersectScissorBounds(state, b);
+	nvg__addClip(ctx, NVG_CLIP_IMAGE, &paint, b, &path, 1);
+}
+
+int nvgBeginLayer(NVGcontext* ctx)
+{
+	NVGstate* state = nvg__getState(ctx);
+	float bounds[4] = { -1e6f, -1e6f, 1e6f, 1e6f };
+	int layer = -1;
+
+	NVG_TRACE(ctx, NVG_TRACE_BEGIN_LAYER);
+
+	nvg__scissorBounds(state, bounds);
+	nvg__flushDeferred(ctx);
+	if (ctx->params.renderBeginLayer != NULL && ctx->nlayers < NVG_MAX_LAYERS)
+		layer = ctx->params.renderBeginLayer(ctx->params.userPtr, bounds);
+
+	// Layers past the maximum are counted, so that their nvgEndLayer() still matches.
+	if (ctx->nlayers < NVG_MAX_LAYERS)
+		ctx->layers[ctx->nlayers] = layer;
+	ctx->nlayers++;
+
+	return layer >= 0;
+}
+
+void nvgEndLayer(NVGcontext* ctx, float alpha)
+{
+	NVGstate* state = nvg__getState(ctx);
+	NVGscissor scissor = state->scissor;
+	int layer;
+
+	NVG_TRACE(ctx, NVG_TRACE_END_LAYER, alpha);
+
+	if (ctx->nlayers == 0) return;
+	ctx->nlayers--;
+	layer = ctx->nlayers < NVG_MAX_LAYERS ? ctx->layers[ctx->nlayers] : -1;
+	if (layer < 0) return;
+
+	scissor.clip = -1;
+	nvg__flushDeferred(ctx);
+	ctx->params.renderEndLayer(ctx->params.userPtr, layer, alpha * state->alpha, state->compositeOperation, &scissor);
+	ctx->drawCallCount++;
+}
+
 void nvgStroke(NVGcontext* ctx)
 {
 	NVGstate* state = nvg__getState(ctx);
@@ -2279,8 +4150,10 @@ void nvgStroke(NVGcontext* ctx)
 	float strokeWidth = nvg__clampf(state->strokeWidth * scale, 0.0f, 200.0f);
 	NVGpaint strokePaint = state->stroke;
 	const NVGpath* path;
+	float fringe;
 	int i;
 
+	NVG_TRACE(ctx, NVG_TRACE_STROKE);
 
 	if (strokeWidth < ctx->fringeWidth) {
 		// If the stroke width is less than pixel size, use alpha to emulate coverage.
@@ -2295,12 +4168,15 @@ void nvgStroke(NVGcontext* ctx)
 	strokePaint.innerColor.a *= state->alpha;
 	strokePaint.outerColor.a *= state->alpha;
 
-	nvg__flattenPaths(ctx);
+	fringe = (ctx->params.edgeAntiAlias && state->shapeAntiAlias) ? ctx->fringeWidth : 0.0f;
+	if (nvg__deferPath(ctx, NVG_DEFERRED_STROKE, &strokePaint, fringe, strokeWidth))
+		return;
+	nvg__flushDeferred(ctx);
 
-	if (ctx->params.edgeAntiAlias && state->shapeAntiAlias)
-		nvg__expandStroke(ctx, strokeWidth*0.5f, ctx->fringeWidth, state->lineCap, state->lineJoin, state->miterLimit);
-	else
-		nvg__expandStroke(ctx, strokeWidth*0.5f, 0.0f, state->lineCap, state->lineJoin, state->miterLimit);
+	nvg__flattenPaths(ctx);
+	if (nvg__retainedStroke(ctx, strokeWidth*0.5f, fringe, state->lineCap, state->lineJoin, state->miterLimit) == 0 &&
+		nvg__expandStroke(ctx, strokeWidth*0.5f, fringe, state->lineCap, state->lineJoin, state->miterLimit))
+		nvg__retainStroke(ctx, strokeWidth*0.5f, fringe, state->lineCap, state->lineJoin, state->miterLimit);
 
 	ctx->params.renderStroke(ctx->params.userPtr, &strokePaint, state->compositeOperation, &state->scissor, ctx->fringeWidth,
 							 strokeWidth, ctx->cache->paths, ctx->cache->npaths);
@@ -2321,7 +4197,9 @@ int nvgCreateFont(NVGcontext* ctx, const char* name, const char* path)
 
 int nvgCreateFontFace(NVGcontext* ctx, const char* name, const char* path, int faceIdx)
 {
-	return fonsAddFont(ctx->fs, name, path, faceIdx);
+	int font = fonsAddFont(ctx->fs, name, path, faceIdx);
+	nvg__traceFont(ctx, font);
+	return font;
 }
 
 int nvgCreateFontMem(NVGcontext* ctx, const char* name, unsigned char* data, int ndata, int freeData)
@@ -2331,7 +4209,9 @@ int nvgCreateFontMem(NVGcontext* ctx, const char* name, unsigned char* data, int
 
 int nvgCreateFontFaceMem(NVGcontext* ctx, const char* name, unsigned char* data, int ndata, int faceIdx, int freeData)
 {
-	return fonsAddFontMem(ctx->fs, name, data, ndata, faceIdx, freeData);
+	int font = fonsAddFontMem(ctx->fs, name, data, ndata, faceIdx, freeData);
+	nvg__traceFont(ctx, font);
+	return font;
 }
 
 int nvgFindFont(NVGcontext* ctx, const char* name)
@@ -2344,6 +4224,9 @@ int nvgFindFont(NVGcontext* ctx, const char* name)
 int nvgAddFallbackFontId(NVGcontext* ctx, int baseFont, int fallbackFont)
 {
 	if(baseFont == -1 || fallbackFont == -1) return 0;
+	NVG_TRACE(ctx, NVG_TRACE_FALLBACK_FONT, baseFont, fallbackFont);
+	// Glyphs missing from the base font may now be found in the fallback.
+	nvgClearTextCache(ctx);
 	return fonsAddFallbackFont(ctx->fs, baseFont, fallbackFont);
 }
 
@@ -2356,42 +4239,49 @@ int nvgAddFallbackFont(NVGcontext* ctx, const char* baseFont, const char* fallba
 void nvgFontSize(NVGcontext* ctx, float size)
 {
 	NVGstate* state = nvg__getState(ctx);
+	NVG_TRACE(ctx, NVG_TRACE_FONT_SIZE, size);
 	state->fontSize = size;
 }
 
 void nvgFontBlur(NVGcontext* ctx, float blur)
 {
 	NVGstate* state = nvg__getState(ctx);
+	NVG_TRACE(ctx, NVG_TRACE_FONT_BLUR, blur);
 	state->fontBlur = blur;
 }
 
 void nvgTextLetterSpacing(NVGcontext* ctx, float spacing)
 {
 	NVGstate* state = nvg__getState(ctx);
+	NVG_TRACE(ctx, NVG_TRACE_LETTER_SPACING, spacing);
 	state->letterSpacing = spacing;
 }
 
 void nvgTextLineHeight(NVGcontext* ctx, float lineHeight)
 {
 	NVGstate* state = nvg__getState(ctx);
+	NVG_TRACE(ctx, NVG_TRACE_LINE_HEIGHT, lineHeight);
 	state->lineHeight = lineHeight;
 }
 
 void nvgTextAlign(NVGcontext* ctx, int align)
 {
 	NVGstate* state = nvg__getState(ctx);
+	NVG_TRACE(ctx, NVG_TRACE_TEXT_ALIGN, align);
 	state->textAlign = align;
 }
 
 void nvgFontFaceId(NVGcontext* ctx, int font)
 {
 	NVGstate* state = nvg__getState(ctx);
+	NVG_TRACE(ctx, NVG_TRACE_FONT_FACE_ID, font);
 	state->fontId = font;
 }
 
 void nvgFontFace(NVGcontext* ctx, const char* font)
 {
 	NVGstate* state = nvg__getState(ctx);
+	NVG_TRACE(ctx, NVG_TRACE_FONT_FACE, font, (const char*)NULL);
 	state->fontId = fonsGetFontByName(ctx->fs, font);
 }
 
@@ -2419,6 +4309,7 @@ static void nvg__flushTextTexture(NVGcontext* ctx)
 			int y = dirty[1];
 			int w = dirty[2] - dirty[0];
 			int h = dirty[3] - dirty[1];
+			nvg__flushDeferred(ctx);
 			ctx->params.renderUpdateTexture(ctx->params.userPtr, fontImage, x,y, w,h, data);
 		}
 	}
@@ -2445,6 +4336,8 @@ static int nvg__allocTextAtlas(NVGcontext* ctx)
 	}
 	++ctx->fontImageIdx;
 	fonsResetAtlas(ctx->fs, iw, ih);
+	// Cached quads refer to the previous atlas.
+	nvgClearTextCache(ctx);
 	return 1;
 }
 
@@ -2460,31 +4353,188 @@ static void nvg__renderText(NVGcontext* ctx, NVGvertex* verts, int nverts)
 	paint.innerColor.a *= state->alpha;
 	paint.outerColor.a *= state->alpha;
 
+	nvg__flushDeferred(ctx);
 	ctx->params.renderTriangles(ctx->params.userPtr, &paint, state->compositeOperation, &state->scissor, verts, nverts, ctx->fringeWidth);
 
 	ctx->drawCallCount++;
 	ctx->textTriCount += nverts/3;
 }
 
+// Transforms the corners of a glyph quad, and writes its two triangles.
+static int nvg__textQuad(NVGvertex* verts, NVGstate* state, const FONSquad* q, float invscale)
+{
+	float c[4*2];
+	nvgTransformPoint(&c[0],&c[1], state->xform, q->x0*invscale, q->y0*invscale);
+	nvgTransformPoint(&c[2],&c[3], state->xform, q->x1*invscale, q->y0*invscale);
+	nvgTransformPoint(&c[4],&c[5], state->xform, q->x1*invscale, q->y1*invscale);
+	nvgTransformPoint(&c[6],&c[7], state->xform, q->x0*invscale, q->y1*invscale);
+	nvg__vset(&verts[0], c[0], c[1], q->s0, q->t0);
+	nvg__vset(&verts[1], c[4], c[5], q->s1, q->t1);
+	nvg__vset(&verts[2], c[2], c[3], q->s1, q->t0);
+	nvg__vset(&verts[3], c[0], c[1], q->s0, q->t0);
+	nvg__vset(&verts[4], c[6], c[7], q->s0, q->t1);
+	nvg__vset(&verts[5], c[4], c[5], q->s1, q->t1);
+	return 6;
+}
+
+static unsigned int nvg__textRunBucket(unsigned long long hash)
+{
+	return (unsigned int)(hash ^ (hash >> 32)) & (NVG_TEXT_CACHE_BUCKETS-1);
+}
+
+static void nvg__unlinkTextRun(NVGtextCache* tc, NVGtextRun* run)
+{
+	if (run->lruPrev != NULL) run->lruPrev->lruNext = run->lruNext;
+	else if (tc->lruHead == run) tc->lruHead = run->lruNext;
+	if (run->lruNext != NULL) run->lruNext->lruPrev = run->lruPrev;
+	else if (tc->lruTail == run) tc->lruTail = run->lruPrev;
+	run->lruPrev = run->lruNext = NULL;
+}
+
+static void nvg__touchTextRun(NVGtextCache* tc, NVGtextRun* run)
+{
+	nvg__unlinkTextRun(tc, run);
+	run->lruNext = tc->lruHead;
+	if (tc->lruHead != NULL) tc->lruHead->lruPrev = run;
+	tc->lruHead = run;
+	if (tc->lruTail == NULL) tc->lruTail = run;
+}
+
+static void nvg__deleteTextRun(NVGtextCache* tc, NVGtextRun* run)
+{
+	NVGtextRun** link = &tc->buckets[nvg__textRunBucket(run->hash)];
+	while (*link != NULL && *link != run)
+		link = &(*link)->next;
+	if (*link == run)
+		*link = run->next;
+	nvg__unlinkTextRun(tc, run);
+	tc->bytes -= run->bytes;
+	free(run);
+}
+
+static unsigned long long nvg__textRunHash(const NVGtextKey* key, const char* string)
+{
+	unsigned long long hash = 14695981039346656037ULL;
+	const unsigned char* bytes = (const unsigned char*)key;
+	int i;
+	for (i = 0; i < (int)sizeof(NVGtextKey); i++)
+		hash = (hash ^ bytes[i]) * 1099511628211ULL;
+	bytes = (const unsigned char*)string;
+	for (i = 0; i < key->length; i++)
+		hash = (hash ^ bytes[i]) * 1099511628211ULL;
+	return hash;
+}
+
+static NVGtextRun* nvg__findTextRun(NVGtextCache* tc, unsigned long long hash, const NVGtextKey* key, const char* string)
+{
+	NVGtextRun* run = tc->buckets[nvg__textRunBucket(hash)];
+	for (; run != NULL; run = run->next) {
+		if (run->hash == hash && memcmp(&run->key, key, sizeof(NVGtextKey)) == 0 &&
+			memcmp(run->string, string, (size_t)key->length) == 0) {
+			nvg__touchTextRun(tc, run);
+			return run;
+		}
+	}
+	return NULL;
+}
+
+// Allocates a run with room for the string and maxquads quads, in one block.
+static NVGtextRun* nvg__allocTextRun(unsigned long long hash, const NVGtextKey* key, const char* string, int maxquads)
+{
+	int bytes = (int)sizeof(NVGtextRun) + maxquads * (int)sizeof(FONSquad) + key->length;
+	NVGtextRun* run = (NVGtextRun*)malloc((size_t)bytes);
+	if (run == NULL) return NULL;
+	memset(run, 0, sizeof(NVGtextRun));
+	run->hash = hash;
+	run->key = *key;
+	run->quads = (FONSquad*)(run + 1);
+	run->string = (char*)(run->quads + maxquads);
+	memcpy(run->string, string, (size_t)key->length);
+	run->bytes = bytes;
+	return run;
+}
+
+static void nvg__addTextRun(NVGtextCache* tc, NVGtextRun* run)
+{
+	NVGtextRun** bucket = &tc->buckets[nvg__textRunBucket(run->hash)];
+	run->next = *bucket;
+	*bucket = run;
+	nvg__touchTextRun(tc, run);
+	tc->bytes += run->bytes;
+	while (tc->bytes > tc->budget && tc->lruTail != NULL)
+		nvg__deleteTextRun(tc, tc->lruTail);
+}
+
+void nvgTextCacheBudget(NVGcontext* ctx, int bytes)
+{
+	NVGtextCache* tc = ctx->textCache;
+	tc->budget = nvg__maxi(bytes, 0);
+	while (tc->bytes > tc->budget && tc->lruTail != NULL)
+		nvg__deleteTextRun(tc, tc->lruTail);
+}
+
+void nvgClearTextCache(NVGcontext* ctx)
+{
+	NVGtextCache* tc = ctx->textCache;
+	while (tc->lruTail != NULL)
+		nvg__deleteTextRun(tc, tc->lruTail);
+}
+
 float nvgText(NVGcontext* ctx, float x, float y, const char* string, const char* end)
 {
 	NVGstate* state = nvg__getState(ctx);
 	FONStextIter iter, prevIter;
 	FONSquad q;
 	NVGvertex* verts;
+	NVGtextKey key;
+	NVGtextRun* run;
+	unsigned long long hash;
 	float scale = nvg__getFontScale(state) * ctx->devicePxRatio;
 	float invscale = 1.0f / scale;
+	float ox, oy;
 	int cverts = 0;
 	int nverts = 0;
+	int i;
 
 	if (end == NULL)
 		end = string + strlen(string);
 
+	NVG_TRACE(ctx, NVG_TRACE_TEXT, x, y, string, end);
+
 	if (state->fontId == FONS_INVALID) return x;
 
-	fonsSetSize(ctx->fs, state->fontSize*scale);
-	fonsSetSpacing(ctx->fs, state->letterSpacing*scale);
-	fonsSetBlur(ctx->fs, state->fontBlur*scale);
+	// Quads are kept relative to the pixel of the origin, the pixel snapping only depends on the fraction.
+	ox = floorf(x*scale);
+	oy = floorf(y*scale);
+	memset(&key, 0, sizeof(key));
+	key.fontId = state->fontId;
+	key.align = state->textAlign;
+	key.size = state->fontSize*scale;
+	key.spacing = state->letterSpacing*scale;
+	key.blur = state->fontBlur*scale;
+	key.fracx = x*scale - ox;
+	key.fracy = y*scale - oy;
+	key.length = (int)(end - string);
+	hash = nvg__textRunHash(&key, string);
+
+	run = nvg__findTextRun(ctx->textCache, hash, &key, string);
+	if (run != NULL) {
+		verts = nvg__allocTempVerts(ctx, nvg__maxi(1, run->nquads) * 6);
+		if (verts == NULL) return x;
+		for (i = 0; i < run->nquads; i++) {
+			q = run->quads[i];
+			q.x0 += ox; q.x1 += ox;
+			q.y0 += oy; q.y1 += oy;
+			nverts += nvg__textQuad(&verts[nverts], state, &q, invscale);
+		}
+		nvg__renderText(ctx, verts, nverts);
+		ctx->textCachedCount++;
+		return (ox + run->advance) / scale;
+	}
+
+	fonsSetSize(ctx->fs, key.size);
+	fonsSetSpacing(ctx->fs, key.spacing);
+	fonsSetBlur(ctx->fs, key.blur);
 	fonsSetAlign(ctx->fs, state->textAlign);
 	fonsSetFont(ctx->fs, state->fontId);
 
@@ -2492,15 +4542,19 @@ float nvgText(NVGcontext* ctx, float x, float y, const char* string, const char*
 	verts = nvg__allocTempVerts(ctx, cverts);
 	if (verts == NULL) return x;
 
+	run = nvg__allocTextRun(hash, &key, string, cverts / 6);
+
 	fonsTextIterInit(ctx->fs, &iter, x*scale, y*scale, string, end, FONS_GLYPH_BITMAP_REQUIRED);
 	prevIter = iter;
 	while (fonsTextIterNext(ctx->fs, &iter, &q)) {
-		float c[4*2];
 		if (iter.prevGlyphIndex == -1) { // can not retrieve glyph?
 			if (nverts != 0) {
 				nvg__renderText(ctx, verts, nverts);
 				nverts = 0;
 			}
+			// The quads drawn so far were in the previous atlas, the run is not cached.
+			free(run);
+			run = NULL;
 			if (!nvg__allocTextAtlas(ctx))
 				break; // no memory :(
 			iter = prevIter;
@@ -2509,19 +4563,13 @@ float nvgText(NVGcontext* ctx, float x, float y, const char* string, const char*
 				break;
 		}
 		prevIter = iter;
-		// Transform corners.
-		nvgTransformPoint(&c[0],&c[1], state->xform, q.x0*invscale, q.y0*invscale);
-		nvgTransformPoint(&c[2],&c[3], state->xform, q.x1*invscale, q.y0*invscale);
-		nvgTransformPoint(&c[4],&c[5], state->xform, q.x1*invscale, q.y1*invscale);
-		nvgTransformPoint(&c[6],&c[7], state->xform, q.x0*invscale, q.y1*invscale);
-		// Create triangles
 		if (nverts+6 <= cverts) {
-			nvg__vset(&verts[nverts], c[0], c[1], q.s0, q.t0); nverts++;
-			nvg__vset(&verts[nverts], c[4], c[5], q.s1, q.t1); nverts++;
-			nvg__vset(&verts[nverts], c[2], c[3], q.s1, q.t0); nverts++;
-			nvg__vset(&verts[nverts], c[0], c[1], q.s0, q.t0); nverts++;
-			nvg__vset(&verts[nverts], c[6], c[7], q.s0, q.t1); nverts++;
-			nvg__vset(&verts[nverts], c[4], c[5], q.s1, q.t1); nverts++;
+			nverts += nvg__textQuad(&verts[nverts], state, &q, invscale);
+			if (run != NULL) {
+				q.x0 -= ox; q.x1 -= ox;
+				q.y0 -= oy; q.y1 -= oy;
+				run->quads[run->nquads++] = q;
+			}
 		}
 	}
 
@@ -2530,9 +4578,82 @@ float nvgText(NVGcontext* ctx, float x, float y, const char* string, const char*
 
 	nvg__renderText(ctx, verts, nverts);
 
+	if (run != NULL) {
+		run->advance = iter.nextx - ox;
+		nvg__addTextRun(ctx->textCache, run);
+	}
+	ctx->textShapedCount++;
+
 	return iter.nextx / scale;
 }
 
+// Draws codepoints, or glyph indices of the current font, at the given positions.
+static void nvg__drawGlyphRun(NVGcontext* ctx, const unsigned int* ids, int glyphIndices, const float* positions, int count)
+{
+	NVGstate* state = nvg__getState(ctx);
+	FONSquad q;
+	NVGvertex* verts;
+	float scale = nvg__getFontScale(state) * ctx->devicePxRatio;
+	float invscale = 1.0f / scale;
+	int nverts = 0;
+	int i, found;
+
+	if (state->fontId == FONS_INVALID || count <= 0) return;
+
+	fonsSetSize(ctx->fs, state->fontSize*scale);
+	fonsSetSpacing(ctx->fs, state->letterSpacing*scale);
+	fonsSetBlur(ctx->fs, state->fontBlur*scale);
+	fonsSetAlign(ctx->fs, state->textAlign);
+	fonsSetFont(ctx->fs, state->fontId);
+
+	verts = nvg__allocTempVerts(ctx, count*6);
+	if (verts == NULL) return;
+
+	for (i = 0; i < count; i++) {
+		float x = positions[i*2+0]*scale, y = positions[i*2+1]*scale;
+		found = glyphIndices ? fonsGlyphQuad(ctx->fs, (int)ids[i], x, y, FONS_GLYPH_BITMAP_REQUIRED, &q)
+							 : fonsCodepointQuad(ctx->fs, ids[i], x, y, FONS_GLYPH_BITMAP_REQUIRED, &q);
+		if (!found) {
+			// The atlas is full, draw what uses it so far and continue on a new one.
+			if (nverts != 0) {
+				nvg__renderText(ctx, verts, nverts);
+				nverts = 0;
+			}
+			if (!nvg__allocTextAtlas(ctx))
+				break;
+			found = glyphIndices ? fonsGlyphQuad(ctx->fs, (int)ids[i], x, y, FONS_GLYPH_BITMAP_REQUIRED, &q)
+								 : fonsCodepointQuad(ctx->fs, ids[i], x, y, FONS_GLYPH_BITMAP_REQUIRED, &q);
+			if (!found)
+				continue;
+		}
+		nverts += nvg__textQuad(&verts[nverts], state, &q, invscale);
+	}
+
+	nvg__flushTextTexture(ctx);
+
+	nvg__renderText(ctx, verts, nverts);
+}
+
+void nvgTextRun(NVGcontext* ctx, const unsigned int* codepoints, const float* positions, int count)
+{
+	NVG_TRACE(ctx, NVG_TRACE_TEXT_RUN, (const void*)codepoints, count * (int)sizeof(unsigned int), positions, count*2);
+	nvg__drawGlyphRun(ctx, codepoints, 0, positions, count);
+}
+
+void nvgGlyphs(NVGcontext* ctx, const int* glyphs, const float* positions, int count)
+{
+	NVG_TRACE(ctx, NVG_TRACE_GLYPHS, (const void*)glyphs, count * (int)sizeof(int), positions, count*2);
+	nvg__drawGlyphRun(ctx, (const unsigned int*)glyphs, 1, positions, count);
+}
+
+int nvgGlyphIndex(NVGcontext* ctx, unsigned int codepoint)
+{
+	NVGstate* state = nvg__getState(ctx);
+	if (state->fontId == FONS_INVALID) return -1;
+	fonsSetFont(ctx->fs, state->fontId);
+	return fonsGlyphIndex(ctx->fs, codepoint);
+}
+
 void nvgTextBox(NVGcontext* ctx, float x, float y, float breakRowWidth, const char* string, const char* end)
 {
 	NVGstate* state = nvg__getState(ctx);
@@ -2543,6 +4664,8 @@ void nvgTextBox(NVGcontext* ctx, float x, float y, float breakRowWidth, const ch
 	int valign = state->textAlign & (NVG_ALIGN_TOP | NVG_ALIGN_MIDDLE | NVG_ALIGN_BOTTOM | NVG_ALIGN_BASELINE);
 	float lineh = 0;
 
+	NVG_TRACE(ctx, NVG_TRACE_TEXT_BOX, x, y, breakRowWidth, string, end);
+
 	if (state->fontId == FONS_INVALID) return;
 
 	nvgTextMetrics(ctx, NULL, NULL, &lineh);
@@ -2553,11 +4676,11 @@ void nvgTextBox(NVGcontext* ctx, float x, float y, float breakRowWidth, const ch
 		for (i = 0; i < nrows; i++) {
 			NVGtextRow* row = &rows[i];
 			if (haling & NVG_ALIGN_LEFT)
-				nvgText(ctx, x, y, row->start, row->end);
+				NVG_TRACE_MUTED(ctx, nvgText(ctx, x, y, row->start, row->end));
 			else if (haling & NVG_ALIGN_CENTER)
-				nvgText(ctx, x + breakRowWidth*0.5f - row->width*0.5f, y, row->start, row->end);
+				NVG_TRACE_MUTED(ctx, nvgText(ctx, x + breakRowWidth*0.5f - row->width*0.5f, y, row->start, row->end));
 			else if (haling & NVG_ALIGN_RIGHT)
-				nvgText(ctx, x + breakRowWidth - row->width, y, row->start, row->end);
+				NVG_TRACE_MUTED(ctx, nvgText(ctx, x + breakRowWidth - row->width, y, row->start, row->end));
 			y += lineh * state->lineHeight;
 		}
 		string = rows[nrows-1].next;
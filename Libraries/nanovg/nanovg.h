@@ -50,6 +50,7 @@ struct NVGpaint {
 	NVGcolor innerColor;
 	NVGcolor outerColor;
 	int image;
+	float ramp;		// Texture coordinate of the row of a gradient's colour ramp in image, or 0.
 };
 typedef struct NVGpaint NVGpaint;
 
@@ -63,6 +64,16 @@ enum NVGsolidity {
 	NVG_HOLE = 2,			// CW
 };
 
+// Command markers used by nvgAppendPathCommands().
+enum NVGcommands {
+	NVG_MOVETO = 0,			// x,y
+	NVG_LINETO = 1,			// x,y
+	NVG_BEZIERTO = 2,		// c1x,c1y, c2x,c2y, x,y
+	NVG_CLOSE = 3,
+	NVG_WINDING = 4,		// dir
+	NVG_QUADTO = 5,			// cx,cy, x,y (converted to NVG_BEZIERTO)
+};
+
 enum NVGlineCap {
 	NVG_BUTT,
 	NVG_ROUND,
@@ -160,6 +171,28 @@ void nvgCancelFrame(NVGcontext* ctx);
 // Ends drawing flushing remaining render state.
 void nvgEndFrame(NVGcontext* ctx);
 
+struct NVGframeStats {
+	int allocations;		// Heap allocations made for per-frame buffers, zero once the arena has settled.
+	int bytes;				// Bytes of those allocations.
+	int arenaSize;			// Size of the arena in bytes.
+	int arenaPeak;			// Bytes of per-frame memory the frame used.
+	int drawCalls;			// Draw calls issued to the back-end, as estimated by the front-end.
+	int fillTriangles;
+	int strokeTriangles;
+	int textTriangles;
+	int textRunsCached;		// nvgText() calls drawn from cached glyph quads.
+	int textRunsShaped;		// nvgText() calls that had to look up and kern their glyphs.
+};
+typedef struct NVGframeStats NVGframeStats;
+
+// Returns per-frame memory and draw statistics of the last completed frame, i.e. the frame which
+// ended before the most recent nvgBeginFrame().
+void nvgFrameStats(NVGcontext* ctx, NVGframeStats* stats);
+
+// Returns the number of frames begun with nvgBeginFrame(). Images drawn in the current frame are
+// only read at nvgEndFrame(), so caches of images use this to avoid deleting them before that.
+unsigned int nvgFrameIndex(NVGcontext* ctx);
+
 //
 // Composite operation
 //
@@ -379,9 +412,18 @@ int nvgCreateImageMem(NVGcontext* ctx, int imageFlags, unsigned char* data, int
 // Returns handle to the image.
 int nvgCreateImageRGBA(NVGcontext* ctx, int w, int h, int imageFlags, const unsigned char* data);
 
-// Updates image data specified by image handle.
+// Creates image from specified image data in BGRA byte order, i.e. 32-bit ARGB pixels on little
+// endian CPUs. Back-ends which can sample such textures upload the data as it is, others convert it.
+// Returns handle to the image.
+int nvgCreateImageBGRA(NVGcontext* ctx, int w, int h, int imageFlags, const unsigned char* data);
+
+// Updates image data specified by image handle. The data is in the byte order the image was created with.
 void nvgUpdateImage(NVGcontext* ctx, int image, const unsigned char* data);
 
+// Updates the pixels of the image within the rectangle (x,y,w,h) only. Data points at the whole image,
+// as for nvgUpdateImage(), and only the pixels within the rectangle are read.
+void nvgUpdateImageRegion(NVGcontext* ctx, int image, int x, int y, int w, int h, const unsigned char* data);
+
 // Returns the dimensions of a created image.
 void nvgImageSize(NVGcontext* ctx, int image, int* w, int* h);
 
@@ -414,6 +456,18 @@ NVGpaint nvgBoxGradient(NVGcontext* ctx, float x, float y, float w, float h,
 NVGpaint nvgRadialGradient(NVGcontext* ctx, float cx, float cy, float inr, float outr,
 						   NVGcolor icol, NVGcolor ocol);
 
+// Creates and returns a linear gradient with any number of colour stops, see nvgLinearGradient().
+// The offsets of the stops increase from 0 at (sx,sy) to 1 at (ex,ey). The colours are sampled from
+// a ramp in an atlas shared by all gradients, where it is kept for as long as the gradient is drawn.
+// If the renderer has no ramps or the atlas is full, the gradient goes from the first to the last colour.
+NVGpaint nvgLinearGradientStops(NVGcontext* ctx, float sx, float sy, float ex, float ey,
+								const float* offsets, const NVGcolor* colors, int nstops);
+
+// Creates and returns a radial gradient with any number of colour stops, from 0 at the inner radius
+// to 1 at the outer one. See nvgRadialGradient() and nvgLinearGradientStops().
+NVGpaint nvgRadialGradientStops(NVGcontext* ctx, float cx, float cy, float inr, float outr,
+								const float* offsets, const NVGcolor* colors, int nstops);
+
 // Creates and returns an image patter. Parameters (ox,oy) specify the left-top location of the image pattern,
 // (ex,ey) the size of one image, angle rotation around the top-left corner, image is handle to the image to render.
 // The gradient is transformed by the current transform when it is passed to nvgFillPaint() or nvgStrokePaint().
@@ -441,6 +495,42 @@ void nvgIntersectScissor(NVGcontext* ctx, float x, float y, float w, float h);
 // Reset and disables scissoring.
 void nvgResetScissor(NVGcontext* ctx);
 
+//
+// Clipping
+//
+// Clips of any shape, applied on top of the scissor. Like the scissor they are part of the state,
+// so nvgRestore() removes the clips added since the matching nvgSave(). The scissor is narrowed to
+// the bounds of each clip, which is all that back-ends without support for clips do. The software
+// and Metal back-ends have none yet.
+
+// Intersects the clip with the current path, filled with the non-zero rule like nvgFill() does.
+// Rectangles only narrow the scissor.
+void nvgClipPath(NVGcontext* ctx);
+
+// Removes a rectangle from the clip. The rectangle is transformed by the current transform.
+// Exclusions that narrow the scissor, or miss it, work everywhere. Others need a back-end with clips;
+// without one the clip is left as it was and 0 is returned.
+int nvgExcludeClipRect(NVGcontext* ctx, float x, float y, float w, float h);
+
+// Multiplies the clip with the alpha of an image pattern, see nvgImagePattern(). The clip is empty
+// outside the image. The pattern is transformed by the current transform.
+void nvgClipImageAlpha(NVGcontext* ctx, NVGpaint paint);
+
+//
+// Layers
+//
+// Drawing between nvgBeginLayer() and nvgEndLayer() goes into an offscreen layer, which is then
+// drawn with one alpha. Overlapping shapes in a layer cover each other before they are blended with
+// what is below, which is what fading a group of shapes needs. Layers can be nested.
+
+// Starts a layer covering the scissor. Returns 0 if the renderer has no layers, in which case the
+// drawing is not redirected and the matching nvgEndLayer() does nothing.
+int nvgBeginLayer(NVGcontext* ctx);
+
+// Ends the innermost layer and draws it with the given alpha, using the current composite operation
+// and scissor. Clips were applied to the content of the layer already.
+void nvgEndLayer(NVGcontext* ctx, float alpha);
+
 //
 // Paths
 //
@@ -482,6 +572,12 @@ void nvgClosePath(NVGcontext* ctx);
 // Sets the current sub-path winding, see NVGwinding and NVGsolidity.
 void nvgPathWinding(NVGcontext* ctx, int dir);
 
+// Appends a buffer of path commands to the current path, see NVGcommands for the layout.
+// Each command marker is followed by its coordinates, e.g. { NVG_MOVETO, x,y, NVG_LINETO, x,y, NVG_CLOSE }.
+// The points are transformed by xform (if not NULL) followed by the current transform in a single pass,
+// which is considerably cheaper than issuing nvgMoveTo()/nvgLineTo() calls for long paths.
+void nvgAppendPathCommands(NVGcontext* ctx, const float* cmds, int ncmds, const float* xform);
+
 // Creates new circle arc shaped sub-path. The arc center is at cx,cy, the arc radius is r,
 // and the arc is drawn from angle a0 to a1, and swept in direction dir (NVG_CCW, or NVG_CW).
 // Angles are specified in radians.
@@ -508,6 +604,68 @@ void nvgFill(NVGcontext* ctx);
 // Fills the current path with current stroke style.
 void nvgStroke(NVGcontext* ctx);
 
+// Fills count rectangles, given as x,y,w,h quadruples, with the current fill style. The result is the same
+// as filling each one with nvgBeginPath(), nvgRect() and nvgFill(), and the current path is cleared as well.
+// Unless the transform rotates or skews them, the rectangles are drawn with a single draw call.
+void nvgFillRects(NVGcontext* ctx, const float* rects, int count);
+
+//
+// Retained paths
+//
+// Shapes that are drawn every frame (widget outlines, icons) can skip flattening and
+// expansion by tagging the path with a key computed by the caller from the path content.
+// The flattened points and the expanded fill and stroke vertices are retained per key and
+// per transform class: the linear part of the current transform and the device pixel ratio
+// must match, while a different translation is applied as an offset to the retained geometry.
+// Retained geometry is evicted least recently used first when the byte budget is exceeded.
+
+struct NVGretainedStats {
+	int hits;		// Number of nvgBeginRetainedPath() calls that found retained geometry.
+	int misses;		// Number of nvgBeginRetainedPath() calls that had to build the path.
+	int entries;	// Number of retained paths.
+	int bytes;		// Memory used by the retained paths.
+	int budget;		// Maximum memory used by the retained paths.
+};
+typedef struct NVGretainedStats NVGretainedStats;
+
+// Clears the current path like nvgBeginPath(), and tags it with the specified key.
+// Returns 1 if geometry is retained for the key, in which case the path is already defined and
+// no path commands should be added. Returns 0 otherwise, in which case the path should be built
+// as usual, and the next nvgFill() or nvgStroke() retains the result under the key.
+int nvgBeginRetainedPath(NVGcontext* ctx, unsigned long long key);
+
+// Like nvgBeginRetainedPath(), for a path added with nvgAppendPathCommands(). The commands are retained
+// with the geometry and compared on reuse, so that a path whose key collides with another one is built
+// again instead of drawing the other one. tx,ty is the translation the commands are appended with, which
+// is applied as an offset like the translation of the current transform: it is left out of the key.
+int nvgBeginRetainedPathCommands(NVGcontext* ctx, unsigned long long key, const float* commands, int ncommands, float tx, float ty);
+
+// Sets the maximum memory in bytes used by retained paths.
+void nvgRetainedPathBudget(NVGcontext* ctx, int bytes);
+
+// Returns retained path counters, see NVGretainedStats.
+void nvgRetainedPathStats(NVGcontext* ctx, NVGretainedStats* stats);
+
+// Deletes all retained paths. Does not reset the hit and miss counters.
+void nvgClearRetainedPaths(NVGcontext* ctx);
+
+//
+// Parallel tessellation
+//
+// With tessellation threads, nvgFill() and nvgStroke() record the path with the state they need
+// instead of flattening and expanding it. Consecutive fills and strokes are then tessellated in
+// parallel, and handed to the back-end in the order they were drawn, before anything else is drawn
+// and at the latest by nvgEndFrame(). Text, images updates, clips and layers end such a run of paths,
+// so scenes drawing many independent paths in a row, such as node graphs and dense plots, gain most.
+// Retained paths, and paths that were already flattened, are still tessellated when drawn.
+
+// Sets the number of threads tessellating fills and strokes, including the one drawing.
+// Values below 2 tessellate every path when it is drawn, which is the default.
+void nvgTessellationThreads(NVGcontext* ctx, int threads);
+
+// Returns the number of threads tessellating fills and strokes, 1 without tessellation threads.
+int nvgGetTessellationThreads(NVGcontext* ctx);
+
 
 //
 // Text
@@ -589,8 +747,21 @@ void nvgFontFaceId(NVGcontext* ctx, int font);
 void nvgFontFace(NVGcontext* ctx, const char* font);
 
 // Draws text string at specified location. If end is specified only the sub-string up to the end is drawn.
+// The glyph quads of the string are cached, see nvgTextCacheBudget().
 float nvgText(NVGcontext* ctx, float x, float y, const char* string, const char* end);
 
+// Draws count codepoints, each with its origin at the next x,y pair of positions, with a single draw call.
+// Meant for text laid out elsewhere: kerning and horizontal alignment are not applied, vertical alignment is.
+void nvgTextRun(NVGcontext* ctx, const unsigned int* codepoints, const float* positions, int count);
+
+// Same as nvgTextRun(), but draws glyph indices of the current font, e.g. as produced by a text shaper.
+// Fallback fonts are not used, the indices must belong to the current font.
+void nvgGlyphs(NVGcontext* ctx, const int* glyphs, const float* positions, int count);
+
+// Returns the glyph index of a codepoint in the current font, for checking that glyph indices from elsewhere
+// belong to it. Fallback fonts are not searched. Returns 0 if the font has no such glyph, -1 if no font is set.
+int nvgGlyphIndex(NVGcontext* ctx, unsigned int codepoint);
+
 // Draws multi-line text string at specified location wrapped at the specified width. If end is specified only the sub-string up to the end is drawn.
 // White space is stripped at the beginning of the rows, the text is split at word boundaries or when new-line characters are encountered.
 // Words longer than the max width are slit at nearest character (i.e. no hyphenation).
@@ -620,20 +791,83 @@ void nvgTextMetrics(NVGcontext* ctx, float* ascender, float* descender, float* l
 // Words longer than the max width are slit at nearest character (i.e. no hyphenation).
 int nvgTextBreakLines(NVGcontext* ctx, const char* string, const char* end, float breakRowWidth, NVGtextRow* rows, int maxRows);
 
+// Text drawn with nvgText() is shaped once and cached. The glyph quads and the advance of a string are
+// kept per font, size in device pixels, letter spacing, blur, align and sub-pixel position of the origin,
+// so that drawing the string again only transforms its quads. Cached runs are evicted least recently
+// used first when the byte budget is exceeded, and all of them when the font atlas is reset.
+
+// Sets the maximum memory in bytes used by cached text runs.
+void nvgTextCacheBudget(NVGcontext* ctx, int bytes);
+
+// Deletes all cached text runs.
+void nvgClearTextCache(NVGcontext* ctx);
+
+//
+// Frame traces
+//
+// A trace records the calls made to the API over a number of frames into a compact binary
+// .nvgtrace file, together with the image and font data they use. Replaying a trace makes the same
+// calls on another context, so a frame captured in an application can be drawn again on any
+// back-end, e.g. to reproduce a rendering bug or to benchmark it.
+//
+// Calls which only measure (text bounds, metrics, etc.) are not recorded. Retained paths are not
+// looked up while recording, so that the trace holds the commands of every path.
+
+// Starts recording calls into the specified file. Frames are recorded from the next nvgBeginFrame(),
+// up to the specified number of frames, or until nvgTraceEnd() if frames is 0. Images and fonts are
+// recorded as they are created; existing fonts are written at once, and existing images are replaced
+// with blank images of the same size on replay.
+// Returns 1 on success, 0 if the file could not be created.
+int nvgTraceBegin(NVGcontext* ctx, const char* filename, int frames);
+
+// Stops recording and closes the trace file.
+void nvgTraceEnd(NVGcontext* ctx);
+
+// Returns 1 while a trace is being recorded, 0 once it is complete.
+int nvgTraceActive(NVGcontext* ctx);
+
+typedef struct NVGreplay NVGreplay;
+
+// Loads a trace for replay on the specified context, creating the fonts and images recorded before
+// its first frame. Returns NULL if the file could not be read or is not a valid trace.
+NVGreplay* nvgReplayLoad(NVGcontext* ctx, const char* filename);
+
+// Deletes the replay and the images it created. Fonts stay in the context.
+void nvgReplayDelete(NVGreplay* replay);
+
+// Returns the number of complete frames in the trace.
+int nvgReplayFrameCount(NVGreplay* replay);
+
+// Returns the size the frame was drawn at, as passed to nvgBeginFrame().
+void nvgReplayFrameSize(NVGreplay* replay, int frame, float* width, float* height, float* devicePixelRatio);
+
+// Draws the frame, from its nvgBeginFrame() to its nvgEndFrame().
+// Frames should be replayed in order, but may be repeated; images recreated by a repeated frame
+// are updated in place. Returns 0 if the frame does not exist.
+int nvgReplayFrame(NVGreplay* replay, int frame);
+
 //
 // Internal Render API
 //
 enum NVGtexture {
 	NVG_TEXTURE_ALPHA = 0x01,
 	NVG_TEXTURE_RGBA = 0x02,
+	NVG_TEXTURE_BGRA = 0x03,
 };
 
 struct NVGscissor {
 	float xform[6];
 	float extent[2];
+	int clip;		// Clip returned by renderClip(), or -1.
 };
 typedef struct NVGscissor NVGscissor;
 
+enum NVGclipOp {
+	NVG_CLIP_INTERSECT,		// Intersects the parent clip with the fill of the paths.
+	NVG_CLIP_EXCLUDE,		// Removes the fill of the paths from the parent clip.
+	NVG_CLIP_IMAGE,			// Multiplies the parent clip with the alpha of the image paint, whose quad is the path.
+};
+
 struct NVGvertex {
 	float x,y,u,v;
 };
@@ -653,9 +887,45 @@ struct NVGpath {
 };
 typedef struct NVGpath NVGpath;
 
+// Per-frame memory
+//
+// Buffers which only live for the duration of a frame (path commands, flattened points, paths and
+// vertices, as well as the draw calls and uniforms recorded by the backend) are carved from a linear
+// arena which is rewound by nvgBeginFrame(). When a frame needs more memory than the arena holds the
+// rest comes from the heap, and the arena is enlarged to that frame's high-water mark on the next
+// rewind. Steady-state frames therefore do not allocate at all.
+
+struct NVGallocator {
+	void* (*alloc)(void* userPtr, int size);
+	void (*free)(void* userPtr, void* ptr);
+	void* userPtr;
+};
+typedef struct NVGallocator NVGallocator;
+
+// Initial capacities of the per-frame buffers. Zero selects the built-in default.
+struct NVGmemoryParams {
+	int commands;			// Path command buffer, in floats.
+	int points;				// Flattened points.
+	int paths;				// Paths.
+	int verts;				// Temporary vertices.
+	int arenaSize;			// Initial arena size in bytes.
+	NVGallocator allocator;	// Where the arena gets its memory from, malloc/free if not set.
+};
+typedef struct NVGmemoryParams NVGmemoryParams;
+
+typedef struct NVGarena NVGarena;
+
+// Returns storage for at least count elements of elemSize bytes from the arena, preserving the
+// first keep elements of ptr. capacity and generation are owned by the caller and updated in place;
+// after the arena has been rewound the old contents are dropped and capacity serves as a size hint.
+void* nvgArenaReserve(NVGarena* arena, void* ptr, int* capacity, int* generation, int count, int keep, int elemSize);
+
 struct NVGparams {
 	void* userPtr;
 	int edgeAntiAlias;
+	int gradientRamps;	// Non-zero if gradients sample their colours from NVGpaint.ramp when it is set.
+	NVGmemoryParams memory;
+	NVGarena* frameArena;	// Set by nvgCreateInternal(), backends may use it for their per-frame buffers.
 	int (*renderCreate)(void* uptr);
 	int (*renderCreateTexture)(void* uptr, int type, int w, int h, int imageFlags, const unsigned char* data);
 	int (*renderDeleteTexture)(void* uptr, int image);
@@ -667,6 +937,14 @@ struct NVGparams {
 	void (*renderFill)(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor, float fringe, const float* bounds, const NVGpath* paths, int npaths);
 	void (*renderStroke)(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor, float fringe, float strokeWidth, const NVGpath* paths, int npaths);
 	void (*renderTriangles)(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor, const NVGvertex* verts, int nverts, float fringe);
+	// Optional. Creates a clip from parent (-1 for none) for the rest of the frame, see NVGclipOp.
+	// Returns the clip to set in NVGscissor, or -1 on failure.
+	int (*renderClip)(void* uptr, int parent, int op, NVGpaint* paint, const float* bounds, const NVGpath* paths, int npaths);
+	// Optional. Redirects the following calls into a layer covering bounds, which may exceed the view.
+	// Returns the layer, or -1 on failure.
+	int (*renderBeginLayer)(void* uptr, const float* bounds);
+	// Ends a layer from renderBeginLayer() and draws it.
+	void (*renderEndLayer)(void* uptr, int layer, float alpha, NVGcompositeOperationState compositeOperation, NVGscissor* scissor);
 	void (*renderDelete)(void* uptr);
 };
 typedef struct NVGparams NVGparams;
@@ -112,11 +112,13 @@ enum NVGimageFlagsGL {
 #include <string.h>
 #include <math.h>
 #include "nanovg.h"
+#include "nanovg_simd.h"
 
 enum GLNVGuniformLoc {
 	GLNVG_LOC_VIEWSIZE,
 	GLNVG_LOC_TEX,
 	GLNVG_LOC_FRAG,
+	GLNVG_LOC_CLIPTEX,
 	GLNVG_MAX_LOCS
 };
 
@@ -141,6 +143,20 @@ struct GLNVGshader {
 };
 typedef struct GLNVGshader GLNVGshader;
 
+// How textures of BGRA pixels are uploaded, see glnvg__initBGRA.
+enum GLNVGbgraUpload {
+	GLNVG_BGRA_CONVERT,		// Converted to RGBA pixels first.
+	GLNVG_BGRA_FORMAT,		// Uploaded as GL_BGRA pixels.
+	GLNVG_BGRA_SWIZZLE,		// Uploaded as GL_RGBA pixels, and sampled with red and blue swapped.
+};
+
+// Not defined by all GL headers.
+#define GLNVG_BGRA 0x80E1
+#define GLNVG_TEXTURE_SWIZZLE_R 0x8E42
+#define GLNVG_TEXTURE_SWIZZLE_B 0x8E44
+#define GLNVG_RED 0x1903
+#define GLNVG_BLUE 0x1905
+
 struct GLNVGtexture {
 	int id;
 	GLuint tex;
@@ -159,12 +175,49 @@ struct GLNVGblend
 };
 typedef struct GLNVGblend GLNVGblend;
 
+// Stencil bit of the clip, the bits below it count the winding of fills.
+#define GLNVG_CLIP_BIT 0x80
+#define GLNVG_WINDING_BITS 0x7f
+
+// Texture unit of the image of the clip.
+#define GLNVG_CLIP_TEXTURE_UNIT 1
+
+// Layer targets are rounded up to multiples of this many pixels, so that layers of similar sizes share them.
+#define GLNVG_LAYER_BUCKET 256
+// Layer targets unused for this many frames are deleted.
+#define GLNVG_LAYER_IDLE_FRAMES 120
+
+#if defined(NANOVG_GL3) || defined(NANOVG_GLES2) || defined(NANOVG_GLES3) || (defined(NANOVG_GL2) && defined(__APPLE__))
+#	define GLNVG_LAYERS 1
+#endif
+
+// Vertex and uniform buffers are used by frames in turn, so that uploading a frame does not wait
+// for the GPU to finish drawing the previous one.
+#define GLNVG_FRAME_BUFFERS 2
+
+// With fences a frame's buffers are written in place, once the GPU has drawn the frame which used
+// them before. Without, they are orphaned on upload and the driver takes care of it.
+//
+// Sync objects are core in GL3 and GLES3. GL2 and GLES2 use them if NANOVG_GL_USE_SYNC is 1, which
+// needs headers or a function loader declaring glFenceSync(), and the context supports them.
+#if !defined(NANOVG_GL_USE_SYNC) && (defined(NANOVG_GL3) || defined(NANOVG_GLES3))
+#	define NANOVG_GL_USE_SYNC 1
+#endif
+
+#if NANOVG_GL_USE_SYNC
+#	define GLNVG_FENCES 1
+// Nanoseconds to wait for a frame's buffers before writing to them anyway.
+#	define GLNVG_FENCE_TIMEOUT 1000000000
+#endif
+
 enum GLNVGcallType {
 	GLNVG_NONE = 0,
 	GLNVG_FILL,
 	GLNVG_CONVEXFILL,
 	GLNVG_STROKE,
 	GLNVG_TRIANGLES,
+	GLNVG_BEGIN_LAYER,
+	GLNVG_END_LAYER,
 };
 
 struct GLNVGcall {
@@ -175,10 +228,48 @@ struct GLNVGcall {
 	int triangleOffset;
 	int triangleCount;
 	int uniformOffset;
+	int clip;
 	GLNVGblend blendFunc;
 };
 typedef struct GLNVGcall GLNVGcall;
 
+// A clip from glnvg__renderClip(). Clips of paths are drawn into the stencil buffer before the calls
+// which use them. The alpha of an image clip is sampled by the calls, one image per call, so image
+// clips within another only clip to their quad.
+struct GLNVGclip {
+	int parent;
+	int op;
+	int stencil;		// This or the innermost parent which is drawn into the stencil buffer, or -1.
+	int mask;			// The image clip multiplying the calls, or -1.
+	int pathOffset;
+	int pathCount;
+	int triangleOffset;	// Bounds quad.
+	int image;
+	float maskMat[12];
+	float maskExt[2];
+	int maskType;		// 1 for the alpha of RGBA images, 2 for alpha images.
+};
+typedef struct GLNVGclip GLNVGclip;
+
+// Offscreen framebuffer of a layer, which is returned to the pool when the layer is ended.
+struct GLNVGlayerTarget {
+	GLuint fbo;
+	GLuint rbo;
+	int image;
+	int width, height;
+	int inUse;
+	int idleFrames;
+};
+typedef struct GLNVGlayerTarget GLNVGlayerTarget;
+
+// A layer of the current frame, drawn into a target with its top left at the pixel x, y of the view.
+struct GLNVGlayer {
+	int parent;
+	int target;
+	int x, y, width, height;
+};
+typedef struct GLNVGlayer GLNVGlayer;
+
 struct GLNVGpath {
 	int fillOffset;
 	int fillCount;
@@ -202,10 +293,14 @@ struct GLNVGfragUniforms {
 		float strokeThr;
 		int texType;
 		int type;
+		float clipMat[12];
+		float clipExt[2];
+		int clipType;
+		float ramp;
 	#else
 		// note: after modifying layout or size of uniform array,
 		// don't forget to also update the fragment shader source!
-		#define NANOVG_GL_UNIFORMARRAY_SIZE 11
+		#define NANOVG_GL_UNIFORMARRAY_SIZE 15
 		union {
 			struct {
 				float scissorMat[12]; // matrices are actually 3 vec4s
@@ -221,6 +316,10 @@ struct GLNVGfragUniforms {
 				float strokeThr;
 				float texType;
 				float type;
+				float clipMat[12];
+				float clipExt[2];
+				float clipType;
+				float ramp;
 			};
 			float uniformArray[NANOVG_GL_UNIFORMARRAY_SIZE][4];
 		};
@@ -228,13 +327,30 @@ struct GLNVGfragUniforms {
 };
 typedef struct GLNVGfragUniforms GLNVGfragUniforms;
 
+struct GLNVGframeBuffers {
+	GLuint vertBuf;
+	int vertBufSize;
+#if NANOVG_GL_USE_UNIFORMBUFFER
+	GLuint fragBuf;
+	int fragBufSize;
+#endif
+#ifdef GLNVG_FENCES
+	GLsync fence;	// Signalled once the GPU has drawn the frame which used the buffers.
+#endif
+};
+typedef struct GLNVGframeBuffers GLNVGframeBuffers;
+
 struct GLNVGcontext {
 	GLNVGshader shader;
 	GLNVGtexture* textures;
 	float view[2];
+	float devicePixelRatio;
 	int ntextures;
 	int ctextures;
 	int textureId;
+	GLNVGframeBuffers frames[GLNVG_FRAME_BUFFERS];
+	int frame;
+	// Buffers of the current flush.
 	GLuint vertBuf;
 #if defined NANOVG_GL3
 	GLuint vertArr;
@@ -245,19 +361,52 @@ struct GLNVGcontext {
 	int fragSize;
 	int flags;
 
-	// Per frame buffers
+	// Per frame buffers, carved from the context's frame arena.
+	NVGarena* arena;
 	GLNVGcall* calls;
 	int ccalls;
 	int ncalls;
+	int gcalls;
 	GLNVGpath* paths;
 	int cpaths;
 	int npaths;
+	int gpaths;
+	GLNVGclip* clips;
+	int cclips;
+	int nclips;
+	int gclips;
 	struct NVGvertex* verts;
 	int cverts;
 	int nverts;
+	int gverts;
 	unsigned char* uniforms;
 	int cuniforms;
 	int nuniforms;
+	int guniforms;
+
+	GLNVGlayer* layers;
+	int clayers;
+	int nlayers;
+	int glayers;
+	int currentLayer;
+	int boundLayer;
+
+	// Pool of layer targets, kept across frames.
+	GLNVGlayerTarget* layerTargets;
+	int nlayerTargets;
+	int clayerTargets;
+
+	// Framebuffer and viewport of the view during a flush with layers.
+	GLint viewFramebuffer;
+	GLint viewViewport[4];
+
+	// Scissor set on the view before the flush, e.g. to repaint a damaged region, kept while drawing into the view.
+	GLboolean viewScissorTest;
+	GLint viewScissor[4];
+
+	// Full view quad and stencil shader uniforms for drawing clips, allocated with the first clip of a frame.
+	int clipQuadOffset;
+	int clipUniformOffset;
 
 	// cached state
 	#if NANOVG_GL_USE_STATE_FILTER
@@ -269,11 +418,26 @@ struct GLNVGcontext {
 	GLNVGblend blendFunc;
 	#endif
 
+	// Clip in the stencil buffer during a flush, -2 before the first one is drawn.
+	int stencilClip;
+	int clipStencilTest;
+	int clipImage;
+
 	int dummyTex;
+
+	int fences;	// Frames are fenced and their buffers written in place, see glnvg__initFences().
+
+	int bgraUpload;
+	GLenum bgraFormat;
+	GLenum bgraInternalFormat;
+	const NVGkernels* kernels;
+	unsigned char* converted;	// Scratch buffer of GLNVG_BGRA_CONVERT.
+	int cconverted;
 };
 typedef struct GLNVGcontext GLNVGcontext;
 
 static int glnvg__maxi(int a, int b) { return a > b ? a : b; }
+static int glnvg__mini(int a, int b) { return a < b ? a : b; }
 
 #ifdef NANOVG_GLES2
 static unsigned int glnvg__nearestPow2(unsigned int num)
@@ -289,6 +453,78 @@ static unsigned int glnvg__nearestPow2(unsigned int num)
 }
 #endif
 
+static void glnvg__initFences(GLNVGcontext* gl)
+{
+#if defined(NANOVG_GL3) || defined(NANOVG_GLES3)
+	gl->fences = 1;
+#elif defined(GLNVG_FENCES)
+	const char* version = (const char*)glGetString(GL_VERSION);
+	const char* extensions;
+
+	gl->fences = 0;
+	if (version == NULL) return;
+
+	// Sync objects are core since GL 3.2 and GLES 3.0, older desktop GL may have them as an extension.
+	if (strncmp(version, "OpenGL ES ", 10) == 0) {
+		gl->fences = version[10] >= '3' && version[10] <= '9';
+		return;
+	}
+	if ((version[0] > '3' && version[0] <= '9') || (version[0] == '3' && version[1] == '.' && version[2] >= '2')) {
+		gl->fences = 1;
+		return;
+	}
+	extensions = (const char*)glGetString(GL_EXTENSIONS);
+	gl->fences = extensions != NULL && strstr(extensions, "GL_ARB_sync") != NULL;
+#else
+	gl->fences = 0;
+#endif
+}
+
+static void glnvg__initBGRA(GLNVGcontext* gl)
+{
+	const char* version = (const char*)glGetString(GL_VERSION);
+	const char* extensions;
+
+	gl->kernels = nvgBestKernels();
+	gl->bgraUpload = GLNVG_BGRA_CONVERT;
+	gl->bgraFormat = GL_RGBA;
+	gl->bgraInternalFormat = GL_RGBA;
+
+	// Desktop GL has taken BGRA pixels since 1.2, also when running the GLES code.
+	if (version != NULL && strncmp(version, "OpenGL ES", 9) != 0) {
+		gl->bgraUpload = GLNVG_BGRA_FORMAT;
+		gl->bgraFormat = GLNVG_BGRA;
+		return;
+	}
+
+	extensions = (const char*)glGetString(GL_EXTENSIONS);
+	if (extensions != NULL && strstr(extensions, "GL_EXT_texture_format_BGRA8888") != NULL) {
+		gl->bgraUpload = GLNVG_BGRA_FORMAT;
+		gl->bgraFormat = GLNVG_BGRA;
+		gl->bgraInternalFormat = GLNVG_BGRA;
+	} else if (extensions != NULL && strstr(extensions, "GL_APPLE_texture_format_BGRA8888") != NULL) {
+		gl->bgraUpload = GLNVG_BGRA_FORMAT;
+		gl->bgraFormat = GLNVG_BGRA;
+	} else {
+#if defined NANOVG_GLES3
+		gl->bgraUpload = GLNVG_BGRA_SWIZZLE;
+#endif
+	}
+}
+
+// Returns the BGRA pixels converted to RGBA in the scratch buffer, or NULL if out of memory.
+static const unsigned char* glnvg__convertBGRA(GLNVGcontext* gl, const unsigned char* data, int npixels)
+{
+	if (npixels > gl->cconverted) {
+		unsigned char* converted = (unsigned char*)realloc(gl->converted, (size_t)npixels * 4);
+		if (converted == NULL) return NULL;
+		gl->converted = converted;
+		gl->cconverted = npixels;
+	}
+	gl->kernels->swapRB(data, gl->converted, npixels);
+	return gl->converted;
+}
+
 static void glnvg__bindTexture(GLNVGcontext* gl, GLuint tex)
 {
 #if NANOVG_GL_USE_STATE_FILTER
@@ -494,6 +730,7 @@ static void glnvg__getUniforms(GLNVGshader* shader)
 {
 	shader->loc[GLNVG_LOC_VIEWSIZE] = glGetUniformLocation(shader->prog, "viewSize");
 	shader->loc[GLNVG_LOC_TEX] = glGetUniformLocation(shader->prog, "tex");
+	shader->loc[GLNVG_LOC_CLIPTEX] = glGetUniformLocation(shader->prog, "clipTex");
 
 #if NANOVG_GL_USE_UNIFORMBUFFER
 	shader->loc[GLNVG_LOC_FRAG] = glGetUniformBlockIndex(shader->prog, "frag");
@@ -508,6 +745,7 @@ static int glnvg__renderCreate(void* uptr)
 {
 	GLNVGcontext* gl = (GLNVGcontext*)uptr;
 	int align = 4;
+	int i;
 
 	// TODO: mediump float may not be enough for GLES2 in iOS.
 	// see the following discussion: https://github.com/memononen/nanovg/issues/46
@@ -528,7 +766,7 @@ static int glnvg__renderCreate(void* uptr)
 #if NANOVG_GL_USE_UNIFORMBUFFER
 	"#define USE_UNIFORMBUFFER 1\n"
 #else
-	"#define UNIFORMARRAY_SIZE 11\n"
+	"#define UNIFORMARRAY_SIZE 15\n"
 #endif
 	"\n";
 
@@ -576,17 +814,23 @@ static int glnvg__renderCreate(void* uptr)
 		"		float strokeThr;\n"
 		"		int texType;\n"
 		"		int type;\n"
+		"		mat3 clipMat;\n"
+		"		vec2 clipExt;\n"
+		"		int clipType;\n"
+		"		float ramp;\n"
 		"	};\n"
 		"#else\n" // NANOVG_GL3 && !USE_UNIFORMBUFFER
 		"	uniform vec4 frag[UNIFORMARRAY_SIZE];\n"
 		"#endif\n"
 		"	uniform sampler2D tex;\n"
+		"	uniform sampler2D clipTex;\n"
 		"	in vec2 ftcoord;\n"
 		"	in vec2 fpos;\n"
 		"	out vec4 outColor;\n"
 		"#else\n" // !NANOVG_GL3
 		"	uniform vec4 frag[UNIFORMARRAY_SIZE];\n"
 		"	uniform sampler2D tex;\n"
+		"	uniform sampler2D clipTex;\n"
 		"	varying vec2 ftcoord;\n"
 		"	varying vec2 fpos;\n"
 		"#endif\n"
@@ -604,6 +848,10 @@ static int glnvg__renderCreate(void* uptr)
 		"	#define strokeThr frag[10].y\n"
 		"	#define texType int(frag[10].z)\n"
 		"	#define type int(frag[10].w)\n"
+		"	#define clipMat mat3(frag[11].xyz, frag[12].xyz, frag[13].xyz)\n"
+		"	#define clipExt frag[14].xy\n"
+		"	#define clipType int(frag[14].z)\n"
+		"	#define ramp frag[14].w\n"
 		"#endif\n"
 		"\n"
 		"float sdroundrect(vec2 pt, vec2 ext, float rad) {\n"
@@ -618,6 +866,18 @@ static int glnvg__renderCreate(void* uptr)
 		"	sc = vec2(0.5,0.5) - sc * scissorScale;\n"
 		"	return clamp(sc.x,0.0,1.0) * clamp(sc.y,0.0,1.0);\n"
 		"}\n"
+		"// Alpha of the image clip\n"
+		"float clipMask(vec2 p) {\n"
+		"	if (clipType == 0) return 1.0;\n"
+		"	vec2 pt = (clipMat * vec3(p,1.0)).xy / clipExt;\n"
+		"	if (pt.x < 0.0 || pt.y < 0.0 || pt.x > 1.0 || pt.y > 1.0) return 0.0;\n"
+		"#ifdef NANOVG_GL3\n"
+		"	vec4 mask = texture(clipTex, pt);\n"
+		"#else\n"
+		"	vec4 mask = texture2D(clipTex, pt);\n"
+		"#endif\n"
+		"	return clipType == 2 ? mask.x : mask.w;\n"
+		"}\n"
 		"#ifdef EDGE_AA\n"
 		"// Stroke - from [0..1] to clipped pyramid, where the slope is 1px.\n"
 		"float strokeMask() {\n"
@@ -627,7 +887,7 @@ static int glnvg__renderCreate(void* uptr)
 		"\n"
 		"void main(void) {\n"
 		"   vec4 result;\n"
-		"	float scissor = scissorMask(fpos);\n"
+		"	float scissor = scissorMask(fpos) * clipMask(fpos);\n"
 		"#ifdef EDGE_AA\n"
 		"	float strokeAlpha = strokeMask();\n"
 		"	if (strokeAlpha < strokeThr) discard;\n"
@@ -639,6 +899,12 @@ static int glnvg__renderCreate(void* uptr)
 		"		vec2 pt = (paintMat * vec3(fpos,1.0)).xy;\n"
 		"		float d = clamp((sdroundrect(pt, extent, radius) + feather*0.5) / feather, 0.0, 1.0);\n"
 		"		vec4 color = mix(innerCol,outerCol,d);\n"
+		"		// Gradients with more than two stops look up their colors in a row of the ramp texture\n"
+		"#ifdef NANOVG_GL3\n"
+		"		if (ramp > 0.0) color = texture(tex, vec2(d, ramp)) * innerCol;\n"
+		"#else\n"
+		"		if (ramp > 0.0) color = texture2D(tex, vec2(d, ramp)) * innerCol;\n"
+		"#endif\n"
 		"		// Combine alpha\n"
 		"		color *= strokeAlpha * scissor;\n"
 		"		result = color;\n"
@@ -694,12 +960,14 @@ static int glnvg__renderCreate(void* uptr)
 #if defined NANOVG_GL3
 	glGenVertexArrays(1, &gl->vertArr);
 #endif
-	glGenBuffers(1, &gl->vertBuf);
+	for (i = 0; i < GLNVG_FRAME_BUFFERS; i++)
+		glGenBuffers(1, &gl->frames[i].vertBuf);
 
 #if NANOVG_GL_USE_UNIFORMBUFFER
 	// Create UBOs
 	glUniformBlockBinding(gl->shader.prog, gl->shader.loc[GLNVG_LOC_FRAG], GLNVG_FRAG_BINDING);
-	glGenBuffers(1, &gl->fragBuf);
+	for (i = 0; i < GLNVG_FRAME_BUFFERS; i++)
+		glGenBuffers(1, &gl->frames[i].fragBuf);
 	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
 #endif
 	gl->fragSize = sizeof(GLNVGfragUniforms) + align - sizeof(GLNVGfragUniforms) % align;
@@ -708,6 +976,9 @@ static int glnvg__renderCreate(void* uptr)
 	// Create empty one which is bound when there's no texture specified.
 	gl->dummyTex = glnvg__renderCreateTexture(gl, NVG_TEXTURE_ALPHA, 1, 1, 0, NULL);
 
+	glnvg__initBGRA(gl);
+	glnvg__initFences(gl);
+
 	glnvg__checkError(gl, "create done");
 
 	glFinish();
@@ -718,8 +989,14 @@ static int glnvg__renderCreate(void* uptr)
 static int glnvg__renderCreateTexture(void* uptr, int type, int w, int h, int imageFlags, const unsigned char* data)
 {
 	GLNVGcontext* gl = (GLNVGcontext*)uptr;
-	GLNVGtexture* tex = glnvg__allocTexture(gl);
+	GLNVGtexture* tex;
+
+	if (type == NVG_TEXTURE_BGRA && gl->bgraUpload == GLNVG_BGRA_CONVERT && data != NULL) {
+		data = glnvg__convertBGRA(gl, data, w*h);
+		if (data == NULL) return 0;
+	}
 
+	tex = glnvg__allocTexture(gl);
 	if (tex == NULL) return 0;
 
 #ifdef NANOVG_GLES2
@@ -761,6 +1038,8 @@ static int glnvg__renderCreateTexture(void* uptr, int type, int w, int h, int im
 
 	if (type == NVG_TEXTURE_RGBA)
 		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+	else if (type == NVG_TEXTURE_BGRA)
+		glTexImage2D(GL_TEXTURE_2D, 0, gl->bgraInternalFormat, w, h, 0, gl->bgraFormat, GL_UNSIGNED_BYTE, data);
 	else
 #if defined(NANOVG_GLES2) || defined (NANOVG_GL2)
 		glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, w, h, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, data);
@@ -800,6 +1079,13 @@ static int glnvg__renderCreateTexture(void* uptr, int type, int w, int h, int im
 	else
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
+#if defined NANOVG_GLES3
+	if (type == NVG_TEXTURE_BGRA && gl->bgraUpload == GLNVG_BGRA_SWIZZLE) {
+		glTexParameteri(GL_TEXTURE_2D, GLNVG_TEXTURE_SWIZZLE_R, GLNVG_BLUE);
+		glTexParameteri(GL_TEXTURE_2D, GLNVG_TEXTURE_SWIZZLE_B, GLNVG_RED);
+	}
+#endif
+
 	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 #ifndef NANOVG_GLES2
 	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
@@ -831,8 +1117,17 @@ static int glnvg__renderUpdateTexture(void* uptr, int image, int x, int y, int w
 {
 	GLNVGcontext* gl = (GLNVGcontext*)uptr;
 	GLNVGtexture* tex = glnvg__findTexture(gl, image);
+	int skipRows = y;
 
 	if (tex == NULL) return 0;
+
+	// Only the updated rows are converted, so the converted data starts at row y.
+	if (tex->type == NVG_TEXTURE_BGRA && gl->bgraUpload == GLNVG_BGRA_CONVERT) {
+		data = glnvg__convertBGRA(gl, data + (size_t)y*tex->width*4, tex->width*h);
+		if (data == NULL) return 0;
+		skipRows = 0;
+	}
+
 	glnvg__bindTexture(gl, tex->tex);
 
 	glPixelStorei(GL_UNPACK_ALIGNMENT,1);
@@ -840,19 +1135,18 @@ static int glnvg__renderUpdateTexture(void* uptr, int image, int x, int y, int w
 #ifndef NANOVG_GLES2
 	glPixelStorei(GL_UNPACK_ROW_LENGTH, tex->width);
 	glPixelStorei(GL_UNPACK_SKIP_PIXELS, x);
-	glPixelStorei(GL_UNPACK_SKIP_ROWS, y);
+	glPixelStorei(GL_UNPACK_SKIP_ROWS, skipRows);
 #else
 	// No support for all of skip, need to update a whole row at a time.
-	if (tex->type == NVG_TEXTURE_RGBA)
-		data += y*tex->width*4;
-	else
-		data += y*tex->width;
+	data += (size_t)skipRows*tex->width*(tex->type == NVG_TEXTURE_ALPHA ? 1 : 4);
 	x = 0;
 	w = tex->width;
 #endif
 
 	if (tex->type == NVG_TEXTURE_RGBA)
 		glTexSubImage2D(GL_TEXTURE_2D, 0, x,y, w,h, GL_RGBA, GL_UNSIGNED_BYTE, data);
+	else if (tex->type == NVG_TEXTURE_BGRA)
+		glTexSubImage2D(GL_TEXTURE_2D, 0, x,y, w,h, gl->bgraFormat, GL_UNSIGNED_BYTE, data);
 	else
 #if defined(NANOVG_GLES2) || defined(NANOVG_GL2)
 		glTexSubImage2D(GL_TEXTURE_2D, 0, x,y, w,h, GL_LUMINANCE, GL_UNSIGNED_BYTE, data);
@@ -906,6 +1200,23 @@ static NVGcolor glnvg__premulColor(NVGcolor c)
 	return c;
 }
 
+// Inverse of the transform of an image paint, flipped for images which are stored upside down.
+static void glnvg__imageInverseXform(float* invxform, const NVGpaint* paint, const GLNVGtexture* tex)
+{
+	if ((tex->flags & NVG_IMAGE_FLIPY) != 0) {
+		float m1[6], m2[6];
+		nvgTransformTranslate(m1, 0.0f, paint->extent[1] * 0.5f);
+		nvgTransformMultiply(m1, paint->xform);
+		nvgTransformScale(m2, 1.0f, -1.0f);
+		nvgTransformMultiply(m2, m1);
+		nvgTransformTranslate(m1, 0.0f, -paint->extent[1] * 0.5f);
+		nvgTransformMultiply(m1, m2);
+		nvgTransformInverse(invxform, m1);
+	} else {
+		nvgTransformInverse(invxform, paint->xform);
+	}
+}
+
 static int glnvg__convertPaint(GLNVGcontext* gl, GLNVGfragUniforms* frag, NVGpaint* paint,
 							   NVGscissor* scissor, float width, float fringe, float strokeThr)
 {
@@ -936,30 +1247,19 @@ static int glnvg__convertPaint(GLNVGcontext* gl, GLNVGfragUniforms* frag, NVGpai
 	frag->strokeMult = (width*0.5f + fringe*0.5f) / fringe;
 	frag->strokeThr = strokeThr;
 
-	if (paint->image != 0) {
+	if (paint->image != 0 && paint->ramp <= 0.0f) {
 		tex = glnvg__findTexture(gl, paint->image);
 		if (tex == NULL) return 0;
-		if ((tex->flags & NVG_IMAGE_FLIPY) != 0) {
-			float m1[6], m2[6];
-			nvgTransformTranslate(m1, 0.0f, frag->extent[1] * 0.5f);
-			nvgTransformMultiply(m1, paint->xform);
-			nvgTransformScale(m2, 1.0f, -1.0f);
-			nvgTransformMultiply(m2, m1);
-			nvgTransformTranslate(m1, 0.0f, -frag->extent[1] * 0.5f);
-			nvgTransformMultiply(m1, m2);
-			nvgTransformInverse(invxform, m1);
-		} else {
-			nvgTransformInverse(invxform, paint->xform);
-		}
+		glnvg__imageInverseXform(invxform, paint, tex);
 		frag->type = NSVG_SHADER_FILLIMG;
 
 		#if NANOVG_GL_USE_UNIFORMBUFFER
-		if (tex->type == NVG_TEXTURE_RGBA)
+		if (tex->type != NVG_TEXTURE_ALPHA)
 			frag->texType = (tex->flags & NVG_IMAGE_PREMULTIPLIED) ? 0 : 1;
 		else
 			frag->texType = 2;
 		#else
-		if (tex->type == NVG_TEXTURE_RGBA)
+		if (tex->type != NVG_TEXTURE_ALPHA)
 			frag->texType = (tex->flags & NVG_IMAGE_PREMULTIPLIED) ? 0.0f : 1.0f;
 		else
 			frag->texType = 2.0f;
@@ -969,11 +1269,20 @@ static int glnvg__convertPaint(GLNVGcontext* gl, GLNVGfragUniforms* frag, NVGpai
 		frag->type = NSVG_SHADER_FILLGRAD;
 		frag->radius = paint->radius;
 		frag->feather = paint->feather;
+		frag->ramp = paint->ramp;
 		nvgTransformInverse(invxform, paint->xform);
 	}
 
 	glnvg__xformToMat3x4(frag->paintMat, invxform);
 
+	if (scissor->clip >= 0 && gl->clips[scissor->clip].mask >= 0) {
+		const GLNVGclip* mask = &gl->clips[gl->clips[scissor->clip].mask];
+		memcpy(frag->clipMat, mask->maskMat, sizeof(frag->clipMat));
+		frag->clipExt[0] = mask->maskExt[0];
+		frag->clipExt[1] = mask->maskExt[1];
+		frag->clipType = mask->maskType;
+	}
+
 	return 1;
 }
 
@@ -1002,21 +1311,123 @@ static void glnvg__setUniforms(GLNVGcontext* gl, int uniformOffset, int image)
 
 static void glnvg__renderViewport(void* uptr, float width, float height, float devicePixelRatio)
 {
-	NVG_NOTUSED(devicePixelRatio);
 	GLNVGcontext* gl = (GLNVGcontext*)uptr;
 	gl->view[0] = width;
 	gl->view[1] = height;
+	gl->devicePixelRatio = devicePixelRatio;
+}
+
+// Draws a clip on top of the one in the stencil buffer, see glnvg__drawStencilClip().
+static void glnvg__drawClipPaths(GLNVGcontext* gl, const GLNVGclip* clip)
+{
+	GLNVGpath* paths = &gl->paths[clip->pathOffset];
+	int i;
+
+	// Winding of the paths
+	glnvg__stencilMask(gl, GLNVG_WINDING_BITS);
+	glnvg__stencilFunc(gl, GL_ALWAYS, 0, 0xff);
+	glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_KEEP, GL_INCR_WRAP);
+	glStencilOpSeparate(GL_BACK, GL_KEEP, GL_KEEP, GL_DECR_WRAP);
+	for (i = 0; i < clip->pathCount; i++)
+		glDrawArrays(GL_TRIANGLE_FAN, paths[i].fillOffset, paths[i].fillCount);
+
+	if (clip->op == NVG_CLIP_EXCLUDE) {
+		// Clear the clip bit and the winding inside the paths.
+		glnvg__stencilMask(gl, 0xff);
+		glnvg__stencilFunc(gl, GL_NOTEQUAL, 0x0, GLNVG_WINDING_BITS);
+		glStencilOp(GL_KEEP, GL_KEEP, GL_ZERO);
+		glDrawArrays(GL_TRIANGLE_STRIP, clip->triangleOffset, 4);
+	} else {
+		// Clear the clip bit outside the paths, then the winding inside them.
+		glnvg__stencilMask(gl, GLNVG_CLIP_BIT);
+		glnvg__stencilFunc(gl, GL_EQUAL, GLNVG_CLIP_BIT, 0xff);
+		glStencilOp(GL_KEEP, GL_KEEP, GL_ZERO);
+		glDrawArrays(GL_TRIANGLE_STRIP, gl->clipQuadOffset, 4);
+		glnvg__stencilMask(gl, GLNVG_WINDING_BITS);
+		glnvg__stencilFunc(gl, GL_NOTEQUAL, 0x0, GLNVG_WINDING_BITS);
+		glDrawArrays(GL_TRIANGLE_STRIP, clip->triangleOffset, 4);
+	}
+}
+
+// Makes the clip bit of the stencil buffer hold the clip, starting from the clip that is there
+// already if it is a parent, or else from everything. Clips are only ever added to the end, so
+// the parents of a clip come before it.
+static void glnvg__drawStencilClip(GLNVGcontext* gl, int clip)
+{
+	int parent;
+
+	if (clip == gl->stencilClip)
+		return;
+
+	if (clip < 0) {
+		glnvg__stencilMask(gl, 0xff);
+		glnvg__stencilFunc(gl, GL_ALWAYS, GLNVG_CLIP_BIT, 0xff);
+		glStencilOp(GL_REPLACE, GL_REPLACE, GL_REPLACE);
+		glDrawArrays(GL_TRIANGLE_STRIP, gl->clipQuadOffset, 4);
+	} else {
+		parent = gl->clips[clip].parent;
+		glnvg__drawStencilClip(gl, parent >= 0 ? gl->clips[parent].stencil : -1);
+		glnvg__drawClipPaths(gl, &gl->clips[clip]);
+	}
+	gl->stencilClip = clip;
+}
+
+// Prepares the clip of a call: the stencil buffer for its stencil test, and the image of its clip mask.
+static void glnvg__setClip(GLNVGcontext* gl, GLNVGcall* call)
+{
+	const GLNVGclip* clip = call->clip >= 0 ? &gl->clips[call->clip] : NULL;
+	int image = clip != NULL && clip->mask >= 0 ? gl->clips[clip->mask].image : 0;
+	GLNVGtexture* tex;
+
+	gl->clipStencilTest = clip != NULL && clip->stencil >= 0;
+
+	if (gl->clipStencilTest && clip->stencil != gl->stencilClip) {
+		glEnable(GL_STENCIL_TEST);
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		glDisable(GL_CULL_FACE);
+		glnvg__setUniforms(gl, gl->clipUniformOffset, 0);
+		glnvg__drawStencilClip(gl, clip->stencil);
+		glEnable(GL_CULL_FACE);
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		glDisable(GL_STENCIL_TEST);
+	}
+
+	if (image != gl->clipImage) {
+		tex = glnvg__findTexture(gl, image != 0 ? image : gl->dummyTex);
+		glActiveTexture(GL_TEXTURE0 + GLNVG_CLIP_TEXTURE_UNIT);
+		glBindTexture(GL_TEXTURE_2D, tex != NULL ? tex->tex : 0);
+		glActiveTexture(GL_TEXTURE0);
+		gl->clipImage = image;
+	}
+}
+
+// Limits the following draws to the clip in the stencil buffer, if the call has one.
+static void glnvg__beginClipTest(GLNVGcontext* gl)
+{
+	if (!gl->clipStencilTest) return;
+	glEnable(GL_STENCIL_TEST);
+	glnvg__stencilMask(gl, 0xff);
+	glnvg__stencilFunc(gl, GL_EQUAL, GLNVG_CLIP_BIT, GLNVG_CLIP_BIT);
+	glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+}
+
+static void glnvg__endClipTest(GLNVGcontext* gl)
+{
+	if (gl->clipStencilTest)
+		glDisable(GL_STENCIL_TEST);
 }
 
 static void glnvg__fill(GLNVGcontext* gl, GLNVGcall* call)
 {
 	GLNVGpath* paths = &gl->paths[call->pathOffset];
 	int i, npaths = call->pathCount;
+	// With no clip the mask is 0 and the clip bit is ignored.
+	GLuint clipBit = gl->clipStencilTest ? GLNVG_CLIP_BIT : 0;
 
-	// Draw shapes
+	// Draw shapes, only within the clip
 	glEnable(GL_STENCIL_TEST);
-	glnvg__stencilMask(gl, 0xff);
-	glnvg__stencilFunc(gl, GL_ALWAYS, 0, 0xff);
+	glnvg__stencilMask(gl, GLNVG_WINDING_BITS);
+	glnvg__stencilFunc(gl, GL_EQUAL, clipBit, clipBit);
 	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
 
 	// set bindpoint for solid loc
@@ -1037,7 +1448,7 @@ static void glnvg__fill(GLNVGcontext* gl, GLNVGcall* call)
 	glnvg__checkError(gl, "fill fill");
 
 	if (gl->flags & NVG_ANTIALIAS) {
-		glnvg__stencilFunc(gl, GL_EQUAL, 0x00, 0xff);
+		glnvg__stencilFunc(gl, GL_EQUAL, clipBit, GLNVG_WINDING_BITS | clipBit);
 		glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
 		// Draw fringes
 		for (i = 0; i < npaths; i++)
@@ -1045,7 +1456,7 @@ static void glnvg__fill(GLNVGcontext* gl, GLNVGcall* call)
 	}
 
 	// Draw fill
-	glnvg__stencilFunc(gl, GL_NOTEQUAL, 0x0, 0xff);
+	glnvg__stencilFunc(gl, GL_NOTEQUAL, 0x0, GLNVG_WINDING_BITS);
 	glStencilOp(GL_ZERO, GL_ZERO, GL_ZERO);
 	glDrawArrays(GL_TRIANGLE_STRIP, call->triangleOffset, call->triangleCount);
 
@@ -1060,13 +1471,17 @@ static void glnvg__convexFill(GLNVGcontext* gl, GLNVGcall* call)
 	glnvg__setUniforms(gl, call->uniformOffset, call->image);
 	glnvg__checkError(gl, "convex fill");
 
+	glnvg__beginClipTest(gl);
 	for (i = 0; i < npaths; i++) {
-		glDrawArrays(GL_TRIANGLE_FAN, paths[i].fillOffset, paths[i].fillCount);
+		// Rectangles from nvgFillRects() are all in the fringe strip.
+		if (paths[i].fillCount > 0)
+			glDrawArrays(GL_TRIANGLE_FAN, paths[i].fillOffset, paths[i].fillCount);
 		// Draw fringes
 		if (paths[i].strokeCount > 0) {
 			glDrawArrays(GL_TRIANGLE_STRIP, paths[i].strokeOffset, paths[i].strokeCount);
 		}
 	}
+	glnvg__endClipTest(gl);
 }
 
 static void glnvg__stroke(GLNVGcontext* gl, GLNVGcall* call)
@@ -1075,12 +1490,13 @@ static void glnvg__stroke(GLNVGcontext* gl, GLNVGcall* call)
 	int npaths = call->pathCount, i;
 
 	if (gl->flags & NVG_STENCIL_STROKES) {
+		GLuint clipBit = gl->clipStencilTest ? GLNVG_CLIP_BIT : 0;
 
 		glEnable(GL_STENCIL_TEST);
-		glnvg__stencilMask(gl, 0xff);
+		glnvg__stencilMask(gl, GLNVG_WINDING_BITS);
 
 		// Fill the stroke base without overlap
-		glnvg__stencilFunc(gl, GL_EQUAL, 0x0, 0xff);
+		glnvg__stencilFunc(gl, GL_EQUAL, clipBit, GLNVG_WINDING_BITS | clipBit);
 		glStencilOp(GL_KEEP, GL_KEEP, GL_INCR);
 		glnvg__setUniforms(gl, call->uniformOffset + gl->fragSize, call->image);
 		glnvg__checkError(gl, "stroke fill 0");
@@ -1089,7 +1505,7 @@ static void glnvg__stroke(GLNVGcontext* gl, GLNVGcall* call)
 
 		// Draw anti-aliased pixels.
 		glnvg__setUniforms(gl, call->uniformOffset, call->image);
-		glnvg__stencilFunc(gl, GL_EQUAL, 0x00, 0xff);
+		glnvg__stencilFunc(gl, GL_EQUAL, clipBit, GLNVG_WINDING_BITS | clipBit);
 		glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
 		for (i = 0; i < npaths; i++)
 			glDrawArrays(GL_TRIANGLE_STRIP, paths[i].strokeOffset, paths[i].strokeCount);
@@ -1111,8 +1527,10 @@ static void glnvg__stroke(GLNVGcontext* gl, GLNVGcall* call)
 		glnvg__setUniforms(gl, call->uniformOffset, call->image);
 		glnvg__checkError(gl, "stroke fill");
 		// Draw Strokes
+		glnvg__beginClipTest(gl);
 		for (i = 0; i < npaths; i++)
 			glDrawArrays(GL_TRIANGLE_STRIP, paths[i].strokeOffset, paths[i].strokeCount);
+		glnvg__endClipTest(gl);
 	}
 }
 
@@ -1121,15 +1539,24 @@ static void glnvg__triangles(GLNVGcontext* gl, GLNVGcall* call)
 	glnvg__setUniforms(gl, call->uniformOffset, call->image);
 	glnvg__checkError(gl, "triangles fill");
 
+	glnvg__beginClipTest(gl);
 	glDrawArrays(GL_TRIANGLES, call->triangleOffset, call->triangleCount);
+	glnvg__endClipTest(gl);
 }
 
 static void glnvg__renderCancel(void* uptr) {
 	GLNVGcontext* gl = (GLNVGcontext*)uptr;
+	int i;
+	for (i = 0; i < gl->nlayerTargets; i++)
+		gl->layerTargets[i].inUse = 0;
+	gl->nlayers = 0;
+	gl->currentLayer = -1;
 	gl->nverts = 0;
 	gl->npaths = 0;
 	gl->ncalls = 0;
 	gl->nuniforms = 0;
+	gl->nclips = 0;
+	gl->clipQuadOffset = -1;
 }
 
 static GLenum glnvg_convertBlendFuncFactor(int factor)
@@ -1176,9 +1603,191 @@ static GLNVGblend glnvg__blendCompositeOperation(NVGcompositeOperationState op)
 	return blend;
 }
 
+#ifdef GLNVG_LAYERS
+static void glnvg__deleteLayerTarget(GLNVGcontext* gl, GLNVGlayerTarget* target)
+{
+	if (target->fbo != 0)
+		glDeleteFramebuffers(1, &target->fbo);
+	if (target->rbo != 0)
+		glDeleteRenderbuffers(1, &target->rbo);
+	if (target->image != 0)
+		glnvg__deleteTexture(gl, target->image);
+	memset(target, 0, sizeof(*target));
+}
+
+// Creates the framebuffer of a layer target, with the attachments of nvgluCreateFramebuffer().
+static int glnvg__createLayerTarget(GLNVGcontext* gl, GLNVGlayerTarget* target, int w, int h)
+{
+	GLint defaultFBO, defaultRBO;
+	GLNVGtexture* tex;
+	int complete;
+
+	memset(target, 0, sizeof(*target));
+	target->image = glnvg__renderCreateTexture(gl, NVG_TEXTURE_RGBA, w, h, NVG_IMAGE_PREMULTIPLIED | NVG_IMAGE_NEAREST, NULL);
+	tex = glnvg__findTexture(gl, target->image);
+	if (tex == NULL) return 0;
+	target->width = w;
+	target->height = h;
+
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &defaultFBO);
+	glGetIntegerv(GL_RENDERBUFFER_BINDING, &defaultRBO);
+
+	glGenFramebuffers(1, &target->fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, target->fbo);
+	glGenRenderbuffers(1, &target->rbo);
+	glBindRenderbuffer(GL_RENDERBUFFER, target->rbo);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_STENCIL_INDEX8, w, h);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex->tex, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_STENCIL_ATTACHMENT, GL_RENDERBUFFER, target->rbo);
+	complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+#ifdef GL_DEPTH24_STENCIL8
+	if (!complete) {
+		// Some graphics cards require a depth buffer along with a stencil.
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, w, h);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_STENCIL_ATTACHMENT, GL_RENDERBUFFER, target->rbo);
+		complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	}
+#endif
+
+	glBindFramebuffer(GL_FRAMEBUFFER, defaultFBO);
+	glBindRenderbuffer(GL_RENDERBUFFER, defaultRBO);
+
+	if (!complete)
+		glnvg__deleteLayerTarget(gl, target);
+	return complete;
+}
+
+// Returns a free target of the pool for w x h pixels, creating one if there is none.
+static int glnvg__acquireLayerTarget(GLNVGcontext* gl, int w, int h)
+{
+	GLNVGlayerTarget* target;
+	int i, slot = -1;
+
+	w = (w + GLNVG_LAYER_BUCKET - 1) / GLNVG_LAYER_BUCKET * GLNVG_LAYER_BUCKET;
+	h = (h + GLNVG_LAYER_BUCKET - 1) / GLNVG_LAYER_BUCKET * GLNVG_LAYER_BUCKET;
+
+	for (i = 0; i < gl->nlayerTargets; i++) {
+		target = &gl->layerTargets[i];
+		if (target->fbo == 0) {
+			if (slot == -1) slot = i;
+		} else if (!target->inUse && target->width == w && target->height == h) {
+			target->inUse = 1;
+			target->idleFrames = 0;
+			return i;
+		}
+	}
+
+	if (slot == -1) {
+		if (gl->nlayerTargets+1 > gl->clayerTargets) {
+			GLNVGlayerTarget* targets;
+			int clayerTargets = glnvg__maxi(gl->nlayerTargets+1, 4) + gl->clayerTargets/2;
+			targets = (GLNVGlayerTarget*)realloc(gl->layerTargets, sizeof(GLNVGlayerTarget)*clayerTargets);
+			if (targets == NULL) return -1;
+			gl->layerTargets = targets;
+			gl->clayerTargets = clayerTargets;
+		}
+		slot = gl->nlayerTargets++;
+		memset(&gl->layerTargets[slot], 0, sizeof(GLNVGlayerTarget));
+	}
+
+	target = &gl->layerTargets[slot];
+	if (!glnvg__createLayerTarget(gl, target, w, h)) return -1;
+	target->inUse = 1;
+	return slot;
+}
+
+// Draws into a layer, or into the view for -1, during a flush.
+static void glnvg__bindLayer(GLNVGcontext* gl, int layer)
+{
+	GLNVGlayer* l;
+	GLNVGlayerTarget* target;
+	int viewWidth, viewHeight;
+
+	if (layer < 0) {
+		glBindFramebuffer(GL_FRAMEBUFFER, gl->viewFramebuffer);
+		glViewport(gl->viewViewport[0], gl->viewViewport[1], gl->viewViewport[2], gl->viewViewport[3]);
+		if (gl->viewScissorTest) {
+			glEnable(GL_SCISSOR_TEST);
+			glScissor(gl->viewScissor[0], gl->viewScissor[1], gl->viewScissor[2], gl->viewScissor[3]);
+		}
+	} else {
+		l = &gl->layers[layer];
+		target = &gl->layerTargets[l->target];
+		viewWidth = (int)(gl->view[0] * gl->devicePixelRatio + 0.5f);
+		viewHeight = (int)(gl->view[1] * gl->devicePixelRatio + 0.5f);
+		glBindFramebuffer(GL_FRAMEBUFFER, target->fbo);
+		glDisable(GL_SCISSOR_TEST);
+		// The view is shifted to put the top left of the layer at the top left of the target.
+		glViewport(-l->x, target->height - viewHeight + l->y, viewWidth, viewHeight);
+	}
+
+	// The clip in the stencil buffer belongs to the previous target.
+	gl->stencilClip = -2;
+	gl->boundLayer = layer;
+}
+
+static void glnvg__beginLayer(GLNVGcontext* gl, int layer)
+{
+	GLNVGlayer* l = &gl->layers[layer];
+	GLNVGlayerTarget* target = &gl->layerTargets[l->target];
+
+	glnvg__bindLayer(gl, layer);
+
+	// Only the part of the target covered by the layer is cleared and drawn later.
+	glEnable(GL_SCISSOR_TEST);
+	glScissor(0, target->height - l->height, l->width, l->height);
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	glClearStencil(0);
+	glnvg__stencilMask(gl, 0xff);
+	glClear(GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+	glDisable(GL_SCISSOR_TEST);
+}
+#endif
+
+// Takes the buffers of the next frame, waiting until the GPU has drawn the frame which used them before.
+static GLNVGframeBuffers* glnvg__beginFrameBuffers(GLNVGcontext* gl)
+{
+	GLNVGframeBuffers* frame;
+
+	gl->frame = (gl->frame + 1) % GLNVG_FRAME_BUFFERS;
+	frame = &gl->frames[gl->frame];
+
+#ifdef GLNVG_FENCES
+	if (frame->fence != NULL) {
+		glClientWaitSync(frame->fence, GL_SYNC_FLUSH_COMMANDS_BIT, GLNVG_FENCE_TIMEOUT);
+		glDeleteSync(frame->fence);
+		frame->fence = NULL;
+	}
+#endif
+
+	gl->vertBuf = frame->vertBuf;
+#if NANOVG_GL_USE_UNIFORMBUFFER
+	gl->fragBuf = frame->fragBuf;
+#endif
+	return frame;
+}
+
+static void glnvg__uploadBuffer(GLenum target, GLuint buf, int* size, const void* data, int bytes, int inPlace)
+{
+	glBindBuffer(target, buf);
+	if (inPlace) {
+		// The GPU is done with the buffer, so it is written in place, and only grown with some room to spare.
+		if (bytes > *size) {
+			*size = glnvg__maxi(bytes + bytes/2, 4096);
+			glBufferData(target, *size, NULL, GL_DYNAMIC_DRAW);
+		}
+		if (bytes > 0)
+			glBufferSubData(target, 0, bytes, data);
+	} else {
+		glBufferData(target, bytes, data, GL_STREAM_DRAW);
+		*size = bytes;
+	}
+}
+
 static void glnvg__renderFlush(void* uptr)
 {
 	GLNVGcontext* gl = (GLNVGcontext*)uptr;
+	GLNVGframeBuffers* frame;
 	int i;
 
 	if (gl->ncalls > 0) {
@@ -1191,7 +1800,9 @@ static void glnvg__renderFlush(void* uptr)
 		glFrontFace(GL_CCW);
 		glEnable(GL_BLEND);
 		glDisable(GL_DEPTH_TEST);
-		glDisable(GL_SCISSOR_TEST);
+		gl->viewScissorTest = glIsEnabled(GL_SCISSOR_TEST);
+		if (gl->viewScissorTest)
+			glGetIntegerv(GL_SCISSOR_BOX, gl->viewScissor);
 		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 		glStencilMask(0xffffffff);
 		glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
@@ -1210,18 +1821,18 @@ static void glnvg__renderFlush(void* uptr)
 		gl->blendFunc.dstAlpha = GL_INVALID_ENUM;
 		#endif
 
+		frame = glnvg__beginFrameBuffers(gl);
+
 #if NANOVG_GL_USE_UNIFORMBUFFER
 		// Upload ubo for frag shaders
-		glBindBuffer(GL_UNIFORM_BUFFER, gl->fragBuf);
-		glBufferData(GL_UNIFORM_BUFFER, gl->nuniforms * gl->fragSize, gl->uniforms, GL_STREAM_DRAW);
+		glnvg__uploadBuffer(GL_UNIFORM_BUFFER, gl->fragBuf, &frame->fragBufSize, gl->uniforms, gl->nuniforms * gl->fragSize, gl->fences);
 #endif
 
 		// Upload vertex data
 #if defined NANOVG_GL3
 		glBindVertexArray(gl->vertArr);
 #endif
-		glBindBuffer(GL_ARRAY_BUFFER, gl->vertBuf);
-		glBufferData(GL_ARRAY_BUFFER, gl->nverts * sizeof(NVGvertex), gl->verts, GL_STREAM_DRAW);
+		glnvg__uploadBuffer(GL_ARRAY_BUFFER, gl->vertBuf, &frame->vertBufSize, gl->verts, gl->nverts * (int)sizeof(NVGvertex), gl->fences);
 		glEnableVertexAttribArray(0);
 		glEnableVertexAttribArray(1);
 		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(NVGvertex), (const GLvoid*)(size_t)0);
@@ -1229,14 +1840,39 @@ static void glnvg__renderFlush(void* uptr)
 
 		// Set view and texture just once per frame.
 		glUniform1i(gl->shader.loc[GLNVG_LOC_TEX], 0);
+		glUniform1i(gl->shader.loc[GLNVG_LOC_CLIPTEX], GLNVG_CLIP_TEXTURE_UNIT);
 		glUniform2fv(gl->shader.loc[GLNVG_LOC_VIEWSIZE], 1, gl->view);
 
+		// Whatever is in the stencil buffer, the clip bit is set again before the first clip.
+		gl->stencilClip = -2;
+		gl->clipImage = -1;
+
+#ifdef GLNVG_LAYERS
+		// Layers switch to their own targets, and back to the view's.
+		gl->boundLayer = -1;
+		if (gl->nlayers > 0) {
+			glGetIntegerv(GL_FRAMEBUFFER_BINDING, &gl->viewFramebuffer);
+			glGetIntegerv(GL_VIEWPORT, gl->viewViewport);
+		}
+#endif
+
 #if NANOVG_GL_USE_UNIFORMBUFFER
 		glBindBuffer(GL_UNIFORM_BUFFER, gl->fragBuf);
 #endif
 
 		for (i = 0; i < gl->ncalls; i++) {
 			GLNVGcall* call = &gl->calls[i];
+#ifdef GLNVG_LAYERS
+			if (call->type == GLNVG_BEGIN_LAYER) {
+				glnvg__beginLayer(gl, call->image);
+				continue;
+			}
+			if (call->type == GLNVG_END_LAYER) {
+				glnvg__bindLayer(gl, gl->layers[call->image].parent);
+				continue;
+			}
+#endif
+			glnvg__setClip(gl, call);
 			glnvg__blendFuncSeparate(gl,&call->blendFunc);
 			if (call->type == GLNVG_FILL)
 				glnvg__fill(gl, call);
@@ -1248,6 +1884,12 @@ static void glnvg__renderFlush(void* uptr)
 				glnvg__triangles(gl, call);
 		}
 
+#ifdef GLNVG_LAYERS
+		// Layers which were not ended are dropped.
+		if (gl->boundLayer >= 0)
+			glnvg__bindLayer(gl, -1);
+#endif
+
 		glDisableVertexAttribArray(0);
 		glDisableVertexAttribArray(1);
 #if defined NANOVG_GL3
@@ -1256,7 +1898,15 @@ static void glnvg__renderFlush(void* uptr)
 		glDisable(GL_CULL_FACE);
 			glBindBuffer(GL_ARRAY_BUFFER, 0);
 		glUseProgram(0);
+		glActiveTexture(GL_TEXTURE0 + GLNVG_CLIP_TEXTURE_UNIT);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glActiveTexture(GL_TEXTURE0);
 		glnvg__bindTexture(gl, 0);
+
+#ifdef GLNVG_FENCES
+		if (gl->fences)
+			frame->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+#endif
 	}
 
 	// Reset calls
@@ -1264,6 +1914,20 @@ static void glnvg__renderFlush(void* uptr)
 	gl->npaths = 0;
 	gl->ncalls = 0;
 	gl->nuniforms = 0;
+	gl->nclips = 0;
+	gl->clipQuadOffset = -1;
+
+#ifdef GLNVG_LAYERS
+	// Layer targets are kept for the next frames, unless they stay unused.
+	for (i = 0; i < gl->nlayerTargets; i++) {
+		GLNVGlayerTarget* target = &gl->layerTargets[i];
+		target->inUse = 0;
+		if (target->fbo != 0 && ++target->idleFrames > GLNVG_LAYER_IDLE_FRAMES)
+			glnvg__deleteLayerTarget(gl, target);
+	}
+#endif
+	gl->nlayers = 0;
+	gl->currentLayer = -1;
 }
 
 static int glnvg__maxVertCount(const NVGpath* paths, int npaths)
@@ -1279,14 +1943,10 @@ static int glnvg__maxVertCount(const NVGpath* paths, int npaths)
 static GLNVGcall* glnvg__allocCall(GLNVGcontext* gl)
 {
 	GLNVGcall* ret = NULL;
-	if (gl->ncalls+1 > gl->ccalls) {
-		GLNVGcall* calls;
-		int ccalls = glnvg__maxi(gl->ncalls+1, 128) + gl->ccalls/2; // 1.5x Overallocate
-		calls = (GLNVGcall*)realloc(gl->calls, sizeof(GLNVGcall) * ccalls);
-		if (calls == NULL) return NULL;
-		gl->calls = calls;
-		gl->ccalls = ccalls;
-	}
+	GLNVGcall* calls = (GLNVGcall*)nvgArenaReserve(gl->arena, gl->calls, &gl->ccalls, &gl->gcalls,
+												   glnvg__maxi(gl->ncalls+1, 128), gl->ncalls, sizeof(GLNVGcall));
+	if (calls == NULL) return NULL;
+	gl->calls = calls;
 	ret = &gl->calls[gl->ncalls++];
 	memset(ret, 0, sizeof(GLNVGcall));
 	return ret;
@@ -1295,30 +1955,34 @@ static GLNVGcall* glnvg__allocCall(GLNVGcontext* gl)
 static int glnvg__allocPaths(GLNVGcontext* gl, int n)
 {
 	int ret = 0;
-	if (gl->npaths+n > gl->cpaths) {
-		GLNVGpath* paths;
-		int cpaths = glnvg__maxi(gl->npaths + n, 128) + gl->cpaths/2; // 1.5x Overallocate
-		paths = (GLNVGpath*)realloc(gl->paths, sizeof(GLNVGpath) * cpaths);
-		if (paths == NULL) return -1;
-		gl->paths = paths;
-		gl->cpaths = cpaths;
-	}
+	GLNVGpath* paths = (GLNVGpath*)nvgArenaReserve(gl->arena, gl->paths, &gl->cpaths, &gl->gpaths,
+												   glnvg__maxi(gl->npaths + n, 128), gl->npaths, sizeof(GLNVGpath));
+	if (paths == NULL) return -1;
+	gl->paths = paths;
 	ret = gl->npaths;
 	gl->npaths += n;
 	return ret;
 }
 
+static int glnvg__allocClip(GLNVGcontext* gl)
+{
+	int ret = 0;
+	GLNVGclip* clips = (GLNVGclip*)nvgArenaReserve(gl->arena, gl->clips, &gl->cclips, &gl->gclips,
+												   glnvg__maxi(gl->nclips + 1, 16), gl->nclips, sizeof(GLNVGclip));
+	if (clips == NULL) return -1;
+	gl->clips = clips;
+	ret = gl->nclips++;
+	memset(&gl->clips[ret], 0, sizeof(GLNVGclip));
+	return ret;
+}
+
 static int glnvg__allocVerts(GLNVGcontext* gl, int n)
 {
 	int ret = 0;
-	if (gl->nverts+n > gl->cverts) {
-		NVGvertex* verts;
-		int cverts = glnvg__maxi(gl->nverts + n, 4096) + gl->cverts/2; // 1.5x Overallocate
-		verts = (NVGvertex*)realloc(gl->verts, sizeof(NVGvertex) * cverts);
-		if (verts == NULL) return -1;
-		gl->verts = verts;
-		gl->cverts = cverts;
-	}
+	NVGvertex* verts = (NVGvertex*)nvgArenaReserve(gl->arena, gl->verts, &gl->cverts, &gl->gverts,
+												   glnvg__maxi(gl->nverts + n, 4096), gl->nverts, sizeof(NVGvertex));
+	if (verts == NULL) return -1;
+	gl->verts = verts;
 	ret = gl->nverts;
 	gl->nverts += n;
 	return ret;
@@ -1327,14 +1991,10 @@ static int glnvg__allocVerts(GLNVGcontext* gl, int n)
 static int glnvg__allocFragUniforms(GLNVGcontext* gl, int n)
 {
 	int ret = 0, structSize = gl->fragSize;
-	if (gl->nuniforms+n > gl->cuniforms) {
-		unsigned char* uniforms;
-		int cuniforms = glnvg__maxi(gl->nuniforms+n, 128) + gl->cuniforms/2; // 1.5x Overallocate
-		uniforms = (unsigned char*)realloc(gl->uniforms, structSize * cuniforms);
-		if (uniforms == NULL) return -1;
-		gl->uniforms = uniforms;
-		gl->cuniforms = cuniforms;
-	}
+	unsigned char* uniforms = (unsigned char*)nvgArenaReserve(gl->arena, gl->uniforms, &gl->cuniforms, &gl->guniforms,
+															  glnvg__maxi(gl->nuniforms+n, 128), gl->nuniforms, structSize);
+	if (uniforms == NULL) return -1;
+	gl->uniforms = uniforms;
 	ret = gl->nuniforms * structSize;
 	gl->nuniforms += n;
 	return ret;
@@ -1370,6 +2030,7 @@ static void glnvg__renderFill(void* uptr, NVGpaint* paint, NVGcompositeOperation
 	if (call->pathOffset == -1) goto error;
 	call->pathCount = npaths;
 	call->image = paint->image;
+	call->clip = scissor->clip;
 	call->blendFunc = glnvg__blendCompositeOperation(compositeOperation);
 
 	if (npaths == 1 && paths[0].convex)
@@ -1449,6 +2110,7 @@ static void glnvg__renderStroke(void* uptr, NVGpaint* paint, NVGcompositeOperati
 	if (call->pathOffset == -1) goto error;
 	call->pathCount = npaths;
 	call->image = paint->image;
+	call->clip = scissor->clip;
 	call->blendFunc = glnvg__blendCompositeOperation(compositeOperation);
 
 	// Allocate vertices for all the paths.
@@ -1502,6 +2164,7 @@ static void glnvg__renderTriangles(void* uptr, NVGpaint* paint, NVGcompositeOper
 
 	call->type = GLNVG_TRIANGLES;
 	call->image = paint->image;
+	call->clip = scissor->clip;
 	call->blendFunc = glnvg__blendCompositeOperation(compositeOperation);
 
 	// Allocate vertices for all the paths.
@@ -1526,6 +2189,183 @@ error:
 	if (gl->ncalls > 0) gl->ncalls--;
 }
 
+#ifdef GLNVG_LAYERS
+static int glnvg__allocLayer(GLNVGcontext* gl)
+{
+	GLNVGlayer* layers = (GLNVGlayer*)nvgArenaReserve(gl->arena, gl->layers, &gl->clayers, &gl->glayers,
+													  glnvg__maxi(gl->nlayers + 1, 16), gl->nlayers, sizeof(GLNVGlayer));
+	if (layers == NULL) return -1;
+	gl->layers = layers;
+	return gl->nlayers++;
+}
+
+static int glnvg__renderBeginLayer(void* uptr, const float* bounds)
+{
+	GLNVGcontext* gl = (GLNVGcontext*)uptr;
+	GLNVGlayer* layer;
+	GLNVGcall* call;
+	float ratio = gl->devicePixelRatio;
+	int x0, y0, x1, y1, target, id;
+
+	// Whole pixels of the bounds within the view.
+	x0 = glnvg__maxi((int)floorf(bounds[0] * ratio), 0);
+	y0 = glnvg__maxi((int)floorf(bounds[1] * ratio), 0);
+	x1 = glnvg__mini((int)ceilf(bounds[2] * ratio), (int)(gl->view[0] * ratio + 0.5f));
+	y1 = glnvg__mini((int)ceilf(bounds[3] * ratio), (int)(gl->view[1] * ratio + 0.5f));
+	if (x1 <= x0 || y1 <= y0) return -1;
+
+	target = glnvg__acquireLayerTarget(gl, x1 - x0, y1 - y0);
+	if (target == -1) return -1;
+	id = glnvg__allocLayer(gl);
+	call = id != -1 ? glnvg__allocCall(gl) : NULL;
+	if (call == NULL) {
+		if (id != -1) gl->nlayers--;
+		gl->layerTargets[target].inUse = 0;
+		return -1;
+	}
+
+	layer = &gl->layers[id];
+	layer->parent = gl->currentLayer;
+	layer->target = target;
+	layer->x = x0;
+	layer->y = y0;
+	layer->width = x1 - x0;
+	layer->height = y1 - y0;
+	gl->currentLayer = id;
+
+	call->type = GLNVG_BEGIN_LAYER;
+	call->image = id;
+	call->clip = -1;
+	return id;
+}
+
+static void glnvg__renderTriangles(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor,
+								   const NVGvertex* verts, int nverts, float fringe);
+
+static void glnvg__renderEndLayer(void* uptr, int id, float alpha, NVGcompositeOperationState compositeOperation, NVGscissor* scissor)
+{
+	GLNVGcontext* gl = (GLNVGcontext*)uptr;
+	GLNVGlayer* layer = &gl->layers[id];
+	GLNVGlayerTarget* target = &gl->layerTargets[layer->target];
+	GLNVGcall* call;
+	NVGvertex verts[6];
+	NVGpaint paint;
+	float ratio = gl->devicePixelRatio;
+	float x0 = layer->x / ratio, y0 = layer->y / ratio;
+	float x1 = (layer->x + layer->width) / ratio, y1 = (layer->y + layer->height) / ratio;
+	float u1 = (float)layer->width / target->width, v1 = 1.0f - (float)layer->height / target->height;
+
+	// The target is free for the next layers of the frame, which are drawn after this one is composited.
+	target->inUse = 0;
+	gl->currentLayer = layer->parent;
+
+	call = glnvg__allocCall(gl);
+	if (call == NULL) return;
+	call->type = GLNVG_END_LAYER;
+	call->image = id;
+	call->clip = -1;
+
+	memset(&paint, 0, sizeof(paint));
+	nvgTransformIdentity(paint.xform);
+	paint.innerColor = paint.outerColor = nvgRGBAf(1.0f, 1.0f, 1.0f, alpha);
+	paint.image = target->image;
+
+	// The layer is at the top of the target, whose rows are bottom up.
+	glnvg__vset(&verts[0], x0, y0, 0.0f, 1.0f);
+	glnvg__vset(&verts[1], x1, y1, u1, v1);
+	glnvg__vset(&verts[2], x1, y0, u1, 1.0f);
+	glnvg__vset(&verts[3], x0, y0, 0.0f, 1.0f);
+	glnvg__vset(&verts[4], x0, y1, 0.0f, v1);
+	glnvg__vset(&verts[5], x1, y1, u1, v1);
+	glnvg__renderTriangles(gl, &paint, compositeOperation, scissor, verts, 6, 1.0f);
+}
+#endif
+
+static int glnvg__renderClip(void* uptr, int parent, int op, NVGpaint* paint, const float* bounds,
+							 const NVGpath* paths, int npaths)
+{
+	GLNVGcontext* gl = (GLNVGcontext*)uptr;
+	GLNVGclip* clip;
+	GLNVGtexture* tex = NULL;
+	GLNVGfragUniforms* frag;
+	NVGvertex* quad;
+	float invxform[6];
+	int i, id, maxverts, offset;
+
+	// The quad covering the view and the uniforms of the stencil passes are shared by all clips.
+	if (gl->clipQuadOffset < 0) {
+		offset = glnvg__allocVerts(gl, 4);
+		if (offset == -1) return -1;
+		gl->clipUniformOffset = glnvg__allocFragUniforms(gl, 1);
+		if (gl->clipUniformOffset == -1) return -1;
+		quad = &gl->verts[offset];
+		glnvg__vset(&quad[0], gl->view[0], gl->view[1], 0.5f, 1.0f);
+		glnvg__vset(&quad[1], gl->view[0], 0.0f, 0.5f, 1.0f);
+		glnvg__vset(&quad[2], 0.0f, gl->view[1], 0.5f, 1.0f);
+		glnvg__vset(&quad[3], 0.0f, 0.0f, 0.5f, 1.0f);
+		frag = nvg__fragUniformPtr(gl, gl->clipUniformOffset);
+		memset(frag, 0, sizeof(*frag));
+		frag->strokeThr = -1.0f;
+		frag->type = NSVG_SHADER_SIMPLE;
+		gl->clipQuadOffset = offset;
+	}
+
+	id = glnvg__allocClip(gl);
+	if (id == -1) return -1;
+	clip = &gl->clips[id];
+	clip->parent = parent;
+	clip->op = op;
+	clip->stencil = parent >= 0 ? gl->clips[parent].stencil : -1;
+	clip->mask = parent >= 0 ? gl->clips[parent].mask : -1;
+
+	// The first image clip is sampled by the calls, later ones are drawn as their quad.
+	if (op == NVG_CLIP_IMAGE && clip->mask < 0)
+		tex = glnvg__findTexture(gl, paint->image);
+	if (tex != NULL) {
+		glnvg__imageInverseXform(invxform, paint, tex);
+		glnvg__xformToMat3x4(clip->maskMat, invxform);
+		clip->maskExt[0] = paint->extent[0];
+		clip->maskExt[1] = paint->extent[1];
+		clip->maskType = tex->type == NVG_TEXTURE_ALPHA ? 2 : 1;
+		clip->image = paint->image;
+		clip->mask = id;
+		return id;
+	}
+
+	clip->pathOffset = glnvg__allocPaths(gl, npaths);
+	if (clip->pathOffset == -1) goto error;
+	clip->pathCount = npaths;
+
+	maxverts = 4;
+	for (i = 0; i < npaths; i++)
+		maxverts += paths[i].nfill;
+	offset = glnvg__allocVerts(gl, maxverts);
+	if (offset == -1) goto error;
+
+	for (i = 0; i < npaths; i++) {
+		GLNVGpath* copy = &gl->paths[clip->pathOffset + i];
+		memset(copy, 0, sizeof(GLNVGpath));
+		copy->fillOffset = offset;
+		copy->fillCount = paths[i].nfill;
+		memcpy(&gl->verts[offset], paths[i].fill, sizeof(NVGvertex) * paths[i].nfill);
+		offset += paths[i].nfill;
+	}
+
+	clip->triangleOffset = offset;
+	quad = &gl->verts[offset];
+	glnvg__vset(&quad[0], bounds[2], bounds[3], 0.5f, 1.0f);
+	glnvg__vset(&quad[1], bounds[2], bounds[1], 0.5f, 1.0f);
+	glnvg__vset(&quad[2], bounds[0], bounds[3], 0.5f, 1.0f);
+	glnvg__vset(&quad[3], bounds[0], bounds[1], 0.5f, 1.0f);
+
+	clip->stencil = id;
+	return id;
+
+error:
+	if (gl->nclips > 0) gl->nclips--;
+	return -1;
+}
+
 static void glnvg__renderDelete(void* uptr)
 {
 	GLNVGcontext* gl = (GLNVGcontext*)uptr;
@@ -1534,27 +2374,36 @@ static void glnvg__renderDelete(void* uptr)
 
 	glnvg__deleteShader(&gl->shader);
 
-#if NANOVG_GL3
+	for (i = 0; i < GLNVG_FRAME_BUFFERS; i++) {
+		GLNVGframeBuffers* frame = &gl->frames[i];
+#ifdef GLNVG_FENCES
+		if (frame->fence != NULL)
+			glDeleteSync(frame->fence);
+#endif
 #if NANOVG_GL_USE_UNIFORMBUFFER
-	if (gl->fragBuf != 0)
-		glDeleteBuffers(1, &gl->fragBuf);
+		if (frame->fragBuf != 0)
+			glDeleteBuffers(1, &frame->fragBuf);
 #endif
+		if (frame->vertBuf != 0)
+			glDeleteBuffers(1, &frame->vertBuf);
+	}
+#if NANOVG_GL3
 	if (gl->vertArr != 0)
 		glDeleteVertexArrays(1, &gl->vertArr);
 #endif
-	if (gl->vertBuf != 0)
-		glDeleteBuffers(1, &gl->vertBuf);
+
+#ifdef GLNVG_LAYERS
+	for (i = 0; i < gl->nlayerTargets; i++)
+		glnvg__deleteLayerTarget(gl, &gl->layerTargets[i]);
+#endif
+	free(gl->layerTargets);
 
 	for (i = 0; i < gl->ntextures; i++) {
 		if (gl->textures[i].tex != 0 && (gl->textures[i].flags & NVG_IMAGE_NODELETE) == 0)
 			glDeleteTextures(1, &gl->textures[i].tex);
 	}
 	free(gl->textures);
-
-	free(gl->paths);
-	free(gl->verts);
-	free(gl->uniforms);
-	free(gl->calls);
+	free(gl->converted);
 
 	free(gl);
 }
@@ -1588,15 +2437,25 @@ NVGcontext* nvgCreateGLES3(int flags)
 	params.renderFill = glnvg__renderFill;
 	params.renderStroke = glnvg__renderStroke;
 	params.renderTriangles = glnvg__renderTriangles;
+	params.renderClip = glnvg__renderClip;
+#ifdef GLNVG_LAYERS
+	params.renderBeginLayer = glnvg__renderBeginLayer;
+	params.renderEndLayer = glnvg__renderEndLayer;
+#endif
 	params.renderDelete = glnvg__renderDelete;
 	params.userPtr = gl;
 	params.edgeAntiAlias = flags & NVG_ANTIALIAS ? 1 : 0;
+	params.gradientRamps = 1;
 
 	gl->flags = flags;
+	gl->clipQuadOffset = -1;
+	gl->currentLayer = -1;
 
 	ctx = nvgCreateInternal(&params);
 	if (ctx == NULL) goto error;
 
+	gl->arena = nvgInternalParams(ctx)->frameArena;
+
 	return ctx;
 
 error:
@@ -0,0 +1,290 @@
+//
+//  Copyright (C) 2022 Arthur Benilov <arthur.benilov@gmail.com> and Timothy Schoen <timschoen123@gmail.com>
+//
+// Copyright (c) 2009-2013 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "nanovg_jobs.h"
+
+#ifdef _WIN32
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  include <windows.h>
+typedef HANDLE NVGthread;
+typedef CRITICAL_SECTION NVGmutex;
+typedef CONDITION_VARIABLE NVGcond;
+#else
+#  include <pthread.h>
+typedef pthread_t NVGthread;
+typedef pthread_mutex_t NVGmutex;
+typedef pthread_cond_t NVGcond;
+#endif
+
+#define NVG_JOBS_MAX_THREADS 64
+#define NVG_JOBS_CACHE_LINE 64
+
+// Jobs [next, end) of a thread. next is advanced atomically by the owner and by the threads stealing
+// from it, and may run past end.
+struct NVGjobRange {
+	volatile long next;
+	long end;
+	char pad[NVG_JOBS_CACHE_LINE - sizeof(long)*2];
+};
+typedef struct NVGjobRange NVGjobRange;
+
+struct NVGjobWorker {
+	NVGjobs* jobs;
+	int index;
+	NVGthread thread;
+	int started;
+};
+typedef struct NVGjobWorker NVGjobWorker;
+
+struct NVGjobs {
+	int nthreads;
+	NVGjobRange ranges[NVG_JOBS_MAX_THREADS];
+	NVGjobWorker workers[NVG_JOBS_MAX_THREADS];
+
+	// Current batch, set under the mutex before the threads are woken.
+	NVGjobFunc func;
+	void* userPtr;
+
+	NVGmutex mutex;
+	NVGcond wake;		// Signalled when a batch starts, or the threads should quit.
+	NVGcond done;		// Signalled when the last thread has finished the batch.
+	unsigned int batch;	// Bumped for every batch.
+	int finished;		// Threads done with the current batch.
+	int quit;
+};
+
+#ifdef _WIN32
+
+static long nvg__fetchAdd(volatile long* value, long n) { return InterlockedExchangeAdd(value, n); }
+static long nvg__load(volatile long* value) { return *value; }
+
+static void nvg__initMutex(NVGmutex* mutex) { InitializeCriticalSection(mutex); }
+static void nvg__deleteMutex(NVGmutex* mutex) { DeleteCriticalSection(mutex); }
+static void nvg__lock(NVGmutex* mutex) { EnterCriticalSection(mutex); }
+static void nvg__unlock(NVGmutex* mutex) { LeaveCriticalSection(mutex); }
+static void nvg__initCond(NVGcond* cond) { InitializeConditionVariable(cond); }
+static void nvg__deleteCond(NVGcond* cond) { (void)cond; }
+static void nvg__wait(NVGcond* cond, NVGmutex* mutex) { SleepConditionVariableCS(cond, mutex, INFINITE); }
+static void nvg__signal(NVGcond* cond) { WakeConditionVariable(cond); }
+static void nvg__broadcast(NVGcond* cond) { WakeAllConditionVariable(cond); }
+
+static DWORD WINAPI nvg__jobThread(LPVOID arg);
+
+static int nvg__startThread(NVGjobWorker* worker)
+{
+	worker->thread = CreateThread(NULL, 0, nvg__jobThread, worker, 0, NULL);
+	return worker->thread != NULL;
+}
+
+static void nvg__joinThread(NVGjobWorker* worker)
+{
+	WaitForSingleObject(worker->thread, INFINITE);
+	CloseHandle(worker->thread);
+}
+
+#else
+
+static long nvg__fetchAdd(volatile long* value, long n) { return __atomic_fetch_add(value, n, __ATOMIC_ACQ_REL); }
+static long nvg__load(volatile long* value) { return __atomic_load_n(value, __ATOMIC_ACQUIRE); }
+
+static void nvg__initMutex(NVGmutex* mutex) { pthread_mutex_init(mutex, NULL); }
+static void nvg__deleteMutex(NVGmutex* mutex) { pthread_mutex_destroy(mutex); }
+static void nvg__lock(NVGmutex* mutex) { pthread_mutex_lock(mutex); }
+static void nvg__unlock(NVGmutex* mutex) { pthread_mutex_unlock(mutex); }
+static void nvg__initCond(NVGcond* cond) { pthread_cond_init(cond, NULL); }
+static void nvg__deleteCond(NVGcond* cond) { pthread_cond_destroy(cond); }
+static void nvg__wait(NVGcond* cond, NVGmutex* mutex) { pthread_cond_wait(cond, mutex); }
+static void nvg__signal(NVGcond* cond) { pthread_cond_signal(cond); }
+static void nvg__broadcast(NVGcond* cond) { pthread_cond_broadcast(cond); }
+
+static void* nvg__jobThread(void* arg);
+
+static int nvg__startThread(NVGjobWorker* worker)
+{
+	return pthread_create(&worker->thread, NULL, nvg__jobThread, worker) == 0;
+}
+
+static void nvg__joinThread(NVGjobWorker* worker)
+{
+	pthread_join(worker->thread, NULL);
+}
+
+#endif
+
+// Claims the next job of a range, or returns -1 if it is empty.
+static long nvg__claimJob(NVGjobRange* range)
+{
+	long index;
+	if (nvg__load(&range->next) >= range->end) return -1;
+	index = nvg__fetchAdd(&range->next, 1);
+	return index < range->end ? index : -1;
+}
+
+// Runs jobs of the thread's own range, then steals from the others until all ranges are empty.
+static void nvg__runBatch(NVGjobs* jobs, int worker)
+{
+	int i;
+	long index;
+
+	for (;;) {
+		index = nvg__claimJob(&jobs->ranges[worker]);
+		for (i = 1; index < 0 && i < jobs->nthreads; i++)
+			index = nvg__claimJob(&jobs->ranges[(worker + i) % jobs->nthreads]);
+		if (index < 0)
+			return;
+		jobs->func(jobs->userPtr, worker, (int)index);
+	}
+}
+
+static void nvg__workerLoop(NVGjobWorker* worker)
+{
+	NVGjobs* jobs = worker->jobs;
+	unsigned int batch = 0;
+
+	nvg__lock(&jobs->mutex);
+	for (;;) {
+		while (!jobs->quit && jobs->batch == batch)
+			nvg__wait(&jobs->wake, &jobs->mutex);
+		if (jobs->quit)
+			break;
+		batch = jobs->batch;
+		nvg__unlock(&jobs->mutex);
+
+		nvg__runBatch(jobs, worker->index);
+
+		nvg__lock(&jobs->mutex);
+		if (++jobs->finished == jobs->nthreads-1)
+			nvg__signal(&jobs->done);
+	}
+	nvg__unlock(&jobs->mutex);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI nvg__jobThread(LPVOID arg)
+{
+	nvg__workerLoop((NVGjobWorker*)arg);
+	return 0;
+}
+#else
+static void* nvg__jobThread(void* arg)
+{
+	nvg__workerLoop((NVGjobWorker*)arg);
+	return NULL;
+}
+#endif
+
+NVGjobs* nvgCreateJobs(int threads)
+{
+	NVGjobs* jobs;
+	int i;
+
+	if (threads < 2) return NULL;
+	if (threads > NVG_JOBS_MAX_THREADS) threads = NVG_JOBS_MAX_THREADS;
+
+	jobs = (NVGjobs*)malloc(sizeof(NVGjobs));
+	if (jobs == NULL) return NULL;
+	memset(jobs, 0, sizeof(NVGjobs));
+	jobs->nthreads = threads;
+
+	nvg__initMutex(&jobs->mutex);
+	nvg__initCond(&jobs->wake);
+	nvg__initCond(&jobs->done);
+
+	// Thread 0 is the caller of nvgRunJobs().
+	for (i = 1; i < threads; i++) {
+		NVGjobWorker* worker = &jobs->workers[i];
+		worker->jobs = jobs;
+		worker->index = i;
+		if (!nvg__startThread(worker)) {
+			nvgDeleteJobs(jobs);
+			return NULL;
+		}
+		worker->started = 1;
+	}
+
+	return jobs;
+}
+
+void nvgDeleteJobs(NVGjobs* jobs)
+{
+	int i;
+	if (jobs == NULL) return;
+
+	nvg__lock(&jobs->mutex);
+	jobs->quit = 1;
+	nvg__broadcast(&jobs->wake);
+	nvg__unlock(&jobs->mutex);
+
+	for (i = 1; i < jobs->nthreads; i++) {
+		if (jobs->workers[i].started)
+			nvg__joinThread(&jobs->workers[i]);
+	}
+
+	nvg__deleteCond(&jobs->done);
+	nvg__deleteCond(&jobs->wake);
+	nvg__deleteMutex(&jobs->mutex);
+	free(jobs);
+}
+
+int nvgJobThreads(NVGjobs* jobs)
+{
+	return jobs != NULL ? jobs->nthreads : 1;
+}
+
+void nvgRunJobs(NVGjobs* jobs, NVGjobFunc func, void* userPtr, int count)
+{
+	long first = 0;
+	int i;
+
+	if (count <= 0) return;
+
+	// Not worth waking the threads for a single job.
+	if (jobs == NULL || count == 1) {
+		for (i = 0; i < count; i++)
+			func(userPtr, 0, i);
+		return;
+	}
+
+	nvg__lock(&jobs->mutex);
+	jobs->func = func;
+	jobs->userPtr = userPtr;
+	for (i = 0; i < jobs->nthreads; i++) {
+		long n = (count - first) / (jobs->nthreads - i);
+		jobs->ranges[i].next = first;
+		jobs->ranges[i].end = first + n;
+		first += n;
+	}
+	jobs->finished = 0;
+	jobs->batch++;
+	nvg__broadcast(&jobs->wake);
+	nvg__unlock(&jobs->mutex);
+
+	nvg__runBatch(jobs, 0);
+
+	// All jobs are claimed, wait for the ones still running on the other threads.
+	nvg__lock(&jobs->mutex);
+	while (jobs->finished < jobs->nthreads-1)
+		nvg__wait(&jobs->done, &jobs->mutex);
+	nvg__unlock(&jobs->mutex);
+}
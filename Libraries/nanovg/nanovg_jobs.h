@@ -0,0 +1,56 @@
+//
+//  Copyright (C) 2022 Arthur Benilov <arthur.benilov@gmail.com> and Timothy Schoen <timschoen123@gmail.com>
+//
+// Copyright (c) 2009-2013 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+#ifndef NANOVG_JOBS_H
+#define NANOVG_JOBS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A small pool of threads running batches of independent jobs, used to tessellate paths in parallel.
+// The jobs of a batch are split into a range per thread. Each thread takes jobs from the front of its
+// own range, and once that is empty takes them from the ranges of the others, so that threads which
+// got cheap jobs help those which got expensive ones.
+
+typedef struct NVGjobs NVGjobs;
+
+// Runs job index on the thread numbered worker, in [0, nvgJobThreads()). Worker 0 is the thread
+// calling nvgRunJobs().
+typedef void (*NVGjobFunc)(void* userPtr, int worker, int index);
+
+// Creates a pool of threads-1 threads, the thread calling nvgRunJobs() being the last one.
+// Returns NULL if threads is less than 2, or if the threads could not be started.
+NVGjobs* nvgCreateJobs(int threads);
+
+// Stops and joins the threads.
+void nvgDeleteJobs(NVGjobs* jobs);
+
+// Returns the number of threads running jobs, including the calling one.
+int nvgJobThreads(NVGjobs* jobs);
+
+// Runs func for every index in [0, count) and returns once all of them are done.
+// Must not be called from several threads at once, nor from a job.
+void nvgRunJobs(NVGjobs* jobs, NVGjobFunc func, void* userPtr, int count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NANOVG_JOBS_H
@@ -595,7 +595,7 @@ void mnvgReadPixels(NVGcontext* ctx, int image, int x, int y, int width,
   if (tex == nil) return;
 
   NSUInteger bytesPerRow;
-  if (tex->type == NVG_TEXTURE_RGBA) {
+  if (tex->type != NVG_TEXTURE_ALPHA) {
     bytesPerRow = tex->tex.width * 4;
   } else {
     bytesPerRow = tex->tex.width;
@@ -831,7 +831,7 @@ enum MNVGTarget mnvgTarget() {
     }
     frag->type = MNVG_SHADER_FILLIMG;
 
-    if (tex->type == NVG_TEXTURE_RGBA)
+    if (tex->type != NVG_TEXTURE_ALPHA)
       frag->texType = (tex->flags & NVG_IMAGE_PREMULTIPLIED) ? 0 : 1;
     else
       frag->texType = 2;
@@ -1184,6 +1184,8 @@ enum MNVGTarget mnvgTarget() {
   MTLPixelFormat pixelFormat = MTLPixelFormatRGBA8Unorm;
   if (type == NVG_TEXTURE_ALPHA) {
     pixelFormat = MTLPixelFormatR8Unorm;
+  } else if (type == NVG_TEXTURE_BGRA) {
+    pixelFormat = MTLPixelFormatBGRA8Unorm;
   }
 
   tex->type = type;
@@ -1204,7 +1206,7 @@ enum MNVGTarget mnvgTarget() {
 
   if (data != NULL) {
     NSUInteger bytesPerRow;
-    if (tex->type == NVG_TEXTURE_RGBA) {
+    if (tex->type != NVG_TEXTURE_ALPHA) {
       bytesPerRow = width * 4;
     } else {
       bytesPerRow = width;
@@ -1655,7 +1657,7 @@ error:
 
   unsigned char* bytes;
   NSUInteger bytesPerRow;
-  if (tex->type == NVG_TEXTURE_RGBA) {
+  if (tex->type != NVG_TEXTURE_ALPHA) {
     bytesPerRow = tex->tex.width * 4;
     bytes = (unsigned char*)data + y * bytesPerRow + x * 4;
   } else {
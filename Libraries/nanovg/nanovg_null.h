@@ -0,0 +1,437 @@
+//
+//  Copyright (C) 2022 Arthur Benilov <arthur.benilov@gmail.com> and Timothy Schoen <timschoen123@gmail.com>
+//
+// Copyright (c) 2009-2013 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+#ifndef NANOVG_NULL_H
+#define NANOVG_NULL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Headless backend which draws nothing. It counts the draw calls and vertices produced by the
+// frontend, and can record the calls or checksum everything that would have reached the GPU.
+// Useful for benchmarking and regression testing tessellation and text layout without a GPU.
+
+enum NVGnullFlags {
+	// Same as NVG_ANTIALIAS, enables the geometry based anti-aliasing fringes.
+	NVG_NULL_ANTIALIAS	= 1<<0,
+	// Keep a copy of every draw call of the frame, see NVGnullStats::calls.
+	NVG_NULL_RECORD		= 1<<1,
+	// Hash vertices, paints, scissors and texture uploads into NVGnullStats::checksum.
+	NVG_NULL_CHECKSUM	= 1<<2,
+};
+
+enum NVGnullCallType {
+	NVG_NULL_FILL,
+	NVG_NULL_STROKE,
+	NVG_NULL_TRIANGLES,
+};
+
+struct NVGnullCall {
+	int type;
+	NVGpaint paint;
+	NVGcompositeOperationState compositeOperation;
+	NVGscissor scissor;
+	float fringe;
+	float strokeWidth;
+	float bounds[4];
+	int npaths;
+	int nverts;
+};
+typedef struct NVGnullCall NVGnullCall;
+
+struct NVGnullStats {
+	int frames;			// Frames flushed so far.
+	int fills;
+	int strokes;
+	int triangles;
+	int paths;
+	int fillVerts;
+	int strokeVerts;
+	int triangleVerts;
+	int textureUploads;
+	int textureBytes;
+	unsigned long long checksum;	// Zero unless created with NVG_NULL_CHECKSUM.
+	const NVGnullCall* calls;		// NULL unless created with NVG_NULL_RECORD, valid until the next nvgBeginFrame.
+	int ncalls;
+};
+typedef struct NVGnullStats NVGnullStats;
+
+NVGcontext* nvgCreateNull(int flags);
+void nvgDeleteNull(NVGcontext* ctx);
+
+// Returns the counters of the last flushed frame.
+const NVGnullStats* nvgNullFrameStats(NVGcontext* ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NANOVG_NULL_H */
+
+#ifdef NANOVG_NULL_IMPLEMENTATION
+
+#include <stdlib.h>
+#include <string.h>
+#include "nanovg.h"
+
+struct NULLNVGtexture {
+	int id;
+	int type;
+	int width, height;
+	int flags;
+};
+typedef struct NULLNVGtexture NULLNVGtexture;
+
+struct NULLNVGcontext {
+	int flags;
+	NVGarena* arena;
+
+	NULLNVGtexture* textures;
+	int ntextures;
+	int ctextures;
+	int textureId;
+
+	// Per frame buffers
+	NVGnullCall* calls;
+	int ccalls;
+	int ncalls;
+	int gcalls;
+
+	NVGnullStats frame;
+	NVGnullStats last;
+};
+typedef struct NULLNVGcontext NULLNVGcontext;
+
+static int nullnvg__maxi(int a, int b) { return a > b ? a : b; }
+
+// FNV-1a
+static void nullnvg__hash(NULLNVGcontext* nl, const void* data, size_t size)
+{
+	const unsigned char* p = (const unsigned char*)data;
+	unsigned long long h = nl->frame.checksum;
+	size_t i;
+	for (i = 0; i < size; i++) {
+		h ^= p[i];
+		h *= 1099511628211ULL;
+	}
+	nl->frame.checksum = h;
+}
+
+static void nullnvg__resetFrame(NULLNVGcontext* nl)
+{
+	int frames = nl->frame.frames;
+	memset(&nl->frame, 0, sizeof(nl->frame));
+	nl->frame.frames = frames;
+	nl->frame.checksum = 14695981039346656037ULL;
+	nl->ncalls = 0;
+}
+
+static NULLNVGtexture* nullnvg__allocTexture(NULLNVGcontext* nl)
+{
+	NULLNVGtexture* tex = NULL;
+	int i;
+
+	for (i = 0; i < nl->ntextures; i++) {
+		if (nl->textures[i].id == 0) {
+			tex = &nl->textures[i];
+			break;
+		}
+	}
+	if (tex == NULL) {
+		if (nl->ntextures+1 > nl->ctextures) {
+			NULLNVGtexture* textures;
+			int ctextures = nullnvg__maxi(nl->ntextures+1, 4) +  nl->ctextures/2; // 1.5x Overallocate
+			textures = (NULLNVGtexture*)realloc(nl->textures, sizeof(NULLNVGtexture)*ctextures);
+			if (textures == NULL) return NULL;
+			nl->textures = textures;
+			nl->ctextures = ctextures;
+		}
+		tex = &nl->textures[nl->ntextures++];
+	}
+
+	memset(tex, 0, sizeof(*tex));
+	tex->id = ++nl->textureId;
+
+	return tex;
+}
+
+static NULLNVGtexture* nullnvg__findTexture(NULLNVGcontext* nl, int id)
+{
+	int i;
+	for (i = 0; i < nl->ntextures; i++)
+		if (nl->textures[i].id == id)
+			return &nl->textures[i];
+	return NULL;
+}
+
+static NVGnullCall* nullnvg__allocCall(NULLNVGcontext* nl)
+{
+	NVGnullCall* calls = (NVGnullCall*)nvgArenaReserve(nl->arena, nl->calls, &nl->ccalls, &nl->gcalls,
+													   nullnvg__maxi(nl->ncalls+1, 128), nl->ncalls, sizeof(NVGnullCall));
+	if (calls == NULL) return NULL;
+	nl->calls = calls;
+	return &nl->calls[nl->ncalls++];
+}
+
+static void nullnvg__call(NULLNVGcontext* nl, int type, NVGpaint* paint, NVGcompositeOperationState compositeOperation,
+						  NVGscissor* scissor, float fringe, float strokeWidth, const float* bounds, int npaths, int nverts)
+{
+	NVGnullCall* call;
+
+	if (nl->flags & NVG_NULL_CHECKSUM) {
+		nullnvg__hash(nl, &type, sizeof(type));
+		nullnvg__hash(nl, paint, sizeof(*paint));
+		nullnvg__hash(nl, &compositeOperation, sizeof(compositeOperation));
+		nullnvg__hash(nl, scissor, sizeof(*scissor));
+		nullnvg__hash(nl, &fringe, sizeof(fringe));
+		nullnvg__hash(nl, &strokeWidth, sizeof(strokeWidth));
+	}
+
+	if ((nl->flags & NVG_NULL_RECORD) == 0) return;
+	call = nullnvg__allocCall(nl);
+	if (call == NULL) return;
+
+	memset(call, 0, sizeof(*call));
+	call->type = type;
+	call->paint = *paint;
+	call->compositeOperation = compositeOperation;
+	call->scissor = *scissor;
+	call->fringe = fringe;
+	call->strokeWidth = strokeWidth;
+	if (bounds != NULL)
+		memcpy(call->bounds, bounds, sizeof(call->bounds));
+	call->npaths = npaths;
+	call->nverts = nverts;
+}
+
+static int nullnvg__renderCreate(void* uptr)
+{
+	NULLNVGcontext* nl = (NULLNVGcontext*)uptr;
+	nullnvg__resetFrame(nl);
+	return 1;
+}
+
+static int nullnvg__renderCreateTexture(void* uptr, int type, int w, int h, int imageFlags, const unsigned char* data)
+{
+	NULLNVGcontext* nl = (NULLNVGcontext*)uptr;
+	NULLNVGtexture* tex = nullnvg__allocTexture(nl);
+
+	if (tex == NULL) return 0;
+
+	tex->type = type;
+	tex->width = w;
+	tex->height = h;
+	tex->flags = imageFlags;
+
+	if (data != NULL) {
+		int bytes = w * h * (type == NVG_TEXTURE_ALPHA ? 1 : 4);
+		nl->frame.textureUploads++;
+		nl->frame.textureBytes += bytes;
+		if (nl->flags & NVG_NULL_CHECKSUM)
+			nullnvg__hash(nl, data, (size_t)bytes);
+	}
+
+	return tex->id;
+}
+
+static int nullnvg__renderDeleteTexture(void* uptr, int image)
+{
+	NULLNVGcontext* nl = (NULLNVGcontext*)uptr;
+	NULLNVGtexture* tex = nullnvg__findTexture(nl, image);
+	if (tex == NULL) return 0;
+	memset(tex, 0, sizeof(*tex));
+	return 1;
+}
+
+static int nullnvg__renderUpdateTexture(void* uptr, int image, int x, int y, int w, int h, const unsigned char* data)
+{
+	NULLNVGcontext* nl = (NULLNVGcontext*)uptr;
+	NULLNVGtexture* tex = nullnvg__findTexture(nl, image);
+	int bpp, row;
+
+	if (tex == NULL) return 0;
+	bpp = tex->type == NVG_TEXTURE_ALPHA ? 1 : 4;
+
+	nl->frame.textureUploads++;
+	nl->frame.textureBytes += w * h * bpp;
+
+	// Data points at the whole image, only the updated rows are hashed.
+	if (nl->flags & NVG_NULL_CHECKSUM) {
+		for (row = y; row < y + h; row++)
+			nullnvg__hash(nl, data + ((size_t)row * tex->width + x) * bpp, (size_t)w * bpp);
+	}
+
+	return 1;
+}
+
+static int nullnvg__renderGetTextureSize(void* uptr, int image, int* w, int* h)
+{
+	NULLNVGcontext* nl = (NULLNVGcontext*)uptr;
+	NULLNVGtexture* tex = nullnvg__findTexture(nl, image);
+	if (tex == NULL) return 0;
+	*w = tex->width;
+	*h = tex->height;
+	return 1;
+}
+
+static void nullnvg__renderViewport(void* uptr, float width, float height, float devicePixelRatio)
+{
+	NULLNVGcontext* nl = (NULLNVGcontext*)uptr;
+	NVG_NOTUSED(width);
+	NVG_NOTUSED(height);
+	NVG_NOTUSED(devicePixelRatio);
+	nullnvg__resetFrame(nl);
+}
+
+static void nullnvg__renderCancel(void* uptr)
+{
+	NULLNVGcontext* nl = (NULLNVGcontext*)uptr;
+	nullnvg__resetFrame(nl);
+}
+
+static void nullnvg__renderFlush(void* uptr)
+{
+	NULLNVGcontext* nl = (NULLNVGcontext*)uptr;
+
+	nl->frame.frames++;
+	nl->last = nl->frame;
+	if ((nl->flags & NVG_NULL_CHECKSUM) == 0)
+		nl->last.checksum = 0;
+	nl->last.calls = (nl->flags & NVG_NULL_RECORD) ? nl->calls : NULL;
+	nl->last.ncalls = (nl->flags & NVG_NULL_RECORD) ? nl->ncalls : 0;
+
+	// Recorded calls stay in the arena until the next frame starts.
+	nullnvg__resetFrame(nl);
+}
+
+static void nullnvg__renderFill(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor, float fringe,
+								const float* bounds, const NVGpath* paths, int npaths)
+{
+	NULLNVGcontext* nl = (NULLNVGcontext*)uptr;
+	int i, nverts = 0;
+
+	for (i = 0; i < npaths; i++) {
+		const NVGpath* path = &paths[i];
+		nl->frame.fillVerts += path->nfill + path->nstroke;
+		nverts += path->nfill + path->nstroke;
+		if (nl->flags & NVG_NULL_CHECKSUM) {
+			nullnvg__hash(nl, path->fill, sizeof(NVGvertex) * path->nfill);
+			nullnvg__hash(nl, path->stroke, sizeof(NVGvertex) * path->nstroke);
+		}
+	}
+	nl->frame.fills++;
+	nl->frame.paths += npaths;
+
+	nullnvg__call(nl, NVG_NULL_FILL, paint, compositeOperation, scissor, fringe, 0.0f, bounds, npaths, nverts);
+}
+
+static void nullnvg__renderStroke(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor, float fringe,
+								  float strokeWidth, const NVGpath* paths, int npaths)
+{
+	NULLNVGcontext* nl = (NULLNVGcontext*)uptr;
+	int i, nverts = 0;
+
+	for (i = 0; i < npaths; i++) {
+		const NVGpath* path = &paths[i];
+		nl->frame.strokeVerts += path->nstroke;
+		nverts += path->nstroke;
+		if (nl->flags & NVG_NULL_CHECKSUM)
+			nullnvg__hash(nl, path->stroke, sizeof(NVGvertex) * path->nstroke);
+	}
+	nl->frame.strokes++;
+	nl->frame.paths += npaths;
+
+	nullnvg__call(nl, NVG_NULL_STROKE, paint, compositeOperation, scissor, fringe, strokeWidth, NULL, npaths, nverts);
+}
+
+static void nullnvg__renderTriangles(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor,
+									 const NVGvertex* verts, int nverts, float fringe)
+{
+	NULLNVGcontext* nl = (NULLNVGcontext*)uptr;
+
+	nl->frame.triangles++;
+	nl->frame.triangleVerts += nverts;
+	if (nl->flags & NVG_NULL_CHECKSUM)
+		nullnvg__hash(nl, verts, sizeof(NVGvertex) * nverts);
+
+	nullnvg__call(nl, NVG_NULL_TRIANGLES, paint, compositeOperation, scissor, fringe, 0.0f, NULL, 0, nverts);
+}
+
+static void nullnvg__renderDelete(void* uptr)
+{
+	NULLNVGcontext* nl = (NULLNVGcontext*)uptr;
+	if (nl == NULL) return;
+
+	// The per frame buffers live in the frame arena owned by the context.
+	free(nl->textures);
+	free(nl);
+}
+
+NVGcontext* nvgCreateNull(int flags)
+{
+	NVGparams params;
+	NVGcontext* ctx = NULL;
+	NULLNVGcontext* nl = (NULLNVGcontext*)malloc(sizeof(NULLNVGcontext));
+	if (nl == NULL) goto error;
+	memset(nl, 0, sizeof(NULLNVGcontext));
+
+	memset(&params, 0, sizeof(params));
+	params.renderCreate = nullnvg__renderCreate;
+	params.renderCreateTexture = nullnvg__renderCreateTexture;
+	params.renderDeleteTexture = nullnvg__renderDeleteTexture;
+	params.renderUpdateTexture = nullnvg__renderUpdateTexture;
+	params.renderGetTextureSize = nullnvg__renderGetTextureSize;
+	params.renderViewport = nullnvg__renderViewport;
+	params.renderCancel = nullnvg__renderCancel;
+	params.renderFlush = nullnvg__renderFlush;
+	params.renderFill = nullnvg__renderFill;
+	params.renderStroke = nullnvg__renderStroke;
+	params.renderTriangles = nullnvg__renderTriangles;
+	params.renderDelete = nullnvg__renderDelete;
+	params.userPtr = nl;
+	params.edgeAntiAlias = flags & NVG_NULL_ANTIALIAS ? 1 : 0;
+
+	nl->flags = flags;
+
+	ctx = nvgCreateInternal(&params);
+	if (ctx == NULL) goto error;
+
+	nl->arena = nvgInternalParams(ctx)->frameArena;
+
+	return ctx;
+
+error:
+	// 'nl' is freed by nvgDeleteInternal.
+	if (ctx != NULL) nvgDeleteInternal(ctx);
+	return NULL;
+}
+
+void nvgDeleteNull(NVGcontext* ctx)
+{
+	nvgDeleteInternal(ctx);
+}
+
+const NVGnullStats* nvgNullFrameStats(NVGcontext* ctx)
+{
+	NULLNVGcontext* nl = (NULLNVGcontext*)nvgInternalParams(ctx)->userPtr;
+	return &nl->last;
+}
+
+#endif /* NANOVG_NULL_IMPLEMENTATION */
@@ -0,0 +1,751 @@
+//
+//  Copyright (C) 2022 Arthur Benilov <arthur.benilov@gmail.com> and Timothy Schoen <timschoen123@gmail.com>
+//
+// Copyright (c) 2009-2013 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <math.h>
+#include <string.h>
+#include "nanovg_simd.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define NVG_HAVE_SSE2 1
+#  include <emmintrin.h>
+#  if defined(__GNUC__) || defined(__clang__)
+#    define NVG_HAVE_AVX2 1
+#    define NVG_AVX2_TARGET __attribute__((target("avx2")))
+#    include <immintrin.h>
+#  elif defined(_MSC_VER)
+#    define NVG_HAVE_AVX2 1
+#    define NVG_AVX2_TARGET
+#    include <immintrin.h>
+#    include <intrin.h>
+#  endif
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#  define NVG_HAVE_NEON 1
+#  include <arm_neon.h>
+#endif
+
+static const int nvg__bitCount[16] = { 0,1,1,2, 1,2,2,3, 1,2,2,3, 2,3,3,4 };
+
+//
+// Scalar
+
+static void nvg__segmentsScalar(const float* x0, const float* y0, const float* x1, const float* y1,
+								float* dx, float* dy, float* len, int n)
+{
+	int i;
+	for (i = 0; i < n; i++) {
+		float sx = x1[i] - x0[i];
+		float sy = y1[i] - y0[i];
+		float d = sqrtf(sx*sx + sy*sy);
+		if (d > 1e-6f) {
+			float id = 1.0f / d;
+			sx *= id;
+			sy *= id;
+		}
+		dx[i] = sx;
+		dy[i] = sy;
+		len[i] = d;
+	}
+}
+
+static void nvg__boundsScalar(const float* x, const float* y, int n, float* bounds)
+{
+	int i;
+	for (i = 0; i < n; i++) {
+		bounds[0] = bounds[0] < x[i] ? bounds[0] : x[i];
+		bounds[1] = bounds[1] < y[i] ? bounds[1] : y[i];
+		bounds[2] = bounds[2] > x[i] ? bounds[2] : x[i];
+		bounds[3] = bounds[3] > y[i] ? bounds[3] : y[i];
+	}
+}
+
+// Flags of a single point, shared by the vector kernels for the lane masks they computed.
+static int nvg__joinFlags(int flags, int left, int innerBevel, int miterBevel)
+{
+	flags &= NVG_PT_CORNER;
+	if (left)
+		flags |= NVG_PT_LEFT;
+	if (innerBevel)
+		flags |= NVG_PR_INNERBEVEL;
+	if ((flags & NVG_PT_CORNER) && miterBevel)
+		flags |= NVG_PT_BEVEL;
+	return flags;
+}
+
+static void nvg__joinsScalar(const float* dx0, const float* dy0, const float* len0,
+							 const float* dx1, const float* dy1, const float* len1,
+							 float* dmx, float* dmy, unsigned char* flags, int n,
+							 float iw, float miterLimit, int bevelCorners, int* nleft, int* nbevel)
+{
+	int i;
+	for (i = 0; i < n; i++) {
+		float mx = (dy0[i] + dy1[i]) * 0.5f;
+		float my = (-dx0[i] + -dx1[i]) * 0.5f;
+		float dmr2 = mx*mx + my*my;
+		float cross, limit, len;
+		int f;
+
+		if (dmr2 > 0.000001f) {
+			float scale = 1.0f / dmr2;
+			if (scale > 600.0f)
+				scale = 600.0f;
+			mx *= scale;
+			my *= scale;
+		}
+		dmx[i] = mx;
+		dmy[i] = my;
+
+		cross = dx1[i] * dy0[i] - dx0[i] * dy1[i];
+		len = len0[i] < len1[i] ? len0[i] : len1[i];
+		limit = 1.01f > len * iw ? 1.01f : len * iw;
+
+		f = nvg__joinFlags(flags[i], cross > 0.0f, (dmr2 * limit*limit) < 1.0f,
+						   (dmr2 * miterLimit*miterLimit) < 1.0f || bevelCorners);
+		if (f & NVG_PT_LEFT)
+			(*nleft)++;
+		if (f & (NVG_PT_BEVEL | NVG_PR_INNERBEVEL))
+			(*nbevel)++;
+		flags[i] = (unsigned char)f;
+	}
+}
+
+static NVGvertex* nvg__fringeScalar(const float* x, const float* y, const float* dmx, const float* dmy, int n,
+									float lw, float rw, float lu, float ru, NVGvertex* dst)
+{
+	int i;
+	for (i = 0; i < n; i++) {
+		dst->x = x[i] + (dmx[i] * lw);
+		dst->y = y[i] + (dmy[i] * lw);
+		dst->u = lu;
+		dst->v = 1;
+		dst++;
+		dst->x = x[i] - (dmx[i] * rw);
+		dst->y = y[i] - (dmy[i] * rw);
+		dst->u = ru;
+		dst->v = 1;
+		dst++;
+	}
+	return dst;
+}
+
+static void nvg__swapRBScalar(const unsigned char* src, unsigned char* dst, int n)
+{
+	int i;
+	for (i = 0; i < n; i++) {
+		unsigned char r = src[0], g = src[1], b = src[2], a = src[3];
+		dst[0] = b;
+		dst[1] = g;
+		dst[2] = r;
+		dst[3] = a;
+		src += 4;
+		dst += 4;
+	}
+}
+
+static void nvg__transformScalar(const float* src, float* dst, int n, const float* t)
+{
+	int i;
+	for (i = 0; i < n; i++) {
+		float sx = src[i*2+0], sy = src[i*2+1];
+		dst[i*2+0] = sx*t[0] + sy*t[2] + t[4];
+		dst[i*2+1] = sx*t[1] + sy*t[3] + t[5];
+	}
+}
+
+static const NVGkernels nvg__scalarKernels = {
+	"scalar", NVG_SIMD_SCALAR,
+	nvg__segmentsScalar,
+	nvg__boundsScalar,
+	nvg__joinsScalar,
+	nvg__fringeScalar,
+	nvg__swapRBScalar,
+	nvg__transformScalar,
+};
+
+//
+// SSE2
+
+#ifdef NVG_HAVE_SSE2
+
+static __m128 nvg__selectSSE(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static void nvg__segmentsSSE2(const float* x0, const float* y0, const float* x1, const float* y1,
+							  float* dx, float* dy, float* len, int n)
+{
+	const __m128 eps = _mm_set1_ps(1e-6f);
+	const __m128 one = _mm_set1_ps(1.0f);
+	int i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128 sx = _mm_sub_ps(_mm_loadu_ps(x1+i), _mm_loadu_ps(x0+i));
+		__m128 sy = _mm_sub_ps(_mm_loadu_ps(y1+i), _mm_loadu_ps(y0+i));
+		__m128 d = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(sx, sx), _mm_mul_ps(sy, sy)));
+		__m128 m = _mm_cmpgt_ps(d, eps);
+		__m128 id = _mm_div_ps(one, d);
+		_mm_storeu_ps(dx+i, nvg__selectSSE(m, _mm_mul_ps(sx, id), sx));
+		_mm_storeu_ps(dy+i, nvg__selectSSE(m, _mm_mul_ps(sy, id), sy));
+		_mm_storeu_ps(len+i, d);
+	}
+	nvg__segmentsScalar(x0+i, y0+i, x1+i, y1+i, dx+i, dy+i, len+i, n-i);
+}
+
+static void nvg__boundsSSE2(const float* x, const float* y, int n, float* bounds)
+{
+	__m128 minx = _mm_set1_ps(bounds[0]), miny = _mm_set1_ps(bounds[1]);
+	__m128 maxx = _mm_set1_ps(bounds[2]), maxy = _mm_set1_ps(bounds[3]);
+	float b[4][4];
+	int i = 0, j;
+	for (; i + 4 <= n; i += 4) {
+		__m128 vx = _mm_loadu_ps(x+i);
+		__m128 vy = _mm_loadu_ps(y+i);
+		minx = _mm_min_ps(minx, vx);
+		miny = _mm_min_ps(miny, vy);
+		maxx = _mm_max_ps(maxx, vx);
+		maxy = _mm_max_ps(maxy, vy);
+	}
+	_mm_storeu_ps(b[0], minx);
+	_mm_storeu_ps(b[1], miny);
+	_mm_storeu_ps(b[2], maxx);
+	_mm_storeu_ps(b[3], maxy);
+	for (j = 0; j < 4; j++) {
+		bounds[0] = bounds[0] < b[0][j] ? bounds[0] : b[0][j];
+		bounds[1] = bounds[1] < b[1][j] ? bounds[1] : b[1][j];
+		bounds[2] = bounds[2] > b[2][j] ? bounds[2] : b[2][j];
+		bounds[3] = bounds[3] > b[3][j] ? bounds[3] : b[3][j];
+	}
+	nvg__boundsScalar(x+i, y+i, n-i, bounds);
+}
+
+static void nvg__joinsSSE2(const float* dx0, const float* dy0, const float* len0,
+						   const float* dx1, const float* dy1, const float* len1,
+						   float* dmx, float* dmy, unsigned char* flags, int n,
+						   float iw, float miterLimit, int bevelCorners, int* nleft, int* nbevel)
+{
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 eps = _mm_set1_ps(0.000001f);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 maxScale = _mm_set1_ps(600.0f);
+	const __m128 minLimit = _mm_set1_ps(1.01f);
+	const __m128 sign = _mm_set1_ps(-0.0f);
+	const __m128 viw = _mm_set1_ps(iw);
+	const __m128 vml = _mm_set1_ps(miterLimit);
+	int i = 0, j;
+	for (; i + 4 <= n; i += 4) {
+		__m128 vdx0 = _mm_loadu_ps(dx0+i), vdy0 = _mm_loadu_ps(dy0+i);
+		__m128 vdx1 = _mm_loadu_ps(dx1+i), vdy1 = _mm_loadu_ps(dy1+i);
+		__m128 mx = _mm_mul_ps(_mm_add_ps(vdy0, vdy1), half);
+		__m128 my = _mm_mul_ps(_mm_xor_ps(_mm_add_ps(vdx0, vdx1), sign), half);
+		__m128 dmr2 = _mm_add_ps(_mm_mul_ps(mx, mx), _mm_mul_ps(my, my));
+		__m128 scale = _mm_min_ps(_mm_div_ps(one, dmr2), maxScale);
+		__m128 m = _mm_cmpgt_ps(dmr2, eps);
+		__m128 cross, limit;
+		int left, inner, miter;
+
+		_mm_storeu_ps(dmx+i, nvg__selectSSE(m, _mm_mul_ps(mx, scale), mx));
+		_mm_storeu_ps(dmy+i, nvg__selectSSE(m, _mm_mul_ps(my, scale), my));
+
+		cross = _mm_sub_ps(_mm_mul_ps(vdx1, vdy0), _mm_mul_ps(vdx0, vdy1));
+		limit = _mm_max_ps(minLimit, _mm_mul_ps(_mm_min_ps(_mm_loadu_ps(len0+i), _mm_loadu_ps(len1+i)), viw));
+		left = _mm_movemask_ps(_mm_cmpgt_ps(cross, _mm_setzero_ps()));
+		inner = _mm_movemask_ps(_mm_cmplt_ps(_mm_mul_ps(_mm_mul_ps(dmr2, limit), limit), one));
+		miter = bevelCorners ? 0xf : _mm_movemask_ps(_mm_cmplt_ps(_mm_mul_ps(_mm_mul_ps(dmr2, vml), vml), one));
+
+		*nleft += nvg__bitCount[left];
+		for (j = 0; j < 4; j++) {
+			int f = nvg__joinFlags(flags[i+j], (left >> j) & 1, (inner >> j) & 1, (miter >> j) & 1);
+			if (f & (NVG_PT_BEVEL | NVG_PR_INNERBEVEL))
+				(*nbevel)++;
+			flags[i+j] = (unsigned char)f;
+		}
+	}
+	nvg__joinsScalar(dx0+i, dy0+i, len0+i, dx1+i, dy1+i, len1+i, dmx+i, dmy+i, flags+i, n-i,
+					 iw, miterLimit, bevelCorners, nleft, nbevel);
+}
+
+// Writes the vertex pairs (lx,ly,lu,1), (rx,ry,ru,1) of four points.
+static void nvg__storeFringeSSE(NVGvertex* dst, __m128 lx, __m128 ly, __m128 rx, __m128 ry, __m128 u, __m128 v)
+{
+	__m128 x = _mm_unpacklo_ps(lx, rx);
+	__m128 y = _mm_unpacklo_ps(ly, ry);
+	__m128 uu = u, vv = v;
+	_MM_TRANSPOSE4_PS(x, y, uu, vv);
+	_mm_storeu_ps(&dst[0].x, x);
+	_mm_storeu_ps(&dst[1].x, y);
+	_mm_storeu_ps(&dst[2].x, uu);
+	_mm_storeu_ps(&dst[3].x, vv);
+
+	x = _mm_unpackhi_ps(lx, rx);
+	y = _mm_unpackhi_ps(ly, ry);
+	uu = u; vv = v;
+	_MM_TRANSPOSE4_PS(x, y, uu, vv);
+	_mm_storeu_ps(&dst[4].x, x);
+	_mm_storeu_ps(&dst[5].x, y);
+	_mm_storeu_ps(&dst[6].x, uu);
+	_mm_storeu_ps(&dst[7].x, vv);
+}
+
+static NVGvertex* nvg__fringeSSE2(const float* x, const float* y, const float* dmx, const float* dmy, int n,
+								  float lw, float rw, float lu, float ru, NVGvertex* dst)
+{
+	const __m128 vlw = _mm_set1_ps(lw), vrw = _mm_set1_ps(rw);
+	const __m128 u = _mm_setr_ps(lu, ru, lu, ru);
+	const __m128 v = _mm_set1_ps(1.0f);
+	int i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128 vx = _mm_loadu_ps(x+i), vy = _mm_loadu_ps(y+i);
+		__m128 mx = _mm_loadu_ps(dmx+i), my = _mm_loadu_ps(dmy+i);
+		nvg__storeFringeSSE(dst,
+							_mm_add_ps(vx, _mm_mul_ps(mx, vlw)), _mm_add_ps(vy, _mm_mul_ps(my, vlw)),
+							_mm_sub_ps(vx, _mm_mul_ps(mx, vrw)), _mm_sub_ps(vy, _mm_mul_ps(my, vrw)), u, v);
+		dst += 8;
+	}
+	return nvg__fringeScalar(x+i, y+i, dmx+i, dmy+i, n-i, lw, rw, lu, ru, dst);
+}
+
+// Pixels are loaded as little endian 32-bit words, so the first byte is the low one.
+static void nvg__swapRBSSE2(const unsigned char* src, unsigned char* dst, int n)
+{
+	const __m128i ga = _mm_set1_epi32((int)0xff00ff00u);
+	const __m128i lo = _mm_set1_epi32(0xff);
+	int i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128i p = _mm_loadu_si128((const __m128i*)(src + i*4));
+		__m128i rb = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(p, lo), 16), _mm_and_si128(_mm_srli_epi32(p, 16), lo));
+		_mm_storeu_si128((__m128i*)(dst + i*4), _mm_or_si128(_mm_and_si128(p, ga), rb));
+	}
+	nvg__swapRBScalar(src + i*4, dst + i*4, n-i);
+}
+
+// Two interleaved points per register, x and y are duplicated into the lanes of both results.
+static void nvg__transformSSE2(const float* src, float* dst, int n, const float* t)
+{
+	const __m128 a = _mm_setr_ps(t[0], t[1], t[0], t[1]);
+	const __m128 c = _mm_setr_ps(t[2], t[3], t[2], t[3]);
+	const __m128 e = _mm_setr_ps(t[4], t[5], t[4], t[5]);
+	int i = 0;
+	for (; i + 2 <= n; i += 2) {
+		__m128 p = _mm_loadu_ps(src + i*2);
+		__m128 x = _mm_shuffle_ps(p, p, _MM_SHUFFLE(2,2,0,0));
+		__m128 y = _mm_shuffle_ps(p, p, _MM_SHUFFLE(3,3,1,1));
+		_mm_storeu_ps(dst + i*2, _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, a), _mm_mul_ps(y, c)), e));
+	}
+	nvg__transformScalar(src + i*2, dst + i*2, n-i, t);
+}
+
+static const NVGkernels nvg__sse2Kernels = {
+	"sse2", NVG_SIMD_SSE2,
+	nvg__segmentsSSE2,
+	nvg__boundsSSE2,
+	nvg__joinsSSE2,
+	nvg__fringeSSE2,
+	nvg__swapRBSSE2,
+	nvg__transformSSE2,
+};
+
+#endif
+
+//
+// AVX2
+//
+// The tails are handed to the SSE2 kernels, which are not VEX encoded. The upper halves of the
+// registers are cleared first, as the compiler does not do it for tail calls and mixing the two
+// stalls on many CPUs.
+
+#ifdef NVG_HAVE_AVX2
+
+NVG_AVX2_TARGET static __m256 nvg__selectAVX(__m256 mask, __m256 a, __m256 b)
+{
+	return _mm256_blendv_ps(b, a, mask);
+}
+
+NVG_AVX2_TARGET static void nvg__segmentsAVX2(const float* x0, const float* y0, const float* x1, const float* y1,
+											  float* dx, float* dy, float* len, int n)
+{
+	const __m256 eps = _mm256_set1_ps(1e-6f);
+	const __m256 one = _mm256_set1_ps(1.0f);
+	int i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256 sx = _mm256_sub_ps(_mm256_loadu_ps(x1+i), _mm256_loadu_ps(x0+i));
+		__m256 sy = _mm256_sub_ps(_mm256_loadu_ps(y1+i), _mm256_loadu_ps(y0+i));
+		__m256 d = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(sx, sx), _mm256_mul_ps(sy, sy)));
+		__m256 m = _mm256_cmp_ps(d, eps, _CMP_GT_OQ);
+		__m256 id = _mm256_div_ps(one, d);
+		_mm256_storeu_ps(dx+i, nvg__selectAVX(m, _mm256_mul_ps(sx, id), sx));
+		_mm256_storeu_ps(dy+i, nvg__selectAVX(m, _mm256_mul_ps(sy, id), sy));
+		_mm256_storeu_ps(len+i, d);
+	}
+	_mm256_zeroupper();
+	nvg__segmentsSSE2(x0+i, y0+i, x1+i, y1+i, dx+i, dy+i, len+i, n-i);
+}
+
+NVG_AVX2_TARGET static void nvg__boundsAVX2(const float* x, const float* y, int n, float* bounds)
+{
+	__m256 minx = _mm256_set1_ps(bounds[0]), miny = _mm256_set1_ps(bounds[1]);
+	__m256 maxx = _mm256_set1_ps(bounds[2]), maxy = _mm256_set1_ps(bounds[3]);
+	float b[4][8];
+	int i = 0, j;
+	for (; i + 8 <= n; i += 8) {
+		__m256 vx = _mm256_loadu_ps(x+i);
+		__m256 vy = _mm256_loadu_ps(y+i);
+		minx = _mm256_min_ps(minx, vx);
+		miny = _mm256_min_ps(miny, vy);
+		maxx = _mm256_max_ps(maxx, vx);
+		maxy = _mm256_max_ps(maxy, vy);
+	}
+	_mm256_storeu_ps(b[0], minx);
+	_mm256_storeu_ps(b[1], miny);
+	_mm256_storeu_ps(b[2], maxx);
+	_mm256_storeu_ps(b[3], maxy);
+	for (j = 0; j < 8; j++) {
+		bounds[0] = bounds[0] < b[0][j] ? bounds[0] : b[0][j];
+		bounds[1] = bounds[1] < b[1][j] ? bounds[1] : b[1][j];
+		bounds[2] = bounds[2] > b[2][j] ? bounds[2] : b[2][j];
+		bounds[3] = bounds[3] > b[3][j] ? bounds[3] : b[3][j];
+	}
+	nvg__boundsScalar(x+i, y+i, n-i, bounds);
+}
+
+NVG_AVX2_TARGET static void nvg__joinsAVX2(const float* dx0, const float* dy0, const float* len0,
+										   const float* dx1, const float* dy1, const float* len1,
+										   float* dmx, float* dmy, unsigned char* flags, int n,
+										   float iw, float miterLimit, int bevelCorners, int* nleft, int* nbevel)
+{
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const __m256 eps = _mm256_set1_ps(0.000001f);
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 maxScale = _mm256_set1_ps(600.0f);
+	const __m256 minLimit = _mm256_set1_ps(1.01f);
+	const __m256 sign = _mm256_set1_ps(-0.0f);
+	const __m256 viw = _mm256_set1_ps(iw);
+	const __m256 vml = _mm256_set1_ps(miterLimit);
+	int i = 0, j;
+	for (; i + 8 <= n; i += 8) {
+		__m256 vdx0 = _mm256_loadu_ps(dx0+i), vdy0 = _mm256_loadu_ps(dy0+i);
+		__m256 vdx1 = _mm256_loadu_ps(dx1+i), vdy1 = _mm256_loadu_ps(dy1+i);
+		__m256 mx = _mm256_mul_ps(_mm256_add_ps(vdy0, vdy1), half);
+		__m256 my = _mm256_mul_ps(_mm256_xor_ps(_mm256_add_ps(vdx0, vdx1), sign), half);
+		__m256 dmr2 = _mm256_add_ps(_mm256_mul_ps(mx, mx), _mm256_mul_ps(my, my));
+		__m256 scale = _mm256_min_ps(_mm256_div_ps(one, dmr2), maxScale);
+		__m256 m = _mm256_cmp_ps(dmr2, eps, _CMP_GT_OQ);
+		__m256 cross, limit;
+		int left, inner, miter;
+
+		_mm256_storeu_ps(dmx+i, nvg__selectAVX(m, _mm256_mul_ps(mx, scale), mx));
+		_mm256_storeu_ps(dmy+i, nvg__selectAVX(m, _mm256_mul_ps(my, scale), my));
+
+		cross = _mm256_sub_ps(_mm256_mul_ps(vdx1, vdy0), _mm256_mul_ps(vdx0, vdy1));
+		limit = _mm256_max_ps(minLimit, _mm256_mul_ps(_mm256_min_ps(_mm256_loadu_ps(len0+i), _mm256_loadu_ps(len1+i)), viw));
+		left = _mm256_movemask_ps(_mm256_cmp_ps(cross, _mm256_setzero_ps(), _CMP_GT_OQ));
+		inner = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_mul_ps(_mm256_mul_ps(dmr2, limit), limit), one, _CMP_LT_OQ));
+		miter = bevelCorners ? 0xff : _mm256_movemask_ps(_mm256_cmp_ps(_mm256_mul_ps(_mm256_mul_ps(dmr2, vml), vml), one, _CMP_LT_OQ));
+
+		*nleft += nvg__bitCount[left & 0xf] + nvg__bitCount[left >> 4];
+		for (j = 0; j < 8; j++) {
+			int f = nvg__joinFlags(flags[i+j], (left >> j) & 1, (inner >> j) & 1, (miter >> j) & 1);
+			if (f & (NVG_PT_BEVEL | NVG_PR_INNERBEVEL))
+				(*nbevel)++;
+			flags[i+j] = (unsigned char)f;
+		}
+	}
+	_mm256_zeroupper();
+	nvg__joinsSSE2(dx0+i, dy0+i, len0+i, dx1+i, dy1+i, len1+i, dmx+i, dmy+i, flags+i, n-i,
+				   iw, miterLimit, bevelCorners, nleft, nbevel);
+}
+
+NVG_AVX2_TARGET static NVGvertex* nvg__fringeAVX2(const float* x, const float* y, const float* dmx, const float* dmy, int n,
+												  float lw, float rw, float lu, float ru, NVGvertex* dst)
+{
+	const __m256 vlw = _mm256_set1_ps(lw), vrw = _mm256_set1_ps(rw);
+	const __m128 u = _mm_setr_ps(lu, ru, lu, ru);
+	const __m128 v = _mm_set1_ps(1.0f);
+	int i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256 vx = _mm256_loadu_ps(x+i), vy = _mm256_loadu_ps(y+i);
+		__m256 mx = _mm256_loadu_ps(dmx+i), my = _mm256_loadu_ps(dmy+i);
+		__m256 lx = _mm256_add_ps(vx, _mm256_mul_ps(mx, vlw));
+		__m256 ly = _mm256_add_ps(vy, _mm256_mul_ps(my, vlw));
+		__m256 rx = _mm256_sub_ps(vx, _mm256_mul_ps(mx, vrw));
+		__m256 ry = _mm256_sub_ps(vy, _mm256_mul_ps(my, vrw));
+		nvg__storeFringeSSE(dst, _mm256_castps256_ps128(lx), _mm256_castps256_ps128(ly),
+							_mm256_castps256_ps128(rx), _mm256_castps256_ps128(ry), u, v);
+		nvg__storeFringeSSE(dst+8, _mm256_extractf128_ps(lx, 1), _mm256_extractf128_ps(ly, 1),
+							_mm256_extractf128_ps(rx, 1), _mm256_extractf128_ps(ry, 1), u, v);
+		dst += 16;
+	}
+	_mm256_zeroupper();
+	return nvg__fringeSSE2(x+i, y+i, dmx+i, dmy+i, n-i, lw, rw, lu, ru, dst);
+}
+
+NVG_AVX2_TARGET static void nvg__swapRBAVX2(const unsigned char* src, unsigned char* dst, int n)
+{
+	const __m256i shuffle = _mm256_setr_epi8(2,1,0,3, 6,5,4,7, 10,9,8,11, 14,13,12,15,
+											 2,1,0,3, 6,5,4,7, 10,9,8,11, 14,13,12,15);
+	int i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256i p = _mm256_loadu_si256((const __m256i*)(src + i*4));
+		_mm256_storeu_si256((__m256i*)(dst + i*4), _mm256_shuffle_epi8(p, shuffle));
+	}
+	_mm256_zeroupper();
+	nvg__swapRBSSE2(src + i*4, dst + i*4, n-i);
+}
+
+NVG_AVX2_TARGET static void nvg__transformAVX2(const float* src, float* dst, int n, const float* t)
+{
+	const __m256 a = _mm256_setr_ps(t[0], t[1], t[0], t[1], t[0], t[1], t[0], t[1]);
+	const __m256 c = _mm256_setr_ps(t[2], t[3], t[2], t[3], t[2], t[3], t[2], t[3]);
+	const __m256 e = _mm256_setr_ps(t[4], t[5], t[4], t[5], t[4], t[5], t[4], t[5]);
+	int i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256 p = _mm256_loadu_ps(src + i*2);
+		__m256 x = _mm256_moveldup_ps(p);
+		__m256 y = _mm256_movehdup_ps(p);
+		_mm256_storeu_ps(dst + i*2, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, a), _mm256_mul_ps(y, c)), e));
+	}
+	_mm256_zeroupper();
+	nvg__transformSSE2(src + i*2, dst + i*2, n-i, t);
+}
+
+static const NVGkernels nvg__avx2Kernels = {
+	"avx2", NVG_SIMD_AVX2,
+	nvg__segmentsAVX2,
+	nvg__boundsAVX2,
+	nvg__joinsAVX2,
+	nvg__fringeAVX2,
+	nvg__swapRBAVX2,
+	nvg__transformAVX2,
+};
+
+static int nvg__cpuHasAVX2(void)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return 0;
+	__cpuid(info, 1);
+	// AVX and OS support for saving the YMM registers.
+	if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0) return 0;
+	if ((_xgetbv(0) & 6) != 6) return 0;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+//
+// NEON
+
+#ifdef NVG_HAVE_NEON
+
+static void nvg__segmentsNEON(const float* x0, const float* y0, const float* x1, const float* y1,
+							  float* dx, float* dy, float* len, int n)
+{
+	const float32x4_t eps = vdupq_n_f32(1e-6f);
+	const float32x4_t one = vdupq_n_f32(1.0f);
+	int i = 0;
+	for (; i + 4 <= n; i += 4) {
+		float32x4_t sx = vsubq_f32(vld1q_f32(x1+i), vld1q_f32(x0+i));
+		float32x4_t sy = vsubq_f32(vld1q_f32(y1+i), vld1q_f32(y0+i));
+		float32x4_t d = vsqrtq_f32(vaddq_f32(vmulq_f32(sx, sx), vmulq_f32(sy, sy)));
+		uint32x4_t m = vcgtq_f32(d, eps);
+		float32x4_t id = vdivq_f32(one, d);
+		vst1q_f32(dx+i, vbslq_f32(m, vmulq_f32(sx, id), sx));
+		vst1q_f32(dy+i, vbslq_f32(m, vmulq_f32(sy, id), sy));
+		vst1q_f32(len+i, d);
+	}
+	nvg__segmentsScalar(x0+i, y0+i, x1+i, y1+i, dx+i, dy+i, len+i, n-i);
+}
+
+static void nvg__boundsNEON(const float* x, const float* y, int n, float* bounds)
+{
+	float32x4_t minx = vdupq_n_f32(bounds[0]), miny = vdupq_n_f32(bounds[1]);
+	float32x4_t maxx = vdupq_n_f32(bounds[2]), maxy = vdupq_n_f32(bounds[3]);
+	int i = 0;
+	for (; i + 4 <= n; i += 4) {
+		float32x4_t vx = vld1q_f32(x+i);
+		float32x4_t vy = vld1q_f32(y+i);
+		minx = vminq_f32(minx, vx);
+		miny = vminq_f32(miny, vy);
+		maxx = vmaxq_f32(maxx, vx);
+		maxy = vmaxq_f32(maxy, vy);
+	}
+	bounds[0] = vminvq_f32(minx);
+	bounds[1] = vminvq_f32(miny);
+	bounds[2] = vmaxvq_f32(maxx);
+	bounds[3] = vmaxvq_f32(maxy);
+	nvg__boundsScalar(x+i, y+i, n-i, bounds);
+}
+
+static int nvg__maskNEON(uint32x4_t m)
+{
+	return (int)((vgetq_lane_u32(m, 0) & 1) | (vgetq_lane_u32(m, 1) & 2) |
+				 (vgetq_lane_u32(m, 2) & 4) | (vgetq_lane_u32(m, 3) & 8));
+}
+
+static void nvg__joinsNEON(const float* dx0, const float* dy0, const float* len0,
+						   const float* dx1, const float* dy1, const float* len1,
+						   float* dmx, float* dmy, unsigned char* flags, int n,
+						   float iw, float miterLimit, int bevelCorners, int* nleft, int* nbevel)
+{
+	const float32x4_t half = vdupq_n_f32(0.5f);
+	const float32x4_t eps = vdupq_n_f32(0.000001f);
+	const float32x4_t one = vdupq_n_f32(1.0f);
+	const float32x4_t maxScale = vdupq_n_f32(600.0f);
+	const float32x4_t minLimit = vdupq_n_f32(1.01f);
+	const float32x4_t viw = vdupq_n_f32(iw);
+	const float32x4_t vml = vdupq_n_f32(miterLimit);
+	int i = 0, j;
+	for (; i + 4 <= n; i += 4) {
+		float32x4_t vdx0 = vld1q_f32(dx0+i), vdy0 = vld1q_f32(dy0+i);
+		float32x4_t vdx1 = vld1q_f32(dx1+i), vdy1 = vld1q_f32(dy1+i);
+		float32x4_t mx = vmulq_f32(vaddq_f32(vdy0, vdy1), half);
+		float32x4_t my = vmulq_f32(vnegq_f32(vaddq_f32(vdx0, vdx1)), half);
+		float32x4_t dmr2 = vaddq_f32(vmulq_f32(mx, mx), vmulq_f32(my, my));
+		float32x4_t scale = vminq_f32(vdivq_f32(one, dmr2), maxScale);
+		uint32x4_t m = vcgtq_f32(dmr2, eps);
+		float32x4_t cross, limit;
+		int left, inner, miter;
+
+		vst1q_f32(dmx+i, vbslq_f32(m, vmulq_f32(mx, scale), mx));
+		vst1q_f32(dmy+i, vbslq_f32(m, vmulq_f32(my, scale), my));
+
+		cross = vsubq_f32(vmulq_f32(vdx1, vdy0), vmulq_f32(vdx0, vdy1));
+		limit = vmaxq_f32(minLimit, vmulq_f32(vminq_f32(vld1q_f32(len0+i), vld1q_f32(len1+i)), viw));
+		left = nvg__maskNEON(vcgtq_f32(cross, vdupq_n_f32(0.0f)));
+		inner = nvg__maskNEON(vcltq_f32(vmulq_f32(vmulq_f32(dmr2, limit), limit), one));
+		miter = bevelCorners ? 0xf : nvg__maskNEON(vcltq_f32(vmulq_f32(vmulq_f32(dmr2, vml), vml), one));
+
+		*nleft += nvg__bitCount[left];
+		for (j = 0; j < 4; j++) {
+			int f = nvg__joinFlags(flags[i+j], (left >> j) & 1, (inner >> j) & 1, (miter >> j) & 1);
+			if (f & (NVG_PT_BEVEL | NVG_PR_INNERBEVEL))
+				(*nbevel)++;
+			flags[i+j] = (unsigned char)f;
+		}
+	}
+	nvg__joinsScalar(dx0+i, dy0+i, len0+i, dx1+i, dy1+i, len1+i, dmx+i, dmy+i, flags+i, n-i,
+					 iw, miterLimit, bevelCorners, nleft, nbevel);
+}
+
+static NVGvertex* nvg__fringeNEON(const float* x, const float* y, const float* dmx, const float* dmy, int n,
+								  float lw, float rw, float lu, float ru, NVGvertex* dst)
+{
+	const float32x4_t vlw = vdupq_n_f32(lw), vrw = vdupq_n_f32(rw);
+	const float uv[4] = { lu, ru, lu, ru };
+	float32x4x4_t out;
+	int i = 0;
+	out.val[2] = vld1q_f32(uv);
+	out.val[3] = vdupq_n_f32(1.0f);
+	for (; i + 4 <= n; i += 4) {
+		float32x4_t vx = vld1q_f32(x+i), vy = vld1q_f32(y+i);
+		float32x4_t mx = vld1q_f32(dmx+i), my = vld1q_f32(dmy+i);
+		float32x4x2_t px = vzipq_f32(vaddq_f32(vx, vmulq_f32(mx, vlw)), vsubq_f32(vx, vmulq_f32(mx, vrw)));
+		float32x4x2_t py = vzipq_f32(vaddq_f32(vy, vmulq_f32(my, vlw)), vsubq_f32(vy, vmulq_f32(my, vrw)));
+		out.val[0] = px.val[0];
+		out.val[1] = py.val[0];
+		vst4q_f32(&dst[0].x, out);
+		out.val[0] = px.val[1];
+		out.val[1] = py.val[1];
+		vst4q_f32(&dst[4].x, out);
+		dst += 8;
+	}
+	return nvg__fringeScalar(x+i, y+i, dmx+i, dmy+i, n-i, lw, rw, lu, ru, dst);
+}
+
+static void nvg__swapRBNEON(const unsigned char* src, unsigned char* dst, int n)
+{
+	int i = 0;
+	for (; i + 16 <= n; i += 16) {
+		uint8x16x4_t p = vld4q_u8(src + i*4);
+		uint8x16_t r = p.val[0];
+		p.val[0] = p.val[2];
+		p.val[2] = r;
+		vst4q_u8(dst + i*4, p);
+	}
+	nvg__swapRBScalar(src + i*4, dst + i*4, n-i);
+}
+
+static void nvg__transformNEON(const float* src, float* dst, int n, const float* t)
+{
+	const float32x4_t t0 = vdupq_n_f32(t[0]), t1 = vdupq_n_f32(t[1]), t2 = vdupq_n_f32(t[2]);
+	const float32x4_t t3 = vdupq_n_f32(t[3]), t4 = vdupq_n_f32(t[4]), t5 = vdupq_n_f32(t[5]);
+	int i = 0;
+	for (; i + 4 <= n; i += 4) {
+		float32x4x2_t p = vld2q_f32(src + i*2);
+		float32x4x2_t r;
+		r.val[0] = vaddq_f32(vaddq_f32(vmulq_f32(p.val[0], t0), vmulq_f32(p.val[1], t2)), t4);
+		r.val[1] = vaddq_f32(vaddq_f32(vmulq_f32(p.val[0], t1), vmulq_f32(p.val[1], t3)), t5);
+		vst2q_f32(dst + i*2, r);
+	}
+	nvg__transformScalar(src + i*2, dst + i*2, n-i, t);
+}
+
+static const NVGkernels nvg__neonKernels = {
+	"neon", NVG_SIMD_NEON,
+	nvg__segmentsNEON,
+	nvg__boundsNEON,
+	nvg__joinsNEON,
+	nvg__fringeNEON,
+	nvg__swapRBNEON,
+	nvg__transformNEON,
+};
+
+#endif
+
+const NVGkernels* nvgKernels(int level)
+{
+	switch (level) {
+	case NVG_SIMD_SCALAR:
+		return &nvg__scalarKernels;
+#ifdef NVG_HAVE_SSE2
+	case NVG_SIMD_SSE2:
+		return &nvg__sse2Kernels;
+#endif
+#ifdef NVG_HAVE_AVX2
+	case NVG_SIMD_AVX2:
+		return nvg__cpuHasAVX2() ? &nvg__avx2Kernels : NULL;
+#endif
+#ifdef NVG_HAVE_NEON
+	case NVG_SIMD_NEON:
+		return &nvg__neonKernels;
+#endif
+	default:
+		return NULL;
+	}
+}
+
+const NVGkernels* nvgBestKernels(void)
+{
+	const NVGkernels* kernels = NULL;
+#ifdef NVG_SIMD_LEVEL
+	kernels = nvgKernels(NVG_SIMD_LEVEL);
+#endif
+	if (kernels == NULL) kernels = nvgKernels(NVG_SIMD_AVX2);
+	if (kernels == NULL) kernels = nvgKernels(NVG_SIMD_NEON);
+	if (kernels == NULL) kernels = nvgKernels(NVG_SIMD_SSE2);
+	if (kernels == NULL) kernels = nvgKernels(NVG_SIMD_SCALAR);
+	return kernels;
+}
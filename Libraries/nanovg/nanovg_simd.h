@@ -0,0 +1,91 @@
+//
+//  Copyright (C) 2022 Arthur Benilov <arthur.benilov@gmail.com> and Timothy Schoen <timschoen123@gmail.com>
+//
+// Copyright (c) 2009-2013 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+#ifndef NANOVG_SIMD_H
+#define NANOVG_SIMD_H
+
+#include "nanovg.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Vectorised kernels for transforming appended paths, the straight-line parts of path expansion,
+// and for converting image data. The path cache keeps points as a structure of arrays, so these
+// work on plain float arrays. Every implementation produces results identical to the scalar one;
+// the fastest set supported by the CPU is picked at runtime.
+// Define NVG_SIMD_LEVEL to one of NVGsimdLevel to pin the kernel set, e.g. for debugging.
+
+enum NVGpointFlags
+{
+	NVG_PT_CORNER = 0x01,
+	NVG_PT_LEFT = 0x02,
+	NVG_PT_BEVEL = 0x04,
+	NVG_PR_INNERBEVEL = 0x08,
+};
+
+enum NVGsimdLevel {
+	NVG_SIMD_SCALAR = 0,
+	NVG_SIMD_SSE2 = 1,
+	NVG_SIMD_AVX2 = 2,
+	NVG_SIMD_NEON = 3,
+};
+
+struct NVGkernels {
+	const char* name;
+	int level;
+
+	// Normalised direction and length of the segments from (x0[i],y0[i]) to (x1[i],y1[i]).
+	void (*segments)(const float* x0, const float* y0, const float* x1, const float* y1,
+					 float* dx, float* dy, float* len, int n);
+
+	// Grows bounds (minx,miny,maxx,maxy) to contain the points.
+	void (*bounds)(const float* x, const float* y, int n, float* bounds);
+
+	// Miter extrusion and join flags for points between the incoming segments (dx0,dy0,len0) and the
+	// outgoing segments (dx1,dy1,len1). Only NVG_PT_CORNER of the input flags is kept. Adds the number
+	// of left turns and of joins needing extra vertices to nleft and nbevel.
+	void (*joins)(const float* dx0, const float* dy0, const float* len0,
+				  const float* dx1, const float* dy1, const float* len1,
+				  float* dmx, float* dmy, unsigned char* flags, int n,
+				  float iw, float miterLimit, int bevelCorners, int* nleft, int* nbevel);
+
+	// Emits a vertex pair per point, offset by lw along the miter and by rw against it.
+	NVGvertex* (*fringe)(const float* x, const float* y, const float* dmx, const float* dmy, int n,
+						 float lw, float rw, float lu, float ru, NVGvertex* dst);
+
+	// Swaps the first and third byte of n 4-byte pixels, converting between RGBA and BGRA. src may equal dst.
+	void (*swapRB)(const unsigned char* src, unsigned char* dst, int n);
+
+	// Transforms n interleaved x,y points by the 2x3 matrix t. src may equal dst.
+	void (*transform)(const float* src, float* dst, int n, const float* t);
+};
+typedef struct NVGkernels NVGkernels;
+
+// Returns the kernels for the given NVGsimdLevel, or NULL if neither the build nor the CPU supports it.
+const NVGkernels* nvgKernels(int level);
+
+// Returns the fastest kernels supported by the CPU.
+const NVGkernels* nvgBestKernels(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NANOVG_SIMD_H
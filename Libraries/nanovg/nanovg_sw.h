@@ -0,0 +1,1174 @@
+//
+//  Copyright (C) 2022 Arthur Benilov <arthur.benilov@gmail.com> and Timothy Schoen <timschoen123@gmail.com>
+//
+// Copyright (c) 2009-2013 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+#ifndef NANOVG_SW_H
+#define NANOVG_SW_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Software backend, rasterises into a 32 bit premultiplied pixel buffer on the CPU.
+// It follows the GL backend: fills use a nonzero winding mask in place of the stencil buffer,
+// and anti-aliasing coverage comes from the fringe coordinates the same way as in the GL shader.
+// The frame is split into tiles on flush, which can be rendered in parallel, see nvgswSetParallelFor.
+
+enum NVGswFlags {
+	// Same as NVG_ANTIALIAS, enables the geometry based anti-aliasing fringes.
+	NVG_SW_ANTIALIAS	= 1<<0,
+	// Store pixels as BGRA instead of RGBA, e.g. for juce::Image::ARGB on little endian machines.
+	NVG_SW_BGRA			= 1<<1,
+};
+
+typedef void (*NVGswTask)(void* arg, int index);
+
+// Must run task(arg, i) for every i in [0, count), and return once all of them are done.
+typedef void (*NVGswParallelFor)(void* userPtr, int count, NVGswTask task, void* arg);
+
+NVGcontext* nvgCreateSW(int flags);
+void nvgDeleteSW(NVGcontext* ctx);
+
+// Sets the buffer to render into. The size is in device pixels, i.e. the window size passed to
+// nvgBeginFrame() times the device pixel ratio. Stride is in bytes. The buffer is not cleared.
+void nvgswSetTarget(NVGcontext* ctx, unsigned char* pixels, int width, int height, int stride);
+
+// Sets how tiles are distributed over threads. Tiles are rendered one after another by default.
+void nvgswSetParallelFor(NVGcontext* ctx, NVGswParallelFor parallelFor, void* userPtr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NANOVG_SW_H */
+
+#ifdef NANOVG_SW_IMPLEMENTATION
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "nanovg.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define NANOVG_SW_SSE2 1
+#endif
+
+#define SWNVG_TILE_SIZE 64
+
+enum SWNVGshaderType {
+	SWNVG_SHADER_FILLGRAD,
+	SWNVG_SHADER_FILLIMG,
+	SWNVG_SHADER_IMG,
+};
+
+enum SWNVGcallType {
+	SWNVG_NONE = 0,
+	SWNVG_FILL,
+	SWNVG_CONVEXFILL,
+	SWNVG_STROKE,
+	SWNVG_TRIANGLES,
+};
+
+struct SWNVGtexture {
+	int id;
+	int type;
+	int width, height;
+	int flags;
+	unsigned char* data;
+};
+typedef struct SWNVGtexture SWNVGtexture;
+
+// Everything the GL fragment shader gets as uniforms, with the matrices mapping device pixels.
+struct SWNVGpaint {
+	float paintMat[6];
+	float scissorMat[6];
+	float scissorExt[2];
+	float scissorScale[2];
+	float extent[2];
+	float radius;
+	float feather;
+	float strokeMult;
+	NVGcolor innerCol;
+	NVGcolor outerCol;
+	int type;
+	int texType;
+	int solid;
+	int image;
+	float ramp;		// Row of the ramp atlas in image, for gradients with stops.
+};
+typedef struct SWNVGpaint SWNVGpaint;
+
+struct SWNVGpath {
+	int fillOffset;
+	int fillCount;
+	int strokeOffset;
+	int strokeCount;
+};
+typedef struct SWNVGpath SWNVGpath;
+
+struct SWNVGcall {
+	int type;
+	int pathOffset;
+	int pathCount;
+	int triangleOffset;
+	int triangleCount;
+	int bounds[4];		// Device pixels, x0,y0 inclusive, x1,y1 exclusive.
+	SWNVGpaint paint;
+	SWNVGtexture* tex;	// Resolved on flush, the texture array may move while recording.
+	NVGcompositeOperationState blend;
+};
+typedef struct SWNVGcall SWNVGcall;
+
+struct SWNVGcontext {
+	int flags;
+	NVGarena* arena;
+
+	SWNVGtexture* textures;
+	int ntextures;
+	int ctextures;
+	int textureId;
+
+	float devicePixelRatio;
+
+	unsigned char* pixels;
+	int width, height;
+	int stride;
+
+	NVGswParallelFor parallelFor;
+	void* parallelUserPtr;
+
+	// Per frame buffers
+	SWNVGcall* calls;
+	int ccalls;
+	int ncalls;
+	int gcalls;
+	SWNVGpath* paths;
+	int cpaths;
+	int npaths;
+	int gpaths;
+	NVGvertex* verts;
+	int cverts;
+	int nverts;
+	int gverts;
+
+	int tilesX, tilesY;
+};
+typedef struct SWNVGcontext SWNVGcontext;
+
+// Scratch memory of a single tile.
+struct SWNVGtile {
+	int x0, y0, x1, y1;
+	int clip[4];		// Tile bounds intersected with the bounds of the current call.
+	short winding[SWNVG_TILE_SIZE*SWNVG_TILE_SIZE];
+	float span[SWNVG_TILE_SIZE*4];
+};
+typedef struct SWNVGtile SWNVGtile;
+
+static int swnvg__maxi(int a, int b) { return a > b ? a : b; }
+static int swnvg__mini(int a, int b) { return a < b ? a : b; }
+static float swnvg__maxf(float a, float b) { return a > b ? a : b; }
+static float swnvg__minf(float a, float b) { return a < b ? a : b; }
+static float swnvg__clampf(float a, float mn, float mx) { return a < mn ? mn : (a > mx ? mx : a); }
+
+static SWNVGtexture* swnvg__allocTexture(SWNVGcontext* sw)
+{
+	SWNVGtexture* tex = NULL;
+	int i;
+
+	for (i = 0; i < sw->ntextures; i++) {
+		if (sw->textures[i].id == 0) {
+			tex = &sw->textures[i];
+			break;
+		}
+	}
+	if (tex == NULL) {
+		if (sw->ntextures+1 > sw->ctextures) {
+			SWNVGtexture* textures;
+			int ctextures = swnvg__maxi(sw->ntextures+1, 4) +  sw->ctextures/2; // 1.5x Overallocate
+			textures = (SWNVGtexture*)realloc(sw->textures, sizeof(SWNVGtexture)*ctextures);
+			if (textures == NULL) return NULL;
+			sw->textures = textures;
+			sw->ctextures = ctextures;
+		}
+		tex = &sw->textures[sw->ntextures++];
+	}
+
+	memset(tex, 0, sizeof(*tex));
+	tex->id = ++sw->textureId;
+
+	return tex;
+}
+
+static SWNVGtexture* swnvg__findTexture(SWNVGcontext* sw, int id)
+{
+	int i;
+	for (i = 0; i < sw->ntextures; i++)
+		if (sw->textures[i].id == id)
+			return &sw->textures[i];
+	return NULL;
+}
+
+static int swnvg__renderCreate(void* uptr)
+{
+	NVG_NOTUSED(uptr);
+	return 1;
+}
+
+static int swnvg__renderCreateTexture(void* uptr, int type, int w, int h, int imageFlags, const unsigned char* data)
+{
+	SWNVGcontext* sw = (SWNVGcontext*)uptr;
+	SWNVGtexture* tex = swnvg__allocTexture(sw);
+	size_t size = (size_t)w * h * (type == NVG_TEXTURE_ALPHA ? 1 : 4);
+
+	if (tex == NULL) return 0;
+
+	tex->data = (unsigned char*)malloc(size);
+	if (tex->data == NULL) {
+		tex->id = 0;
+		return 0;
+	}
+	if (data != NULL)
+		memcpy(tex->data, data, size);
+	else
+		memset(tex->data, 0, size);
+
+	tex->type = type;
+	tex->width = w;
+	tex->height = h;
+	tex->flags = imageFlags;
+
+	return tex->id;
+}
+
+static int swnvg__renderDeleteTexture(void* uptr, int image)
+{
+	SWNVGcontext* sw = (SWNVGcontext*)uptr;
+	SWNVGtexture* tex = swnvg__findTexture(sw, image);
+	if (tex == NULL) return 0;
+	free(tex->data);
+	memset(tex, 0, sizeof(*tex));
+	return 1;
+}
+
+static int swnvg__renderUpdateTexture(void* uptr, int image, int x, int y, int w, int h, const unsigned char* data)
+{
+	SWNVGcontext* sw = (SWNVGcontext*)uptr;
+	SWNVGtexture* tex = swnvg__findTexture(sw, image);
+	int bpp, row;
+
+	if (tex == NULL) return 0;
+	bpp = tex->type == NVG_TEXTURE_ALPHA ? 1 : 4;
+
+	// Data points at the whole image.
+	for (row = y; row < y + h; row++) {
+		size_t offset = ((size_t)row * tex->width + x) * bpp;
+		memcpy(tex->data + offset, data + offset, (size_t)w * bpp);
+	}
+
+	return 1;
+}
+
+static int swnvg__renderGetTextureSize(void* uptr, int image, int* w, int* h)
+{
+	SWNVGcontext* sw = (SWNVGcontext*)uptr;
+	SWNVGtexture* tex = swnvg__findTexture(sw, image);
+	if (tex == NULL) return 0;
+	*w = tex->width;
+	*h = tex->height;
+	return 1;
+}
+
+static void swnvg__renderViewport(void* uptr, float width, float height, float devicePixelRatio)
+{
+	SWNVGcontext* sw = (SWNVGcontext*)uptr;
+	NVG_NOTUSED(width);
+	NVG_NOTUSED(height);
+	sw->devicePixelRatio = devicePixelRatio;
+}
+
+static void swnvg__renderCancel(void* uptr)
+{
+	SWNVGcontext* sw = (SWNVGcontext*)uptr;
+	sw->nverts = 0;
+	sw->npaths = 0;
+	sw->ncalls = 0;
+}
+
+static SWNVGcall* swnvg__allocCall(SWNVGcontext* sw)
+{
+	SWNVGcall* ret = NULL;
+	SWNVGcall* calls = (SWNVGcall*)nvgArenaReserve(sw->arena, sw->calls, &sw->ccalls, &sw->gcalls,
+												   swnvg__maxi(sw->ncalls+1, 128), sw->ncalls, sizeof(SWNVGcall));
+	if (calls == NULL) return NULL;
+	sw->calls = calls;
+	ret = &sw->calls[sw->ncalls++];
+	memset(ret, 0, sizeof(SWNVGcall));
+	return ret;
+}
+
+static int swnvg__allocPaths(SWNVGcontext* sw, int n)
+{
+	int ret = 0;
+	SWNVGpath* paths = (SWNVGpath*)nvgArenaReserve(sw->arena, sw->paths, &sw->cpaths, &sw->gpaths,
+												   swnvg__maxi(sw->npaths + n, 128), sw->npaths, sizeof(SWNVGpath));
+	if (paths == NULL) return -1;
+	sw->paths = paths;
+	ret = sw->npaths;
+	sw->npaths += n;
+	return ret;
+}
+
+static int swnvg__allocVerts(SWNVGcontext* sw, int n)
+{
+	int ret = 0;
+	NVGvertex* verts = (NVGvertex*)nvgArenaReserve(sw->arena, sw->verts, &sw->cverts, &sw->gverts,
+												   swnvg__maxi(sw->nverts + n, 4096), sw->nverts, sizeof(NVGvertex));
+	if (verts == NULL) return -1;
+	sw->verts = verts;
+	ret = sw->nverts;
+	sw->nverts += n;
+	return ret;
+}
+
+// Copies vertices scaled to device pixels and grows the call bounds.
+static void swnvg__copyVerts(SWNVGcontext* sw, int offset, const NVGvertex* src, int n, float* bounds)
+{
+	NVGvertex* dst = &sw->verts[offset];
+	float s = sw->devicePixelRatio;
+	int i;
+	for (i = 0; i < n; i++) {
+		dst[i].x = src[i].x * s;
+		dst[i].y = src[i].y * s;
+		dst[i].u = src[i].u;
+		dst[i].v = src[i].v;
+		bounds[0] = swnvg__minf(bounds[0], dst[i].x);
+		bounds[1] = swnvg__minf(bounds[1], dst[i].y);
+		bounds[2] = swnvg__maxf(bounds[2], dst[i].x);
+		bounds[3] = swnvg__maxf(bounds[3], dst[i].y);
+	}
+}
+
+static NVGcolor swnvg__premulColor(NVGcolor c)
+{
+	c.r *= c.a;
+	c.g *= c.a;
+	c.b *= c.a;
+	return c;
+}
+
+static int swnvg__convertPaint(SWNVGcontext* sw, SWNVGpaint* frag, NVGpaint* paint,
+							   NVGscissor* scissor, float width, float fringe)
+{
+	SWNVGtexture* tex = NULL;
+	float invxform[6], toLogical[6];
+
+	memset(frag, 0, sizeof(*frag));
+
+	// Rasterisation happens in device pixels, the matrices below expect nanovg units.
+	nvgTransformScale(toLogical, 1.0f / sw->devicePixelRatio, 1.0f / sw->devicePixelRatio);
+
+	frag->innerCol = swnvg__premulColor(paint->innerColor);
+	frag->outerCol = swnvg__premulColor(paint->outerColor);
+	frag->image = paint->image;
+
+	if (scissor->extent[0] < -0.5f || scissor->extent[1] < -0.5f) {
+		memset(frag->scissorMat, 0, sizeof(frag->scissorMat));
+		frag->scissorExt[0] = 1.0f;
+		frag->scissorExt[1] = 1.0f;
+		frag->scissorScale[0] = 1.0f;
+		frag->scissorScale[1] = 1.0f;
+	} else {
+		nvgTransformInverse(invxform, scissor->xform);
+		memcpy(frag->scissorMat, toLogical, sizeof(toLogical));
+		nvgTransformMultiply(frag->scissorMat, invxform);
+		frag->scissorExt[0] = scissor->extent[0];
+		frag->scissorExt[1] = scissor->extent[1];
+		frag->scissorScale[0] = sqrtf(scissor->xform[0]*scissor->xform[0] + scissor->xform[2]*scissor->xform[2]) / fringe;
+		frag->scissorScale[1] = sqrtf(scissor->xform[1]*scissor->xform[1] + scissor->xform[3]*scissor->xform[3]) / fringe;
+	}
+
+	memcpy(frag->extent, paint->extent, sizeof(frag->extent));
+	frag->strokeMult = (width*0.5f + fringe*0.5f) / fringe;
+
+	if (paint->image != 0 && paint->ramp <= 0.0f) {
+		tex = swnvg__findTexture(sw, paint->image);
+		if (tex == NULL) return 0;
+		if ((tex->flags & NVG_IMAGE_FLIPY) != 0) {
+			float m1[6], m2[6];
+			nvgTransformTranslate(m1, 0.0f, frag->extent[1] * 0.5f);
+			nvgTransformMultiply(m1, paint->xform);
+			nvgTransformScale(m2, 1.0f, -1.0f);
+			nvgTransformMultiply(m2, m1);
+			nvgTransformTranslate(m1, 0.0f, -frag->extent[1] * 0.5f);
+			nvgTransformMultiply(m1, m2);
+			nvgTransformInverse(invxform, m1);
+		} else {
+			nvgTransformInverse(invxform, paint->xform);
+		}
+		frag->type = SWNVG_SHADER_FILLIMG;
+
+		if (tex->type != NVG_TEXTURE_ALPHA)
+			frag->texType = (tex->flags & NVG_IMAGE_PREMULTIPLIED) ? 0 : 1;
+		else
+			frag->texType = 2;
+	} else {
+		frag->type = SWNVG_SHADER_FILLGRAD;
+		frag->radius = paint->radius;
+		frag->feather = paint->feather;
+		frag->ramp = paint->ramp;
+		nvgTransformInverse(invxform, paint->xform);
+		frag->solid = frag->ramp <= 0.0f && memcmp(&frag->innerCol, &frag->outerCol, sizeof(NVGcolor)) == 0;
+	}
+
+	memcpy(frag->paintMat, toLogical, sizeof(toLogical));
+	nvgTransformMultiply(frag->paintMat, invxform);
+
+	return 1;
+}
+
+static NVGcompositeOperationState swnvg__blendCompositeOperation(NVGcompositeOperationState op)
+{
+	int valid = NVG_ZERO | NVG_ONE | NVG_SRC_COLOR | NVG_ONE_MINUS_SRC_COLOR | NVG_DST_COLOR | NVG_ONE_MINUS_DST_COLOR |
+				NVG_SRC_ALPHA | NVG_ONE_MINUS_SRC_ALPHA | NVG_DST_ALPHA | NVG_ONE_MINUS_DST_ALPHA | NVG_SRC_ALPHA_SATURATE;
+	if ((op.srcRGB & ~valid) || (op.dstRGB & ~valid) || (op.srcAlpha & ~valid) || (op.dstAlpha & ~valid) ||
+		op.srcRGB == 0 || op.dstRGB == 0 || op.srcAlpha == 0 || op.dstAlpha == 0) {
+		op.srcRGB = NVG_ONE;
+		op.dstRGB = NVG_ONE_MINUS_SRC_ALPHA;
+		op.srcAlpha = NVG_ONE;
+		op.dstAlpha = NVG_ONE_MINUS_SRC_ALPHA;
+	}
+	return op;
+}
+
+// Clips the call's pixel bounds against the target and the scissor.
+static void swnvg__setCallBounds(SWNVGcontext* sw, SWNVGcall* call, const float* bounds, NVGscissor* scissor)
+{
+	float b[4];
+	memcpy(b, bounds, sizeof(b));
+
+	if (scissor->extent[0] >= -0.5f && scissor->extent[1] >= -0.5f) {
+		float s = sw->devicePixelRatio;
+		float ex = fabsf(scissor->xform[0]) * scissor->extent[0] + fabsf(scissor->xform[2]) * scissor->extent[1];
+		float ey = fabsf(scissor->xform[1]) * scissor->extent[0] + fabsf(scissor->xform[3]) * scissor->extent[1];
+		// The scissor mask fades over half a pixel outside the edge.
+		b[0] = swnvg__maxf(b[0], (scissor->xform[4] - ex) * s - 1.0f);
+		b[1] = swnvg__maxf(b[1], (scissor->xform[5] - ey) * s - 1.0f);
+		b[2] = swnvg__minf(b[2], (scissor->xform[4] + ex) * s + 1.0f);
+		b[3] = swnvg__minf(b[3], (scissor->xform[5] + ey) * s + 1.0f);
+	}
+
+	call->bounds[0] = swnvg__maxi(0, (int)floorf(b[0]));
+	call->bounds[1] = swnvg__maxi(0, (int)floorf(b[1]));
+	call->bounds[2] = swnvg__mini(sw->width, (int)ceilf(b[2]) + 1);
+	call->bounds[3] = swnvg__mini(sw->height, (int)ceilf(b[3]) + 1);
+	if (call->bounds[2] <= call->bounds[0] || call->bounds[3] <= call->bounds[1])
+		call->type = SWNVG_NONE;
+}
+
+static void swnvg__renderFill(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor, float fringe,
+							  const float* bounds, const NVGpath* paths, int npaths)
+{
+	SWNVGcontext* sw = (SWNVGcontext*)uptr;
+	SWNVGcall* call = swnvg__allocCall(sw);
+	float b[4] = { 1e6f, 1e6f, -1e6f, -1e6f };
+	int i, maxverts = 0, offset;
+
+	NVG_NOTUSED(bounds);
+	if (call == NULL) return;
+
+	call->type = SWNVG_FILL;
+	call->pathOffset = swnvg__allocPaths(sw, npaths);
+	if (call->pathOffset == -1) goto error;
+	call->pathCount = npaths;
+	call->blend = swnvg__blendCompositeOperation(compositeOperation);
+
+	if (npaths == 1 && paths[0].convex)
+		call->type = SWNVG_CONVEXFILL;
+
+	for (i = 0; i < npaths; i++)
+		maxverts += paths[i].nfill + paths[i].nstroke;
+	offset = swnvg__allocVerts(sw, maxverts);
+	if (offset == -1) goto error;
+
+	for (i = 0; i < npaths; i++) {
+		SWNVGpath* copy = &sw->paths[call->pathOffset + i];
+		const NVGpath* path = &paths[i];
+		memset(copy, 0, sizeof(SWNVGpath));
+		if (path->nfill > 0) {
+			copy->fillOffset = offset;
+			copy->fillCount = path->nfill;
+			swnvg__copyVerts(sw, offset, path->fill, path->nfill, b);
+			offset += path->nfill;
+		}
+		if (path->nstroke > 0) {
+			copy->strokeOffset = offset;
+			copy->strokeCount = path->nstroke;
+			swnvg__copyVerts(sw, offset, path->stroke, path->nstroke, b);
+			offset += path->nstroke;
+		}
+	}
+
+	if (swnvg__convertPaint(sw, &call->paint, paint, scissor, fringe, fringe) == 0) goto error;
+	swnvg__setCallBounds(sw, call, b, scissor);
+	return;
+
+error:
+	// We get here if call alloc was ok, but something else is not.
+	// Roll back the last call to prevent drawing it.
+	if (sw->ncalls > 0) sw->ncalls--;
+}
+
+static void swnvg__renderStroke(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor, float fringe,
+								float strokeWidth, const NVGpath* paths, int npaths)
+{
+	SWNVGcontext* sw = (SWNVGcontext*)uptr;
+	SWNVGcall* call = swnvg__allocCall(sw);
+	float b[4] = { 1e6f, 1e6f, -1e6f, -1e6f };
+	int i, maxverts = 0, offset;
+
+	if (call == NULL) return;
+
+	call->type = SWNVG_STROKE;
+	call->pathOffset = swnvg__allocPaths(sw, npaths);
+	if (call->pathOffset == -1) goto error;
+	call->pathCount = npaths;
+	call->blend = swnvg__blendCompositeOperation(compositeOperation);
+
+	for (i = 0; i < npaths; i++)
+		maxverts += paths[i].nstroke;
+	offset = swnvg__allocVerts(sw, maxverts);
+	if (offset == -1) goto error;
+
+	for (i = 0; i < npaths; i++) {
+		SWNVGpath* copy = &sw->paths[call->pathOffset + i];
+		const NVGpath* path = &paths[i];
+		memset(copy, 0, sizeof(SWNVGpath));
+		if (path->nstroke) {
+			copy->strokeOffset = offset;
+			copy->strokeCount = path->nstroke;
+			swnvg__copyVerts(sw, offset, path->stroke, path->nstroke, b);
+			offset += path->nstroke;
+		}
+	}
+
+	if (swnvg__convertPaint(sw, &call->paint, paint, scissor, strokeWidth, fringe) == 0) goto error;
+	swnvg__setCallBounds(sw, call, b, scissor);
+	return;
+
+error:
+	// We get here if call alloc was ok, but something else is not.
+	// Roll back the last call to prevent drawing it.
+	if (sw->ncalls > 0) sw->ncalls--;
+}
+
+static void swnvg__renderTriangles(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor,
+								   const NVGvertex* verts, int nverts, float fringe)
+{
+	SWNVGcontext* sw = (SWNVGcontext*)uptr;
+	SWNVGcall* call = swnvg__allocCall(sw);
+	float b[4] = { 1e6f, 1e6f, -1e6f, -1e6f };
+
+	if (call == NULL) return;
+
+	call->type = SWNVG_TRIANGLES;
+	call->blend = swnvg__blendCompositeOperation(compositeOperation);
+
+	call->triangleOffset = swnvg__allocVerts(sw, nverts);
+	if (call->triangleOffset == -1) goto error;
+	call->triangleCount = nverts;
+	swnvg__copyVerts(sw, call->triangleOffset, verts, nverts, b);
+
+	if (swnvg__convertPaint(sw, &call->paint, paint, scissor, 1.0f, fringe) == 0) goto error;
+	call->paint.type = SWNVG_SHADER_IMG;
+	swnvg__setCallBounds(sw, call, b, scissor);
+	return;
+
+error:
+	// We get here if call alloc was ok, but something else is not.
+	// Roll back the last call to prevent drawing it.
+	if (sw->ncalls > 0) sw->ncalls--;
+}
+
+//
+// Shading
+
+static float swnvg__sdroundrect(float px, float py, float ex, float ey, float rad)
+{
+	float dx = fabsf(px) - (ex - rad);
+	float dy = fabsf(py) - (ey - rad);
+	float mx = swnvg__maxf(dx, 0.0f), my = swnvg__maxf(dy, 0.0f);
+	return swnvg__minf(swnvg__maxf(dx, dy), 0.0f) + sqrtf(mx*mx + my*my) - rad;
+}
+
+static float swnvg__scissorMask(const SWNVGpaint* frag, float x, float y)
+{
+	const float* m = frag->scissorMat;
+	float sx = fabsf(m[0]*x + m[2]*y + m[4]) - frag->scissorExt[0];
+	float sy = fabsf(m[1]*x + m[3]*y + m[5]) - frag->scissorExt[1];
+	sx = 0.5f - sx * frag->scissorScale[0];
+	sy = 0.5f - sy * frag->scissorScale[1];
+	return swnvg__clampf(sx, 0.0f, 1.0f) * swnvg__clampf(sy, 0.0f, 1.0f);
+}
+
+static int swnvg__wrap(int i, int n, int repeat)
+{
+	if (repeat) {
+		i %= n;
+		return i < 0 ? i + n : i;
+	}
+	return i < 0 ? 0 : (i >= n ? n-1 : i);
+}
+
+static void swnvg__texel(const SWNVGtexture* tex, int x, int y, float* c)
+{
+	x = swnvg__wrap(x, tex->width, tex->flags & NVG_IMAGE_REPEATX);
+	y = swnvg__wrap(y, tex->height, tex->flags & NVG_IMAGE_REPEATY);
+	if (tex->type != NVG_TEXTURE_ALPHA) {
+		// BGRA textures are kept as uploaded, and swapped here.
+		const unsigned char* p = &tex->data[((size_t)y * tex->width + x) * 4];
+		int r = tex->type == NVG_TEXTURE_BGRA ? 2 : 0;
+		c[0] = p[r] * (1.0f/255.0f);
+		c[1] = p[1] * (1.0f/255.0f);
+		c[2] = p[2-r] * (1.0f/255.0f);
+		c[3] = p[3] * (1.0f/255.0f);
+	} else {
+		c[0] = c[1] = c[2] = c[3] = tex->data[(size_t)y * tex->width + x] * (1.0f/255.0f);
+	}
+}
+
+// Samples like GL_LINEAR or GL_NEAREST, with texture coordinates in [0,1].
+static void swnvg__sample(const SWNVGtexture* tex, int texType, float u, float v, float* c)
+{
+	if (tex == NULL) {
+		c[0] = c[1] = c[2] = c[3] = 1.0f;
+		return;
+	}
+	u = u * tex->width - 0.5f;
+	v = v * tex->height - 0.5f;
+	if (tex->flags & NVG_IMAGE_NEAREST) {
+		swnvg__texel(tex, (int)floorf(u + 0.5f), (int)floorf(v + 0.5f), c);
+	} else {
+		float c00[4], c10[4], c01[4], c11[4];
+		int x0 = (int)floorf(u), y0 = (int)floorf(v), i;
+		float fx = u - x0, fy = v - y0;
+		swnvg__texel(tex, x0, y0, c00);
+		swnvg__texel(tex, x0+1, y0, c10);
+		swnvg__texel(tex, x0, y0+1, c01);
+		swnvg__texel(tex, x0+1, y0+1, c11);
+		for (i = 0; i < 4; i++) {
+			float top = c00[i] + (c10[i] - c00[i]) * fx;
+			float bottom = c01[i] + (c11[i] - c01[i]) * fx;
+			c[i] = top + (bottom - top) * fy;
+		}
+	}
+	if (texType == 1) {
+		c[0] *= c[3];
+		c[1] *= c[3];
+		c[2] *= c[3];
+	} else if (texType == 2) {
+		c[1] = c[2] = c[3] = c[0];
+	}
+}
+
+// Shades the pixels x0..x1-1 of row y into span, as premultiplied floats in target channel order.
+// (u,v) is the fringe coordinate at the first pixel centre, advancing by (du,dv) per pixel.
+static void swnvg__shadeSpan(const SWNVGcall* call, int aa, int bgra, int x0, int x1, int y,
+							 float u, float v, float du, float dv, float* span)
+{
+	const SWNVGpaint* frag = &call->paint;
+	float py = y + 0.5f;
+	int x, ri = bgra ? 2 : 0, bi = bgra ? 0 : 2;
+
+	for (x = x0; x < x1; x++, u += du, v += dv, span += 4) {
+		float px = x + 0.5f;
+		float alpha = swnvg__scissorMask(frag, px, py);
+		float c[4];
+
+		if (frag->type != SWNVG_SHADER_IMG && aa)
+			alpha *= swnvg__minf(1.0f, (1.0f - fabsf(u*2.0f - 1.0f)) * frag->strokeMult) * swnvg__minf(1.0f, v);
+
+		if (frag->type == SWNVG_SHADER_FILLGRAD) {
+			if (frag->solid) {
+				c[0] = frag->innerCol.r; c[1] = frag->innerCol.g; c[2] = frag->innerCol.b; c[3] = frag->innerCol.a;
+			} else {
+				const float* m = frag->paintMat;
+				float tx = m[0]*px + m[2]*py + m[4];
+				float ty = m[1]*px + m[3]*py + m[5];
+				float d = swnvg__clampf((swnvg__sdroundrect(tx, ty, frag->extent[0], frag->extent[1], frag->radius) + frag->feather*0.5f) / frag->feather, 0.0f, 1.0f);
+				if (frag->ramp > 0.0f) {
+					swnvg__sample(call->tex, 0, d, frag->ramp, c);
+					c[0] *= frag->innerCol.r;
+					c[1] *= frag->innerCol.g;
+					c[2] *= frag->innerCol.b;
+					c[3] *= frag->innerCol.a;
+				} else {
+					c[0] = frag->innerCol.r + (frag->outerCol.r - frag->innerCol.r) * d;
+					c[1] = frag->innerCol.g + (frag->outerCol.g - frag->innerCol.g) * d;
+					c[2] = frag->innerCol.b + (frag->outerCol.b - frag->innerCol.b) * d;
+					c[3] = frag->innerCol.a + (frag->outerCol.a - frag->innerCol.a) * d;
+				}
+			}
+		} else {
+			if (frag->type == SWNVG_SHADER_FILLIMG) {
+				const float* m = frag->paintMat;
+				float tx = (m[0]*px + m[2]*py + m[4]) / frag->extent[0];
+				float ty = (m[1]*px + m[3]*py + m[5]) / frag->extent[1];
+				swnvg__sample(call->tex, frag->texType, tx, ty, c);
+			} else {
+				swnvg__sample(call->tex, frag->texType, u, v, c);
+			}
+			c[0] *= frag->innerCol.r;
+			c[1] *= frag->innerCol.g;
+			c[2] *= frag->innerCol.b;
+			c[3] *= frag->innerCol.a;
+		}
+
+		span[ri] = c[0] * alpha;
+		span[1] = c[1] * alpha;
+		span[bi] = c[2] * alpha;
+		span[3] = c[3] * alpha;
+	}
+}
+
+//
+// Blending
+
+static float swnvg__factor(int factor, const float* s, const float* d, int i)
+{
+	switch (factor) {
+	case NVG_ZERO: return 0.0f;
+	case NVG_ONE: return 1.0f;
+	case NVG_SRC_COLOR: return s[i];
+	case NVG_ONE_MINUS_SRC_COLOR: return 1.0f - s[i];
+	case NVG_DST_COLOR: return d[i];
+	case NVG_ONE_MINUS_DST_COLOR: return 1.0f - d[i];
+	case NVG_SRC_ALPHA: return s[3];
+	case NVG_ONE_MINUS_SRC_ALPHA: return 1.0f - s[3];
+	case NVG_DST_ALPHA: return d[3];
+	case NVG_ONE_MINUS_DST_ALPHA: return 1.0f - d[3];
+	case NVG_SRC_ALPHA_SATURATE: return i == 3 ? 1.0f : swnvg__minf(s[3], 1.0f - d[3]);
+	}
+	return 0.0f;
+}
+
+static unsigned char swnvg__toByte(float c)
+{
+	return (unsigned char)(swnvg__clampf(c, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+static void swnvg__blendSpanGeneric(unsigned char* dst, const float* span, int n, NVGcompositeOperationState op)
+{
+	int x, i;
+	for (x = 0; x < n; x++, dst += 4, span += 4) {
+		float d[4];
+		for (i = 0; i < 4; i++)
+			d[i] = dst[i] * (1.0f/255.0f);
+		for (i = 0; i < 4; i++) {
+			int sf = i < 3 ? op.srcRGB : op.srcAlpha;
+			int df = i < 3 ? op.dstRGB : op.dstAlpha;
+			dst[i] = swnvg__toByte(span[i] * swnvg__factor(sf, span, d, i) + d[i] * swnvg__factor(df, span, d, i));
+		}
+	}
+}
+
+// Source over, the blend mode used for nearly everything.
+static void swnvg__blendSpanOver(unsigned char* dst, const float* span, int n)
+{
+	int x = 0;
+#ifdef NANOVG_SW_SSE2
+	const __m128 scale = _mm_set1_ps(1.0f/255.0f);
+	const __m128 unscale = _mm_set1_ps(255.0f);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128i zeroi = _mm_setzero_si128();
+	for (; x + 2 <= n; x += 2, dst += 8, span += 8) {
+		__m128 s0 = _mm_loadu_ps(span);
+		__m128 s1 = _mm_loadu_ps(span + 4);
+		__m128i d8 = _mm_loadl_epi64((const __m128i*)dst);
+		__m128i d16 = _mm_unpacklo_epi8(d8, zeroi);
+		__m128 d0 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(d16, zeroi)), scale);
+		__m128 d1 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(d16, zeroi)), scale);
+		__m128 ia0 = _mm_sub_ps(one, _mm_shuffle_ps(s0, s0, _MM_SHUFFLE(3,3,3,3)));
+		__m128 ia1 = _mm_sub_ps(one, _mm_shuffle_ps(s1, s1, _MM_SHUFFLE(3,3,3,3)));
+		__m128 o0 = _mm_add_ps(s0, _mm_mul_ps(d0, ia0));
+		__m128 o1 = _mm_add_ps(s1, _mm_mul_ps(d1, ia1));
+		__m128i i0, i1;
+		o0 = _mm_min_ps(_mm_max_ps(o0, zero), one);
+		o1 = _mm_min_ps(_mm_max_ps(o1, zero), one);
+		i0 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(o0, unscale), _mm_set1_ps(0.5f)));
+		i1 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(o1, unscale), _mm_set1_ps(0.5f)));
+		d16 = _mm_packs_epi32(i0, i1);
+		_mm_storel_epi64((__m128i*)dst, _mm_packus_epi16(d16, d16));
+	}
+#endif
+	for (; x < n; x++, dst += 4, span += 4) {
+		float ia = 1.0f - span[3];
+		dst[0] = swnvg__toByte(span[0] + dst[0] * (1.0f/255.0f) * ia);
+		dst[1] = swnvg__toByte(span[1] + dst[1] * (1.0f/255.0f) * ia);
+		dst[2] = swnvg__toByte(span[2] + dst[2] * (1.0f/255.0f) * ia);
+		dst[3] = swnvg__toByte(span[3] + dst[3] * (1.0f/255.0f) * ia);
+	}
+}
+
+static int swnvg__isSourceOver(NVGcompositeOperationState op)
+{
+	return op.srcRGB == NVG_ONE && op.dstRGB == NVG_ONE_MINUS_SRC_ALPHA &&
+		   op.srcAlpha == NVG_ONE && op.dstAlpha == NVG_ONE_MINUS_SRC_ALPHA;
+}
+
+static void swnvg__drawSpan(SWNVGcontext* sw, SWNVGtile* tile, const SWNVGcall* call, int x0, int x1, int y,
+							float u, float v, float du, float dv)
+{
+	unsigned char* dst = sw->pixels + (size_t)y * sw->stride + (size_t)x0 * 4;
+	if (x1 <= x0) return;
+	swnvg__shadeSpan(call, sw->flags & NVG_SW_ANTIALIAS, sw->flags & NVG_SW_BGRA, x0, x1, y, u, v, du, dv, tile->span);
+	if (swnvg__isSourceOver(call->blend))
+		swnvg__blendSpanOver(dst, tile->span, x1 - x0);
+	else
+		swnvg__blendSpanGeneric(dst, tile->span, x1 - x0, call->blend);
+}
+
+//
+// Rasterisation
+
+// Stencil test against the winding mask, see swnvg__fill.
+enum SWNVGstencil {
+	SWNVG_STENCIL_NONE,
+	SWNVG_STENCIL_OUTSIDE,
+};
+
+// X coordinate where the edge crosses the row centre, computed the same way for both triangles
+// sharing the edge so that they neither overlap nor leave gaps.
+static int swnvg__crossing(const NVGvertex* a, const NVGvertex* b, float cy, float* x)
+{
+	const NVGvertex* t;
+	if (a->y > b->y || (a->y == b->y && a->x > b->x)) {
+		t = a; a = b; b = t;
+	}
+	if (cy < a->y || cy >= b->y) return 0;
+	*x = a->x + (cy - a->y) * (b->x - a->x) / (b->y - a->y);
+	return 1;
+}
+
+// Rasterises a triangle clipped to the tile, sampling at pixel centres.
+static void swnvg__triangle(SWNVGcontext* sw, SWNVGtile* tile, const SWNVGcall* call,
+							const NVGvertex* v0, const NVGvertex* v1, const NVGvertex* v2, int stencil)
+{
+	float area = (v1->x - v0->x) * (v2->y - v0->y) - (v2->x - v0->x) * (v1->y - v0->y);
+	float dudx, dudy, dvdx, dvdy, ia;
+	float miny, maxy;
+	int y, y0, y1;
+
+	if (area == 0.0f) return;
+	ia = 1.0f / area;
+	dudx = ((v1->u - v0->u) * (v2->y - v0->y) - (v2->u - v0->u) * (v1->y - v0->y)) * ia;
+	dudy = ((v2->u - v0->u) * (v1->x - v0->x) - (v1->u - v0->u) * (v2->x - v0->x)) * ia;
+	dvdx = ((v1->v - v0->v) * (v2->y - v0->y) - (v2->v - v0->v) * (v1->y - v0->y)) * ia;
+	dvdy = ((v2->v - v0->v) * (v1->x - v0->x) - (v1->v - v0->v) * (v2->x - v0->x)) * ia;
+
+	miny = swnvg__minf(v0->y, swnvg__minf(v1->y, v2->y));
+	maxy = swnvg__maxf(v0->y, swnvg__maxf(v1->y, v2->y));
+	y0 = swnvg__maxi(tile->clip[1], (int)ceilf(miny - 0.5f));
+	y1 = swnvg__mini(tile->clip[3], (int)ceilf(maxy - 0.5f));
+
+	for (y = y0; y < y1; y++) {
+		float cy = y + 0.5f, xs[3], xl, xr, fx;
+		int n = 0, x0, x1, x;
+		n += swnvg__crossing(v0, v1, cy, &xs[n]);
+		n += swnvg__crossing(v1, v2, cy, &xs[n]);
+		n += swnvg__crossing(v2, v0, cy, &xs[n]);
+		if (n < 2) continue;
+		xl = swnvg__minf(xs[0], xs[1]);
+		xr = swnvg__maxf(xs[0], xs[1]);
+		x0 = swnvg__maxi(tile->clip[0], (int)ceilf(xl - 0.5f));
+		x1 = swnvg__mini(tile->clip[2], (int)ceilf(xr - 0.5f));
+		if (x1 <= x0) continue;
+
+		fx = x0 + 0.5f;
+		if (stencil == SWNVG_STENCIL_NONE) {
+			swnvg__drawSpan(sw, tile, call, x0, x1, y,
+							v0->u + dudx * (fx - v0->x) + dudy * (cy - v0->y),
+							v0->v + dvdx * (fx - v0->x) + dvdy * (cy - v0->y), dudx, dvdx);
+		} else {
+			// Draw the runs outside of the fill.
+			const short* w = &tile->winding[(y - tile->y0) * SWNVG_TILE_SIZE];
+			x = x0;
+			while (x < x1) {
+				int s;
+				while (x < x1 && w[x - tile->x0] != 0) x++;
+				s = x;
+				while (x < x1 && w[x - tile->x0] == 0) x++;
+				if (x > s) {
+					fx = s + 0.5f;
+					swnvg__drawSpan(sw, tile, call, s, x, y,
+									v0->u + dudx * (fx - v0->x) + dudy * (cy - v0->y),
+									v0->v + dvdx * (fx - v0->x) + dvdy * (cy - v0->y), dudx, dvdx);
+				}
+			}
+		}
+	}
+}
+
+static void swnvg__triangleStrip(SWNVGcontext* sw, SWNVGtile* tile, const SWNVGcall* call, const NVGvertex* verts, int n, int stencil)
+{
+	int i;
+	for (i = 0; i + 2 < n; i++)
+		swnvg__triangle(sw, tile, call, &verts[i], &verts[i+1], &verts[i+2], stencil);
+}
+
+static void swnvg__triangleFan(SWNVGcontext* sw, SWNVGtile* tile, const SWNVGcall* call, const NVGvertex* verts, int n)
+{
+	int i;
+	for (i = 1; i + 1 < n; i++)
+		swnvg__triangle(sw, tile, call, &verts[0], &verts[i], &verts[i+1], SWNVG_STENCIL_NONE);
+}
+
+static void swnvg__convexFill(SWNVGcontext* sw, SWNVGtile* tile, const SWNVGcall* call)
+{
+	SWNVGpath* paths = &sw->paths[call->pathOffset];
+	int i;
+	for (i = 0; i < call->pathCount; i++) {
+		swnvg__triangleFan(sw, tile, call, &sw->verts[paths[i].fillOffset], paths[i].fillCount);
+		// Draw fringes
+		if (paths[i].strokeCount > 0)
+			swnvg__triangleStrip(sw, tile, call, &sw->verts[paths[i].strokeOffset], paths[i].strokeCount, SWNVG_STENCIL_NONE);
+	}
+}
+
+// Nonzero winding at the pixel centres of the call bounds within the tile, the software
+// equivalent of the stencil pass of the GL backend.
+static void swnvg__windingMask(SWNVGcontext* sw, SWNVGtile* tile, const SWNVGcall* call)
+{
+	SWNVGpath* paths = &sw->paths[call->pathOffset];
+	int x0 = tile->clip[0], y0 = tile->clip[1], x1 = tile->clip[2], y1 = tile->clip[3];
+	int i, j, y;
+
+	for (y = y0; y < y1; y++)
+		memset(&tile->winding[(y - tile->y0) * SWNVG_TILE_SIZE + (x0 - tile->x0)], 0, sizeof(short) * (x1 - x0));
+
+	for (i = 0; i < call->pathCount; i++) {
+		const NVGvertex* pts = &sw->verts[paths[i].fillOffset];
+		int n = paths[i].fillCount;
+		for (j = 0; j < n; j++) {
+			const NVGvertex* a = &pts[j];
+			const NVGvertex* b = &pts[j+1 < n ? j+1 : 0];
+			int dir = a->y < b->y ? 1 : -1;
+			float ey0 = swnvg__minf(a->y, b->y), ey1 = swnvg__maxf(a->y, b->y);
+			int ya = swnvg__maxi(y0, (int)ceilf(ey0 - 0.5f));
+			int yb = swnvg__mini(y1, (int)ceilf(ey1 - 0.5f));
+			for (y = ya; y < yb; y++) {
+				float cx;
+				int x;
+				if (swnvg__crossing(a, b, y + 0.5f, &cx) == 0) continue;
+				x = swnvg__maxi(x0, (int)ceilf(cx - 0.5f));
+				if (x < x1)
+					tile->winding[(y - tile->y0) * SWNVG_TILE_SIZE + (x - tile->x0)] += (short)dir;
+			}
+		}
+	}
+
+	for (y = y0; y < y1; y++) {
+		short* w = &tile->winding[(y - tile->y0) * SWNVG_TILE_SIZE];
+		int x;
+		for (x = x0 - tile->x0 + 1; x < x1 - tile->x0; x++)
+			w[x] += w[x-1];
+	}
+}
+
+static void swnvg__fill(SWNVGcontext* sw, SWNVGtile* tile, const SWNVGcall* call)
+{
+	SWNVGpath* paths = &sw->paths[call->pathOffset];
+	int x0 = tile->clip[0], y0 = tile->clip[1], x1 = tile->clip[2], y1 = tile->clip[3];
+	int i, y;
+
+	swnvg__windingMask(sw, tile, call);
+
+	// Draw anti-aliased pixels outside of the fill.
+	if (sw->flags & NVG_SW_ANTIALIAS) {
+		for (i = 0; i < call->pathCount; i++)
+			swnvg__triangleStrip(sw, tile, call, &sw->verts[paths[i].strokeOffset], paths[i].strokeCount, SWNVG_STENCIL_OUTSIDE);
+	}
+
+	// Draw fill, the cover quad has u=0.5, v=1 which gives full coverage.
+	for (y = y0; y < y1; y++) {
+		const short* w = &tile->winding[(y - tile->y0) * SWNVG_TILE_SIZE];
+		int x = x0;
+		while (x < x1) {
+			int s;
+			while (x < x1 && w[x - tile->x0] == 0) x++;
+			s = x;
+			while (x < x1 && w[x - tile->x0] != 0) x++;
+			if (x > s)
+				swnvg__drawSpan(sw, tile, call, s, x, y, 0.5f, 1.0f, 0.0f, 0.0f);
+		}
+	}
+}
+
+static void swnvg__stroke(SWNVGcontext* sw, SWNVGtile* tile, const SWNVGcall* call)
+{
+	SWNVGpath* paths = &sw->paths[call->pathOffset];
+	int i;
+	for (i = 0; i < call->pathCount; i++)
+		swnvg__triangleStrip(sw, tile, call, &sw->verts[paths[i].strokeOffset], paths[i].strokeCount, SWNVG_STENCIL_NONE);
+}
+
+static void swnvg__triangles(SWNVGcontext* sw, SWNVGtile* tile, const SWNVGcall* call)
+{
+	const NVGvertex* verts = &sw->verts[call->triangleOffset];
+	int i;
+	for (i = 0; i + 2 < call->triangleCount; i += 3)
+		swnvg__triangle(sw, tile, call, &verts[i], &verts[i+1], &verts[i+2], SWNVG_STENCIL_NONE);
+}
+
+// Runs every call of the frame restricted to a single tile, tiles never share pixels.
+static void swnvg__renderTile(void* arg, int index)
+{
+	SWNVGcontext* sw = (SWNVGcontext*)arg;
+	SWNVGtile tile;
+	int i;
+
+	tile.x0 = (index % sw->tilesX) * SWNVG_TILE_SIZE;
+	tile.y0 = (index / sw->tilesX) * SWNVG_TILE_SIZE;
+	tile.x1 = swnvg__mini(tile.x0 + SWNVG_TILE_SIZE, sw->width);
+	tile.y1 = swnvg__mini(tile.y0 + SWNVG_TILE_SIZE, sw->height);
+
+	for (i = 0; i < sw->ncalls; i++) {
+		const SWNVGcall* call = &sw->calls[i];
+		if (call->bounds[0] >= tile.x1 || call->bounds[2] <= tile.x0 ||
+			call->bounds[1] >= tile.y1 || call->bounds[3] <= tile.y0)
+			continue;
+		tile.clip[0] = swnvg__maxi(tile.x0, call->bounds[0]);
+		tile.clip[1] = swnvg__maxi(tile.y0, call->bounds[1]);
+		tile.clip[2] = swnvg__mini(tile.x1, call->bounds[2]);
+		tile.clip[3] = swnvg__mini(tile.y1, call->bounds[3]);
+		switch (call->type) {
+		case SWNVG_FILL: swnvg__fill(sw, &tile, call); break;
+		case SWNVG_CONVEXFILL: swnvg__convexFill(sw, &tile, call); break;
+		case SWNVG_STROKE: swnvg__stroke(sw, &tile, call); break;
+		case SWNVG_TRIANGLES: swnvg__triangles(sw, &tile, call); break;
+		}
+	}
+}
+
+static void swnvg__renderFlush(void* uptr)
+{
+	SWNVGcontext* sw = (SWNVGcontext*)uptr;
+	int i, ntiles;
+
+	if (sw->ncalls > 0 && sw->pixels != NULL && sw->width > 0 && sw->height > 0) {
+		for (i = 0; i < sw->ncalls; i++) {
+			SWNVGcall* call = &sw->calls[i];
+			call->tex = call->paint.image != 0 ? swnvg__findTexture(sw, call->paint.image) : NULL;
+		}
+
+		sw->tilesX = (sw->width + SWNVG_TILE_SIZE-1) / SWNVG_TILE_SIZE;
+		sw->tilesY = (sw->height + SWNVG_TILE_SIZE-1) / SWNVG_TILE_SIZE;
+		ntiles = sw->tilesX * sw->tilesY;
+
+		if (sw->parallelFor != NULL) {
+			sw->parallelFor(sw->parallelUserPtr, ntiles, swnvg__renderTile, sw);
+		} else {
+			for (i = 0; i < ntiles; i++)
+				swnvg__renderTile(sw, i);
+		}
+	}
+
+	// Reset calls
+	sw->nverts = 0;
+	sw->npaths = 0;
+	sw->ncalls = 0;
+}
+
+static void swnvg__renderDelete(void* uptr)
+{
+	SWNVGcontext* sw = (SWNVGcontext*)uptr;
+	int i;
+	if (sw == NULL) return;
+
+	for (i = 0; i < sw->ntextures; i++)
+		free(sw->textures[i].data);
+	free(sw->textures);
+
+	// The per frame buffers live in the frame arena owned by the context.
+	free(sw);
+}
+
+NVGcontext* nvgCreateSW(int flags)
+{
+	NVGparams params;
+	NVGcontext* ctx = NULL;
+	SWNVGcontext* sw = (SWNVGcontext*)malloc(sizeof(SWNVGcontext));
+	if (sw == NULL) goto error;
+	memset(sw, 0, sizeof(SWNVGcontext));
+
+	memset(&params, 0, sizeof(params));
+	params.renderCreate = swnvg__renderCreate;
+	params.renderCreateTexture = swnvg__renderCreateTexture;
+	params.renderDeleteTexture = swnvg__renderDeleteTexture;
+	params.renderUpdateTexture = swnvg__renderUpdateTexture;
+	params.renderGetTextureSize = swnvg__renderGetTextureSize;
+	params.renderViewport = swnvg__renderViewport;
+	params.renderCancel = swnvg__renderCancel;
+	params.renderFlush = swnvg__renderFlush;
+	params.renderFill = swnvg__renderFill;
+	params.renderStroke = swnvg__renderStroke;
+	params.renderTriangles = swnvg__renderTriangles;
+	params.renderDelete = swnvg__renderDelete;
+	params.userPtr = sw;
+	params.edgeAntiAlias = flags & NVG_SW_ANTIALIAS ? 1 : 0;
+	params.gradientRamps = 1;
+
+	sw->flags = flags;
+	sw->devicePixelRatio = 1.0f;
+
+	ctx = nvgCreateInternal(&params);
+	if (ctx == NULL) goto error;
+
+	sw->arena = nvgInternalParams(ctx)->frameArena;
+
+	return ctx;
+
+error:
+	// 'sw' is freed by nvgDeleteInternal.
+	if (ctx != NULL) nvgDeleteInternal(ctx);
+	return NULL;
+}
+
+void nvgDeleteSW(NVGcontext* ctx)
+{
+	nvgDeleteInternal(ctx);
+}
+
+void nvgswSetTarget(NVGcontext* ctx, unsigned char* pixels, int width, int height, int stride)
+{
+	SWNVGcontext* sw = (SWNVGcontext*)nvgInternalParams(ctx)->userPtr;
+	sw->pixels = pixels;
+	sw->width = width;
+	sw->height = height;
+	sw->stride = stride;
+}
+
+void nvgswSetParallelFor(NVGcontext* ctx, NVGswParallelFor parallelFor, void* userPtr)
+{
+	SWNVGcontext* sw = (SWNVGcontext*)nvgInternalParams(ctx)->userPtr;
+	sw->parallelFor = parallelFor;
+	sw->parallelUserPtr = userPtr;
+}
+
+#endif /* NANOVG_SW_IMPLEMENTATION */
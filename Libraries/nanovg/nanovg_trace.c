@@ -0,0 +1,934 @@
+//
+//  Copyright (C) 2022 Arthur Benilov <arthur.benilov@gmail.com> and Timothy Schoen <timschoen123@gmail.com>
+//
+// Copyright (c) 2013 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "nanovg_trace.h"
+
+#define NVG_TRACE_MAX_NAME 64
+
+static const char* nvg__traceFormats[NVG_TRACE_OPS] = {
+	"fff",		// NVG_TRACE_BEGIN_FRAME
+	"",			// NVG_TRACE_CANCEL_FRAME
+	"",			// NVG_TRACE_END_FRAME
+	"",			// NVG_TRACE_SAVE
+	"",			// NVG_TRACE_RESTORE
+	"",			// NVG_TRACE_RESET
+	"i",		// NVG_TRACE_SHAPE_ANTIALIAS
+	"f",		// NVG_TRACE_STROKE_WIDTH
+	"f",		// NVG_TRACE_MITER_LIMIT
+	"i",		// NVG_TRACE_LINE_CAP
+	"i",		// NVG_TRACE_LINE_JOIN
+	"f",		// NVG_TRACE_GLOBAL_ALPHA
+	"ffffff",	// NVG_TRACE_TRANSFORM
+	"",			// NVG_TRACE_RESET_TRANSFORM
+	"ff",		// NVG_TRACE_TRANSLATE
+	"f",		// NVG_TRACE_ROTATE
+	"f",		// NVG_TRACE_SKEW_X
+	"f",		// NVG_TRACE_SKEW_Y
+	"ff",		// NVG_TRACE_SCALE
+	"c",		// NVG_TRACE_STROKE_COLOR
+	"p",		// NVG_TRACE_STROKE_PAINT
+	"c",		// NVG_TRACE_FILL_COLOR
+	"p",		// NVG_TRACE_FILL_PAINT
+	"ffff",		// NVG_TRACE_SCISSOR
+	"ffff",		// NVG_TRACE_INTERSECT_SCISSOR
+	"",			// NVG_TRACE_RESET_SCISSOR
+	"i",		// NVG_TRACE_COMPOSITE_OPERATION
+	"iiii",		// NVG_TRACE_COMPOSITE_BLEND
+	"",			// NVG_TRACE_BEGIN_PATH
+	"ff",		// NVG_TRACE_MOVE_TO
+	"ff",		// NVG_TRACE_LINE_TO
+	"ffffff",	// NVG_TRACE_BEZIER_TO
+	"ffff",		// NVG_TRACE_QUAD_TO
+	"fffff",	// NVG_TRACE_ARC_TO
+	"",			// NVG_TRACE_CLOSE_PATH
+	"i",		// NVG_TRACE_PATH_WINDING
+	"Fx",		// NVG_TRACE_APPEND_PATH
+	"fffffi",	// NVG_TRACE_ARC
+	"ffff",		// NVG_TRACE_RECT
+	"ffffffff",	// NVG_TRACE_ROUNDED_RECT
+	"ffff",		// NVG_TRACE_ELLIPSE
+	"u",		// NVG_TRACE_BEGIN_RETAINED_PATH
+	"i",		// NVG_TRACE_RETAINED_BUDGET
+	"",			// NVG_TRACE_CLEAR_RETAINED
+	"",			// NVG_TRACE_FILL
+	"",			// NVG_TRACE_STROKE
+	"f",		// NVG_TRACE_FONT_SIZE
+	"f",		// NVG_TRACE_FONT_BLUR
+	"f",		// NVG_TRACE_LETTER_SPACING
+	"f",		// NVG_TRACE_LINE_HEIGHT
+	"i",		// NVG_TRACE_TEXT_ALIGN
+	"i",		// NVG_TRACE_FONT_FACE_ID
+	"s",		// NVG_TRACE_FONT_FACE
+	"ffs",		// NVG_TRACE_TEXT
+	"fffs",		// NVG_TRACE_TEXT_BOX
+	"iiiib",	// NVG_TRACE_CREATE_IMAGE: image, width, height, flags, RGBA pixels
+	"ib",		// NVG_TRACE_UPDATE_IMAGE: image, pixels in the byte order of the image
+	"i",		// NVG_TRACE_DELETE_IMAGE
+	"iii",		// NVG_TRACE_PLACEHOLDER_IMAGE: image, width, height
+	"isib",		// NVG_TRACE_CREATE_FONT: font, name, face index, font file
+	"ii",		// NVG_TRACE_FALLBACK_FONT: base font, fallback font
+	"iiiib",	// NVG_TRACE_CREATE_IMAGE_BGRA: image, width, height, flags, BGRA pixels
+	"iiiiib",	// NVG_TRACE_UPDATE_IMAGE_REGION: image, x, y, width, height, pixels of the region
+	"bF",		// NVG_TRACE_TEXT_RUN: 32-bit codepoints, positions
+	"bF",		// NVG_TRACE_GLYPHS: 32-bit glyph indices, positions
+	"F",		// NVG_TRACE_FILL_RECTS: x, y, w, h of each rectangle
+	"",			// NVG_TRACE_CLIP_PATH
+	"ffff",		// NVG_TRACE_EXCLUDE_CLIP_RECT
+	"p",		// NVG_TRACE_CLIP_IMAGE_ALPHA
+	"",			// NVG_TRACE_BEGIN_LAYER
+	"f",		// NVG_TRACE_END_LAYER
+	"ifbF",		// NVG_TRACE_GRADIENT_RAMP: ramp image, ramp, colors of the stops, offsets of the stops
+};
+
+const char* nvgTraceFormat(int op)
+{
+	if (op < 0 || op >= NVG_TRACE_OPS) return NULL;
+	return nvg__traceFormats[op];
+}
+
+static int nvg__traceResourceOp(int op)
+{
+	// Image and font ops, NVG_TRACE_TEXT_RUN and later are drawing ops again.
+	return op >= NVG_TRACE_CREATE_IMAGE && op < NVG_TRACE_TEXT_RUN;
+}
+
+static int nvg__traceEndsFrame(int op)
+{
+	return op == NVG_TRACE_END_FRAME || op == NVG_TRACE_CANCEL_FRAME;
+}
+
+static int nvg__tracePathOp(int op)
+{
+	return op >= NVG_TRACE_MOVE_TO && op <= NVG_TRACE_ELLIPSE;
+}
+
+
+//
+// Writing
+//
+
+struct NVGtrace {
+	FILE* fp;
+	int frames;		// Number of frames to record, 0 for no limit.
+	int nframes;
+	int started;
+	int error;
+	int* images;
+	int nimages;
+	int cimages;
+};
+
+static void nvg__traceWrite(NVGtrace* trace, const void* data, int size)
+{
+	if (size > 0 && fwrite(data, 1, size, trace->fp) != (size_t)size)
+		trace->error = 1;
+}
+
+static void nvg__traceWriteInt(NVGtrace* trace, int v)
+{
+	nvg__traceWrite(trace, &v, sizeof(v));
+}
+
+static void nvg__traceWriteFloat(NVGtrace* trace, float v)
+{
+	nvg__traceWrite(trace, &v, sizeof(v));
+}
+
+static void nvg__traceWriteColor(NVGtrace* trace, const NVGcolor* c)
+{
+	nvg__traceWrite(trace, c->rgba, sizeof(float)*4);
+}
+
+static void nvg__traceWritePaint(NVGtrace* trace, const NVGpaint* p)
+{
+	nvg__traceWrite(trace, p->xform, sizeof(float)*6);
+	nvg__traceWrite(trace, p->extent, sizeof(float)*2);
+	nvg__traceWriteFloat(trace, p->radius);
+	nvg__traceWriteFloat(trace, p->feather);
+	nvg__traceWriteColor(trace, &p->innerColor);
+	nvg__traceWriteColor(trace, &p->outerColor);
+	nvg__traceWriteInt(trace, p->image);
+	nvg__traceWriteFloat(trace, p->ramp);
+}
+
+NVGtrace* nvgTraceOpen(const char* filename, int frames)
+{
+	NVGtrace* trace = (NVGtrace*)malloc(sizeof(NVGtrace));
+	if (trace == NULL) return NULL;
+	memset(trace, 0, sizeof(NVGtrace));
+	trace->frames = frames > 0 ? frames : 0;
+
+	trace->fp = fopen(filename, "wb");
+	if (trace->fp == NULL) {
+		free(trace);
+		return NULL;
+	}
+
+	nvg__traceWrite(trace, NVG_TRACE_MAGIC, 8);
+	nvg__traceWriteInt(trace, NVG_TRACE_VERSION);
+	if (trace->error) {
+		nvgTraceClose(trace);
+		return NULL;
+	}
+	return trace;
+}
+
+void nvgTraceClose(NVGtrace* trace)
+{
+	if (trace == NULL) return;
+	fclose(trace->fp);
+	free(trace->images);
+	free(trace);
+}
+
+int nvgTraceWriteV(NVGtrace* trace, int op, va_list args)
+{
+	const char* format = nvgTraceFormat(op);
+	unsigned char code = (unsigned char)op;
+
+	if (format == NULL) return 1;
+
+	if (op == NVG_TRACE_BEGIN_FRAME)
+		trace->started = 1;
+	if (!trace->started && !nvg__traceResourceOp(op))
+		return 1;
+
+	nvg__traceWrite(trace, &code, 1);
+	for (; *format; format++) {
+		switch (*format) {
+		case 'f':
+			nvg__traceWriteFloat(trace, (float)va_arg(args, double));
+			break;
+		case 'i':
+			nvg__traceWriteInt(trace, va_arg(args, int));
+			break;
+		case 'u': {
+			unsigned long long v = va_arg(args, unsigned long long);
+			nvg__traceWrite(trace, &v, sizeof(v));
+		} break;
+		case 'c':
+			nvg__traceWriteColor(trace, va_arg(args, const NVGcolor*));
+			break;
+		case 'p':
+			nvg__traceWritePaint(trace, va_arg(args, const NVGpaint*));
+			break;
+		case 's': {
+			const char* string = va_arg(args, const char*);
+			const char* end = va_arg(args, const char*);
+			if (string == NULL) string = end = "";
+			if (end == NULL) end = string + strlen(string);
+			nvg__traceWriteInt(trace, (int)(end - string));
+			nvg__traceWrite(trace, string, (int)(end - string));
+		} break;
+		case 'b': {
+			const void* data = va_arg(args, const void*);
+			int size = va_arg(args, int);
+			if (data == NULL) size = 0;
+			nvg__traceWriteInt(trace, size);
+			nvg__traceWrite(trace, data, size);
+		} break;
+		case 'F': {
+			const float* values = va_arg(args, const float*);
+			int count = va_arg(args, int);
+			nvg__traceWriteInt(trace, count);
+			nvg__traceWrite(trace, values, count * (int)sizeof(float));
+		} break;
+		case 'x': {
+			const float* xform = va_arg(args, const float*);
+			unsigned char present = xform != NULL ? 1 : 0;
+			nvg__traceWrite(trace, &present, 1);
+			if (present)
+				nvg__traceWrite(trace, xform, sizeof(float)*6);
+		} break;
+		}
+	}
+
+	if (trace->error)
+		return 0;
+	if (nvg__traceEndsFrame(op) && trace->started) {
+		trace->nframes++;
+		if (trace->frames > 0 && trace->nframes >= trace->frames)
+			return 0;
+	}
+	return 1;
+}
+
+int nvgTraceHasImage(NVGtrace* trace, int image)
+{
+	int i;
+	for (i = 0; i < trace->nimages; i++) {
+		if (trace->images[i] == image)
+			return 1;
+	}
+	return 0;
+}
+
+void nvgTraceAddImage(NVGtrace* trace, int image)
+{
+	if (nvgTraceHasImage(trace, image)) return;
+	if (trace->nimages + 1 > trace->cimages) {
+		int cimages = trace->cimages > 0 ? trace->cimages * 2 : 64;
+		int* images = (int*)realloc(trace->images, sizeof(int) * cimages);
+		if (images == NULL) return;
+		trace->images = images;
+		trace->cimages = cimages;
+	}
+	trace->images[trace->nimages++] = image;
+}
+
+void nvgTraceRemoveImage(NVGtrace* trace, int image)
+{
+	int i;
+	for (i = 0; i < trace->nimages; i++) {
+		if (trace->images[i] == image) {
+			trace->images[i] = trace->images[--trace->nimages];
+			return;
+		}
+	}
+}
+
+
+//
+// Replay
+//
+
+#define NVG_REPLAY_RAMPS 256
+
+struct NVGreplayRamp {
+	int image;
+	float ramp;
+	NVGpaint paint;
+};
+typedef struct NVGreplayRamp NVGreplayRamp;
+
+struct NVGreplay {
+	NVGcontext* ctx;
+	unsigned char* data;
+	int size;
+	int start;			// Offset of the first frame, the records before it are replayed on load.
+	int* frames;		// Per frame, the offsets of its nvgBeginFrame() record and of its end.
+	int nframes;
+	int* images;		// Trace image to context image, 0 if not created.
+	int cimages;
+	int* fonts;			// Trace font to context font + 1, 0 if not created.
+	int cfonts;
+	float* scratch;
+	int cscratch;
+	unsigned char* bytes;	// Whole images for nvgUpdateImageRegion(), aligned codepoints for nvgTextRun().
+	int cbytes;
+	int skipPath;		// Set when nvgBeginRetainedPath() found the path, its commands are skipped.
+	NVGreplayRamp ramps[NVG_REPLAY_RAMPS];	// Traced ramps of gradients, and the paints made for them.
+	int nramps;
+};
+
+struct NVGtraceArgs {
+	float f[8];
+	int i[8];
+	unsigned long long u;
+	NVGcolor color;
+	NVGpaint paint;
+	const char* string;
+	int nstring;
+	const unsigned char* bytes;
+	int nbytes;
+	const float* floats;
+	int nfloats;
+	float xform[6];
+	int hasXform;
+};
+typedef struct NVGtraceArgs NVGtraceArgs;
+
+struct NVGtraceReader {
+	const unsigned char* ptr;
+	const unsigned char* end;
+	int error;
+};
+typedef struct NVGtraceReader NVGtraceReader;
+
+static void nvg__traceRead(NVGtraceReader* r, void* dst, int size)
+{
+	if (size < 0 || r->end - r->ptr < size) {
+		r->error = 1;
+		return;
+	}
+	if (dst != NULL)
+		memcpy(dst, r->ptr, size);
+	r->ptr += size;
+}
+
+static int nvg__traceReadInt(NVGtraceReader* r)
+{
+	int v = 0;
+	nvg__traceRead(r, &v, sizeof(v));
+	return v;
+}
+
+// Returns a pointer to the next size bytes of the trace, and skips them.
+static const unsigned char* nvg__traceReadBytes(NVGtraceReader* r, int size)
+{
+	const unsigned char* ptr = r->ptr;
+	nvg__traceRead(r, NULL, size);
+	return r->error ? NULL : ptr;
+}
+
+static void nvg__traceReadColor(NVGtraceReader* r, NVGcolor* c)
+{
+	nvg__traceRead(r, c->rgba, sizeof(float)*4);
+}
+
+static void nvg__traceReadPaint(NVGtraceReader* r, NVGpaint* p)
+{
+	nvg__traceRead(r, p->xform, sizeof(float)*6);
+	nvg__traceRead(r, p->extent, sizeof(float)*2);
+	nvg__traceRead(r, &p->radius, sizeof(float));
+	nvg__traceRead(r, &p->feather, sizeof(float));
+	nvg__traceReadColor(r, &p->innerColor);
+	nvg__traceReadColor(r, &p->outerColor);
+	p->image = nvg__traceReadInt(r);
+	nvg__traceRead(r, &p->ramp, sizeof(float));
+}
+
+static unsigned char* nvg__replayBytes(NVGreplay* replay, int size)
+{
+	if (size > replay->cbytes) {
+		unsigned char* bytes = (unsigned char*)realloc(replay->bytes, (size_t)size);
+		if (bytes == NULL) return NULL;
+		replay->bytes = bytes;
+		replay->cbytes = size;
+	}
+	return replay->bytes;
+}
+
+static float* nvg__replayScratch(NVGreplay* replay, int count)
+{
+	if (count > replay->cscratch) {
+		int cscratch = count + count/2;
+		float* scratch = (float*)realloc(replay->scratch, sizeof(float) * cscratch);
+		if (scratch == NULL) return NULL;
+		replay->scratch = scratch;
+		replay->cscratch = cscratch;
+	}
+	return replay->scratch;
+}
+
+// Reads the next record, returns its op or -1 at the end of the trace or on error.
+static int nvg__traceReadRecord(NVGreplay* replay, NVGtraceReader* r, NVGtraceArgs* args)
+{
+	const char* format;
+	unsigned char code;
+	int nf = 0, ni = 0;
+
+	if (r->ptr >= r->end) return -1;
+	nvg__traceRead(r, &code, 1);
+	format = nvgTraceFormat(code);
+	if (format == NULL) {
+		r->error = 1;
+		return -1;
+	}
+
+	for (; *format && !r->error; format++) {
+		switch (*format) {
+		case 'f':
+			nvg__traceRead(r, &args->f[nf++], sizeof(float));
+			break;
+		case 'i':
+			args->i[ni++] = nvg__traceReadInt(r);
+			break;
+		case 'u':
+			nvg__traceRead(r, &args->u, sizeof(args->u));
+			break;
+		case 'c':
+			nvg__traceReadColor(r, &args->color);
+			break;
+		case 'p':
+			nvg__traceReadPaint(r, &args->paint);
+			break;
+		case 's':
+			args->nstring = nvg__traceReadInt(r);
+			args->string = (const char*)nvg__traceReadBytes(r, args->nstring);
+			break;
+		case 'b':
+			args->nbytes = nvg__traceReadInt(r);
+			args->bytes = nvg__traceReadBytes(r, args->nbytes);
+			if (args->nbytes == 0) args->bytes = NULL;
+			break;
+		case 'F': {
+			// Copied out, since floats in the trace are not aligned.
+			const unsigned char* src;
+			float* dst;
+			args->nfloats = nvg__traceReadInt(r);
+			src = nvg__traceReadBytes(r, args->nfloats * (int)sizeof(float));
+			dst = nvg__replayScratch(replay, args->nfloats);
+			if (src == NULL || dst == NULL) {
+				r->error = 1;
+				break;
+			}
+			memcpy(dst, src, args->nfloats * sizeof(float));
+			args->floats = dst;
+		} break;
+		case 'x': {
+			unsigned char present = 0;
+			nvg__traceRead(r, &present, 1);
+			args->hasXform = present;
+			if (present)
+				nvg__traceRead(r, args->xform, sizeof(float)*6);
+		} break;
+		}
+	}
+
+	return r->error ? -1 : code;
+}
+
+static int nvg__replayImage(NVGreplay* replay, int image)
+{
+	if (image <= 0 || image >= replay->cimages) return 0;
+	return replay->images[image];
+}
+
+static void nvg__replaySetImage(NVGreplay* replay, int image, int id)
+{
+	if (image <= 0) return;
+	if (image >= replay->cimages) {
+		int cimages = image + 64;
+		int* images = (int*)realloc(replay->images, sizeof(int) * cimages);
+		if (images == NULL) return;
+		memset(images + replay->cimages, 0, sizeof(int) * (cimages - replay->cimages));
+		replay->images = images;
+		replay->cimages = cimages;
+	}
+	replay->images[image] = id;
+}
+
+static int nvg__replayFont(NVGreplay* replay, int font)
+{
+	if (font < 0 || font >= replay->cfonts) return -1;
+	return replay->fonts[font] - 1;
+}
+
+static void nvg__replaySetFont(NVGreplay* replay, int font, int id)
+{
+	if (font < 0) return;
+	if (font >= replay->cfonts) {
+		int cfonts = font + 16;
+		int* fonts = (int*)realloc(replay->fonts, sizeof(int) * cfonts);
+		if (fonts == NULL) return;
+		memset(fonts + replay->cfonts, 0, sizeof(int) * (cfonts - replay->cfonts));
+		replay->fonts = fonts;
+		replay->cfonts = cfonts;
+	}
+	replay->fonts[font] = id + 1;
+}
+
+static void nvg__replayString(char* dst, const NVGtraceArgs* args)
+{
+	int n = args->nstring < NVG_TRACE_MAX_NAME-1 ? args->nstring : NVG_TRACE_MAX_NAME-1;
+	memcpy(dst, args->string, n);
+	dst[n] = '\0';
+}
+
+static void nvg__replayCreateImage(NVGreplay* replay, const NVGtraceArgs* args, int bgra)
+{
+	NVGcontext* ctx = replay->ctx;
+	int image = nvg__replayImage(replay, args->i[0]);
+	int w = args->i[1], h = args->i[2];
+	const unsigned char* data = args->nbytes == w*h*4 ? args->bytes : NULL;
+
+	// A repeated frame recreates its images, update them instead of piling up copies.
+	if (image != 0) {
+		int iw = 0, ih = 0;
+		nvgImageSize(ctx, image, &iw, &ih);
+		if (iw == w && ih == h) {
+			if (data != NULL)
+				nvgUpdateImage(ctx, image, data);
+			return;
+		}
+		nvgDeleteImage(ctx, image);
+	}
+	if (bgra)
+		image = nvgCreateImageBGRA(ctx, w, h, args->i[3], data);
+	else
+		image = nvgCreateImageRGBA(ctx, w, h, args->i[3], data);
+	nvg__replaySetImage(replay, args->i[0], image);
+}
+
+static void nvg__replayUpdateImageRegion(NVGreplay* replay, const NVGtraceArgs* args)
+{
+	NVGcontext* ctx = replay->ctx;
+	int image = nvg__replayImage(replay, args->i[0]);
+	int x = args->i[1], y = args->i[2], w = args->i[3], h = args->i[4];
+	int iw = 0, ih = 0, row;
+	unsigned char* pixels;
+
+	if (image == 0 || args->bytes == NULL) return;
+	nvgImageSize(ctx, image, &iw, &ih);
+	if (x < 0 || y < 0 || w <= 0 || h <= 0 || x + w > iw || y + h > ih || args->nbytes != w*h*4) return;
+
+	pixels = nvg__replayBytes(replay, iw*ih*4);
+	if (pixels == NULL) return;
+	for (row = 0; row < h; row++)
+		memcpy(pixels + ((size_t)(y+row)*iw + x)*4, args->bytes + (size_t)row*w*4, (size_t)w*4);
+	nvgUpdateImageRegion(ctx, image, x, y, w, h, pixels);
+}
+
+// Replays nvgTextRun() or nvgGlyphs().
+static void nvg__replayGlyphRun(NVGreplay* replay, const NVGtraceArgs* args, int glyphIndices)
+{
+	int count = args->nbytes / 4;
+	unsigned char* ids;
+
+	if (count == 0 || args->nfloats != count*2) return;
+	ids = nvg__replayBytes(replay, args->nbytes);
+	if (ids == NULL) return;
+	memcpy(ids, args->bytes, (size_t)args->nbytes);
+	if (glyphIndices)
+		nvgGlyphs(replay->ctx, (const int*)ids, args->floats, count);
+	else
+		nvgTextRun(replay->ctx, (const unsigned int*)ids, args->floats, count);
+}
+
+static void nvg__replayGradientRamp(NVGreplay* replay, const NVGtraceArgs* args)
+{
+	NVGreplayRamp* ramp = NULL;
+	NVGcolor* colors;
+	int i, nstops = args->nfloats;
+
+	if (nstops == 0 || args->nbytes != nstops * (int)sizeof(NVGcolor)) return;
+	colors = (NVGcolor*)nvg__replayBytes(replay, args->nbytes);
+	if (colors == NULL) return;
+	memcpy(colors, args->bytes, (size_t)args->nbytes);
+
+	// A row of the traced atlas is replaced by the newest ramp written to it.
+	for (i = 0; i < replay->nramps; i++) {
+		if (replay->ramps[i].image == args->i[0] && replay->ramps[i].ramp == args->f[0])
+			ramp = &replay->ramps[i];
+	}
+	if (ramp == NULL)
+		ramp = &replay->ramps[replay->nramps < NVG_REPLAY_RAMPS ? replay->nramps++ : 0];
+	ramp->image = args->i[0];
+	ramp->ramp = args->f[0];
+	ramp->paint = nvgLinearGradientStops(replay->ctx, 0.0f, 0.0f, 1.0f, 0.0f, args->floats, colors, nstops);
+}
+
+// Maps the image of a traced paint to the context, or the ramp of a gradient to the one made for it.
+static void nvg__replayPaint(NVGreplay* replay, NVGpaint* paint)
+{
+	int i;
+	if (paint->ramp > 0.0f) {
+		for (i = 0; i < replay->nramps; i++) {
+			const NVGreplayRamp* ramp = &replay->ramps[i];
+			if (ramp->image == paint->image && ramp->ramp == paint->ramp) {
+				paint->image = ramp->paint.image;
+				paint->ramp = ramp->paint.ramp;
+				paint->innerColor = ramp->paint.innerColor;
+				paint->outerColor = ramp->paint.outerColor;
+				return;
+			}
+		}
+		paint->ramp = 0.0f;
+	}
+	paint->image = nvg__replayImage(replay, paint->image);
+}
+
+static void nvg__replayPlaceholderImage(NVGreplay* replay, const NVGtraceArgs* args)
+{
+	int w = args->i[1], h = args->i[2];
+	unsigned char* data;
+
+	if (nvg__replayImage(replay, args->i[0]) != 0 || w <= 0 || h <= 0) return;
+
+	data = (unsigned char*)malloc(w*h*4);
+	if (data == NULL) return;
+	memset(data, 0x80, w*h*4);
+	nvg__replaySetImage(replay, args->i[0], nvgCreateImageRGBA(replay->ctx, w, h, 0, data));
+	free(data);
+}
+
+static void nvg__replayCreateFont(NVGreplay* replay, const NVGtraceArgs* args)
+{
+	char name[NVG_TRACE_MAX_NAME];
+	unsigned char* data;
+	int font;
+
+	if (nvg__replayFont(replay, args->i[0]) != -1 || args->bytes == NULL) return;
+
+	// The context keeps font data until it is deleted, which may be after the replay.
+	data = (unsigned char*)malloc(args->nbytes);
+	if (data == NULL) return;
+	memcpy(data, args->bytes, args->nbytes);
+	nvg__replayString(name, args);
+
+	font = nvgCreateFontFaceMem(replay->ctx, name, data, args->nbytes, args->i[1], 1);
+	if (font != -1)
+		nvg__replaySetFont(replay, args->i[0], font);
+}
+
+static void nvg__replayRecord(NVGreplay* replay, int op, NVGtraceArgs* a)
+{
+	NVGcontext* ctx = replay->ctx;
+	const float* f = a->f;
+	char name[NVG_TRACE_MAX_NAME];
+
+	if (nvg__tracePathOp(op)) {
+		if (replay->skipPath) return;
+	} else {
+		replay->skipPath = 0;
+	}
+
+	switch (op) {
+	case NVG_TRACE_BEGIN_FRAME: nvgBeginFrame(ctx, f[0], f[1], f[2]); break;
+	case NVG_TRACE_CANCEL_FRAME: nvgCancelFrame(ctx); break;
+	case NVG_TRACE_END_FRAME: nvgEndFrame(ctx); break;
+	case NVG_TRACE_SAVE: nvgSave(ctx); break;
+	case NVG_TRACE_RESTORE: nvgRestore(ctx); break;
+	case NVG_TRACE_RESET: nvgReset(ctx); break;
+	case NVG_TRACE_SHAPE_ANTIALIAS: nvgShapeAntiAlias(ctx, a->i[0]); break;
+	case NVG_TRACE_STROKE_WIDTH: nvgStrokeWidth(ctx, f[0]); break;
+	case NVG_TRACE_MITER_LIMIT: nvgMiterLimit(ctx, f[0]); break;
+	case NVG_TRACE_LINE_CAP: nvgLineCap(ctx, a->i[0]); break;
+	case NVG_TRACE_LINE_JOIN: nvgLineJoin(ctx, a->i[0]); break;
+	case NVG_TRACE_GLOBAL_ALPHA: nvgGlobalAlpha(ctx, f[0]); break;
+	case NVG_TRACE_TRANSFORM: nvgTransform(ctx, f[0], f[1], f[2], f[3], f[4], f[5]); break;
+	case NVG_TRACE_RESET_TRANSFORM: nvgResetTransform(ctx); break;
+	case NVG_TRACE_TRANSLATE: nvgTranslate(ctx, f[0], f[1]); break;
+	case NVG_TRACE_ROTATE: nvgRotate(ctx, f[0]); break;
+	case NVG_TRACE_SKEW_X: nvgSkewX(ctx, f[0]); break;
+	case NVG_TRACE_SKEW_Y: nvgSkewY(ctx, f[0]); break;
+	case NVG_TRACE_SCALE: nvgScale(ctx, f[0], f[1]); break;
+	case NVG_TRACE_STROKE_COLOR: nvgStrokeColor(ctx, a->color); break;
+	case NVG_TRACE_STROKE_PAINT:
+		nvg__replayPaint(replay, &a->paint);
+		nvgStrokePaint(ctx, a->paint);
+		break;
+	case NVG_TRACE_FILL_COLOR: nvgFillColor(ctx, a->color); break;
+	case NVG_TRACE_FILL_PAINT:
+		nvg__replayPaint(replay, &a->paint);
+		nvgFillPaint(ctx, a->paint);
+		break;
+	case NVG_TRACE_SCISSOR: nvgScissor(ctx, f[0], f[1], f[2], f[3]); break;
+	case NVG_TRACE_INTERSECT_SCISSOR: nvgIntersectScissor(ctx, f[0], f[1], f[2], f[3]); break;
+	case NVG_TRACE_RESET_SCISSOR: nvgResetScissor(ctx); break;
+	case NVG_TRACE_COMPOSITE_OPERATION: nvgGlobalCompositeOperation(ctx, a->i[0]); break;
+	case NVG_TRACE_COMPOSITE_BLEND: nvgGlobalCompositeBlendFuncSeparate(ctx, a->i[0], a->i[1], a->i[2], a->i[3]); break;
+	case NVG_TRACE_BEGIN_PATH: nvgBeginPath(ctx); break;
+	case NVG_TRACE_MOVE_TO: nvgMoveTo(ctx, f[0], f[1]); break;
+	case NVG_TRACE_LINE_TO: nvgLineTo(ctx, f[0], f[1]); break;
+	case NVG_TRACE_BEZIER_TO: nvgBezierTo(ctx, f[0], f[1], f[2], f[3], f[4], f[5]); break;
+	case NVG_TRACE_QUAD_TO: nvgQuadTo(ctx, f[0], f[1], f[2], f[3]); break;
+	case NVG_TRACE_ARC_TO: nvgArcTo(ctx, f[0], f[1], f[2], f[3], f[4]); break;
+	case NVG_TRACE_CLOSE_PATH: nvgClosePath(ctx); break;
+	case NVG_TRACE_PATH_WINDING: nvgPathWinding(ctx, a->i[0]); break;
+	case NVG_TRACE_APPEND_PATH: nvgAppendPathCommands(ctx, a->floats, a->nfloats, a->hasXform ? a->xform : NULL); break;
+	case NVG_TRACE_ARC: nvgArc(ctx, f[0], f[1], f[2], f[3], f[4], a->i[0]); break;
+	case NVG_TRACE_RECT: nvgRect(ctx, f[0], f[1], f[2], f[3]); break;
+	case NVG_TRACE_ROUNDED_RECT: nvgRoundedRectVarying(ctx, f[0], f[1], f[2], f[3], f[4], f[5], f[6], f[7]); break;
+	case NVG_TRACE_ELLIPSE: nvgEllipse(ctx, f[0], f[1], f[2], f[3]); break;
+	case NVG_TRACE_BEGIN_RETAINED_PATH: replay->skipPath = nvgBeginRetainedPath(ctx, a->u); break;
+	case NVG_TRACE_RETAINED_BUDGET: nvgRetainedPathBudget(ctx, a->i[0]); break;
+	case NVG_TRACE_CLEAR_RETAINED: nvgClearRetainedPaths(ctx); break;
+	case NVG_TRACE_FILL: nvgFill(ctx); break;
+	case NVG_TRACE_STROKE: nvgStroke(ctx); break;
+	case NVG_TRACE_FONT_SIZE: nvgFontSize(ctx, f[0]); break;
+	case NVG_TRACE_FONT_BLUR: nvgFontBlur(ctx, f[0]); break;
+	case NVG_TRACE_LETTER_SPACING: nvgTextLetterSpacing(ctx, f[0]); break;
+	case NVG_TRACE_LINE_HEIGHT: nvgTextLineHeight(ctx, f[0]); break;
+	case NVG_TRACE_TEXT_ALIGN: nvgTextAlign(ctx, a->i[0]); break;
+	case NVG_TRACE_FONT_FACE_ID: nvgFontFaceId(ctx, nvg__replayFont(replay, a->i[0])); break;
+	case NVG_TRACE_FONT_FACE:
+		nvg__replayString(name, a);
+		nvgFontFace(ctx, name);
+		break;
+	case NVG_TRACE_TEXT: nvgText(ctx, f[0], f[1], a->string, a->string + a->nstring); break;
+	case NVG_TRACE_TEXT_RUN: nvg__replayGlyphRun(replay, a, 0); break;
+	case NVG_TRACE_GLYPHS: nvg__replayGlyphRun(replay, a, 1); break;
+	case NVG_TRACE_FILL_RECTS: nvgFillRects(ctx, a->floats, a->nfloats / 4); break;
+	case NVG_TRACE_CLIP_PATH: nvgClipPath(ctx); break;
+	case NVG_TRACE_EXCLUDE_CLIP_RECT: nvgExcludeClipRect(ctx, f[0], f[1], f[2], f[3]); break;
+	case NVG_TRACE_CLIP_IMAGE_ALPHA:
+		a->paint.image = nvg__replayImage(replay, a->paint.image);
+		nvgClipImageAlpha(ctx, a->paint);
+		break;
+	case NVG_TRACE_BEGIN_LAYER: nvgBeginLayer(ctx); break;
+	case NVG_TRACE_END_LAYER: nvgEndLayer(ctx, f[0]); break;
+	case NVG_TRACE_GRADIENT_RAMP: nvg__replayGradientRamp(replay, a); break;
+	case NVG_TRACE_TEXT_BOX: nvgTextBox(ctx, f[0], f[1], f[2], a->string, a->string + a->nstring); break;
+	case NVG_TRACE_CREATE_IMAGE: nvg__replayCreateImage(replay, a, 0); break;
+	case NVG_TRACE_CREATE_IMAGE_BGRA: nvg__replayCreateImage(replay, a, 1); break;
+	case NVG_TRACE_UPDATE_IMAGE_REGION: nvg__replayUpdateImageRegion(replay, a); break;
+	case NVG_TRACE_UPDATE_IMAGE: {
+		int image = nvg__replayImage(replay, a->i[0]);
+		int w = 0, h = 0;
+		if (image == 0) break;
+		nvgImageSize(ctx, image, &w, &h);
+		if (a->nbytes == w*h*4)
+			nvgUpdateImage(ctx, image, a->bytes);
+	} break;
+	case NVG_TRACE_DELETE_IMAGE: {
+		int image = nvg__replayImage(replay, a->i[0]);
+		if (image == 0) break;
+		nvgDeleteImage(ctx, image);
+		nvg__replaySetImage(replay, a->i[0], 0);
+	} break;
+	case NVG_TRACE_PLACEHOLDER_IMAGE: nvg__replayPlaceholderImage(replay, a); break;
+	case NVG_TRACE_CREATE_FONT: nvg__replayCreateFont(replay, a); break;
+	case NVG_TRACE_FALLBACK_FONT:
+		nvgAddFallbackFontId(ctx, nvg__replayFont(replay, a->i[0]), nvg__replayFont(replay, a->i[1]));
+		break;
+	}
+}
+
+// Replays the records between two offsets.
+static void nvg__replayRange(NVGreplay* replay, int start, int end)
+{
+	NVGtraceReader r;
+	NVGtraceArgs args;
+	int op;
+
+	r.ptr = replay->data + start;
+	r.end = replay->data + end;
+	r.error = 0;
+	replay->skipPath = 0;
+	while ((op = nvg__traceReadRecord(replay, &r, &args)) != -1)
+		nvg__replayRecord(replay, op, &args);
+}
+
+// Finds the frames of the trace, returns 0 if it is malformed.
+static int nvg__replayIndex(NVGreplay* replay)
+{
+	NVGtraceReader r;
+	NVGtraceArgs args;
+	int op, begin = -1, cframes = 0;
+
+	r.ptr = replay->data + 8 + 4;
+	r.end = replay->data + replay->size;
+	r.error = 0;
+	replay->start = replay->size;
+
+	for (;;) {
+		int offset = (int)(r.ptr - replay->data);
+		op = nvg__traceReadRecord(replay, &r, &args);
+		if (op == -1) break;
+
+		if (op == NVG_TRACE_BEGIN_FRAME) {
+			if (replay->nframes == 0 && begin == -1)
+				replay->start = offset;
+			begin = offset;
+		} else if (nvg__traceEndsFrame(op) && begin != -1) {
+			if (replay->nframes + 1 > cframes) {
+				int* frames;
+				cframes = cframes > 0 ? cframes * 2 : 16;
+				frames = (int*)realloc(replay->frames, sizeof(int) * 2 * cframes);
+				if (frames == NULL) return 0;
+				replay->frames = frames;
+			}
+			replay->frames[replay->nframes*2+0] = begin;
+			replay->frames[replay->nframes*2+1] = (int)(r.ptr - replay->data);
+			replay->nframes++;
+			begin = -1;
+		}
+	}
+
+	// A trace which was cut short still replays its complete frames.
+	return r.error == 0 || replay->nframes > 0;
+}
+
+NVGreplay* nvgReplayLoad(NVGcontext* ctx, const char* filename)
+{
+	NVGreplay* replay = NULL;
+	FILE* fp = NULL;
+	int version = 0;
+	long size;
+
+	replay = (NVGreplay*)malloc(sizeof(NVGreplay));
+	if (replay == NULL) goto error;
+	memset(replay, 0, sizeof(NVGreplay));
+	replay->ctx = ctx;
+
+	fp = fopen(filename, "rb");
+	if (fp == NULL) goto error;
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	if (size < 8 + 4 || size > 0x7fffffff) goto error;
+
+	replay->size = (int)size;
+	replay->data = (unsigned char*)malloc(replay->size);
+	if (replay->data == NULL) goto error;
+	if (fread(replay->data, 1, replay->size, fp) != (size_t)replay->size) goto error;
+	fclose(fp);
+	fp = NULL;
+
+	memcpy(&version, replay->data + 8, sizeof(int));
+	if (memcmp(replay->data, NVG_TRACE_MAGIC, 8) != 0 || version != NVG_TRACE_VERSION) goto error;
+	if (!nvg__replayIndex(replay)) goto error;
+
+	nvg__replayRange(replay, 8 + 4, replay->start);
+
+	return replay;
+
+error:
+	if (fp != NULL) fclose(fp);
+	nvgReplayDelete(replay);
+	return NULL;
+}
+
+void nvgReplayDelete(NVGreplay* replay)
+{
+	int i;
+	if (replay == NULL) return;
+	for (i = 0; i < replay->cimages; i++) {
+		if (replay->images[i] != 0)
+			nvgDeleteImage(replay->ctx, replay->images[i]);
+	}
+	free(replay->images);
+	free(replay->fonts);
+	free(replay->frames);
+	free(replay->scratch);
+	free(replay->bytes);
+	free(replay->data);
+	free(replay);
+}
+
+int nvgReplayFrameCount(NVGreplay* replay)
+{
+	return replay->nframes;
+}
+
+void nvgReplayFrameSize(NVGreplay* replay, int frame, float* width, float* height, float* devicePixelRatio)
+{
+	float size[3] = { 0, 0, 1 };
+	if (frame >= 0 && frame < replay->nframes)
+		memcpy(size, replay->data + replay->frames[frame*2] + 1, sizeof(size));
+	if (width != NULL) *width = size[0];
+	if (height != NULL) *height = size[1];
+	if (devicePixelRatio != NULL) *devicePixelRatio = size[2];
+}
+
+int nvgReplayFrame(NVGreplay* replay, int frame)
+{
+	int start;
+	if (frame < 0 || frame >= replay->nframes) return 0;
+	// Images and fonts created between frames belong to the next one.
+	start = frame > 0 ? replay->frames[frame*2-1] : replay->start;
+	nvg__replayRange(replay, start, replay->frames[frame*2+1]);
+	return 1;
+}
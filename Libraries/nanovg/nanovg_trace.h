@@ -0,0 +1,150 @@
+//
+//  Copyright (C) 2022 Arthur Benilov <arthur.benilov@gmail.com> and Timothy Schoen <timschoen123@gmail.com>
+//
+// Copyright (c) 2013 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+#ifndef NANOVG_TRACE_H
+#define NANOVG_TRACE_H
+
+#include <stdarg.h>
+#include "nanovg.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Writer side of the .nvgtrace format, used by nanovg.c. See nvgTraceBegin() for the public API.
+//
+// A trace is the 8 byte NVG_TRACE_MAGIC, a 32-bit NVG_TRACE_VERSION, and a sequence of records.
+// A record is a one byte NVGtraceOp followed by its arguments, encoded as described by
+// nvgTraceFormat(). Values are stored in host byte order.
+
+#define NVG_TRACE_MAGIC "NVGTRACE"
+#define NVG_TRACE_VERSION 2
+
+// Record types. Values are stored in trace files, append new ones at the end.
+enum NVGtraceOp {
+	NVG_TRACE_BEGIN_FRAME = 0,
+	NVG_TRACE_CANCEL_FRAME,
+	NVG_TRACE_END_FRAME,
+	NVG_TRACE_SAVE,
+	NVG_TRACE_RESTORE,
+	NVG_TRACE_RESET,
+	NVG_TRACE_SHAPE_ANTIALIAS,
+	NVG_TRACE_STROKE_WIDTH,
+	NVG_TRACE_MITER_LIMIT,
+	NVG_TRACE_LINE_CAP,
+	NVG_TRACE_LINE_JOIN,
+	NVG_TRACE_GLOBAL_ALPHA,
+	NVG_TRACE_TRANSFORM,
+	NVG_TRACE_RESET_TRANSFORM,
+	NVG_TRACE_TRANSLATE,
+	NVG_TRACE_ROTATE,
+	NVG_TRACE_SKEW_X,
+	NVG_TRACE_SKEW_Y,
+	NVG_TRACE_SCALE,
+	NVG_TRACE_STROKE_COLOR,
+	NVG_TRACE_STROKE_PAINT,
+	NVG_TRACE_FILL_COLOR,
+	NVG_TRACE_FILL_PAINT,
+	NVG_TRACE_SCISSOR,
+	NVG_TRACE_INTERSECT_SCISSOR,
+	NVG_TRACE_RESET_SCISSOR,
+	NVG_TRACE_COMPOSITE_OPERATION,
+	NVG_TRACE_COMPOSITE_BLEND,
+	NVG_TRACE_BEGIN_PATH,
+	NVG_TRACE_MOVE_TO,
+	NVG_TRACE_LINE_TO,
+	NVG_TRACE_BEZIER_TO,
+	NVG_TRACE_QUAD_TO,
+	NVG_TRACE_ARC_TO,
+	NVG_TRACE_CLOSE_PATH,
+	NVG_TRACE_PATH_WINDING,
+	NVG_TRACE_APPEND_PATH,
+	NVG_TRACE_ARC,
+	NVG_TRACE_RECT,
+	NVG_TRACE_ROUNDED_RECT,
+	NVG_TRACE_ELLIPSE,
+	NVG_TRACE_BEGIN_RETAINED_PATH,
+	NVG_TRACE_RETAINED_BUDGET,
+	NVG_TRACE_CLEAR_RETAINED,
+	NVG_TRACE_FILL,
+	NVG_TRACE_STROKE,
+	NVG_TRACE_FONT_SIZE,
+	NVG_TRACE_FONT_BLUR,
+	NVG_TRACE_LETTER_SPACING,
+	NVG_TRACE_LINE_HEIGHT,
+	NVG_TRACE_TEXT_ALIGN,
+	NVG_TRACE_FONT_FACE_ID,
+	NVG_TRACE_FONT_FACE,
+	NVG_TRACE_TEXT,
+	NVG_TRACE_TEXT_BOX,
+	NVG_TRACE_CREATE_IMAGE,
+	NVG_TRACE_UPDATE_IMAGE,
+	NVG_TRACE_DELETE_IMAGE,
+	NVG_TRACE_PLACEHOLDER_IMAGE,
+	NVG_TRACE_CREATE_FONT,
+	NVG_TRACE_FALLBACK_FONT,
+	NVG_TRACE_CREATE_IMAGE_BGRA,
+	NVG_TRACE_UPDATE_IMAGE_REGION,
+	NVG_TRACE_TEXT_RUN,
+	NVG_TRACE_GLYPHS,
+	NVG_TRACE_FILL_RECTS,
+	NVG_TRACE_CLIP_PATH,
+	NVG_TRACE_EXCLUDE_CLIP_RECT,
+	NVG_TRACE_CLIP_IMAGE_ALPHA,
+	NVG_TRACE_BEGIN_LAYER,
+	NVG_TRACE_END_LAYER,
+	NVG_TRACE_GRADIENT_RAMP,
+	NVG_TRACE_OPS
+};
+
+typedef struct NVGtrace NVGtrace;
+
+// Returns the argument encoding of a record type, one character per argument:
+//   f  float, passed as double
+//   i  32-bit int
+//   u  64-bit unsigned int, passed as unsigned long long
+//   c  NVGcolor, passed as const NVGcolor*
+//   p  NVGpaint, passed as const NVGpaint*
+//   s  string, passed as const char* start and end, end may be NULL; stored as a 32-bit length and the bytes
+//   b  bytes, passed as const void* and int size; stored as a 32-bit size and the bytes
+//   F  float array, passed as const float* and int count; stored as a 32-bit count and the floats
+//   x  optional transform, passed as const float[6] or NULL; stored as a byte flag and 6 floats
+// Returns NULL for unknown record types.
+const char* nvgTraceFormat(int op);
+
+// Creates the trace file. Records of frames are written from the next NVG_TRACE_BEGIN_FRAME on,
+// for the specified number of frames, or until the trace is closed if frames is 0. Resource records
+// (images and fonts) are written at any time.
+NVGtrace* nvgTraceOpen(const char* filename, int frames);
+void nvgTraceClose(NVGtrace* trace);
+
+// Writes a record, the arguments follow nvgTraceFormat(op).
+// Returns 0 once the trace is complete or could not be written, after which it should be closed.
+int nvgTraceWriteV(NVGtrace* trace, int op, va_list args);
+
+// Tracks the images whose contents are in the trace, so that others can be replaced on replay.
+int nvgTraceHasImage(NVGtrace* trace, int image);
+void nvgTraceAddImage(NVGtrace* trace, int image);
+void nvgTraceRemoveImage(NVGtrace* trace, int image);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NANOVG_TRACE_H
@@ -6,20 +6,32 @@
 
 #if NANOVG_METAL_IMPLEMENTATION
 #include <nanovg_mtl.h>
+#elif NANOVG_GL_IMPLEMENTATION
+// Only the declarations, the framebuffer helpers are compiled with nanovg_gl.h in NanoVGGraphics.cpp.
+#undef NANOVG_GL_IMPLEMENTATION
+#include <nanovg_gl_utils.h>
+#define NANOVG_GL_IMPLEMENTATION 1
 #endif
 
 
 void NanoVGComponent::startPeriodicRepaint (int fps)
 {
-    if (fps > 0)
-        startTimerHz (fps);
-    else
-        stopTimer();
+    frameScheduler.setPeriodicRepaint (fps);
 }
 
 void NanoVGComponent::stopPeriodicRepaint()
 {
-    stopTimer();
+    frameScheduler.setPeriodicRepaint (0);
+}
+
+NanoVGFrameScheduler::Statistics NanoVGComponent::getFrameStatistics() const
+{
+    return frameScheduler.getStatistics();
+}
+
+void NanoVGComponent::resetFrameStatistics()
+{
+    frameScheduler.resetStatistics();
 }
 
 
@@ -35,6 +47,8 @@ void NanoVGComponent::paintComponent()
         initialise();
     }
 
+    recordDisplayList();
+
 #if NANOVG_METAL_IMPLEMENTATION
     render();
 #else
@@ -44,21 +58,33 @@ void NanoVGComponent::paintComponent()
     currentlyPainting = false;
 }
 
-void NanoVGComponent::timerCallback()
+void NanoVGComponent::paintFrame (bool periodicRepaint)
 {
-    repaint();
+    if (periodicRepaint)
+        addDamage (getLocalBounds());
+
+    paintComponent();
 }
 
 NanoVGComponent::NanoVGComponent()
+#if NANOVG_GL_IMPLEMENTATION
+    // The render thread waits for the swap, which paces the frames.
+    : frameScheduler ([this] (bool periodicRepaint) { paintFrame (periodicRepaint); }, true)
+#else
+    : frameScheduler ([this] (bool periodicRepaint) { paintFrame (periodicRepaint); }, false)
+#endif
 {
     setOpaque (true);
     addComponentListener (this);
     
+    renderCache = new RenderCache (*this);
+    setCachedComponentImage (renderCache);
+
 #if NANOVG_METAL_IMPLEMENTATION
-    setCachedComponentImage (new RenderCache (*this));
+    // Metal draws on the message thread without keeping the previous frame.
+    paintFullFrames = true;
 
 #elif NANOVG_GL_IMPLEMENTATION
-    setCachedComponentImage (new RenderCache (*this));
     
 #if NANOVG_GL3_IMPLEMENTATION || NANOVG_GLES3_IMPLEMENTATION
     openGLContext.setOpenGLVersionRequired(juce::OpenGLContext::openGL3_2);
@@ -82,6 +108,7 @@ NanoVGComponent::~NanoVGComponent()
     if (nvg != nullptr)
     {
         nvgGraphicsContext->removeCachedImages();
+        nvgGraphicsContext->setImageTracker (nullptr);
         //nvgDeleteContext(nvg);
     }
 }
@@ -91,11 +118,6 @@ NanoVGComponent::RenderCache::RenderCache (NanoVGComponent& comp)
 {
 }
 
-NanoVGComponent::RenderCache::~RenderCache()
-{
-    cancelPendingUpdate();
-}
-
 void NanoVGComponent::RenderCache::paint (juce::Graphics&)
 {
     component.paintComponent();
@@ -103,39 +125,28 @@ void NanoVGComponent::RenderCache::paint (juce::Graphics&)
 
 bool NanoVGComponent::RenderCache::invalidateAll()
 {
-    triggerAsyncUpdate();
-    return true;
+    return invalidate (component.getLocalBounds());
 }
 
-bool NanoVGComponent::RenderCache::invalidate (const juce::Rectangle<int>&)
+bool NanoVGComponent::RenderCache::invalidate (const juce::Rectangle<int>& area)
 {
-    // TODO: more selective invalidation
-    return invalidateAll();
+    component.addDamage (area);
+    component.frameScheduler.requestFrame();
+    return true;
 }
 
 void NanoVGComponent::RenderCache::releaseResources()
 {
 }
 
-void NanoVGComponent::RenderCache::handleAsyncUpdate()
-{
-    component.paintComponent();
-}
 
-
-void NanoVGComponent::componentMovedOrResized (juce::Component& component, bool wasMoved, bool wasResized)
+void NanoVGComponent::componentMovedOrResized (juce::Component& component, bool wasMoved, bool)
 {
     if (!initialised)
         return;
     
-    if (wasResized && nvg) {
-        nvgReset(nvg);
-    }
-    
     if (auto* display {juce::Desktop::getInstance().getDisplays().getPrimaryDisplay()})
         scale = display->scale;
-    
-    nvgGraphicsContext->resized(getWidth(), getHeight(), scale);
 
     #if NANOVG_METAL_IMPLEMENTATION
       mnvgSetViewBounds(getPeer()->getNativeHandle(), scale * getWidth(), scale * getHeight());
@@ -165,18 +176,85 @@ void NanoVGComponent::initialise()
 
 
         initialised = true;
+        repaint();
     });
 
 }
 
+void NanoVGComponent::addDamage (juce::Rectangle<int> area)
+{
+    const juce::SpinLock::ScopedLockType lock (damageLock);
+    damagedArea.add (area);
+}
+
+void NanoVGComponent::recordDisplayList()
+{
+    if (!initialised)
+        return;
+
+    juce::RectangleList<int> damage;
+    {
+        const juce::SpinLock::ScopedLockType lock (damageLock);
+        damage.swapWith (damagedArea);
+    }
+
+    if (paintFullFrames)
+        damage = getLocalBounds();
+
+    {
+        // A list the render thread has not drawn yet is replaced, so its area is painted again.
+        const juce::SpinLock::ScopedLockType lock (displayListLock);
+
+        if (hasPendingDisplayList)
+            damage.add (pendingDisplayList.getArea());
+    }
+
+    {
+        NanoVGDisplayList::Recorder recorder (recordingDisplayList, imageSnapshots, getLocalBounds(), damage, scale);
+        juce::Graphics g (recorder);
+        paintEntireComponent (g, true);
+    }
+
+    const juce::SpinLock::ScopedLockType lock (displayListLock);
+    std::swap (recordingDisplayList, pendingDisplayList);
+    hasPendingDisplayList = true;
+}
+
 void NanoVGComponent::render()
+{
+    const auto startTime = juce::Time::getMillisecondCounterHiRes();
+    renderFrame();
+    frameScheduler.frameRendered (startTime, juce::Time::getMillisecondCounterHiRes());
+}
+
+void NanoVGComponent::renderFrame()
 {
     if(!initialised) return;
-    
+
+    // The latest list recorded on the message thread, without one the previous frame is presented again.
+    bool hasDisplayList = false;
+    {
+        const juce::SpinLock::ScopedLockType lock (displayListLock);
+
+        if (hasPendingDisplayList)
+        {
+            std::swap (pendingDisplayList, replayedDisplayList);
+            hasPendingDisplayList = false;
+            hasDisplayList = true;
+        }
+    }
+
+    // The size of the component is only read from the lists, as it may change on the message thread.
+    const auto bounds = replayedDisplayList.getBounds();
+    const auto frameScale = replayedDisplayList.getScale();
+
+    if (bounds.isEmpty())
+        return;
+
     if (!nvg)
     {
-        const float width {getWidth() * scale};
-        const float height {getHeight() * scale};
+        const float width {bounds.getWidth() * frameScale};
+        const float height {bounds.getHeight() * frameScale};
         
         #if NANOVG_METAL_IMPLEMENTATION
         void* nativeHandle = getPeer()->getNativeHandle();
@@ -184,57 +262,217 @@ void NanoVGComponent::render()
         void* nativeHandle = nullptr;
         #endif
         
-        nvgGraphicsContext.reset (new NanoVGGraphicsContext (nativeHandle, (int)width, (int)height, scale));
+        nvgGraphicsContext.reset (new NanoVGGraphicsContext (nativeHandle, (int)width, (int)height, frameScale));
         nvg = nvgGraphicsContext->getContext();
+
+        // The lists only draw copies made by the snapshots, which are modified on the message thread.
+        nvgGraphicsContext->setImageTracker (&imageSnapshots);
         
         //mainFrameBuffer = nvgCreateFramebuffer(nvg, width, height, 0);
+
+       #if NANOVG_GL_IMPLEMENTATION
+        // One frame per refresh, the scheduler relies on the swap waiting for it.
+        openGLContext.setSwapInterval (1);
+       #endif
+    }
+
+    nvgGraphicsContext->resized (bounds.getWidth(), bounds.getHeight(), frameScale);
+
+    // Traces hold whole frames, a partial one recorded before the capture was requested is painted again in full.
+    if (hasDisplayList && ! replayedDisplayList.isFullFrame() && (nvgTraceActive (nvg) || isCapturePending()))
+    {
+        renderCache->invalidate (bounds);
+        hasDisplayList = false;
     }
+
+    if (hasDisplayList)
+        startPendingCapture();
+
 #if NANOVG_GL_IMPLEMENTATION
-    glViewport(0, 0, getWidth() * scale, getHeight() * scale);
-    glClearColor(0,0,0,0);
-    glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT|GL_STENCIL_BUFFER_BIT);
+    const int pixelWidth = (int) (bounds.getWidth() * frameScale);
+    const int pixelHeight = (int) (bounds.getHeight() * frameScale);
+
+    // Pixels covering an area of the component, top down.
+    auto toPixels = [frameScale] (juce::Rectangle<int> area)
+    {
+        return juce::Rectangle<int>::leftTopRightBottom ((int) std::floor (area.getX() * frameScale),
+                                                         (int) std::floor (area.getY() * frameScale),
+                                                         (int) std::ceil (area.getRight() * frameScale),
+                                                         (int) std::ceil (area.getBottom() * frameScale));
+    };
+
+    GLint windowFramebuffer = 0;
+    glGetIntegerv (GL_FRAMEBUFFER_BINDING, &windowFramebuffer);
+
+    if (frameBufferWidth != pixelWidth || frameBufferHeight != pixelHeight)
+    {
+        if (frameBuffer != nullptr)
+            nvgluDeleteFramebuffer (frameBuffer);
+
+        frameBuffer = nvgluCreateFramebuffer (nvg, pixelWidth, pixelHeight, NVG_IMAGE_NEAREST);
+        frameBufferWidth = pixelWidth;
+        frameBufferHeight = pixelHeight;
+        fullCopies = presentedDamage.size();
+
+        // The new framebuffer is empty outside of what this frame paints.
+        if (! (hasDisplayList && replayedDisplayList.isFullFrame()))
+            renderCache->invalidate (bounds);
+    }
+
+    // Without a framebuffer to keep the previous frame, every frame is painted in full, with the
+    // last list again if there is no new one.
+    const bool drawFrame = hasDisplayList || frameBuffer == nullptr;
+
+    if (frameBuffer != nullptr)
+        glBindFramebuffer (GL_FRAMEBUFFER, frameBuffer->fbo);
+
+    if (drawFrame)
+    {
+        // Only the painted area is cleared, and nanovg keeps this scissor while drawing.
+        const auto area = toPixels (frameBuffer != nullptr ? replayedDisplayList.getArea().getBounds() : bounds);
+
+        glViewport (0, 0, pixelWidth, pixelHeight);
+        glEnable (GL_SCISSOR_TEST);
+        glScissor (area.getX(), pixelHeight - area.getBottom(), area.getWidth(), area.getHeight());
+        glClearColor(0,0,0,0);
+        glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT|GL_STENCIL_BUFFER_BIT);
+    }
+#else
+    const bool drawFrame = hasDisplayList;
 #endif
-    
-    //nvgScissor(nvg, 0, 0, getWidth(), getHeight());
-    nvgBeginFrame (nvg, getWidth(), getHeight(), scale);
-    
-    juce::MessageManager::Lock mmLock;
-    //if(mmLock.tryEnter()) {
-        juce::Graphics g (*nvgGraphicsContext.get());
-        paintEntireComponent (g, true);
-        //mmLock.exit();
-    
+
+    if (drawFrame)
+    {
+        //nvgScissor(nvg, 0, 0, getWidth(), getHeight());
+        nvgBeginFrame (nvg, bounds.getWidth(), bounds.getHeight(), frameScale);
+
+        replayedDisplayList.replay (*nvgGraphicsContext);
+        nvgGraphicsContext->flush();
+
+        int x = 10, y = 10, w = 200, h = 200;
+        float pos = 1.0f;
+        
+        float cy = y+(int)(h*0.5f);
+            float kr = (int)(h*0.25f);
+        
+        NVGpaint knob = nvgLinearGradient(nvg, x,cy-kr,x,cy+kr, nvgRGBA(255,255,255,16), nvgRGBA(0,0,0,16));
+        nvgBeginPath(nvg);
+        nvgCircle(nvg, x+(int)(pos*w),cy, kr-1);
+        nvgFillColor(nvg, nvgRGBA(40,43,48,255));
+        nvgFill(nvg);
+        nvgFillPaint(nvg, knob);
+        nvgFill(nvg);
+
+        nvgBeginPath(nvg);
+        nvgCircle(nvg, x+(int)(pos*w),cy, kr-0.5f);
+        nvgStrokeColor(nvg, nvgRGBA(0,0,0,92));
+        nvgStroke(nvg);
+        
+        nvgEndFrame (nvg);
+    }
+
 #if NANOVG_GL_IMPLEMENTATION
-    if (!openGLContext.isActive())
-        openGLContext.makeActive();
-#endif
+    glDisable (GL_SCISSOR_TEST);
 
-    int x = 10, y = 10, w = 200, h = 200;
-    float pos = 1.0f;
-    
-    float cy = y+(int)(h*0.5f);
-        float kr = (int)(h*0.25f);
-    
-    NVGpaint knob = nvgLinearGradient(nvg, x,cy-kr,x,cy+kr, nvgRGBA(255,255,255,16), nvgRGBA(0,0,0,16));
-    nvgBeginPath(nvg);
-    nvgCircle(nvg, x+(int)(pos*w),cy, kr-1);
-    nvgFillColor(nvg, nvgRGBA(40,43,48,255));
-    nvgFill(nvg);
-    nvgFillPaint(nvg, knob);
-    nvgFill(nvg);
-
-    nvgBeginPath(nvg);
-    nvgCircle(nvg, x+(int)(pos*w),cy, kr-0.5f);
-    nvgStrokeColor(nvg, nvgRGBA(0,0,0,92));
-    nvgStroke(nvg);
-    
-    nvgEndFrame (nvg);
+    // The window's back buffers do not keep the previous frame, but each of them was presented a
+    // few frames ago. Copying what was painted in the last frames brings any of them up to date,
+    // as long as the window does not have more buffers than the frames that are remembered.
+    if (frameBuffer != nullptr)
+    {
+        const juce::Rectangle<int> pixelBounds (pixelWidth, pixelHeight);
+        auto& damage = presentedDamage[presentedFrames++ % presentedDamage.size()];
+        damage.clear();
+
+        if (drawFrame)
+            for (const auto& area : replayedDisplayList.getArea())
+                damage.add (toPixels (area));
+
+        juce::RectangleList<int> copiedArea;
+
+        if (fullCopies > 0)
+        {
+            copiedArea = pixelBounds;
+            --fullCopies;
+        }
+        else
+        {
+            for (const auto& area : presentedDamage)
+                copiedArea.add (area);
+
+            copiedArea.clipTo (pixelBounds);
+        }
+
+        // Each rectangle is a draw call, many small ones are copied as one.
+        if (copiedArea.getNumRectangles() > 8)
+            copiedArea = copiedArea.getBounds();
+
+        glBindFramebuffer (GL_FRAMEBUFFER, (GLuint) windowFramebuffer);
+        glViewport (0, 0, pixelWidth, pixelHeight);
+        glClearColor(0,0,0,0);
+        glEnable (GL_SCISSOR_TEST);
+
+        glActiveTexture (GL_TEXTURE0);
+        glBindTexture (GL_TEXTURE_2D, frameBuffer->texture);
+
+        // copyTexture() blends over the window, so each area is cleared first.
+        for (const auto& area : copiedArea)
+        {
+            glScissor (area.getX(), pixelHeight - area.getBottom(), area.getWidth(), area.getHeight());
+            glClear (GL_COLOR_BUFFER_BIT);
+            openGLContext.copyTexture (area, pixelBounds, pixelWidth, pixelHeight, false);
+        }
+
+        glDisable (GL_SCISSOR_TEST);
+        glBindTexture (GL_TEXTURE_2D, 0);
+    }
+
+    paintFullFrames = frameBuffer == nullptr || nvgTraceActive (nvg) || isCapturePending();
+#else
+    paintFullFrames = true;
+#endif
     
     //openGLContext.swapBuffers();
 }
 
+void NanoVGComponent::captureFrames (const juce::File& file, int numFrames)
+{
+    const juce::SpinLock::ScopedLockType lock (captureLock);
+    captureFile = file;
+    captureFrameCount = juce::jmax (1, numFrames);
+    paintFullFrames = true;
+}
+
+bool NanoVGComponent::isCapturePending()
+{
+    const juce::SpinLock::ScopedLockType lock (captureLock);
+    return captureFile != juce::File();
+}
+
+void NanoVGComponent::startPendingCapture()
+{
+    const juce::SpinLock::ScopedLockType lock (captureLock);
+
+    if (captureFile == juce::File())
+        return;
+
+    // Cached images are uploaded again inside the trace, so that it holds their pixels.
+    nvgGraphicsContext->removeCachedImages();
+
+    if (! nvgTraceBegin (nvg, captureFile.getFullPathName().toRawUTF8(), captureFrameCount))
+        DBG ("Could not create " << captureFile.getFullPathName());
+
+    captureFile = juce::File();
+}
+
 void NanoVGComponent::shutdown()
 {
+#if NANOVG_GL_IMPLEMENTATION
+    if (frameBuffer != nullptr)
+    {
+        nvgluDeleteFramebuffer (frameBuffer);
+        frameBuffer = nullptr;
+    }
+#endif
     //nvgDeleteContext(nvg);
 }
 
@@ -5,6 +5,8 @@
 #pragma once
 
 #include "NanoVGGraphics.h"
+#include "NanoVGDisplayList.h"
+#include "NanoVGFrameScheduler.h"
 
 /**
     JUCE UI component rendered usin nanovg
@@ -14,6 +16,7 @@
 */
 
 class MNVGframebuffer;
+struct NVGLUframebuffer;
 
 class NanoVGComponent :
 #if NANOVG_METAL_IMPLEMENTATION
@@ -21,14 +24,12 @@ public juce::Component,
 #elif NANOVG_GL_IMPLEMENTATION
 public juce::OpenGLAppComponent,
 #endif
-public juce::ComponentListener, public juce::Timer
+public juce::ComponentListener
 {
-    class RenderCache : public juce::CachedComponentImage,
-    private juce::AsyncUpdater
+    class RenderCache : public juce::CachedComponentImage
     {
     public:
         RenderCache (NanoVGComponent& comp);
-        ~RenderCache();
 
         void paint (juce::Graphics&) override;
         bool invalidateAll() override;
@@ -36,8 +37,6 @@ public juce::ComponentListener, public juce::Timer
         void releaseResources() override;
 
     private:
-        void handleAsyncUpdate() override;
-
         NanoVGComponent& component;
     };
 
@@ -47,16 +46,30 @@ public:
     NanoVGComponent();
     ~NanoVGComponent();
 
+    /** Repaints the whole component at most fps times per second, at the refreshes of the display. */
     void startPeriodicRepaint(int fps = 30);
     void stopPeriodicRepaint();
 
+    /** Frame times and dropped frames since the last reset. */
+    NanoVGFrameScheduler::Statistics getFrameStatistics() const;
+    void resetFrameStatistics();
+
+    /** Records the next frames into a .nvgtrace file, which can be replayed with
+        nanovg_replay or nvgReplayLoad() to reproduce or benchmark them.
+    */
+    void captureFrames (const juce::File& file, int numFrames = 1);
+
 private:
 
     friend class NanoVGComponent::RenderCache;
 
     void paintComponent();
 
-    void timerCallback() override;
+    /** Paints a frame for the scheduler, on the message thread. */
+    void paintFrame (bool periodicRepaint);
+
+    /** Records the damaged area for the render thread, on the message thread. */
+    void recordDisplayList();
 
     bool currentlyPainting {false};
     bool showRenderStats {false};
@@ -68,8 +81,52 @@ private:
     
     void initialise();
     void render();
+    void renderFrame();
     void shutdown();
 
+    void startPendingCapture();
+    bool isCapturePending();
+
+    /** Adds an area to paint again with the next frame, in component coordinates. */
+    void addDamage (juce::Rectangle<int> area);
+
+    juce::SpinLock damageLock;
+    juce::RectangleList<int> damagedArea;
+
+    /** Lists are recorded on the message thread and replayed on the render thread, which
+        takes the latest pending one when it draws a frame.
+    */
+    NanoVGDisplayList recordingDisplayList, pendingDisplayList, replayedDisplayList;
+    NanoVGDisplayList::ImageSnapshots imageSnapshots;
+    bool hasPendingDisplayList {false};
+    juce::SpinLock displayListLock;
+
+    /** Set by the render thread when it cannot keep the previous frame, or is capturing a trace. */
+    std::atomic<bool> paintFullFrames {false};
+
+    RenderCache* renderCache {nullptr};
+
+    NanoVGFrameScheduler frameScheduler;
+
+   #if NANOVG_GL_IMPLEMENTATION
+    /** Keeps the previous frame, so that only the damaged area is painted again. */
+    NVGLUframebuffer* frameBuffer {nullptr};
+    int frameBufferWidth {0}, frameBufferHeight {0};
+
+    /** Pixels painted in each of the last frames, which are copied to the window again. The
+        window's back buffers were each presented a few frames ago, and miss what was painted since.
+    */
+    std::array<juce::RectangleList<int>, 3> presentedDamage;
+    size_t presentedFrames {0};
+
+    /** Frames left to copy all of the framebuffer, until each back buffer had a full copy. */
+    size_t fullCopies {0};
+   #endif
+
+    juce::SpinLock captureLock;
+    juce::File captureFile;
+    int captureFrameCount {0};
+
     //==========================================================================
 
     /** Detach the context from the currently attached component. */
@@ -0,0 +1,568 @@
+//
+//  Copyright (C) 2022 Arthur Benilov <arthur.benilov@gmail.com> and Timothy Schoen <timschoen123@gmail.com>
+//
+
+#include "NanoVGDisplayList.h"
+
+namespace
+{
+
+// Reads back the values written by NanoVGDisplayList::write().
+struct CommandReader
+{
+    const uint8_t* data;
+
+    template <typename Value>
+    Value read()
+    {
+        Value value;
+        std::memcpy (&value, data, sizeof (Value));
+        data += sizeof (Value);
+        return value;
+    }
+};
+
+} // namespace
+
+//==============================================================================
+NanoVGDisplayList::Transform NanoVGDisplayList::toTransform (const juce::AffineTransform& t)
+{
+    return { { t.mat00, t.mat01, t.mat02, t.mat10, t.mat11, t.mat12 } };
+}
+
+juce::AffineTransform NanoVGDisplayList::fromTransform (const Transform& t)
+{
+    return { t.m[0], t.m[1], t.m[2], t.m[3], t.m[4], t.m[5] };
+}
+
+template <typename... Values>
+void NanoVGDisplayList::write (Op op, const Values&... values)
+{
+    static_assert ((std::is_trivially_copyable_v<Values> && ...), "Only plain values can be stored in the command buffer");
+
+    const auto offset = commands.size();
+    commands.resize (offset + sizeof (Op) + (sizeof (Values) + ... + 0));
+
+    auto* data = commands.data() + offset;
+    std::memcpy (data, &op, sizeof (Op));
+    data += sizeof (Op);
+
+    ((std::memcpy (data, &values, sizeof (Values)), data += sizeof (Values)), ...);
+}
+
+template <typename Object>
+int NanoVGDisplayList::add (std::vector<Object>& table, size_t& count, const Object& object)
+{
+    if (count < table.size())
+        table[count] = object;
+    else
+        table.push_back (object);
+
+    return (int) count++;
+}
+
+void NanoVGDisplayList::clear()
+{
+    commands.clear();
+
+    // Paths keep their storage to be assigned again, the others are released so that the list
+    // does not keep images and fonts alive.
+    numPaths = 0;
+
+    images.clear();
+    fonts.clear();
+    fills.clear();
+    strings.clear();
+    numImages = numFonts = numFills = numStrings = 0;
+
+    bounds = {};
+    area.clear();
+    scale = 1.0f;
+}
+
+void NanoVGDisplayList::replay (juce::LowLevelGraphicsContext& context) const
+{
+    CommandReader reader { commands.data() };
+    const auto* end = commands.data() + commands.size();
+
+    while (reader.data < end)
+    {
+        switch (reader.read<Op>())
+        {
+            case Op::setOrigin:
+                context.setOrigin (reader.read<juce::Point<int>>());
+                break;
+            case Op::addTransform:
+                context.addTransform (fromTransform (reader.read<Transform>()));
+                break;
+            case Op::clipToRectangle:
+                context.clipToRectangle (reader.read<juce::Rectangle<int>>());
+                break;
+            case Op::clipToRectangleList:
+            {
+                juce::RectangleList<int> rectangles;
+                const auto count = reader.read<int>();
+                rectangles.ensureStorageAllocated (count);
+
+                for (int i = 0; i < count; ++i)
+                    rectangles.addWithoutMerging (reader.read<juce::Rectangle<int>>());
+
+                context.clipToRectangleList (rectangles);
+                break;
+            }
+            case Op::excludeClipRectangle:
+                context.excludeClipRectangle (reader.read<juce::Rectangle<int>>());
+                break;
+            case Op::clipToPath:
+            {
+                const auto& path = paths[(size_t) reader.read<int>()];
+                context.clipToPath (path, fromTransform (reader.read<Transform>()));
+                break;
+            }
+            case Op::clipToImageAlpha:
+            {
+                const auto& image = images[(size_t) reader.read<int>()];
+                context.clipToImageAlpha (image, fromTransform (reader.read<Transform>()));
+                break;
+            }
+            case Op::saveState:
+                context.saveState();
+                break;
+            case Op::restoreState:
+                context.restoreState();
+                break;
+            case Op::beginTransparencyLayer:
+                context.beginTransparencyLayer (reader.read<float>());
+                break;
+            case Op::endTransparencyLayer:
+                context.endTransparencyLayer();
+                break;
+            case Op::setColour:
+                context.setFill (juce::Colour (reader.read<juce::uint32>()));
+                break;
+            case Op::setFill:
+                context.setFill (fills[(size_t) reader.read<int>()]);
+                break;
+            case Op::setOpacity:
+                context.setOpacity (reader.read<float>());
+                break;
+            case Op::setInterpolationQuality:
+                context.setInterpolationQuality ((juce::Graphics::ResamplingQuality) reader.read<int>());
+                break;
+            case Op::fillRectInt:
+            {
+                const auto rectangle = reader.read<juce::Rectangle<int>>();
+                context.fillRect (rectangle, reader.read<bool>());
+                break;
+            }
+            case Op::fillRect:
+                context.fillRect (reader.read<juce::Rectangle<float>>());
+                break;
+            case Op::fillRectList:
+            {
+                juce::RectangleList<float> rectangles;
+                const auto count = reader.read<int>();
+                rectangles.ensureStorageAllocated (count);
+
+                for (int i = 0; i < count; ++i)
+                    rectangles.addWithoutMerging (reader.read<juce::Rectangle<float>>());
+
+                context.fillRectList (rectangles);
+                break;
+            }
+            case Op::fillPath:
+            {
+                const auto& path = paths[(size_t) reader.read<int>()];
+                context.fillPath (path, fromTransform (reader.read<Transform>()));
+                break;
+            }
+            case Op::strokePath:
+            {
+                const auto& path = paths[(size_t) reader.read<int>()];
+                const auto thickness = reader.read<float>();
+                const auto joint = (juce::PathStrokeType::JointStyle) reader.read<int>();
+                const auto cap = (juce::PathStrokeType::EndCapStyle) reader.read<int>();
+                context.strokePath (path, { thickness, joint, cap }, fromTransform (reader.read<Transform>()));
+                break;
+            }
+            case Op::drawImage:
+            {
+                const auto& image = images[(size_t) reader.read<int>()];
+                context.drawImage (image, fromTransform (reader.read<Transform>()));
+                break;
+            }
+            case Op::drawLine:
+                context.drawLine (reader.read<juce::Line<float>>());
+                break;
+            case Op::setFont:
+                context.setFont (fonts[(size_t) reader.read<int>()]);
+                break;
+            case Op::drawGlyph:
+            {
+                const auto glyph = reader.read<int>();
+                context.drawGlyph (glyph, fromTransform (reader.read<Transform>()));
+                break;
+            }
+            case Op::drawTextLayout:
+            {
+                const auto& text = strings[(size_t) reader.read<int>()];
+                context.drawTextLayout (text, reader.read<juce::Rectangle<float>>());
+                break;
+            }
+        }
+    }
+}
+
+//==============================================================================
+NanoVGDisplayList::ImageSnapshots::~ImageSnapshots()
+{
+    const juce::ScopedLock sl (lock);
+
+    for (auto& [pixelData, entry] : entries)
+        pixelData->listeners.remove (this);
+}
+
+juce::Image NanoVGDisplayList::ImageSnapshots::get (const juce::Image& image)
+{
+    auto* pixelData = image.getPixelData();
+
+    if (pixelData == nullptr)
+        return {};
+
+    const juce::ScopedLock sl (lock);
+
+    auto [it, inserted] = entries.try_emplace (pixelData);
+    auto& entry = it->second;
+    entry.lastUsedFrame = frame;
+
+    if (inserted)
+        pixelData->listeners.add (this);
+    else if (! entry.modified)
+        return entry.copies.front();
+
+    entry.modified = false;
+
+    // A copy only referenced here is not in any list, so the render thread is not reading it.
+    for (auto copy = entry.copies.begin(); copy != entry.copies.end(); ++copy)
+    {
+        if (copy->getReferenceCount() == 1 && copy->getBounds() == image.getBounds() && copy->getFormat() == image.getFormat())
+        {
+            {
+                const juce::Image::BitmapData source (image, juce::Image::BitmapData::readOnly);
+                juce::Image::BitmapData destination (*copy, juce::Image::BitmapData::writeOnly);
+
+                for (int y = 0; y < source.height; ++y)
+                    std::memcpy (destination.getLinePointer (y), source.getLinePointer (y), (size_t) (source.width * source.pixelStride));
+            }
+
+            ++generations[copy->getPixelData()];
+
+            std::rotate (entry.copies.begin(), copy, copy + 1);
+            return entry.copies.front();
+        }
+    }
+
+    entry.copies.insert (entry.copies.begin(), image.createCopy());
+    generations[entry.copies.front().getPixelData()] = 0;
+    return entry.copies.front();
+}
+
+void NanoVGDisplayList::ImageSnapshots::beginFrame()
+{
+    // About five seconds at 60 frames per second.
+    constexpr int maxUnusedFrames = 300;
+
+    const juce::ScopedLock sl (lock);
+    ++frame;
+
+    for (auto it = entries.begin(); it != entries.end();)
+    {
+        if (frame - it->second.lastUsedFrame > maxUnusedFrames)
+        {
+            it->first->listeners.remove (this);
+            release (it->second);
+            it = entries.erase (it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    // A copy only referenced here is not in any list, and can be deleted on this thread.
+    for (auto copy = releasedCopies.begin(); copy != releasedCopies.end();)
+    {
+        if (copy->getReferenceCount() == 1)
+        {
+            generations.erase (copy->getPixelData());
+            deletedCopies.push_back (copy->getPixelData());
+            copy = releasedCopies.erase (copy);
+        }
+        else
+        {
+            ++copy;
+        }
+    }
+}
+
+bool NanoVGDisplayList::ImageSnapshots::getGeneration (juce::ImagePixelData* pixelData, juce::uint32& generation)
+{
+    const juce::ScopedLock sl (lock);
+
+    auto it = generations.find (pixelData);
+
+    if (it == generations.end())
+        return false;
+
+    generation = it->second;
+    return true;
+}
+
+void NanoVGDisplayList::ImageSnapshots::takeDeletedImages (std::vector<juce::ImagePixelData*>& deleted)
+{
+    const juce::ScopedLock sl (lock);
+
+    deleted.clear();
+    std::swap (deleted, deletedCopies);
+}
+
+void NanoVGDisplayList::ImageSnapshots::release (Entry& entry)
+{
+    for (auto& copy : entry.copies)
+        releasedCopies.push_back (std::move (copy));
+
+    entry.copies.clear();
+}
+
+void NanoVGDisplayList::ImageSnapshots::imageDataChanged (juce::ImagePixelData* pixelData)
+{
+    const juce::ScopedLock sl (lock);
+
+    if (auto it = entries.find (pixelData); it != entries.end())
+        it->second.modified = true;
+}
+
+void NanoVGDisplayList::ImageSnapshots::imageDataBeingDeleted (juce::ImagePixelData* pixelData)
+{
+    const juce::ScopedLock sl (lock);
+
+    // This may be called on any thread, the copies are deleted by the next beginFrame().
+    if (auto it = entries.find (pixelData); it != entries.end())
+    {
+        release (it->second);
+        entries.erase (it);
+    }
+}
+
+//==============================================================================
+NanoVGDisplayList::Recorder::Recorder (NanoVGDisplayList& l, ImageSnapshots& i, juce::Rectangle<int> bounds,
+                                       const juce::RectangleList<int>& area, float s)
+    : list (l)
+    , snapshots (i)
+    , scale (s)
+{
+    list.clear();
+    list.bounds = bounds;
+    list.area = area;
+    list.area.clipTo (bounds);
+    list.scale = scale;
+
+    snapshots.beginFrame();
+
+    state.clip = list.area.getBounds().toFloat();
+
+    // The area is a clip of the replay as well, so that it does not draw over the rest of the frame.
+    if (! list.area.isEmpty())
+        clipToRectangleList (list.area);
+}
+
+bool NanoVGDisplayList::Recorder::isVectorDevice() const
+{
+    return false;
+}
+
+void NanoVGDisplayList::Recorder::setOrigin (juce::Point<int> origin)
+{
+    state.transform = juce::AffineTransform::translation (origin).followedBy (state.transform);
+    list.write (Op::setOrigin, origin);
+}
+
+void NanoVGDisplayList::Recorder::addTransform (const juce::AffineTransform& transform)
+{
+    state.transform = transform.followedBy (state.transform);
+    list.write (Op::addTransform, toTransform (transform));
+}
+
+float NanoVGDisplayList::Recorder::getPhysicalPixelScaleFactor()
+{
+    return scale;
+}
+
+void NanoVGDisplayList::Recorder::intersectClip (juce::Rectangle<float> area)
+{
+    state.clip = state.clip.getIntersection (area);
+}
+
+bool NanoVGDisplayList::Recorder::clipToRectangle (const juce::Rectangle<int>& rectangle)
+{
+    intersectClip (rectangle.toFloat().transformedBy (state.transform));
+    list.write (Op::clipToRectangle, rectangle);
+    return ! isClipEmpty();
+}
+
+bool NanoVGDisplayList::Recorder::clipToRectangleList (const juce::RectangleList<int>& rectangles)
+{
+    intersectClip (rectangles.getBounds().toFloat().transformedBy (state.transform));
+
+    list.write (Op::clipToRectangleList, rectangles.getNumRectangles());
+    for (const auto& rectangle : rectangles)
+        list.commands.insert (list.commands.end(), reinterpret_cast<const uint8_t*> (&rectangle), reinterpret_cast<const uint8_t*> (&rectangle + 1));
+
+    return ! isClipEmpty();
+}
+
+void NanoVGDisplayList::Recorder::excludeClipRectangle (const juce::Rectangle<int>& rectangle)
+{
+    list.write (Op::excludeClipRectangle, rectangle);
+}
+
+void NanoVGDisplayList::Recorder::clipToPath (const juce::Path& path, const juce::AffineTransform& transform)
+{
+    intersectClip (path.getBoundsTransformed (transform.followedBy (state.transform)));
+    list.write (Op::clipToPath, add (list.paths, list.numPaths, path), toTransform (transform));
+}
+
+void NanoVGDisplayList::Recorder::clipToImageAlpha (const juce::Image& image, const juce::AffineTransform& transform)
+{
+    intersectClip (image.getBounds().toFloat().transformedBy (transform.followedBy (state.transform)));
+    list.write (Op::clipToImageAlpha, add (list.images, list.numImages, snapshots.get (image)), toTransform (transform));
+}
+
+bool NanoVGDisplayList::Recorder::clipRegionIntersects (const juce::Rectangle<int>& rectangle)
+{
+    return getClipBounds().intersects (rectangle);
+}
+
+juce::Rectangle<int> NanoVGDisplayList::Recorder::getClipBounds() const
+{
+    return state.clip.transformedBy (state.transform.inverted()).getSmallestIntegerContainer();
+}
+
+bool NanoVGDisplayList::Recorder::isClipEmpty() const
+{
+    return state.clip.isEmpty();
+}
+
+void NanoVGDisplayList::Recorder::saveState()
+{
+    savedStates.push_back (state);
+    list.write (Op::saveState);
+}
+
+void NanoVGDisplayList::Recorder::restoreState()
+{
+    if (savedStates.empty())
+        return;
+
+    state = savedStates.back();
+    savedStates.pop_back();
+    list.write (Op::restoreState);
+}
+
+void NanoVGDisplayList::Recorder::beginTransparencyLayer (float opacity)
+{
+    savedStates.push_back (state);
+    list.write (Op::beginTransparencyLayer, opacity);
+}
+
+void NanoVGDisplayList::Recorder::endTransparencyLayer()
+{
+    if (savedStates.empty())
+        return;
+
+    state = savedStates.back();
+    savedStates.pop_back();
+    list.write (Op::endTransparencyLayer);
+}
+
+void NanoVGDisplayList::Recorder::setFill (const juce::FillType& fillType)
+{
+    if (fillType.isColour())
+        list.write (Op::setColour, fillType.colour.getARGB());
+    else
+        list.write (Op::setFill, add (list.fills, list.numFills, fillType));
+}
+
+void NanoVGDisplayList::Recorder::setOpacity (float opacity)
+{
+    list.write (Op::setOpacity, opacity);
+}
+
+void NanoVGDisplayList::Recorder::setInterpolationQuality (juce::Graphics::ResamplingQuality quality)
+{
+    list.write (Op::setInterpolationQuality, (int) quality);
+}
+
+void NanoVGDisplayList::Recorder::fillRect (const juce::Rectangle<int>& rectangle, bool replaceExistingContents)
+{
+    list.write (Op::fillRectInt, rectangle, replaceExistingContents);
+}
+
+void NanoVGDisplayList::Recorder::fillRect (const juce::Rectangle<float>& rectangle)
+{
+    list.write (Op::fillRect, rectangle);
+}
+
+void NanoVGDisplayList::Recorder::fillRectList (const juce::RectangleList<float>& rectangles)
+{
+    list.write (Op::fillRectList, rectangles.getNumRectangles());
+    for (const auto& rectangle : rectangles)
+        list.commands.insert (list.commands.end(), reinterpret_cast<const uint8_t*> (&rectangle), reinterpret_cast<const uint8_t*> (&rectangle + 1));
+}
+
+void NanoVGDisplayList::Recorder::strokePath (const juce::Path& path, const juce::PathStrokeType& strokeType, const juce::AffineTransform& transform)
+{
+    list.write (Op::strokePath,
+                add (list.paths, list.numPaths, path),
+                strokeType.getStrokeThickness(),
+                (int) strokeType.getJointStyle(),
+                (int) strokeType.getEndStyle(),
+                toTransform (transform));
+}
+
+void NanoVGDisplayList::Recorder::fillPath (const juce::Path& path, const juce::AffineTransform& transform)
+{
+    list.write (Op::fillPath, add (list.paths, list.numPaths, path), toTransform (transform));
+}
+
+void NanoVGDisplayList::Recorder::drawImage (const juce::Image& image, const juce::AffineTransform& transform)
+{
+    list.write (Op::drawImage, add (list.images, list.numImages, snapshots.get (image)), toTransform (transform));
+}
+
+void NanoVGDisplayList::Recorder::drawLine (const juce::Line<float>& line)
+{
+    list.write (Op::drawLine, line);
+}
+
+void NanoVGDisplayList::Recorder::setFont (const juce::Font& font)
+{
+    state.font = font;
+    list.write (Op::setFont, add (list.fonts, list.numFonts, font));
+}
+
+const juce::Font& NanoVGDisplayList::Recorder::getFont()
+{
+    return state.font;
+}
+
+void NanoVGDisplayList::Recorder::drawGlyph (int glyphNumber, const juce::AffineTransform& transform)
+{
+    list.write (Op::drawGlyph, glyphNumber, toTransform (transform));
+}
+
+bool NanoVGDisplayList::Recorder::drawTextLayout (const juce::AttributedString& text, const juce::Rectangle<float>& area)
+{
+    list.write (Op::drawTextLayout, add (list.strings, list.numStrings, text), area);
+    return true;
+}
@@ -0,0 +1,245 @@
+//
+//  Copyright (C) 2022 Arthur Benilov <arthur.benilov@gmail.com> and Timothy Schoen <timschoen123@gmail.com>
+//
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "NanoVGImageCache.h"
+
+/**
+    JUCE paint calls recorded to be made later, possibly on another thread: components paint
+    into a Recorder on the message thread, and the render thread replays the list into a
+    NanoVGGraphicsContext.
+
+    Calls are stored as an opcode followed by plain values in a byte buffer, the paths, images,
+    fonts, fills and strings they use are copied into tables next to it. Images are copied through
+    an ImageSnapshots, so that they can be modified while the list is replayed. Clearing the list
+    keeps the memory, so once the buffers have grown recording a frame does not allocate for them.
+
+    @code
+    NanoVGDisplayList list;
+    NanoVGDisplayList::ImageSnapshots snapshots;
+    {
+        NanoVGDisplayList::Recorder recorder (list, snapshots, component.getLocalBounds(), damagedArea, scale);
+        juce::Graphics g (recorder);
+        component.paintEntireComponent (g, true);
+    }
+    list.replay (graphicsContext);
+    @endcode
+*/
+class NanoVGDisplayList
+{
+public:
+    class Recorder;
+    class ImageSnapshots;
+
+    /** Drops the recorded calls and the objects they use, keeping the memory. */
+    void clear();
+
+    /** Makes the recorded calls on the context, in the same order. */
+    void replay (juce::LowLevelGraphicsContext& context) const;
+
+    /** Bounds of the component the list was recorded for. */
+    juce::Rectangle<int> getBounds() const noexcept { return bounds; }
+
+    /** Pixels per point of the display the list was recorded for. */
+    float getScale() const noexcept { return scale; }
+
+    /** Part of the bounds that was painted, outside of it the previous frame is kept. */
+    const juce::RectangleList<int>& getArea() const noexcept { return area; }
+
+    /** True if the whole component was painted. */
+    bool isFullFrame() const { return area.containsRectangle (bounds); }
+
+private:
+    enum class Op : uint8_t
+    {
+        setOrigin,
+        addTransform,
+        clipToRectangle,
+        clipToRectangleList,
+        excludeClipRectangle,
+        clipToPath,
+        clipToImageAlpha,
+        saveState,
+        restoreState,
+        beginTransparencyLayer,
+        endTransparencyLayer,
+        setColour,
+        setFill,
+        setOpacity,
+        setInterpolationQuality,
+        fillRectInt,
+        fillRect,
+        fillRectList,
+        fillPath,
+        strokePath,
+        drawImage,
+        drawLine,
+        setFont,
+        drawGlyph,
+        drawTextLayout
+    };
+
+    // AffineTransform as plain floats, in the order of its members.
+    struct Transform
+    {
+        float m[6];
+    };
+
+    static Transform toTransform (const juce::AffineTransform&);
+    static juce::AffineTransform fromTransform (const Transform&);
+
+    template <typename... Values>
+    void write (Op op, const Values&... values);
+
+    template <typename Object>
+    static int add (std::vector<Object>& table, size_t& count, const Object& object);
+
+    std::vector<uint8_t> commands;
+
+    std::vector<juce::Path> paths;
+    std::vector<juce::Image> images;
+    std::vector<juce::Font> fonts;
+    std::vector<juce::FillType> fills;
+    std::vector<juce::AttributedString> strings;
+
+    // Entries of the tables used by the current recording, the ones after them are kept for reuse.
+    size_t numPaths {0}, numImages {0}, numFonts {0}, numFills {0}, numStrings {0};
+
+    juce::Rectangle<int> bounds;
+    juce::RectangleList<int> area;
+    float scale {1.0f};
+};
+
+/**
+    Copies of the images drawn into display lists, made on the message thread, so that the render
+    thread never reads pixels which are being modified.
+
+    An image is copied again only after it has been modified. A copy which no list holds anymore
+    is overwritten in place, so the image cache on the render thread keeps seeing the same few
+    images and updates their textures instead of creating new ones. Copies of images which have
+    not been drawn for a while are released.
+
+    The copies are only modified and deleted on the message thread, and the image cache of the
+    render thread tracks them through this class instead of listening to them.
+*/
+class NanoVGDisplayList::ImageSnapshots : public NanoVGImageCache::Tracker,
+                                          private juce::ImagePixelData::Listener
+{
+public:
+    ImageSnapshots() = default;
+    ~ImageSnapshots() override;
+
+    /** Returns a copy of the image with its current pixels. */
+    juce::Image get (const juce::Image& image);
+
+    /** Called for each recorded frame, releases the copies of images it did not draw lately. */
+    void beginFrame();
+
+    bool getGeneration (juce::ImagePixelData* pixelData, juce::uint32& generation) override;
+    void takeDeletedImages (std::vector<juce::ImagePixelData*>& deleted) override;
+
+private:
+    struct Entry
+    {
+        // Copies of the image, the first one has its current pixels.
+        std::vector<juce::Image> copies;
+        bool modified {false};
+        int lastUsedFrame {0};
+    };
+
+    void release (Entry& entry);
+
+    void imageDataChanged (juce::ImagePixelData*) override;
+    void imageDataBeingDeleted (juce::ImagePixelData*) override;
+
+    std::unordered_map<juce::ImagePixelData*, Entry> entries;
+    int frame {0};
+
+    // Times each copy has been overwritten, until it is deleted.
+    std::unordered_map<juce::ImagePixelData*, juce::uint32> generations;
+
+    // Released copies are kept until no list holds them, and deleted by beginFrame().
+    std::vector<juce::Image> releasedCopies;
+    std::vector<juce::ImagePixelData*> deletedCopies;
+
+    // Images may be modified or deleted on any thread.
+    juce::CriticalSection lock;
+
+    JUCE_DECLARE_NON_COPYABLE (ImageSnapshots)
+};
+
+/**
+    Records paint calls into a NanoVGDisplayList.
+
+    The clip is tracked as a bounding box, which is enough for components to skip painting what
+    is outside of it. Excluded rectangles and the shapes of path and image clips are applied when
+    the list is replayed.
+*/
+class NanoVGDisplayList::Recorder : public juce::LowLevelGraphicsContext
+{
+public:
+    /** Clears the list and records into it, clipped to the area of the given bounds. */
+    Recorder (NanoVGDisplayList& list, ImageSnapshots& snapshots, juce::Rectangle<int> bounds,
+              const juce::RectangleList<int>& area, float scale);
+
+    bool isVectorDevice() const override;
+    void setOrigin (juce::Point<int>) override;
+    void addTransform (const juce::AffineTransform&) override;
+    float getPhysicalPixelScaleFactor() override;
+
+    bool clipToRectangle (const juce::Rectangle<int>&) override;
+    bool clipToRectangleList (const juce::RectangleList<int>&) override;
+    void excludeClipRectangle (const juce::Rectangle<int>&) override;
+    void clipToPath (const juce::Path&, const juce::AffineTransform&) override;
+    void clipToImageAlpha (const juce::Image&, const juce::AffineTransform&) override;
+
+    bool clipRegionIntersects (const juce::Rectangle<int>&) override;
+    juce::Rectangle<int> getClipBounds() const override;
+    bool isClipEmpty() const override;
+
+    void saveState() override;
+    void restoreState() override;
+
+    void beginTransparencyLayer (float opacity) override;
+    void endTransparencyLayer() override;
+
+    void setFill (const juce::FillType&) override;
+    void setOpacity (float) override;
+    void setInterpolationQuality (juce::Graphics::ResamplingQuality) override;
+
+    void fillRect (const juce::Rectangle<int>&, bool) override;
+    void fillRect (const juce::Rectangle<float>&) override;
+    void fillRectList (const juce::RectangleList<float>&) override;
+
+    void strokePath (const juce::Path&, const juce::PathStrokeType&, const juce::AffineTransform&) override;
+    void fillPath (const juce::Path&, const juce::AffineTransform&) override;
+    void drawImage (const juce::Image&, const juce::AffineTransform&) override;
+    void drawLine (const juce::Line<float>&) override;
+
+    void setFont (const juce::Font&) override;
+    const juce::Font& getFont() override;
+    void drawGlyph (int glyphNumber, const juce::AffineTransform&) override;
+    bool drawTextLayout (const juce::AttributedString&, const juce::Rectangle<float>&) override;
+
+private:
+    struct State
+    {
+        juce::AffineTransform transform;
+        juce::Rectangle<float> clip;    // Bounding box of the clip, in the coordinates of the list.
+        juce::Font font;
+    };
+
+    void intersectClip (juce::Rectangle<float> area);
+
+    NanoVGDisplayList& list;
+    ImageSnapshots& snapshots;
+    float scale;
+
+    State state;
+    std::vector<State> savedStates;
+
+    JUCE_DECLARE_NON_COPYABLE (Recorder)
+};
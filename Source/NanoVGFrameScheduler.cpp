@@ -0,0 +1,213 @@
+//
+//  Copyright (C) 2022 Arthur Benilov <arthur.benilov@gmail.com> and Timothy Schoen <timschoen123@gmail.com>
+//
+
+#include "NanoVGFrameScheduler.h"
+
+namespace
+{
+    /** A frame the render thread has not drawn after this long is given up on, e.g. while the
+        context is being recreated or the component is hidden.
+    */
+    constexpr double frameTimeout = 250.0;
+
+    double now() { return juce::Time::getMillisecondCounterHiRes(); }
+}
+
+NanoVGFrameScheduler::NanoVGFrameScheduler (std::function<void (bool)> paintFrameToUse, bool isPacedBySwap)
+    : paintFrame {std::move (paintFrameToUse)},
+      pacedBySwap {isPacedBySwap}
+{
+}
+
+NanoVGFrameScheduler::~NanoVGFrameScheduler()
+{
+    cancelPendingUpdate();
+    stopTimer();
+}
+
+void NanoVGFrameScheduler::requestFrame()
+{
+    dirty = true;
+
+    // Otherwise the render thread asks for the next frame when it is done with this one.
+    if (! frameInFlight || now() - frameRequestTime > frameTimeout)
+        triggerAsyncUpdate();
+}
+
+void NanoVGFrameScheduler::setPeriodicRepaint (int fps)
+{
+    periodicRepaintInterval = fps > 0 ? 1000.0 / fps : 0.0;
+    nextPeriodicRepaint = now();
+
+    {
+        // The next frame is not timed against the previous rate.
+        const juce::SpinLock::ScopedLockType lock (statisticsLock);
+        nextFrameRefreshes = 0;
+    }
+
+    triggerAsyncUpdate();
+}
+
+void NanoVGFrameScheduler::handleAsyncUpdate()
+{
+    update();
+}
+
+void NanoVGFrameScheduler::timerCallback()
+{
+    update();
+}
+
+void NanoVGFrameScheduler::update()
+{
+    stopTimer();
+
+    const auto time = now();
+    const auto period = getRefreshPeriod();
+    const auto interval = periodicRepaintInterval.load();
+
+    if (frameInFlight)
+    {
+        const auto waited = time - frameRequestTime;
+
+        if (waited < frameTimeout)
+        {
+            if (dirty || interval > 0.0)
+                startTimer (juce::jmax (1, juce::roundToInt (frameTimeout - waited)));
+
+            return;
+        }
+    }
+
+    // A periodic repaint is painted for the refresh nearest to when it is due.
+    const bool periodicRepaint = interval > 0.0 && time >= nextPeriodicRepaint - period * 0.5;
+
+    if (! dirty && ! periodicRepaint)
+    {
+        if (interval > 0.0)
+            startTimer (juce::jmax (1, juce::roundToInt (nextPeriodicRepaint - period * 0.5 - time)));
+
+        return;
+    }
+
+    if (! pacedBySwap)
+    {
+        const auto nextRefresh = lastFrameStart + period;
+
+        if (time < nextRefresh - 1.0)
+        {
+            startTimer (juce::jmax (1, juce::roundToInt (nextRefresh - time)));
+            return;
+        }
+    }
+
+    if (periodicRepaint)
+    {
+        nextPeriodicRepaint += interval;
+
+        // Too late for the next one as well, start again from this frame.
+        if (time >= nextPeriodicRepaint - period * 0.5)
+            nextPeriodicRepaint = time + interval;
+    }
+
+    dirty = false;
+
+    if (pacedBySwap)
+    {
+        frameRequestTime = time;
+        frameInFlight = true;
+    }
+
+    paintFrame (periodicRepaint);
+}
+
+void NanoVGFrameScheduler::frameRendered (double startTime, double endTime)
+{
+    const auto period = getRefreshPeriod();
+    const auto interval = periodicRepaintInterval.load();
+    const bool isDirty = dirty;
+
+    {
+        const juce::SpinLock::ScopedLockType lock (statisticsLock);
+
+        ++statistics.framesRendered;
+        totalRenderTime += endTime - startTime;
+
+        if (nextFrameRefreshes > 0)
+        {
+            const auto frameTime = startTime - lastFrameStart;
+
+            ++framesTimed;
+            totalFrameTime += frameTime;
+            statistics.worstFrameTime = juce::jmax (statistics.worstFrameTime, frameTime);
+            statistics.framesDropped += juce::jmax (0, juce::roundToInt (frameTime / period) - nextFrameRefreshes);
+
+            // Only the swap tells when the display refreshes, with a timer frames follow the estimate.
+            // Frames drawn without waiting for it, e.g. when JUCE repaints the context, are left out.
+            if (pacedBySwap && nextFrameRefreshes == 1 && frameTime >= 1000.0 / 240.0)
+            {
+                refreshSamples[numRefreshSamples++] = frameTime;
+
+                if (numRefreshSamples == refreshSamples.size())
+                {
+                    updateRefreshPeriod();
+                    numRefreshSamples = 0;
+                }
+            }
+        }
+
+        if (isDirty)
+            nextFrameRefreshes = 1;
+        else if (interval > 0.0)
+            nextFrameRefreshes = juce::jmax (1, juce::roundToInt (interval / period));
+        else
+            nextFrameRefreshes = 0;
+    }
+
+    lastFrameStart = startTime;
+    frameInFlight = false;
+
+    if (isDirty || interval > 0.0)
+        triggerAsyncUpdate();
+}
+
+void NanoVGFrameScheduler::updateRefreshPeriod()
+{
+    // The mean of the frames that did not miss a refresh, the swap returns at slightly different times.
+    const auto shortest = *std::min_element (refreshSamples.begin(), refreshSamples.end());
+    double total = 0.0;
+    int count = 0;
+
+    for (auto frameTime : refreshSamples)
+    {
+        if (frameTime < shortest * 1.5)
+        {
+            total += frameTime;
+            ++count;
+        }
+    }
+
+    refreshPeriod = juce::jlimit (1000.0 / 240.0, 1000.0 / 24.0, total / count);
+}
+
+NanoVGFrameScheduler::Statistics NanoVGFrameScheduler::getStatistics() const
+{
+    const juce::SpinLock::ScopedLockType lock (statisticsLock);
+
+    auto result = statistics;
+    result.averageFrameTime = framesTimed > 0 ? totalFrameTime / framesTimed : 0.0;
+    result.averageRenderTime = statistics.framesRendered > 0 ? totalRenderTime / statistics.framesRendered : 0.0;
+    result.refreshRate = 1000.0 / getRefreshPeriod();
+    return result;
+}
+
+void NanoVGFrameScheduler::resetStatistics()
+{
+    const juce::SpinLock::ScopedLockType lock (statisticsLock);
+
+    statistics = {};
+    totalFrameTime = 0.0;
+    totalRenderTime = 0.0;
+    framesTimed = 0;
+}
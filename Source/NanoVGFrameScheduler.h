@@ -0,0 +1,104 @@
+//
+//  Copyright (C) 2022 Arthur Benilov <arthur.benilov@gmail.com> and Timothy Schoen <timschoen123@gmail.com>
+//
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+    Paces the frames of a NanoVGComponent with the display refresh.
+
+    Invalidations from any thread only mark the component as dirty, and are painted together
+    with the next frame: at most one frame is in flight, and the next one is requested when the
+    render thread has drawn it. Since the render thread waits for the swap, frames follow the
+    refresh of the display instead of a timer, and nothing is painted while nothing is dirty.
+
+    Without a swap to wait for, as with Metal which draws on the message thread, frames are
+    spaced by a timer at the refresh rate instead.
+
+    Frames are painted on the message thread with the function given to the constructor, which
+    is told whether the frame is due to the periodic repaint.
+*/
+class NanoVGFrameScheduler : private juce::AsyncUpdater,
+                             private juce::Timer
+{
+public:
+    /** Frame times are in milliseconds. */
+    struct Statistics
+    {
+        /** Frames drawn by the render thread. */
+        int framesRendered = 0;
+
+        /** Refreshes missed between frames that should have followed each other. */
+        int framesDropped = 0;
+
+        /** Time between frames that should have followed each other. */
+        double averageFrameTime = 0.0;
+        double worstFrameTime = 0.0;
+
+        /** Time the render thread spent drawing a frame, without waiting for the swap. */
+        double averageRenderTime = 0.0;
+
+        /** Estimated from the frame times, 60 Hz until frames have been drawn back to back. */
+        double refreshRate = 0.0;
+    };
+
+    NanoVGFrameScheduler (std::function<void (bool periodicRepaint)> paintFrame, bool pacedBySwap);
+    ~NanoVGFrameScheduler() override;
+
+    /** Paints a frame at the next refresh, can be called from any thread. */
+    void requestFrame();
+
+    /** Repaints everything at most fps times per second, aligned to the refresh of the display.
+        Zero or less stops the periodic repaint.
+    */
+    void setPeriodicRepaint (int fps);
+
+    /** Called by the render thread when it has drawn a frame, with the times it started and
+        finished drawing it as given by juce::Time::getMillisecondCounterHiRes().
+    */
+    void frameRendered (double startTime, double endTime);
+
+    Statistics getStatistics() const;
+    void resetStatistics();
+
+private:
+    void handleAsyncUpdate() override;
+    void timerCallback() override;
+
+    /** Paints the next frame if one is needed and due, on the message thread. */
+    void update();
+
+    void updateRefreshPeriod();
+
+    double getRefreshPeriod() const noexcept { return refreshPeriod.load(); }
+
+    std::function<void (bool)> paintFrame;
+    const bool pacedBySwap;
+
+    std::atomic<bool> dirty {false};
+    std::atomic<bool> frameInFlight {false};
+    std::atomic<double> frameRequestTime {0.0};
+
+    std::atomic<double> periodicRepaintInterval {0.0};
+    double nextPeriodicRepaint {0.0};
+
+    std::atomic<double> refreshPeriod {1000.0 / 60.0};
+    std::atomic<double> lastFrameStart {0.0};
+
+    // Written by the render thread.
+    juce::SpinLock statisticsLock;
+    Statistics statistics;
+    double totalFrameTime {0.0}, totalRenderTime {0.0};
+    int framesTimed {0};
+
+    /** Refreshes expected before the next frame, zero if it was not requested right away. */
+    int nextFrameRefreshes {0};
+
+    /** Times between frames drawn at consecutive refreshes, for the refresh rate. */
+    std::array<double, 60> refreshSamples {};
+    size_t numRefreshSamples {0};
+
+    JUCE_DECLARE_NON_COPYABLE (NanoVGFrameScheduler)
+};
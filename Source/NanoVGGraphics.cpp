@@ -7,7 +7,11 @@
 #if NANOVG_METAL_IMPLEMENTATION
 #include <nanovg_mtl.h>
 #else
+// JUCE's loader declares the sync objects of GL 3.2 and GLES 3, which nanovg then uses to write its
+// vertex buffers in place if the context has them.
+#define NANOVG_GL_USE_SYNC 1
 #include <nanovg_gl.h>
+#include <nanovg_gl_utils.h>
 #endif
 
 //==============================================================================
@@ -22,27 +26,46 @@ void nvgCurrentScissor(NVGcontext* ctx, float* x, float* y, float* w, float* h);
 
 //==============================================================================
 
-const static auto allPrintableAsciiCharacters = []() -> juce::String {
-    juce::String str;
-
-    // Only map printable characters
-    for (juce::juce_wchar c = 32; c < 127; ++c)
-        str += juce::String::charToString (c);
-
-    return str;
-}();
+// JUCE's FreeType and Android typefaces number glyphs by their character, the others by their
+// index in the font file. nanovg draws those directly when it loaded the same file, see getGlyphMapping().
+#if JUCE_LINUX || JUCE_BSD || JUCE_ANDROID
+ static constexpr bool glyphNumbersAreCharacters = true;
+#else
+ static constexpr bool glyphNumbersAreCharacters = false;
+#endif
 
-const static int maxImageCacheSize = 256;
+// Name of the font nanovg loads for a JUCE font, from the resource of the same name.
+static juce::String getFontName (const juce::Font& font)
+{
+    return font.getTypefacePtr()->getName() + "-" + font.getTypefaceStyle();
+}
 
 static NVGcolor nvgColour (const juce::Colour& c)
 {
     return nvgRGBA (c.getRed(), c.getGreen(), c.getBlue(), c.getAlpha());
 }
 
-static uint64_t getImageHash (const juce::Image& image)
+// FNV-1a over the path commands, the linear part of the transform and the fill rule, used as the key
+// for nanovg's retained path cache. The translation is left out, nanovg applies it as an offset.
+static uint64_t getPathHash (const float* commands, size_t numCommands, const juce::AffineTransform& transform, bool nonZeroWinding)
 {
-    juce::Image::BitmapData src (image, juce::Image::BitmapData::readOnly);
-    return (uint64_t) src.data;
+    uint64_t hash = 14695981039346656037ull;
+
+    auto add = [&hash] (const void* data, size_t size)
+    {
+        auto* bytes = static_cast<const uint8_t*> (data);
+
+        for (size_t i = 0; i < size; ++i)
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+    };
+
+    add (commands, sizeof (float) * numCommands);
+
+    const float matrix[] = { transform.mat00, transform.mat01, transform.mat10, transform.mat11 };
+    add (matrix, sizeof (matrix));
+    add (&nonZeroWinding, sizeof (nonZeroWinding));
+
+    return hash;
 }
 
 static const char* getResourceByFileName(const juce::String& fileName, int& size)
@@ -60,7 +83,9 @@ static const char* getResourceByFileName(const juce::String& fileName, int& size
 
 const juce::String NanoVGGraphicsContext::defaultTypefaceName = "Verdana-Regular";
 
-const int NanoVGGraphicsContext::imageCacheSize = 256;
+const size_t NanoVGGraphicsContext::imageCacheBudget = 64 * 1024 * 1024;
+
+const int NanoVGGraphicsContext::pathCacheBudget = 4 * 1024 * 1024;
 
 //==============================================================================
 
@@ -76,11 +101,28 @@ NanoVGGraphicsContext::NanoVGGraphicsContext (void* nativeHandle, int w, int h,
     nvg = nvgCreateContext(NVG_ANTIALIAS | NVG_STENCIL_STROKES);
 #endif
 
-    nvgGlobalCompositeOperation(nvg, NVG_SOURCE_OVER);
+    initialise();
+}
 
+NanoVGGraphicsContext::NanoVGGraphicsContext (NVGcontext* context, int w, int h, float pixelScale) :
+      nvg {context},
+      width {w},
+      height {h},
+      scale{pixelScale}
+{
+    initialise();
+}
+
+void NanoVGGraphicsContext::initialise()
+{
     jassert(nvg);
 
+    nvgGlobalCompositeOperation(nvg, NVG_SOURCE_OVER);
+    nvgRetainedPathBudget(nvg, pathCacheBudget);
+
     loadFontFromResources(defaultTypefaceName);
+
+    imageCache = std::make_unique<NanoVGImageCache> (nvg, imageCacheBudget);
 }
 
 NanoVGGraphicsContext::~NanoVGGraphicsContext()
@@ -91,11 +133,15 @@ bool NanoVGGraphicsContext::isVectorDevice() const { return false; }
 
 void NanoVGGraphicsContext::setOrigin (juce::Point<int> origin)
 {
+    flush();
+
     nvgTranslate (nvg, origin.getX(), origin.getY());
 }
 
 void NanoVGGraphicsContext::addTransform (const juce::AffineTransform& t)
 {
+    flush();
+
     nvgTransform (nvg, t.mat00, t.mat10, t.mat01, t.mat11, t.mat02, t.mat12);
 }
 
@@ -103,35 +149,66 @@ float NanoVGGraphicsContext::getPhysicalPixelScaleFactor() { return scale; }
 
 bool NanoVGGraphicsContext::clipToRectangle (const juce::Rectangle<int>& rect)
 {
+    flush();
+
     nvgIntersectScissor (nvg, rect.getX(), rect.getY(), rect.getWidth(), rect.getHeight());
     return !getClipBounds().isEmpty();
 }
 
 bool NanoVGGraphicsContext::clipToRectangleList (const juce::RectangleList<int>& rects)
 {
+    if (rects.getNumRectangles() == 1)
+        return clipToRectangle (rects.getRectangle (0));
+
+    flush();
+
+    // An empty list clips everything, like an empty path.
+    nvgBeginPath (nvg);
+
     for (const auto& rect : rects)
-        nvgIntersectScissor (nvg, rect.getX(), rect.getY(), rect.getWidth(), rect.getHeight());
+        nvgRect (nvg, rect.getX(), rect.getY(), rect.getWidth(), rect.getHeight());
 
-    return ! getClipBounds().isEmpty();
+    nvgClipPath (nvg);
+    return ! isClipEmpty();
 }
 
 void NanoVGGraphicsContext::excludeClipRectangle (const juce::Rectangle<int>& rect)
 {
-    // @todo
-    jassertfalse;
+    flush();
+
+    // Renderers without clips only manage exclusions that narrow the scissor. Otherwise the clip is
+    // left as it was unless it is excluded entirely, which JUCE's own use of this is fine with: it
+    // excludes opaque child components, which are painted over what is drawn below them.
+    if (! nvgExcludeClipRect (nvg, (float) rect.getX(), (float) rect.getY(), (float) rect.getWidth(), (float) rect.getHeight())
+        && rect.contains (getClipBounds()))
+        nvgScissor (nvg, 0.0f, 0.0f, 0.0f, 0.0f);
 }
 
 void NanoVGGraphicsContext::clipToPath (const juce::Path& path, const juce::AffineTransform& t)
 {
-    // @todo
-    const auto rect = path.getBoundsTransformed (t);
-    nvgIntersectScissor (nvg, rect.getX(), rect.getY(), rect.getWidth(), rect.getHeight());
+    flush();
+
+    setPath (path, t);
+    nvgClipPath (nvg);
 }
 
-void NanoVGGraphicsContext::clipToImageAlpha (const juce::Image&, const juce::AffineTransform&)
+void NanoVGGraphicsContext::clipToImageAlpha (const juce::Image& image, const juce::AffineTransform& t)
 {
-    // @todo
-    jassertfalse;
+    flush();
+
+    const auto id = imageCache->getImageId (image);
+
+    if (id < 0)
+    {
+        nvgScissor (nvg, 0.0f, 0.0f, 0.0f, 0.0f);
+        return;
+    }
+
+    auto paint = nvgImagePattern (nvg, 0.0f, 0.0f, (float) image.getWidth(), (float) image.getHeight(), 0.0f, id, 1.0f);
+    const float xform[6] = { t.mat00, t.mat10, t.mat01, t.mat11, t.mat02, t.mat12 };
+    nvgTransformMultiply (paint.xform, xform);
+
+    nvgClipImageAlpha (nvg, paint);
 }
 
 bool NanoVGGraphicsContext::clipRegionIntersects (const juce::Rectangle<int>& rect)
@@ -160,37 +237,65 @@ bool NanoVGGraphicsContext::isClipEmpty() const
 
     nvgCurrentScissor (nvg, &x, &y, &w, &h);
     
-    return w < 0.0f || h < 0.0f;
+    return w <= 0.0f || h <= 0.0f;
 }
 
 void NanoVGGraphicsContext::saveState()
 {
+    flush();
+
     nvgSave (nvg);
 }
 
 void NanoVGGraphicsContext::restoreState()
 {
+    flush();
+
     nvgRestore (nvg);
 }
 
 void NanoVGGraphicsContext::beginTransparencyLayer (float op)
 {
     saveState();
-    nvgGlobalAlpha (nvg, op);
+
+    // Renderers without offscreen layers fade each shape on its own instead.
+    if (nvgBeginLayer (nvg))
+    {
+        layerOpacities.push_back (op);
+    }
+    else
+    {
+        layerOpacities.push_back (-1.0f);
+        nvgGlobalAlpha (nvg, op);
+    }
 }
 
 void NanoVGGraphicsContext::endTransparencyLayer()
 {
     restoreState();
+
+    if (layerOpacities.empty())
+        return;
+
+    const auto op = layerOpacities.back();
+    layerOpacities.pop_back();
+
+    if (op >= 0.0f)
+        nvgEndLayer (nvg, op);
 }
 
 void NanoVGGraphicsContext::setFill (const juce::FillType& f)
 {
+    if (f != fillType)
+        flush();
+
     fillType = f;
 }
 
 void NanoVGGraphicsContext::setOpacity(float op)
 {
+    flush();
+
     fillType.setOpacity(op);
 }
 
@@ -201,28 +306,28 @@ void NanoVGGraphicsContext::setInterpolationQuality (juce::Graphics::ResamplingQ
 
 void NanoVGGraphicsContext::fillRect (const juce::Rectangle<int>& rect, bool /* replaceExistingContents */)
 {
-    nvgBeginPath (nvg);
-    applyFillType();
-    nvgRect (nvg, rect.getX(), rect.getY(), rect.getWidth(), rect.getHeight());
-    nvgFill (nvg);
+    fillRect (rect.toFloat());
 }
 
 void NanoVGGraphicsContext::fillRect (const juce::Rectangle<float>& rect)
 {
-    nvgBeginPath (nvg);
-    applyFillType();
-    nvgRect (nvg, rect.getX(), rect.getY(), rect.getWidth(), rect.getHeight());
-    nvgFill (nvg);
+    // Rectangles are filled together when the state changes, so a meter or a grid is one draw call.
+    flushGlyphs();
+
+    pendingRects.insert (pendingRects.end(), { rect.getX(), rect.getY(), rect.getWidth(), rect.getHeight() });
 }
 
 void NanoVGGraphicsContext::fillRectList (const juce::RectangleList<float>& rects)
 {
+    flushGlyphs();
+
     for (const auto& rect : rects)
-        fillRect (rect);
+        pendingRects.insert (pendingRects.end(), { rect.getX(), rect.getY(), rect.getWidth(), rect.getHeight() });
 }
 
 void NanoVGGraphicsContext::strokePath (const juce::Path& path, const juce::PathStrokeType& strokeType, const juce::AffineTransform& transform) {
-    
+    flush();
+
        // First set options
     switch (strokeType.getEndStyle())
     {
@@ -248,13 +353,20 @@ void NanoVGGraphicsContext::strokePath (const juce::Path& path, const juce::Path
 
 void NanoVGGraphicsContext::setPath (const juce::Path& path, const juce::AffineTransform& transform)
 {
-    juce::Path p (path);
-    p.applyTransform (transform);
+    // The buffer is written in place and never shrinks, so once it is large enough no path allocates.
+    size_t numCommands = 0;
 
-    nvgBeginPath (nvg);
+    auto append = [this, &numCommands] (std::initializer_list<float> values)
+    {
+        if (numCommands + values.size() > pathCommands.size())
+            pathCommands.resize (juce::jmax ((size_t) 256, pathCommands.size() * 2));
+
+        std::copy (values.begin(), values.end(), pathCommands.data() + numCommands);
+        numCommands += values.size();
+    };
+
+    juce::Path::Iterator i (path);
 
-    juce::Path::Iterator i (p);
-    
     // Flag is used to flip winding when drawing shapes with holes.
     bool solid = true;
 
@@ -263,20 +375,19 @@ void NanoVGGraphicsContext::setPath (const juce::Path& path, const juce::AffineT
         switch (i.elementType)
         {
             case juce::Path::Iterator::startNewSubPath:
-            nvgMoveTo (nvg, i.x1, i.y1);
+            append ({ (float) NVG_MOVETO, i.x1, i.y1 });
             break;
             case juce::Path::Iterator::lineTo:
-            nvgLineTo (nvg, i.x1, i.y1);
+            append ({ (float) NVG_LINETO, i.x1, i.y1 });
             break;
             case juce::Path::Iterator::quadraticTo:
-            nvgQuadTo (nvg, i.x1, i.y1, i.x2, i.y2);
+            append ({ (float) NVG_QUADTO, i.x1, i.y1, i.x2, i.y2 });
             break;
             case juce::Path::Iterator::cubicTo:
-            nvgBezierTo (nvg, i.x1, i.y1, i.x2, i.y2, i.x3, i.y3);
+            append ({ (float) NVG_BEZIERTO, i.x1, i.y1, i.x2, i.y2, i.x3, i.y3 });
             break;
             case juce::Path::Iterator::closePath:
-            nvgClosePath (nvg);
-            nvgPathWinding (nvg, solid ? NVG_SOLID : NVG_HOLE);
+            append ({ (float) NVG_CLOSE, (float) NVG_WINDING, (float) (solid ? NVG_SOLID : NVG_HOLE) });
             solid = ! solid;
             break;
         default:
@@ -284,10 +395,23 @@ void NanoVGGraphicsContext::setPath (const juce::Path& path, const juce::AffineT
         }
     }
 
+    // Paths that were drawn before with the same scale and rotation reuse their tessellated geometry,
+    // moved by the translation. The commands are compared as well, in case another path has the same key.
+    const auto key = getPathHash (pathCommands.data(), numCommands, transform, path.isUsingNonZeroWinding());
+
+    if (nvgBeginRetainedPathCommands (nvg, key, pathCommands.data(), (int) numCommands, transform.mat02, transform.mat12))
+        return;
+
+    // nanovg transforms the points with its SIMD kernels while ingesting them.
+    const float xform[] = { transform.mat00, transform.mat10, transform.mat01, transform.mat11, transform.mat02, transform.mat12 };
+
+    nvgAppendPathCommands (nvg, pathCommands.data(), (int) numCommands, transform.isIdentity() ? nullptr : xform);
 }
 
 void NanoVGGraphicsContext::fillPath (const juce::Path& path, const juce::AffineTransform& transform)
 {
+    flush();
+
     setPath(path, transform);
     applyFillType();
     nvgFill (nvg);
@@ -295,10 +419,12 @@ void NanoVGGraphicsContext::fillPath (const juce::Path& path, const juce::Affine
 
 void NanoVGGraphicsContext::drawImage (const juce::Image& image, const juce::AffineTransform& t)
 {
+    flush();
+
     if (image.isARGB())
     {
         juce::Image::BitmapData srcData (image, juce::Image::BitmapData::readOnly);
-        auto id = getNvgImageId (image);
+        auto id = imageCache->getImageId (image);
 
         if (id < 0)
             return; // invalid image.
@@ -326,6 +452,8 @@ void NanoVGGraphicsContext::drawImage (const juce::Image& image, const juce::Aff
 
 void NanoVGGraphicsContext::drawLine (const juce::Line<float>& line)
 {
+    flush();
+
     nvgBeginPath (nvg);
     nvgMoveTo (nvg, line.getStartX(), line.getStartY());
     nvgLineTo (nvg, line.getEndX(), line.getEndY());
@@ -335,6 +463,9 @@ void NanoVGGraphicsContext::drawLine (const juce::Line<float>& line)
 
 void NanoVGGraphicsContext::setFont (const juce::Font& f)
 {
+    if (f != font)
+        flush();
+
     font = f;
     applyFont();
 }
@@ -346,26 +477,135 @@ const juce::Font& NanoVGGraphicsContext::getFont()
 
 void NanoVGGraphicsContext::drawGlyph (int glyphNumber, const juce::AffineTransform& t)
 {
-    if (currentGlyphToCharMap == nullptr)
-        return;
+    // Glyphs are drawn together when the state changes, so a line of text is one draw call.
+    flushRects();
 
-    char txt[2] = {'?', 0};
+    glyphRun.push_back (glyphNumber);
+    glyphRunPositions.insert (glyphRunPositions.end(), { t.getTranslationX(), t.getTranslationY() });
+}
+
+void NanoVGGraphicsContext::flush()
+{
+    flushGlyphs();
+    flushRects();
+}
 
-    if (currentGlyphToCharMap->find (glyphNumber) != currentGlyphToCharMap->end())
-        txt[0] = (char)currentGlyphToCharMap->at (glyphNumber);
+void NanoVGGraphicsContext::flushGlyphs()
+{
+    if (glyphRun.empty())
+        return;
 
     nvgFillColor (nvg, nvgColour (fillType.colour));
-    nvgText (nvg, t.getTranslationX(), t.getTranslationY(), txt, &txt[1]);
 
+    if (glyphNumbersAreCharacters)
+    {
+        nvgTextRun (nvg, reinterpret_cast<const unsigned int*> (glyphRun.data()), glyphRunPositions.data(), (int) glyphRun.size());
+    }
+    else if (const auto& mapping = getGlyphMapping(); mapping.indicesMatch)
+    {
+        nvgGlyphs (nvg, glyphRun.data(), glyphRunPositions.data(), (int) glyphRun.size());
+    }
+    else
+    {
+        // nanovg draws another font file, so the glyphs are drawn by their characters. Glyphs whose
+        // character is not known are left out, the others keep their positions.
+        size_t count = 0;
+
+        for (size_t i = 0; i < glyphRun.size(); ++i)
+        {
+            const auto c = mapping.characters.find (glyphRun[i]);
+
+            if (c == mapping.characters.end())
+                continue;
+
+            glyphRun[count] = (int) c->second;
+            glyphRunPositions[count * 2] = glyphRunPositions[i * 2];
+            glyphRunPositions[count * 2 + 1] = glyphRunPositions[i * 2 + 1];
+            ++count;
+        }
+
+        nvgTextRun (nvg, reinterpret_cast<const unsigned int*> (glyphRun.data()), glyphRunPositions.data(), (int) count);
+    }
+
+    glyphRun.clear();
+    glyphRunPositions.clear();
+}
+
+const NanoVGGraphicsContext::GlyphMapping& NanoVGGraphicsContext::getGlyphMapping()
+{
+    const auto name = getFontName (font);
+    auto [it, inserted] = glyphMappings.try_emplace (name);
+    auto& mapping = it->second;
+
+    if (! inserted)
+        return mapping;
+
+    auto typeface = font.getTypefacePtr();
+    juce::Array<int> glyphs;
+    juce::Array<float> offsets;
+
+    auto getGlyph = [&] (juce::juce_wchar c)
+    {
+        glyphs.clearQuick();
+        offsets.clearQuick();
+        typeface->getGlyphPositions (juce::String::charToString (c), glyphs, offsets);
+        return glyphs.size() == 1 ? glyphs.getFirst() : -1;
+    };
+
+    // applyFont() falls back to the default font when there is no resource for the typeface. If
+    // there is one, JUCE may still have found another version of the font on the system, so a few
+    // characters are checked to have the same glyph indices in both.
+    if (loadedFonts.count (name) > 0)
+    {
+        const juce::String probe ("AaEeGgQqRrWwz019&@?");
+        mapping.indicesMatch = true;
+
+        for (auto p = probe.getCharPointer(); ! p.isEmpty(); ++p)
+            mapping.indicesMatch = mapping.indicesMatch && getGlyph (*p) == nvgGlyphIndex (nvg, (unsigned int) *p);
+    }
+
+    if (! mapping.indicesMatch)
+    {
+        // Latin, Greek, Cyrillic, punctuation and currency signs.
+        const std::pair<juce::juce_wchar, juce::juce_wchar> ranges[] = { { 0x20, 0x24f }, { 0x370, 0x4ff }, { 0x2000, 0x20cf } };
+
+        for (const auto& [first, last] : ranges)
+        {
+            for (auto c = first; c <= last; ++c)
+            {
+                const auto glyph = getGlyph (c);
+
+                if (glyph > 0)
+                    mapping.characters.try_emplace (glyph, c);
+            }
+        }
+    }
+
+    return mapping;
+}
+
+void NanoVGGraphicsContext::flushRects()
+{
+    if (pendingRects.empty())
+        return;
+
+    applyFillType();
+    nvgFillRects (nvg, pendingRects.data(), (int) pendingRects.size() / 4);
+
+    pendingRects.clear();
 }
 
 bool NanoVGGraphicsContext::drawTextLayout (const juce::AttributedString& str, const juce::Rectangle<float>& rect)
 {
+    flush();
+
     nvgSave (nvg);
     nvgIntersectScissor (nvg, rect.getX(), rect.getY(), rect.getWidth(), rect.getHeight());
 
-    const std::string text = str.getText().toStdString();
-    const char* textPtr = text.c_str();
+    // JUCE strings are UTF-8 already, the attribute ranges are in characters.
+    const juce::String& text = str.getText();
+    auto textPtr = text.getCharPointer();
+    int textIndex = 0;
 
     // NOTE:
     // This will not perform the correct rendering when JUCE's assumed font
@@ -384,20 +624,34 @@ bool NanoVGGraphicsContext::drawTextLayout (const juce::AttributedString& str, c
 
     nvgTextAlign (nvg, NVG_ALIGN_TOP);
 
+    // The font is only set on the nanovg state, which nvgRestore() puts back.
+    const auto previousFont = font;
+
     for (int i = 0; i < str.getNumAttributes(); ++i)
     {
-        const auto attr = str.getAttribute (i);
-        setFont (attr.font);
+        const auto& attr = str.getAttribute (i);
+
+        // Attributes often share a font, and nvgText() caches the glyphs of each run.
+        if (i == 0 || attr.font != font)
+        {
+            font = attr.font;
+            applyFont();
+        }
+
         nvgFillColor (nvg, nvgColour (attr.colour));
 
-        const char* begin = &textPtr[attr.range.getStart()];
-        const char* end = &textPtr[attr.range.getEnd()];
+        textPtr += attr.range.getStart() - textIndex;
+        const char* begin = textPtr.getAddress();
+        textPtr += attr.range.getLength();
+        const char* end = textPtr.getAddress();
+        textIndex = attr.range.getEnd();
 
         // We assume that ranges are sorted by x so that we can move
         // to the next glyph position efficiently.
         x = nvgText (nvg, x, y, begin, end);
     }
 
+    font = previousFont;
     nvgRestore (nvg);
     return true;
 }
@@ -411,21 +665,33 @@ void NanoVGGraphicsContext::resized(int w, int h, float pixelScale)
 
 void NanoVGGraphicsContext::removeCachedImages()
 {
-    for (auto it = images.begin(); it != images.end(); ++it)
-        nvgDeleteImage (nvg, it->second.id);
+    imageCache->clear();
+}
 
-    images.clear();
+void NanoVGGraphicsContext::setImageTracker (NanoVGImageCache::Tracker* tracker)
+{
+    imageCache->setTracker (tracker);
 }
 
-bool NanoVGGraphicsContext::loadFontFromResources (const juce::String& typefaceName)
+void NanoVGGraphicsContext::setImageCacheBudget (size_t budgetInBytes)
 {
-    auto it = loadedFonts.find (typefaceName);
+    imageCache->setBudget (budgetInBytes);
+}
 
-    if (it != loadedFonts.end())
-    {
-        currentGlyphToCharMap = &it->second;
+void NanoVGGraphicsContext::invalidateImageRegion (const juce::Image& image, juce::Rectangle<int> area)
+{
+    imageCache->invalidateRegion (image, area);
+}
+
+NanoVGImageCache::Stats NanoVGGraphicsContext::getImageCacheStats() const
+{
+    return imageCache->getStats();
+}
+
+bool NanoVGGraphicsContext::loadFontFromResources (const juce::String& typefaceName)
+{
+    if (loadedFonts.count (typefaceName) > 0)
         return true; // Already loaded
-    }
 
     int size;
     juce::String resName {typefaceName + ".ttf"};
@@ -440,9 +706,7 @@ bool NanoVGGraphicsContext::loadFontFromResources (const juce::String& typefaceN
 
         if (id >= 0)
         {
-            juce::Font tmpFont (juce::Typeface::createSystemTypefaceFor (ptr, size));
-            loadedFonts[typefaceName] = getGlyphToCharMapForFont (tmpFont);
-            currentGlyphToCharMap = &loadedFonts[typefaceName];
+            loadedFonts.insert (typefaceName);
             return true;
         }
     }
@@ -475,21 +739,37 @@ void NanoVGGraphicsContext::applyFillType()
             }
             else if (numColours > 1)
             {
+                std::vector<float> offsets ((size_t) numColours);
+                std::vector<NVGcolor> colours ((size_t) numColours);
+
+                for (int i = 0; i < numColours; ++i)
+                {
+                    offsets[(size_t) i] = (float) gradient->getColourPosition (i);
+                    colours[(size_t) i] = nvgColour (gradient->getColour (i));
+                }
+
                 NVGpaint p;
 
                 if (gradient->isRadial)
                 {
-                    p = nvgRadialGradient (nvg,
-                                           gradient->point1.getX(), gradient->point1.getY(),
-                                           gradient->point2.getX(), gradient->point2.getY(),
-                                           nvgColour (gradient->getColour (0)), nvgColour (gradient->getColour (numColours - 1)));
+                    p = nvgRadialGradientStops (nvg,
+                                                gradient->point1.getX(), gradient->point1.getY(),
+                                                0.0f, gradient->point1.getDistanceFrom (gradient->point2),
+                                                offsets.data(), colours.data(), numColours);
                 }
                 else
                 {
-                    p = nvgLinearGradient (nvg,
-                                           gradient->point1.getX(), gradient->point1.getY(),
-                                           gradient->point2.getX(), gradient->point2.getY(),
-                                           nvgColour (gradient->getColour (0)), nvgColour (gradient->getColour (numColours - 1)));
+                    p = nvgLinearGradientStops (nvg,
+                                                gradient->point1.getX(), gradient->point1.getY(),
+                                                gradient->point2.getX(), gradient->point2.getY(),
+                                                offsets.data(), colours.data(), numColours);
+                }
+
+                if (! fillType.transform.isIdentity())
+                {
+                    const auto& t = fillType.transform;
+                    const float xform[6] = { t.mat00, t.mat10, t.mat01, t.mat11, t.mat02, t.mat12 };
+                    nvgTransformMultiply (p.xform, xform);
                 }
 
                 nvgFillPaint (nvg, p);
@@ -509,8 +789,7 @@ void NanoVGGraphicsContext::applyStrokeType()
 
 void NanoVGGraphicsContext::applyFont()
 {
-    juce::String name {font.getTypefacePtr()->getName()};
-    name << "-" << font.getTypefaceStyle();
+    const auto name = getFontName (font);
 
     if (loadFontFromResources (name))
         nvgFontFace (nvg, name.toUTF8());
@@ -519,98 +798,3 @@ void NanoVGGraphicsContext::applyFont()
 
     nvgFontSize (nvg, font.getHeight());
 }
-
-int NanoVGGraphicsContext::getNvgImageId (const juce::Image& image)
-{
-    int id = -1;
-    const auto hash = getImageHash (image);
-    auto it = images.find (hash);
-
-    if (it == images.end())
-    {
-        // Nanovg expects images in RGBA format, so we do conversion here
-        juce::Image argbImage (image);
-        argbImage.duplicateIfShared();
-
-        argbImage = argbImage.convertedToFormat (juce::Image::PixelFormat::ARGB);
-        juce::Image::BitmapData bitmap (argbImage, juce::Image::BitmapData::readOnly);
-
-        for (int y = 0; y < argbImage.getHeight(); ++y)
-        {
-            auto* scanLine = (juce::uint32*) bitmap.getLinePointer (y);
-
-            for (int x = 0; x < argbImage.getWidth(); ++x)
-            {
-                juce::uint32 argb = scanLine[x];
-                juce::uint32 abgr =  (argb & 0xFF00FF00)          // a, g
-                            | ((argb & 0x000000FF) << 16)   // b
-                            | ((argb & 0x00FF0000) >> 16);  // r
-
-                scanLine[x] = abgr; // bytes order
-            }
-        }
-
-        id = nvgCreateImageRGBA (nvg, argbImage.getWidth(), argbImage.getHeight(), 0, bitmap.data);
-
-        if (images.size() >= maxImageCacheSize)
-            reduceImageCache();
-
-        images[hash] = { id, 1 };
-    }
-    else
-    {
-        it->second.accessCounter++;
-        id = it->second.id;
-    }
-
-    return id;
-}
-
-void NanoVGGraphicsContext::reduceImageCache()
-{
-    int minAccessCounter = 0;
-
-    for (auto it = images.begin(); it != images.end(); ++it)
-    {
-        minAccessCounter = minAccessCounter == 0 ? it->second.accessCounter
-                                                 : juce::jmin (minAccessCounter, it->second.accessCounter);
-    }
-
-    auto it = images.begin();
-
-    while (it != images.end())
-    {
-        if (it->second.accessCounter == minAccessCounter)
-        {
-            nvgDeleteImage (nvg, it->second.id);
-            it = images.erase(it);
-        }
-        else
-        {
-            it->second.accessCounter -= minAccessCounter;
-            ++it;
-        }
-    }
-}
-
-NanoVGGraphicsContext::GlyphToCharMap NanoVGGraphicsContext::getGlyphToCharMapForFont (const juce::Font& f)
-{
-    NanoVGGraphicsContext::GlyphToCharMap map;
-
-    if (auto tf = f.getTypefacePtr())
-    {
-        juce::Array<int> glyphs;
-        juce::Array<float> offsets;
-        tf->getGlyphPositions (allPrintableAsciiCharacters, glyphs, offsets);
-
-        // Make sure we get all the glyphs for the printable characters
-        jassert (glyphs.size() == allPrintableAsciiCharacters.length());
-
-        const auto* wstr = allPrintableAsciiCharacters.toWideCharPointer();
-
-        for (int i = 0; i < allPrintableAsciiCharacters.length(); ++i)
-            map[glyphs[i]] = wstr[i];
-    }
-
-    return map;
-}
@@ -10,6 +10,7 @@
 using namespace juce::gl;
 
 #include <nanovg.h>
+#include "NanoVGImageCache.h"
 
 #if defined NANOVG_GL2_IMPLEMENTATION
   #define NANOVG_GL_IMPLEMENTATION 1
@@ -48,6 +49,10 @@ class NanoVGGraphicsContext : public juce::LowLevelGraphicsContext
 {
 public:
     NanoVGGraphicsContext (void* nativeHandle, int width, int height, float scale);
+
+    /** Draws into a context created elsewhere, e.g. with nvgCreateSW(). The context is not deleted. */
+    NanoVGGraphicsContext (NVGcontext* context, int width, int height, float scale);
+
     ~NanoVGGraphicsContext();
 
     bool isVectorDevice() const override;
@@ -91,25 +96,62 @@ public:
     void drawGlyph (int glyphNumber, const juce::AffineTransform&) override;
     bool drawTextLayout (const juce::AttributedString&, const juce::Rectangle<float>&) override;
 
+    /** Draws the glyphs and rectangles buffered by drawGlyph() and fillRect(). This happens
+        whenever the state changes, but has to be done before nvgEndFrame() or drawing with nvg
+        directly.
+    */
+    void flush();
+
     void resized (int w, int h, float scale);
 
     void removeCachedImages();
 
+    /** Images known to the tracker are not listened to by the image cache, see NanoVGImageCache::Tracker. */
+    void setImageTracker (NanoVGImageCache::Tracker* tracker);
+
+    /** Sets the memory the textures of drawn images may use, see imageCacheBudget. */
+    void setImageCacheBudget (size_t budgetInBytes);
+
+    /** Limits the next update of a drawn image's texture to the given area, which can be called
+        after modifying a small part of a large image. From a paint() call the context is found with
+        dynamic_cast<NanoVGGraphicsContext*> (&g.getInternalContext()).
+    */
+    void invalidateImageRegion (const juce::Image& image, juce::Rectangle<int> area);
+
+    NanoVGImageCache::Stats getImageCacheStats() const;
+
     NVGcontext* getContext() const { return nvg; };
 
     const static juce::String defaultTypefaceName;
 
-    const static int imageCacheSize;
+    // Default byte budget of the textures of drawn images.
+    const static size_t imageCacheBudget;
+
+    // Byte budget of nanovg's retained path cache, see nvgBeginRetainedPath.
+    const static int pathCacheBudget;
 
 private:
 
+    void initialise();
+
     bool loadFontFromResources (const juce::String& typefaceName);
     void applyFillType();
     void applyStrokeType();
     void applyFont();
+    void flushGlyphs();
+
+    /** How the glyph numbers of a JUCE typeface relate to the font nanovg draws it with. */
+    struct GlyphMapping
+    {
+        // The typeface was loaded from the same file, its glyph numbers are nanovg's glyph indices.
+        bool indicesMatch = false;
+
+        // Otherwise the character of each glyph number, for the characters that were looked up.
+        std::unordered_map<int, juce::juce_wchar> characters;
+    };
 
-    int getNvgImageId (const juce::Image& image);
-    void reduceImageCache();
+    const GlyphMapping& getGlyphMapping();
+    void flushRects();
 
     NVGcontext* nvg;
 
@@ -120,22 +162,24 @@ private:
     juce::FillType fillType;
     juce::Font font;
 
-    // Mapping glyph number to a character
-    using GlyphToCharMap = std::map<int, wchar_t>;
+    // Command buffer reused by setPath, see nvgAppendPathCommands. Only the start of it is used.
+    std::vector<float> pathCommands;
 
-    GlyphToCharMap getGlyphToCharMapForFont (const juce::Font& f);
+    // Names of the fonts loaded into nanovg
+    std::set<juce::String> loadedFonts;
 
-    // Mapping font names to glyph-to-character tables
-    std::map<juce::String, GlyphToCharMap> loadedFonts;
-    const GlyphToCharMap* currentGlyphToCharMap;
+    // Glyph mappings of the typefaces drawn so far, by nanovg font name.
+    std::map<juce::String, GlyphMapping> glyphMappings;
 
-    // Tracking images mapped tomtextures.
-    struct NvgImage
-    {
-        int id {-1};            ///< Image/texture ID.
-        int accessCounter {0};  ///< Usage counter.
-    };
+    std::unique_ptr<NanoVGImageCache> imageCache;
+
+    // Glyph numbers and positions of the glyphs drawn since the last state change.
+    std::vector<int> glyphRun;
+    std::vector<float> glyphRunPositions;
 
+    // Rectangles filled since the last state change, as x, y, width and height.
+    std::vector<float> pendingRects;
 
-    std::map<juce::uint64, NvgImage> images;
+    // Opacity of each open transparency layer, or -1 for layers drawn with the global alpha.
+    std::vector<float> layerOpacities;
 };
@@ -0,0 +1,397 @@
+//
+//  Copyright (C) 2022 Arthur Benilov <arthur.benilov@gmail.com> and Timothy Schoen <timschoen123@gmail.com>
+//
+
+#include "NanoVGImageCache.h"
+
+// Large images are compared in tiles of this size when modified, smaller ones are updated whole.
+static constexpr int tileSize = 64;
+static constexpr int minTiledArea = 256 * 256;
+
+static juce::uint64 hashTile (const juce::Image::BitmapData& bitmap, juce::Rectangle<int> tile)
+{
+    const juce::uint64 prime = 1099511628211ull;
+    juce::uint64 h0 = 14695981039346656037ull, h1 = h0;
+
+    for (int y = tile.getY(); y < tile.getBottom(); ++y)
+    {
+        auto* pixels = reinterpret_cast<const juce::uint32*> (bitmap.getPixelPointer (tile.getX(), y));
+        int x = 0;
+
+        // Two independent lanes, so that the multiplications overlap.
+        for (; x + 4 <= tile.getWidth(); x += 4)
+        {
+            juce::uint64 a, b;
+            std::memcpy (&a, pixels + x, sizeof (a));
+            std::memcpy (&b, pixels + x + 2, sizeof (b));
+            h0 = (h0 ^ a) * prime;
+            h1 = (h1 ^ b) * prime;
+        }
+
+        for (; x < tile.getWidth(); ++x)
+            h0 = (h0 ^ pixels[x]) * prime;
+    }
+
+    return h0 ^ (h1 * prime);
+}
+
+NanoVGImageCache::NanoVGImageCache (NVGcontext* context, size_t budgetInBytes)
+    : nvg {context},
+      budget {budgetInBytes}
+{
+}
+
+NanoVGImageCache::~NanoVGImageCache()
+{
+    const juce::ScopedLock sl (lock);
+
+    for (auto& entry : entries)
+        if (! entry.tracked)
+            entry.pixelData->listeners.remove (this);
+}
+
+int NanoVGImageCache::getImageId (const juce::Image& image)
+{
+    auto* pixelData = image.getPixelData();
+
+    if (pixelData == nullptr)
+        return -1;
+
+    const juce::ScopedLock sl (lock);
+    const auto frame = nvgFrameIndex (nvg);
+
+    deleteOrphans();
+    removeDeletedImages();
+
+    // Tracked images are modified and deleted by another thread, whose listeners can't be used here.
+    juce::uint32 trackedGeneration = 0;
+    const bool tracked = tracker != nullptr && tracker->getGeneration (pixelData, trackedGeneration);
+
+    auto it = lookup.find (pixelData);
+
+    if (it != lookup.end())
+    {
+        auto& entry = *it->second;
+
+        entries.splice (entries.begin(), entries, it->second);
+        entry.lastUsedFrame = frame;
+
+        if (entry.tracked)
+            entry.generation = trackedGeneration;
+
+        if (entry.generation == entry.uploadedGeneration)
+        {
+            ++stats.hits;
+        }
+        else
+        {
+            entry.uploadedGeneration = entry.generation;
+            update (image, entry);
+        }
+
+        return entry.id;
+    }
+
+    ++stats.misses;
+
+    const int id = upload (image);
+
+    if (id < 0)
+        return -1;
+
+    const auto bytes = (size_t) image.getWidth() * (size_t) image.getHeight() * 4;
+
+    entries.push_front ({ pixelData, id, bytes, trackedGeneration, trackedGeneration, tracked, frame, {}, {} });
+    lookup[pixelData] = entries.begin();
+
+    if (! tracked)
+        pixelData->listeners.add (this);
+
+    stats.bytesResident += bytes;
+    stats.numImages = (int) entries.size();
+
+    trim();
+
+    return id;
+}
+
+void NanoVGImageCache::clear()
+{
+    const juce::ScopedLock sl (lock);
+
+    for (auto& entry : entries)
+    {
+        if (! entry.tracked)
+            entry.pixelData->listeners.remove (this);
+
+        deleteTexture (entry);
+    }
+
+    for (auto& entry : orphans)
+        deleteTexture (entry);
+
+    entries.clear();
+    lookup.clear();
+    orphans.clear();
+
+    stats.numImages = 0;
+}
+
+void NanoVGImageCache::setTracker (Tracker* trackerToUse)
+{
+    const juce::ScopedLock sl (lock);
+    tracker = trackerToUse;
+
+    // Taken before the next lookup, even if it is made in the current frame.
+    deletedImagesFrame = nvgFrameIndex (nvg) - 1;
+}
+
+void NanoVGImageCache::setBudget (size_t budgetInBytes)
+{
+    const juce::ScopedLock sl (lock);
+    budget = budgetInBytes;
+    trim();
+}
+
+void NanoVGImageCache::invalidateRegion (const juce::Image& image, juce::Rectangle<int> area)
+{
+    const juce::ScopedLock sl (lock);
+
+    auto it = lookup.find (image.getPixelData());
+
+    if (it != lookup.end())
+        it->second->dirtyRegion.add (area.getIntersection (image.getBounds()));
+}
+
+NanoVGImageCache::Stats NanoVGImageCache::getStats() const
+{
+    const juce::ScopedLock sl (lock);
+    return stats;
+}
+
+void NanoVGImageCache::resetStats()
+{
+    const juce::ScopedLock sl (lock);
+
+    const auto bytesResident = stats.bytesResident;
+    const auto numImages = stats.numImages;
+
+    stats = {};
+    stats.bytesResident = bytesResident;
+    stats.numImages = numImages;
+}
+
+void NanoVGImageCache::imageDataChanged (juce::ImagePixelData* pixelData)
+{
+    const juce::ScopedLock sl (lock);
+
+    auto it = lookup.find (pixelData);
+
+    if (it != lookup.end())
+        ++it->second->generation;
+}
+
+void NanoVGImageCache::imageDataBeingDeleted (juce::ImagePixelData* pixelData)
+{
+    const juce::ScopedLock sl (lock);
+    orphan (pixelData);
+}
+
+const juce::uint8* NanoVGImageCache::getPackedPixels (const juce::Image::BitmapData& bitmap)
+{
+    const auto rowBytes = (size_t) bitmap.width * 4;
+
+    if ((size_t) bitmap.lineStride == rowBytes)
+        return bitmap.data;
+
+    // Rows of clipped images are spaced by the stride of the image they are clipped from.
+    packedPixels.resize (rowBytes * (size_t) bitmap.height);
+
+    for (int y = 0; y < bitmap.height; ++y)
+        std::memcpy (packedPixels.data() + rowBytes * (size_t) y, bitmap.getLinePointer (y), rowBytes);
+
+    return packedPixels.data();
+}
+
+int NanoVGImageCache::upload (const juce::Image& image)
+{
+    // JUCE's ARGB images are premultiplied 32-bit pixels, i.e. BGRA bytes on little endian CPUs,
+    // which the back-end can sample as they are.
+    const auto argbImage = image.isARGB() ? image : image.convertedToFormat (juce::Image::ARGB);
+    const juce::Image::BitmapData bitmap (argbImage, juce::Image::BitmapData::readOnly);
+
+    ++stats.uploads;
+    stats.bytesUploaded += (juce::int64) bitmap.width * bitmap.height * 4;
+
+    return nvgCreateImageBGRA (nvg, bitmap.width, bitmap.height, NVG_IMAGE_PREMULTIPLIED, getPackedPixels (bitmap));
+}
+
+void NanoVGImageCache::update (const juce::Image& image, Entry& entry)
+{
+    const auto argbImage = image.isARGB() ? image : image.convertedToFormat (juce::Image::ARGB);
+    const juce::Image::BitmapData bitmap (argbImage, juce::Image::BitmapData::readOnly);
+    const auto bounds = argbImage.getBounds();
+
+    juce::RectangleList<int> region;
+
+    if (! entry.dirtyRegion.isEmpty())
+    {
+        region.swapWith (entry.dirtyRegion);
+
+        // Keeps the hashes of the tiles in sync with the texture.
+        if (! entry.tileHashes.empty())
+            hashTiles (bitmap, entry, region);
+    }
+    else if (! entry.tileHashes.empty())
+    {
+        region = hashTiles (bitmap, entry, bounds);
+    }
+    else
+    {
+        region = bounds;
+
+        // The image has been modified after it was first drawn, so it is likely to change again.
+        if (bounds.getWidth() * bounds.getHeight() >= minTiledArea)
+        {
+            entry.tileHashes.resize ((size_t) (((bounds.getWidth() + tileSize - 1) / tileSize)
+                                               * ((bounds.getHeight() + tileSize - 1) / tileSize)));
+            hashTiles (bitmap, entry, bounds);
+        }
+    }
+
+    if (region.isEmpty())
+        return;
+
+    const auto* pixels = getPackedPixels (bitmap);
+
+    for (const auto& r : region)
+    {
+        nvgUpdateImageRegion (nvg, entry.id, r.getX(), r.getY(), r.getWidth(), r.getHeight(), pixels);
+        stats.bytesUploaded += (juce::int64) r.getWidth() * r.getHeight() * 4;
+    }
+
+    ++stats.uploads;
+}
+
+juce::RectangleList<int> NanoVGImageCache::hashTiles (const juce::Image::BitmapData& bitmap, Entry& entry,
+                                                      const juce::RectangleList<int>& area)
+{
+    const int tilesX = (bitmap.width + tileSize - 1) / tileSize;
+    const juce::Rectangle<int> bounds (bitmap.width, bitmap.height);
+
+    juce::RectangleList<int> changed;
+
+    for (int ty = 0; ty * tileSize < bitmap.height; ++ty)
+    {
+        // Adjacent changed tiles of a row are merged into one rectangle.
+        juce::Rectangle<int> run;
+
+        for (int tx = 0; tx < tilesX; ++tx)
+        {
+            const auto tile = juce::Rectangle<int> (tx * tileSize, ty * tileSize, tileSize, tileSize).getIntersection (bounds);
+
+            if (! area.intersectsRectangle (tile))
+                continue;
+
+            const auto hash = hashTile (bitmap, tile);
+            auto& stored = entry.tileHashes[(size_t) (ty * tilesX + tx)];
+
+            if (hash == stored)
+                continue;
+
+            stored = hash;
+
+            if (! run.isEmpty() && run.getRight() == tile.getX())
+            {
+                run = run.getUnion (tile);
+            }
+            else
+            {
+                changed.add (run);
+                run = tile;
+            }
+        }
+
+        changed.add (run);
+    }
+
+    return changed;
+}
+
+void NanoVGImageCache::deleteTexture (const Entry& entry)
+{
+    nvgDeleteImage (nvg, entry.id);
+    stats.bytesResident -= entry.bytes;
+}
+
+void NanoVGImageCache::orphan (juce::ImagePixelData* pixelData)
+{
+    auto it = lookup.find (pixelData);
+
+    if (it == lookup.end())
+        return;
+
+    // This may be called on any thread, so the texture is deleted by the next getImageId() call.
+    orphans.push_back (std::move (*it->second));
+    entries.erase (it->second);
+    lookup.erase (it);
+
+    stats.numImages = (int) entries.size();
+}
+
+void NanoVGImageCache::deleteOrphans()
+{
+    const auto frame = nvgFrameIndex (nvg);
+
+    for (auto it = orphans.begin(); it != orphans.end();)
+    {
+        if (it->lastUsedFrame != frame)
+        {
+            deleteTexture (*it);
+            it = orphans.erase (it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void NanoVGImageCache::removeDeletedImages()
+{
+    const auto frame = nvgFrameIndex (nvg);
+
+    // The tracker reports an image before its memory is reused, and an image at the same address
+    // is drawn by a list replayed in a later frame, so the old entry is gone by then.
+    if (tracker == nullptr || frame == deletedImagesFrame)
+        return;
+
+    deletedImagesFrame = frame;
+    tracker->takeDeletedImages (deletedImages);
+
+    for (auto* pixelData : deletedImages)
+        orphan (pixelData);
+}
+
+void NanoVGImageCache::trim()
+{
+    const auto frame = nvgFrameIndex (nvg);
+
+    // Textures drawn in this frame are still referenced by its pending draw calls.
+    while (stats.bytesResident > budget && ! entries.empty() && entries.back().lastUsedFrame != frame)
+    {
+        auto& entry = entries.back();
+
+        if (! entry.tracked)
+            entry.pixelData->listeners.remove (this);
+
+        deleteTexture (entry);
+
+        lookup.erase (entry.pixelData);
+        entries.pop_back();
+
+        ++stats.evictions;
+    }
+
+    stats.numImages = (int) entries.size();
+}
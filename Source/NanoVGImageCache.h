@@ -0,0 +1,139 @@
+//
+//  Copyright (C) 2022 Arthur Benilov <arthur.benilov@gmail.com> and Timothy Schoen <timschoen123@gmail.com>
+//
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <nanovg.h>
+#include <list>
+#include <unordered_map>
+
+/**
+    Maps juce::Images to nanovg images.
+
+    Textures are keyed by the image's pixel data, and are updated when the pixels have been modified
+    since, e.g. by a Graphics or a writable BitmapData. Only the areas passed to invalidateRegion()
+    are updated, if any. Otherwise large images which have been modified before are compared in
+    tiles with the last upload, and only the changed tiles are updated.
+
+    When the textures exceed the byte budget, the least recently drawn ones are deleted, but never
+    one drawn in the current frame.
+
+    Images may be modified or deleted on any thread, while getImageId() is called from the thread
+    that owns the nanovg context. The cache listens to the images it draws, except those known to
+    its Tracker, whose listeners are only used by the thread which modifies them.
+*/
+class NanoVGImageCache : private juce::ImagePixelData::Listener
+{
+public:
+    struct Stats
+    {
+        juce::int64 hits {0};       ///< Lookups which found an up to date texture.
+        juce::int64 misses {0};     ///< Lookups which had to create a texture.
+        juce::int64 uploads {0};    ///< Texture uploads, including those of modified images.
+        juce::int64 evictions {0};  ///< Textures deleted to stay within the budget.
+        juce::int64 bytesUploaded {0};
+        size_t bytesResident {0};   ///< Memory of the textures in the cache.
+        int numImages {0};
+    };
+
+    /** Reports the modifications and deletions of images which another thread owns, e.g. copies
+        made for display lists, to a cache which cannot listen to them. Called with the lock of the
+        cache held, from its thread.
+    */
+    class Tracker
+    {
+    public:
+        virtual ~Tracker() = default;
+
+        /** Returns false if the image is not tracked, otherwise sets the number of times its
+            pixels have been modified.
+        */
+        virtual bool getGeneration (juce::ImagePixelData* pixelData, juce::uint32& generation) = 0;
+
+        /** Replaces the contents of the array with the tracked images deleted since the last call. */
+        virtual void takeDeletedImages (std::vector<juce::ImagePixelData*>& deleted) = 0;
+    };
+
+    NanoVGImageCache (NVGcontext* context, size_t budgetInBytes);
+
+    /** Textures are left to be deleted with the nanovg context. */
+    ~NanoVGImageCache() override;
+
+    /** Returns the nanovg image for drawing the image in the current frame, or -1 on failure. */
+    int getImageId (const juce::Image& image);
+
+    /** Marks an area of an image as modified, so that only the marked areas are updated when the
+        image is drawn next. Does nothing if the image isn't cached.
+    */
+    void invalidateRegion (const juce::Image& image, juce::Rectangle<int> area);
+
+    /** Deletes all textures. */
+    void clear();
+
+    /** Tracks some of the images instead of listening to them, or none if the tracker is null.
+        The tracker must outlive the calls to getImageId().
+    */
+    void setTracker (Tracker* trackerToUse);
+
+    void setBudget (size_t budgetInBytes);
+    size_t getBudget() const noexcept { return budget; }
+
+    Stats getStats() const;
+    void resetStats();
+
+private:
+    struct Entry
+    {
+        juce::ImagePixelData* pixelData;
+        int id;
+        size_t bytes;
+        juce::uint32 generation;          ///< Bumped whenever the pixels are modified.
+        juce::uint32 uploadedGeneration;  ///< Generation of the pixels in the texture.
+        bool tracked;                     ///< Known to the tracker, and not listened to.
+        unsigned int lastUsedFrame;
+        juce::RectangleList<int> dirtyRegion;     ///< Areas passed to invalidateRegion() since the upload.
+        std::vector<juce::uint64> tileHashes;     ///< Hashes of the uploaded tiles, if compared in tiles.
+    };
+
+    using EntryList = std::list<Entry>;
+
+    void imageDataChanged (juce::ImagePixelData*) override;
+    void imageDataBeingDeleted (juce::ImagePixelData*) override;
+
+    const juce::uint8* getPackedPixels (const juce::Image::BitmapData& bitmap);
+    int upload (const juce::Image& image);
+    void update (const juce::Image& image, Entry& entry);
+    juce::RectangleList<int> hashTiles (const juce::Image::BitmapData& bitmap, Entry& entry,
+                                        const juce::RectangleList<int>& area);
+    void deleteTexture (const Entry& entry);
+    void orphan (juce::ImagePixelData* pixelData);
+    void deleteOrphans();
+    void removeDeletedImages();
+    void trim();
+
+    NVGcontext* nvg;
+    size_t budget;
+
+    // Most recently used first.
+    EntryList entries;
+    std::unordered_map<juce::ImagePixelData*, EntryList::iterator> lookup;
+
+    // Textures of deleted images, kept until no frame draws them anymore.
+    std::vector<Entry> orphans;
+
+    // Deleted images are taken from the tracker once per frame, into a buffer kept for the next one.
+    Tracker* tracker {nullptr};
+    std::vector<juce::ImagePixelData*> deletedImages;
+    unsigned int deletedImagesFrame {0};
+
+    // Rows of images with padded rows, packed for uploading.
+    std::vector<juce::uint8> packedPixels;
+
+    Stats stats;
+
+    juce::CriticalSection lock;
+
+    JUCE_DECLARE_NON_COPYABLE (NanoVGImageCache)
+};
@@ -0,0 +1,105 @@
+//
+//  Copyright (C) 2022 Arthur Benilov <arthur.benilov@gmail.com> and Timothy Schoen <timschoen123@gmail.com>
+//
+
+#define NANOVG_SW_IMPLEMENTATION
+#include "NanoVGSoftwareRenderer.h"
+
+// juce::Image::ARGB is stored as BGRA on little endian machines.
+static_assert (juce::PixelARGB::indexA == 3 && juce::PixelARGB::indexB == 0,
+               "The software renderer writes BGRA pixels");
+
+NanoVGSoftwareRenderer::NanoVGSoftwareRenderer (int numThreads)
+    : pool (juce::jmax (1, numThreads - 1))
+{
+    nvg = nvgCreateSW (NVG_SW_ANTIALIAS | NVG_SW_BGRA);
+    jassert (nvg);
+
+    // The calling thread renders tiles too.
+    if (numThreads > 1)
+        nvgswSetParallelFor (nvg, parallelFor, this);
+}
+
+NanoVGSoftwareRenderer::~NanoVGSoftwareRenderer()
+{
+    graphicsContext.reset();
+
+    if (nvg != nullptr)
+        nvgDeleteSW (nvg);
+}
+
+void NanoVGSoftwareRenderer::parallelFor (void* userPtr, int count, NVGswTask task, void* arg)
+{
+    auto& self = *static_cast<NanoVGSoftwareRenderer*> (userPtr);
+
+    auto work = [&self, count, task, arg]
+    {
+        for (int i; (i = self.nextTile++) < count;)
+            task (arg, i);
+    };
+
+    const int numJobs = juce::jmin (self.pool.getNumThreads(), count - 1);
+
+    self.nextTile = 0;
+    self.runningJobs = numJobs;
+    self.jobsDone.reset();
+
+    for (int i = 0; i < numJobs; ++i)
+    {
+        self.pool.addJob ([&self, work]
+        {
+            work();
+
+            if (--self.runningJobs == 0)
+                self.jobsDone.signal();
+        });
+    }
+
+    work();
+
+    if (numJobs > 0)
+        self.jobsDone.wait();
+}
+
+NanoVGGraphicsContext& NanoVGSoftwareRenderer::beginFrame (int width, int height, float scale)
+{
+    const int pixelWidth = juce::roundToInt ((float) width * scale);
+    const int pixelHeight = juce::roundToInt ((float) height * scale);
+
+    if (image.getWidth() != pixelWidth || image.getHeight() != pixelHeight)
+        image = juce::Image (juce::Image::ARGB, juce::jmax (1, pixelWidth), juce::jmax (1, pixelHeight), true, juce::SoftwareImageType());
+    else
+        image.clear (image.getBounds());
+
+    // Software images keep their pixels in place, so the pointer stays valid for the frame.
+    juce::Image::BitmapData bitmap (image, juce::Image::BitmapData::readWrite);
+    nvgswSetTarget (nvg, bitmap.data, bitmap.width, bitmap.height, bitmap.lineStride);
+
+    if (graphicsContext == nullptr)
+        graphicsContext = std::make_unique<NanoVGGraphicsContext> (nvg, width, height, scale);
+    else
+        graphicsContext->resized (width, height, scale);
+
+    nvgBeginFrame (nvg, (float) width, (float) height, scale);
+
+    return *graphicsContext;
+}
+
+const juce::Image& NanoVGSoftwareRenderer::endFrame()
+{
+    if (graphicsContext != nullptr)
+        graphicsContext->flush();
+
+    nvgEndFrame (nvg);
+    return image;
+}
+
+const juce::Image& NanoVGSoftwareRenderer::renderComponent (juce::Component& component, float scale)
+{
+    {
+        juce::Graphics g (beginFrame (component.getWidth(), component.getHeight(), scale));
+        component.paintEntireComponent (g, true);
+    }
+
+    return endFrame();
+}
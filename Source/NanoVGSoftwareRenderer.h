@@ -0,0 +1,57 @@
+//
+//  Copyright (C) 2022 Arthur Benilov <arthur.benilov@gmail.com> and Timothy Schoen <timschoen123@gmail.com>
+//
+
+#pragma once
+
+#include "NanoVGGraphics.h"
+#include <nanovg_sw.h>
+
+/**
+    Renders with nanovg on the CPU into a juce::Image, for machines without a GPU.
+
+    Each frame is split into tiles which are rasterised in parallel on a thread pool.
+
+    @code
+    NanoVGSoftwareRenderer renderer;
+    auto& image = renderer.renderComponent (component, 2.0f);
+    @endcode
+*/
+class NanoVGSoftwareRenderer
+{
+public:
+    NanoVGSoftwareRenderer (int numThreads = juce::SystemStats::getNumCpus());
+    ~NanoVGSoftwareRenderer();
+
+    /** Starts a frame of the given size in logical pixels and clears the image.
+        Paint into the returned context, then call endFrame().
+    */
+    NanoVGGraphicsContext& beginFrame (int width, int height, float scale = 1.0f);
+
+    /** Rasterises the frame, returns the image of width * scale by height * scale pixels. */
+    const juce::Image& endFrame();
+
+    /** Paints the component and its children into the image. */
+    const juce::Image& renderComponent (juce::Component& component, float scale = 1.0f);
+
+    const juce::Image& getImage() const noexcept { return image; }
+
+    NVGcontext* getContext() const noexcept { return nvg; }
+
+private:
+    static void parallelFor (void* userPtr, int count, NVGswTask task, void* arg);
+
+    juce::ThreadPool pool;
+
+    // Shared with the jobs of the current parallelFor call.
+    std::atomic<int> nextTile {0};
+    std::atomic<int> runningJobs {0};
+    juce::WaitableEvent jobsDone;
+
+    NVGcontext* nvg {nullptr};
+    std::unique_ptr<NanoVGGraphicsContext> graphicsContext;
+
+    juce::Image image;
+
+    JUCE_DECLARE_NON_COPYABLE (NanoVGSoftwareRenderer)
+};